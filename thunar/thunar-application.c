@@ -41,6 +41,8 @@
 #include <gudev/gudev.h>
 #endif
 
+#include <glib/gstdio.h>
+
 #include <libxfce4ui/libxfce4ui.h>
 
 #include <thunar/thunar-application.h>
@@ -50,17 +52,23 @@
 #include <thunar/thunar-gdk-extensions.h>
 #include <thunar/thunar-gobject-extensions.h>
 #include <thunar/thunar-io-jobs.h>
+#include <thunar/thunar-io-trash.h>
 #include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-progress-dialog.h>
 #include <thunar/thunar-renamer-dialog.h>
 #include <thunar/thunar-thumbnail-cache.h>
 #include <thunar/thunar-thumbnailer.h>
+#include <thunar/thunar-transfer-job.h>
+#include <thunar/thunar-transfer-journal.h>
 #include <thunar/thunar-util.h>
 #include <thunar/thunar-view.h>
 
 #define ACCEL_MAP_PATH "Thunar/accels.scm"
 
+/* seconds after startup to continue an interrupted trash purge */
+#define TRASH_PURGE_DELAY 30
+
 
 
 /* Prototype for the Thunar job launchers */
@@ -74,6 +82,7 @@ enum
 {
   PROP_0,
   PROP_DAEMON,
+  PROP_PENDING_TRANSFERS,
 };
 
 
@@ -89,6 +98,15 @@ static void           thunar_application_set_property           (GObject
                                                                  GParamSpec             *pspec);
 static void           thunar_application_accel_map_changed      (ThunarApplication      *application);
 static gboolean       thunar_application_accel_map_save         (gpointer                user_data);
+static gboolean       thunar_application_trash_purge            (gpointer                user_data);
+static void           thunar_application_scan_transfers         (ThunarApplication      *application);
+static gpointer       thunar_application_scan_transfers_thread  (gpointer                user_data);
+static gboolean       thunar_application_scan_transfers_idle    (gpointer                user_data);
+static gboolean       thunar_application_rescan_transfers_idle  (gpointer                user_data);
+static void           thunar_application_transfer_job_gone      (gpointer                user_data,
+                                                                 GObject                *where_the_object_was);
+static void           thunar_application_set_pending_transfers  (ThunarApplication      *application,
+                                                                 gboolean                pending_transfers);
 static void           thunar_application_collect_and_launch     (ThunarApplication      *application,
                                                                  gpointer                parent,
                                                                  const gchar            *icon_name,
@@ -99,6 +117,12 @@ static void           thunar_application_collect_and_launch     (ThunarApplicati
                                                                  GClosure               *new_files_closure);
 static void           thunar_application_launch_finished        (ThunarJob              *job,
                                                                  ThunarView             *view);
+static void           thunar_application_launch_job             (ThunarApplication      *application,
+                                                                 gpointer                parent,
+                                                                 const gchar            *icon_name,
+                                                                 const gchar            *title,
+                                                                 ThunarJob              *job,
+                                                                 GClosure               *new_files_closure);
 static void           thunar_application_launch                 (ThunarApplication      *application,
                                                                  gpointer                parent,
                                                                  const gchar            *icon_name,
@@ -151,6 +175,16 @@ struct _ThunarApplication
 
   guint                  show_dialogs_timer_id;
 
+  guint                  trash_purge_id;
+
+  /* whether journals of interrupted transfers were found */
+  gboolean               pending_transfers;
+  gboolean               transfers_found;
+  guint                  transfers_scanning : 1;
+  guint                  transfers_rescan : 1;
+  guint                  transfers_rescan_id;
+  GSList                *transfer_jobs;
+
 #ifdef HAVE_GUDEV
   GUdevClient           *udev_client;
 
@@ -208,6 +242,20 @@ thunar_application_class_init (ThunarApplicationClass *klass)
                                                          "daemon",
                                                          FALSE,
                                                          EXO_PARAM_READWRITE));
+
+  /**
+   * ThunarApplication:pending-transfers:
+   *
+   * %TRUE if journals of interrupted copy or move operations
+   * were found, which can be resumed or discarded.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_PENDING_TRANSFERS,
+                                   g_param_spec_boolean ("pending-transfers",
+                                                         "pending-transfers",
+                                                         "pending-transfers",
+                                                         FALSE,
+                                                         EXO_PARAM_READABLE));
 }
 
 
@@ -240,6 +288,17 @@ thunar_application_init (ThunarApplication *application)
   g_signal_connect_swapped (G_OBJECT (application->accel_map), "changed",
       G_CALLBACK (thunar_application_accel_map_changed), application);
 
+  /* delete what an earlier "Empty Trash" left behind, once things calmed down */
+  application->trash_purge_id =
+      g_timeout_add_seconds_full (G_PRIORITY_LOW, TRASH_PURGE_DELAY, thunar_application_trash_purge,
+                                  application, NULL);
+
+  /* look for interrupted transfers in the background, and again
+   * whenever the journal is switched on or off */
+  thunar_application_scan_transfers (application);
+  g_signal_connect_swapped (G_OBJECT (application->preferences), "notify::misc-transfer-journal",
+                            G_CALLBACK (thunar_application_scan_transfers), application);
+
 #ifdef HAVE_GUDEV
   /* establish connection with udev */
   application->udev_client = g_udev_client_new (subsystems);
@@ -257,6 +316,7 @@ static void
 thunar_application_finalize (GObject *object)
 {
   ThunarApplication *application = THUNAR_APPLICATION (object);
+  GSList            *slp;
   GList             *lp;
 
   /* unqueue all files waiting to be processed */
@@ -272,6 +332,18 @@ thunar_application_finalize (GObject *object)
   if (application->accel_map != NULL)
     g_object_unref (G_OBJECT (application->accel_map));
 
+  /* drop the pending trash purge */
+  if (G_UNLIKELY (application->trash_purge_id != 0))
+    g_source_remove (application->trash_purge_id);
+
+  /* stop watching the transfer jobs */
+  for (slp = application->transfer_jobs; slp != NULL; slp = slp->next)
+    g_object_weak_unref (G_OBJECT (slp->data), thunar_application_transfer_job_gone, application);
+  g_slist_free (application->transfer_jobs);
+
+  if (G_UNLIKELY (application->transfers_rescan_id != 0))
+    g_source_remove (application->transfers_rescan_id);
+
 #ifdef HAVE_GUDEV
   /* cancel any pending volman watch source */
   if (G_UNLIKELY (application->volman_watch_id != 0))
@@ -309,6 +381,8 @@ thunar_application_finalize (GObject *object)
     g_object_unref (G_OBJECT (application->thumbnail_cache));
 
   /* disconnect from the preferences */
+  g_signal_handlers_disconnect_by_func (G_OBJECT (application->preferences),
+                                        thunar_application_scan_transfers, application);
   g_object_unref (G_OBJECT (application->preferences));
   
   (*G_OBJECT_CLASS (thunar_application_parent_class)->finalize) (object);
@@ -330,6 +404,10 @@ thunar_application_get_property (GObject    *object,
       g_value_set_boolean (value, thunar_application_get_daemon (application));
       break;
 
+    case PROP_PENDING_TRANSFERS:
+      g_value_set_boolean (value, thunar_application_get_pending_transfers (application));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -384,6 +462,153 @@ thunar_application_accel_map_save (gpointer user_data)
 
 
 
+static gboolean
+thunar_application_trash_purge (gpointer user_data)
+{
+  ThunarApplication *application = THUNAR_APPLICATION (user_data);
+
+  _thunar_return_val_if_fail (THUNAR_IS_APPLICATION (application), FALSE);
+
+  application->trash_purge_id = 0;
+
+  /* runs in its own thread with a low priority */
+  thunar_io_trash_purge ();
+
+  return FALSE;
+}
+
+
+
+static void
+thunar_application_scan_transfers (ThunarApplication *application)
+{
+  gboolean enabled;
+
+  _thunar_return_if_fail (THUNAR_IS_APPLICATION (application));
+
+  /* without the journal, there is nothing to look for */
+  g_object_get (G_OBJECT (application->preferences), "misc-transfer-journal", &enabled, NULL);
+  if (!enabled)
+    {
+      /* let a running scan discard its result */
+      application->transfers_rescan = application->transfers_scanning;
+      thunar_application_set_pending_transfers (application, FALSE);
+      return;
+    }
+
+  /* scan again once the running scan is done */
+  if (application->transfers_scanning)
+    {
+      application->transfers_rescan = TRUE;
+      return;
+    }
+
+  /* the journal directory is scanned and every journal is probed
+   * for its lock, keep that away from the main thread */
+  application->transfers_scanning = TRUE;
+  g_object_ref (G_OBJECT (application));
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_thread_unref (g_thread_new ("thunar-transfers", thunar_application_scan_transfers_thread, application));
+#else
+  g_thread_create (thunar_application_scan_transfers_thread, application, FALSE, NULL);
+#endif
+}
+
+
+
+static gpointer
+thunar_application_scan_transfers_thread (gpointer user_data)
+{
+  ThunarApplication *application = THUNAR_APPLICATION (user_data);
+  GList             *journal_paths;
+
+  journal_paths = thunar_transfer_journal_list_pending ();
+  application->transfers_found = (journal_paths != NULL);
+  g_list_free_full (journal_paths, g_free);
+
+  /* report back to the main thread, which drops our reference */
+  g_idle_add (thunar_application_scan_transfers_idle, application);
+
+  return NULL;
+}
+
+
+
+static gboolean
+thunar_application_scan_transfers_idle (gpointer user_data)
+{
+  ThunarApplication *application = THUNAR_APPLICATION (user_data);
+
+  _thunar_return_val_if_fail (THUNAR_IS_APPLICATION (application), FALSE);
+
+  application->transfers_scanning = FALSE;
+
+  if (application->transfers_rescan)
+    {
+      /* the result is outdated already */
+      application->transfers_rescan = FALSE;
+      thunar_application_scan_transfers (application);
+    }
+  else
+    {
+      thunar_application_set_pending_transfers (application, application->transfers_found);
+    }
+
+  g_object_unref (G_OBJECT (application));
+
+  return FALSE;
+}
+
+
+
+static gboolean
+thunar_application_rescan_transfers_idle (gpointer user_data)
+{
+  ThunarApplication *application = THUNAR_APPLICATION (user_data);
+
+  application->transfers_rescan_id = 0;
+  thunar_application_scan_transfers (application);
+
+  return FALSE;
+}
+
+
+
+static void
+thunar_application_transfer_job_gone (gpointer  user_data,
+                                      GObject  *where_the_object_was)
+{
+  ThunarApplication *application = THUNAR_APPLICATION (user_data);
+
+  application->transfer_jobs = g_slist_remove (application->transfer_jobs, where_the_object_was);
+
+  /* the journal of a failed transfer is only released once the job is
+   * gone, so look for it after the job was finalized */
+  if (application->transfers_rescan_id == 0)
+    {
+      application->transfers_rescan_id =
+          g_idle_add_full (G_PRIORITY_LOW, thunar_application_rescan_transfers_idle,
+                           application, NULL);
+    }
+}
+
+
+
+static void
+thunar_application_set_pending_transfers (ThunarApplication *application,
+                                          gboolean           pending_transfers)
+{
+  _thunar_return_if_fail (THUNAR_IS_APPLICATION (application));
+
+  if (application->pending_transfers != pending_transfers)
+    {
+      application->pending_transfers = pending_transfers;
+      g_object_notify (G_OBJECT (application), "pending-transfers");
+    }
+}
+
+
+
 static void
 thunar_application_accel_map_changed (ThunarApplication *application)
 {
@@ -503,27 +728,22 @@ thunar_application_launch_finished (ThunarJob  *job,
 
 
 static void
-thunar_application_launch (ThunarApplication *application,
-                           gpointer           parent,
-                           const gchar       *icon_name,
-                           const gchar       *title,
-                           Launcher           launcher,
-                           GList             *source_file_list,
-                           GList             *target_file_list,
-                           GClosure          *new_files_closure)
+thunar_application_launch_job (ThunarApplication *application,
+                               gpointer           parent,
+                               const gchar       *icon_name,
+                               const gchar       *title,
+                               ThunarJob         *job,
+                               GClosure          *new_files_closure)
 {
   GtkWidget *dialog;
   GdkScreen *screen;
-  ThunarJob *job;
 
   _thunar_return_if_fail (parent == NULL || GDK_IS_SCREEN (parent) || GTK_IS_WIDGET (parent));
+  _thunar_return_if_fail (THUNAR_IS_JOB (job));
 
   /* parse the parent pointer */
   screen = thunar_util_parse_parent (parent, NULL);
 
-  /* try to allocate a new job for the operation */
-  job = (*launcher) (source_file_list, target_file_list);
-
   if (THUNAR_IS_VIEW (parent))
     {
       /* connect a callback to instantly refresh the thunar view */
@@ -542,6 +762,13 @@ thunar_application_launch (ThunarApplication *application,
   if (G_LIKELY (new_files_closure != NULL))
     g_signal_connect_closure (job, "new-files", new_files_closure, FALSE);
 
+  /* a failed transfer leaves a journal behind that can be resumed */
+  if (THUNAR_IS_TRANSFER_JOB (job))
+    {
+      g_object_weak_ref (G_OBJECT (job), thunar_application_transfer_job_gone, application);
+      application->transfer_jobs = g_slist_prepend (application->transfer_jobs, job);
+    }
+
   /* get the shared progress dialog */
   dialog = thunar_application_get_progress_dialog (application);
 
@@ -574,6 +801,30 @@ thunar_application_launch (ThunarApplication *application,
                                 application, thunar_application_show_dialogs_destroy);
         }
     }
+}
+
+
+
+static void
+thunar_application_launch (ThunarApplication *application,
+                           gpointer           parent,
+                           const gchar       *icon_name,
+                           const gchar       *title,
+                           Launcher           launcher,
+                           GList             *source_file_list,
+                           GList             *target_file_list,
+                           GClosure          *new_files_closure)
+{
+  ThunarJob *job;
+
+  _thunar_return_if_fail (parent == NULL || GDK_IS_SCREEN (parent) || GTK_IS_WIDGET (parent));
+
+  /* try to allocate a new job for the operation */
+  job = (*launcher) (source_file_list, target_file_list);
+
+  /* hook it up with the view and the progress dialog */
+  thunar_application_launch_job (application, parent, icon_name, title,
+                                 job, new_files_closure);
 
   /* drop our reference on the job */
   g_object_unref (job);
@@ -878,6 +1129,24 @@ thunar_application_set_daemon (ThunarApplication *application,
 
 
 
+/**
+ * thunar_application_get_pending_transfers:
+ * @application : a #ThunarApplication.
+ *
+ * Returns %TRUE if journals of interrupted transfers were found,
+ * see thunar_application_resume_transfers().
+ *
+ * Return value: %TRUE if there are transfers to resume.
+ **/
+gboolean
+thunar_application_get_pending_transfers (ThunarApplication *application)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_APPLICATION (application), FALSE);
+  return application->pending_transfers;
+}
+
+
+
 /**
  * thunar_application_get_windows:
  * @application : a #ThunarApplication.
@@ -1740,6 +2009,94 @@ thunar_application_move_into (ThunarApplication *application,
 
 
 
+/**
+ * thunar_application_resume_transfers:
+ * @application : a #ThunarApplication.
+ * @parent      : a #GdkScreen, a #GtkWidget or %NULL.
+ *
+ * Resumes the copy and move operations that were interrupted by
+ * cancellation or a crash, and for which a journal was kept. Files
+ * that were already transferred are not touched again.
+ **/
+void
+thunar_application_resume_transfers (ThunarApplication *application,
+                                     gpointer           parent)
+{
+  ThunarJob *job;
+  GError    *err = NULL;
+  GList     *journal_paths;
+  GList     *lp;
+
+  _thunar_return_if_fail (parent == NULL || GDK_IS_SCREEN (parent) || GTK_IS_WIDGET (parent));
+  _thunar_return_if_fail (THUNAR_IS_APPLICATION (application));
+
+  journal_paths = thunar_transfer_journal_list_pending ();
+  for (lp = journal_paths; lp != NULL; lp = lp->next)
+    {
+      job = thunar_io_jobs_resume_transfer (lp->data, &err);
+      if (G_LIKELY (job != NULL))
+        {
+          thunar_application_launch_job (application, parent, "stock_folder-copy",
+                                         _("Resuming transfer..."), job, NULL);
+          g_object_unref (job);
+        }
+      else if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_BUSY))
+        {
+          /* busy journals were resumed by someone else in the meantime */
+          thunar_dialogs_show_error (parent, err, _("Failed to resume transfer"));
+
+          /* a broken journal will never be resumable */
+          if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+            g_unlink (lp->data);
+        }
+
+      g_clear_error (&err);
+    }
+
+  g_list_free_full (journal_paths, g_free);
+
+  /* the journals are in use now, or were dropped */
+  thunar_application_set_pending_transfers (application, FALSE);
+}
+
+
+
+/**
+ * thunar_application_discard_transfers:
+ * @application : a #ThunarApplication.
+ *
+ * Deletes the journals of the interrupted copy and move operations,
+ * so they are no longer offered for resuming, along with the files
+ * they left incomplete. The files that were transferred completely
+ * are left alone.
+ **/
+void
+thunar_application_discard_transfers (ThunarApplication *application)
+{
+  GError *err = NULL;
+  GList  *journal_paths;
+  GList  *lp;
+
+  _thunar_return_if_fail (THUNAR_IS_APPLICATION (application));
+
+  /* journals in use by a transfer are not listed */
+  journal_paths = thunar_transfer_journal_list_pending ();
+  for (lp = journal_paths; lp != NULL; lp = lp->next)
+    {
+      /* a broken journal can only be dropped as it is */
+      if (!thunar_transfer_journal_discard (lp->data, &err)
+          && g_error_matches (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+        g_unlink (lp->data);
+
+      g_clear_error (&err);
+    }
+  g_list_free_full (journal_paths, g_free);
+
+  thunar_application_set_pending_transfers (application, FALSE);
+}
+
+
+
 static ThunarJob *
 unlink_stub (GList *source_path_list,
              GList *target_path_list)
@@ -1749,6 +2106,15 @@ unlink_stub (GList *source_path_list,
 
 
 
+static ThunarJob *
+empty_trash_stub (GList *source_path_list,
+                  GList *target_path_list)
+{
+  return thunar_io_jobs_empty_trash ();
+}
+
+
+
 /**
  * thunar_application_unlink_files:
  * @application : a #ThunarApplication.
@@ -1985,6 +2351,7 @@ thunar_application_empty_trash (ThunarApplication *application,
   GtkWindow *window;
   GdkScreen *screen;
   GList      file_list;
+  gboolean   in_background;
   gint       response;
 
   _thunar_return_if_fail (THUNAR_IS_APPLICATION (application));
@@ -2024,10 +2391,16 @@ thunar_application_empty_trash (ThunarApplication *application,
       file_list.next = NULL;
       file_list.prev = NULL;
 
+      /* check whether the local trash folders should only be moved aside
+       * and deleted in the background, which empties the Trash at once */
+      g_object_get (G_OBJECT (application->preferences),
+                    "misc-empty-trash-in-background", &in_background, NULL);
+
       /* launch the operation */
       thunar_application_launch (application, parent, "user-trash",
                                  _("Emptying the Trash..."),
-                                 unlink_stub, &file_list, NULL, NULL);
+                                 in_background ? empty_trash_stub : unlink_stub,
+                                 &file_list, NULL, NULL);
 
       /* cleanup */
       g_object_unref (file_list.data);
@@ -46,6 +46,8 @@ gboolean              thunar_application_get_daemon                 (ThunarAppli
 void                  thunar_application_set_daemon                 (ThunarApplication *application,
                                                                      gboolean           daemon);
 
+gboolean              thunar_application_get_pending_transfers      (ThunarApplication *application);
+
 GList                *thunar_application_get_windows                (ThunarApplication *application);
 
 gboolean              thunar_application_has_windows                (ThunarApplication *application);
@@ -113,6 +115,11 @@ void                  thunar_application_move_into                 (ThunarApplic
                                                                     GFile             *target_file,
                                                                     GClosure          *new_files_closure);
 
+void                  thunar_application_resume_transfers          (ThunarApplication *application,
+                                                                    gpointer           parent);
+
+void                  thunar_application_discard_transfers         (ThunarApplication *application);
+
 void                  thunar_application_unlink_files              (ThunarApplication *application,
                                                                     gpointer           parent,
                                                                     GList             *file_list,
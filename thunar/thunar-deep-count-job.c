@@ -19,20 +19,68 @@
  * MA  02111-1307  USA
  */
 
+/* statx() is a GNU extension */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
 
 #include <thunar/thunar-deep-count-job.h>
+#include <thunar/thunar-io-jobs-util.h>
 #include <thunar/thunar-job.h>
 #include <thunar/thunar-marshal.h>
+#include <thunar/thunar-preferences.h>
+#include <thunar/thunar-size-cache.h>
 #include <thunar/thunar-util.h>
 #include <thunar/thunar-private.h>
 
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_FSTATAT)
+#define DEEP_COUNT_NATIVE 1
+#endif
+
 
 
 /* Signal identifiers */
@@ -46,7 +94,26 @@ enum
 #define DEEP_COUNT_FILE_INFO_NAMESPACE \
   G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
   G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
-  G_FILE_ATTRIBUTE_ID_FILESYSTEM
+  G_FILE_ATTRIBUTE_ID_FILESYSTEM "," \
+  G_FILE_ATTRIBUTE_UNIX_BLOCKS "," \
+  G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+  G_FILE_ATTRIBUTE_UNIX_INODE "," \
+  G_FILE_ATTRIBUTE_UNIX_NLINK
+
+/* interval between two status updates, in microseconds */
+#define STATUS_INTERVAL (G_USEC_PER_SEC / 4)
+
+/* folders modified less than this many seconds ago are not cached,
+ * they could change again within the same timestamp */
+#define SIZE_CACHE_MIN_AGE (2)
+
+
+
+typedef struct _ThunarDeepCountSlot ThunarDeepCountSlot;
+typedef struct _ThunarDeepCountTask ThunarDeepCountTask;
+typedef struct _ThunarDeepCountWalk ThunarDeepCountWalk;
+
+
 
 static void     thunar_deep_count_job_finalize   (GObject                 *object);
 static gboolean thunar_deep_count_job_execute    (ExoJob                  *job,
@@ -61,6 +128,7 @@ struct _ThunarDeepCountJobClass
   /* signals */
   void (*status_update) (ThunarJob *job,
                          guint64    total_size,
+                         guint64    allocated_size,
                          guint      file_count,
                          guint      directory_count,
                          guint      unreadable_directory_count);
@@ -73,16 +141,68 @@ struct _ThunarDeepCountJob
   GList              *files;
   GFileQueryInfoFlags query_flags;
 
+  /* number of folders read in parallel for local files */
+  guint               n_threads;
+
   /* the time of the last "status-update" emission */
   gint64              last_time;
 
+  /* inodes with more than one link that were counted already */
+  GHashTable         *links;
+
+  /* contents of the folders counted before */
+  ThunarSizeCache    *size_cache;
+
   /* status information */
   guint64             total_size;
+  guint64             allocated_size;
   guint               file_count;
   guint               directory_count;
   guint               unreadable_directory_count;
 };
 
+#ifdef DEEP_COUNT_NATIVE
+/* counters of a worker, merged into the job by the job thread
+ * whenever the worker is not using them */
+struct _ThunarDeepCountSlot
+{
+  guint64 total_size;
+  guint64 allocated_size;
+  guint   file_count;
+  guint   directory_count;
+  guint   unreadable_directory_count;
+
+  /* ThunarSizeCacheLink<!---->s, deduplicated by the job thread */
+  GArray *links;
+};
+
+/* a folder to read */
+struct _ThunarDeepCountTask
+{
+  gchar  *path;
+  guint64 dev;
+
+  /* the opened folder or -1 */
+  gint    fd;
+};
+
+struct _ThunarDeepCountWalk
+{
+  GCancellable    *cancellable;
+  GThreadPool     *pool;
+  ThunarSizeCache *size_cache;
+
+  /* the unused ThunarDeepCountSlot<!---->s */
+  GAsyncQueue     *slots;
+  guint            n_slots;
+
+  /* number of queued and running tasks and the queue
+   * that wakes up the job thread when it drops to 0 */
+  volatile gint    n_pending;
+  GAsyncQueue     *done;
+};
+#endif
+
 
 
 static guint deep_count_signals[LAST_SIGNAL];
@@ -96,25 +216,27 @@ G_DEFINE_TYPE (ThunarDeepCountJob, thunar_deep_count_job, THUNAR_TYPE_JOB)
 static void
 thunar_deep_count_job_class_init (ThunarDeepCountJobClass *klass)
 {
-  ExoJobClass  *job_class;
-  GObjectClass *gobject_class;
+  ThunarJobClass *job_class;
+  GObjectClass   *gobject_class;
 
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->finalize = thunar_deep_count_job_finalize;
 
-  job_class = EXO_JOB_CLASS (klass);
+  job_class = THUNAR_JOB_CLASS (klass);
   job_class->execute = thunar_deep_count_job_execute;
 
   /**
    * ThunarDeepCountJob::status-update:
    * @job                        : a #ThunarJob.
    * @total_size                 : the total size in bytes.
+   * @allocated_size             : the disk space used, in bytes.
    * @file_count                 : the number of files.
    * @directory_count            : the number of directories.
    * @unreadable_directory_count : the number of unreadable directories.
    *
    * Emitted by the @job to inform listeners about the number of files,
-   * directories and bytes counted so far.
+   * directories and bytes counted so far. Files with several hard
+   * links are only counted once.
    **/
   deep_count_signals[STATUS_UPDATE] =
     g_signal_new ("status-update",
@@ -122,8 +244,9 @@ thunar_deep_count_job_class_init (ThunarDeepCountJobClass *klass)
                   G_SIGNAL_NO_HOOKS,
                   G_STRUCT_OFFSET (ThunarDeepCountJobClass, status_update),
                   NULL, NULL,
-                  _thunar_marshal_VOID__UINT64_UINT_UINT_UINT,
-                  G_TYPE_NONE, 4,
+                  _thunar_marshal_VOID__UINT64_UINT64_UINT_UINT_UINT,
+                  G_TYPE_NONE, 5,
+                  G_TYPE_UINT64,
                   G_TYPE_UINT64,
                   G_TYPE_UINT,
                   G_TYPE_UINT,
@@ -132,10 +255,39 @@ thunar_deep_count_job_class_init (ThunarDeepCountJobClass *klass)
 
 
 
+static guint
+thunar_deep_count_link_hash (gconstpointer key)
+{
+  const ThunarSizeCacheLink *link = key;
+
+  return (guint) (link->ino ^ (link->ino >> 32) ^ link->dev);
+}
+
+
+
+static gboolean
+thunar_deep_count_link_equal (gconstpointer a,
+                              gconstpointer b)
+{
+  const ThunarSizeCacheLink *link_a = a;
+  const ThunarSizeCacheLink *link_b = b;
+
+  return link_a->ino == link_b->ino && link_a->dev == link_b->dev;
+}
+
+
+
 static void
 thunar_deep_count_job_init (ThunarDeepCountJob *job)
 {
   job->query_flags = G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS;
+  job->n_threads = 1;
+  job->links = g_hash_table_new_full (thunar_deep_count_link_hash,
+                                      thunar_deep_count_link_equal,
+                                      g_free, NULL);
+  job->size_cache = thunar_size_cache_get ();
+
+  thunar_job_set_priority (THUNAR_JOB (job), THUNAR_JOB_PRIORITY_DEEP_COUNT);
 }
 
 
@@ -146,6 +298,8 @@ thunar_deep_count_job_finalize (GObject *object)
   ThunarDeepCountJob *job = THUNAR_DEEP_COUNT_JOB (object);
 
   g_list_free_full (job->files, g_object_unref);
+  g_hash_table_destroy (job->links);
+  g_object_unref (job->size_cache);
 
   (*G_OBJECT_CLASS (thunar_deep_count_job_parent_class)->finalize) (object);
 }
@@ -161,6 +315,7 @@ thunar_deep_count_job_status_update (ThunarDeepCountJob *job)
                 deep_count_signals[STATUS_UPDATE],
                 0,
                 job->total_size,
+                job->allocated_size,
                 job->file_count,
                 job->directory_count,
                 job->unreadable_directory_count);
@@ -168,6 +323,27 @@ thunar_deep_count_job_status_update (ThunarDeepCountJob *job)
 
 
 
+/* counts a file once, no matter how many hard links it has */
+static void
+thunar_deep_count_job_add_link (ThunarDeepCountJob        *job,
+                                const ThunarSizeCacheLink *link)
+{
+  ThunarSizeCacheLink *key;
+
+  if (g_hash_table_lookup_extended (job->links, link, NULL, NULL))
+    return;
+
+  key = g_new (ThunarSizeCacheLink, 1);
+  *key = *link;
+  g_hash_table_insert (job->links, key, NULL);
+
+  job->file_count++;
+  job->total_size += link->size;
+  job->allocated_size += link->allocated_size;
+}
+
+
+
 static gboolean
 thunar_deep_count_job_process (ExoJob       *job,
                                GFile        *file,
@@ -176,6 +352,7 @@ thunar_deep_count_job_process (ExoJob       *job,
                                GError      **error)
 {
   ThunarDeepCountJob *count_job = THUNAR_DEEP_COUNT_JOB (job);
+  ThunarSizeCacheLink link;
   GFileEnumerator    *enumerator;
   GFileInfo          *child_info;
   GFileInfo          *info;
@@ -314,16 +491,33 @@ thunar_deep_count_job_process (ExoJob       *job,
         {
           if (count_job->last_time != 0)
             thunar_deep_count_job_status_update (count_job);
-          count_job->last_time = real_time + (G_USEC_PER_SEC / 4);
+          count_job->last_time = real_time + STATUS_INTERVAL;
         }
     }
   else
     {
       /* we have a regular file or at least not a directory */
-      count_job->file_count++;
+      link.size = g_file_info_get_size (info);
+
+      /* not all backends know the disk usage */
+      if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_BLOCKS))
+        link.allocated_size = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_BLOCKS) * 512;
+      else
+        link.allocated_size = link.size;
 
-      /* add size of the file to the total size */
-      count_job->total_size += g_file_info_get_size (info);
+      if (g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) > 1)
+        {
+          /* hard links to the same inode only count once */
+          link.dev = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+          link.ino = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+          thunar_deep_count_job_add_link (count_job, &link);
+        }
+      else
+        {
+          count_job->file_count++;
+          count_job->total_size += link.size;
+          count_job->allocated_size += link.allocated_size;
+        }
     }
 
   /* destroy the file info */
@@ -336,15 +530,458 @@ thunar_deep_count_job_process (ExoJob       *job,
 
 
 
+#ifdef DEEP_COUNT_NATIVE
+static gboolean
+thunar_deep_count_job_stat (gint                 dir_fd,
+                            const gchar         *name,
+                            gboolean            *is_dir,
+                            guint               *n_links,
+                            ThunarSizeCacheLink *link)
+{
+  struct stat statb;
+#ifdef HAVE_STATX
+  struct statx stx;
+
+  /* only ask for what we need and let network file systems answer
+   * from their attribute cache instead of asking the server for
+   * every single file */
+  if (statx (dir_fd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC,
+             STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_INO | STATX_NLINK, &stx) == 0)
+    {
+      *is_dir = S_ISDIR (stx.stx_mode);
+      *n_links = stx.stx_nlink;
+      link->dev = makedev (stx.stx_dev_major, stx.stx_dev_minor);
+      link->ino = stx.stx_ino;
+      link->size = stx.stx_size;
+      link->allocated_size = stx.stx_blocks * 512;
+      return TRUE;
+    }
+
+  /* older kernels don't have statx() */
+  if (errno != ENOSYS)
+    return FALSE;
+#endif
+
+  if (fstatat (dir_fd, name, &statb, AT_SYMLINK_NOFOLLOW) != 0)
+    return FALSE;
+
+  *is_dir = S_ISDIR (statb.st_mode);
+  *n_links = statb.st_nlink;
+  link->dev = statb.st_dev;
+  link->ino = statb.st_ino;
+  link->size = statb.st_size;
+  link->allocated_size = (guint64) statb.st_blocks * 512;
+
+  return TRUE;
+}
+
+
+
+static void
+thunar_deep_count_walk_push (ThunarDeepCountWalk *walk,
+                             const gchar         *folder,
+                             const gchar         *name,
+                             guint64              dev)
+{
+  ThunarDeepCountTask *task;
+
+  /* let the next free worker read the subfolder */
+  task = g_slice_new (ThunarDeepCountTask);
+  task->path = g_build_filename (folder, name, NULL);
+  task->dev = dev;
+  task->fd = -1;
+
+  g_atomic_int_inc (&walk->n_pending);
+  g_thread_pool_push (walk->pool, task, NULL);
+}
+
+
+
+static void
+thunar_deep_count_walk_add (ThunarDeepCountSlot         *slot,
+                            const ThunarSizeCacheFolder *folder)
+{
+  slot->directory_count++;
+  slot->file_count += folder->file_count;
+  slot->total_size += folder->total_size;
+  slot->allocated_size += folder->allocated_size;
+
+  /* the job thread counts these once */
+  g_array_append_vals (slot->links, folder->links->data, folder->links->len);
+}
+
+
+
+/* reads the folder @fd and stores its contents in the size cache */
+static void
+thunar_deep_count_walk_read (ThunarDeepCountWalk *walk,
+                             ThunarDeepCountTask *task,
+                             ThunarDeepCountSlot *slot,
+                             gint                 fd,
+                             const struct stat   *statb,
+                             guint64              mtime)
+{
+  ThunarSizeCacheFolder folder;
+  ThunarSizeCacheLink   link;
+  struct dirent        *entry;
+  GPtrArray            *subfolders;
+  gboolean              is_dir;
+  gboolean              complete = FALSE;
+  guint                 n_links;
+  DIR                  *dir;
+
+  dir = fdopendir (fd);
+  if (G_UNLIKELY (dir == NULL))
+    {
+      close (fd);
+      slot->unreadable_directory_count++;
+      return;
+    }
+
+  memset (&folder, 0, sizeof (folder));
+  folder.links = g_array_new (FALSE, FALSE, sizeof (ThunarSizeCacheLink));
+  subfolders = g_ptr_array_new ();
+
+  while (!g_cancellable_is_cancelled (walk->cancellable))
+    {
+      errno = 0;
+      entry = readdir (dir);
+      if (entry == NULL)
+        {
+          /* only remember folders that were read to the end */
+          complete = (errno == 0);
+          break;
+        }
+
+      if (strcmp (entry->d_name, ".") == 0 || strcmp (entry->d_name, "..") == 0)
+        continue;
+
+      if (!thunar_deep_count_job_stat (dirfd (dir), entry->d_name, &is_dir, &n_links, &link))
+        continue;
+
+      /* only count files on the same filesystem, so no remote
+       * mounts or dummy filesystems are counted */
+      if (link.dev != task->dev)
+        continue;
+
+      if (is_dir)
+        {
+          thunar_deep_count_walk_push (walk, task->path, entry->d_name, task->dev);
+          g_ptr_array_add (subfolders, g_strdup (entry->d_name));
+        }
+      else if (n_links > 1)
+        {
+          g_array_append_val (folder.links, link);
+        }
+      else
+        {
+          folder.file_count++;
+          folder.total_size += link.size;
+          folder.allocated_size += link.allocated_size;
+        }
+    }
+
+  closedir (dir);
+
+  thunar_deep_count_walk_add (slot, &folder);
+
+  g_ptr_array_add (subfolders, NULL);
+  folder.subfolders = (gchar **) g_ptr_array_free (subfolders, FALSE);
+
+  /* a folder changed right before it was read could change again
+   * without getting a new modification time */
+  if (complete && statb->st_mtime + SIZE_CACHE_MIN_AGE < g_get_real_time () / G_USEC_PER_SEC)
+    thunar_size_cache_store_folder (walk->size_cache, statb->st_dev, statb->st_ino, mtime, &folder);
+
+  thunar_size_cache_folder_clear (&folder);
+}
+
+
+
+static void
+thunar_deep_count_job_walk (gpointer data,
+                            gpointer user_data)
+{
+  ThunarDeepCountWalk  *walk = user_data;
+  ThunarDeepCountTask  *task = data;
+  ThunarDeepCountSlot  *slot;
+  ThunarSizeCacheFolder folder;
+  struct stat           statb;
+  guint64               mtime;
+  guint                 n;
+  gint                  fd;
+
+  /* the pool threads are shared, so use the I/O priority of the job */
+  thunar_io_jobs_util_set_io_priority (TRUE);
+
+  if (!g_cancellable_is_cancelled (walk->cancellable))
+    {
+      /* counters of our own while we read this folder */
+      slot = g_async_queue_pop (walk->slots);
+
+      fd = task->fd;
+      if (fd < 0)
+        fd = open (task->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      task->fd = -1;
+
+      if (fd < 0 || fstat (fd, &statb) != 0)
+        {
+          slot->unreadable_directory_count++;
+        }
+      else if (statb.st_dev != task->dev)
+        {
+          /* something was mounted on the folder since it was cached */
+        }
+      else
+        {
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+          mtime = (guint64) statb.st_mtim.tv_sec * G_GUINT64_CONSTANT (1000000000) + statb.st_mtim.tv_nsec;
+#else
+          mtime = (guint64) statb.st_mtime * G_GUINT64_CONSTANT (1000000000);
+#endif
+
+          if (thunar_size_cache_lookup_folder (walk->size_cache, statb.st_dev, statb.st_ino, mtime, &folder))
+            {
+              /* the folder did not change, so only its subfolders
+               * have to be checked */
+              thunar_deep_count_walk_add (slot, &folder);
+              for (n = 0; folder.subfolders[n] != NULL; ++n)
+                thunar_deep_count_walk_push (walk, task->path, folder.subfolders[n], task->dev);
+              thunar_size_cache_folder_clear (&folder);
+            }
+          else
+            {
+              /* takes over the descriptor */
+              thunar_deep_count_walk_read (walk, task, slot, fd, &statb, mtime);
+              fd = -1;
+            }
+        }
+
+      if (fd >= 0)
+        close (fd);
+
+      g_async_queue_push (walk->slots, slot);
+    }
+
+  if (task->fd >= 0)
+    close (task->fd);
+  g_free (task->path);
+  g_slice_free (ThunarDeepCountTask, task);
+
+  thunar_io_jobs_util_set_io_priority (FALSE);
+
+  /* wake up the job thread if this was the last folder */
+  if (g_atomic_int_dec_and_test (&walk->n_pending))
+    g_async_queue_push (walk->done, GUINT_TO_POINTER (1));
+}
+
+
+
+static void
+thunar_deep_count_walk_init (ThunarDeepCountWalk *walk,
+                             ThunarDeepCountJob  *job)
+{
+  ThunarDeepCountSlot *slot;
+  guint                n;
+
+  walk->cancellable = exo_job_get_cancellable (EXO_JOB (job));
+  walk->size_cache = job->size_cache;
+  walk->n_pending = 0;
+  walk->done = g_async_queue_new ();
+
+  /* one set of counters for each worker */
+  walk->n_slots = job->n_threads;
+  walk->slots = g_async_queue_new ();
+  for (n = 0; n < walk->n_slots; ++n)
+    {
+      slot = g_slice_new0 (ThunarDeepCountSlot);
+      slot->links = g_array_new (FALSE, FALSE, sizeof (ThunarSizeCacheLink));
+      g_async_queue_push (walk->slots, slot);
+    }
+
+  walk->pool = g_thread_pool_new (thunar_deep_count_job_walk, walk, job->n_threads, FALSE, NULL);
+}
+
+
+
+static void
+thunar_deep_count_walk_free (ThunarDeepCountWalk *walk)
+{
+  ThunarDeepCountSlot *slot;
+
+  g_thread_pool_free (walk->pool, FALSE, TRUE);
+
+  while ((slot = g_async_queue_try_pop (walk->slots)) != NULL)
+    {
+      g_array_free (slot->links, TRUE);
+      g_slice_free (ThunarDeepCountSlot, slot);
+    }
+
+  g_async_queue_unref (walk->slots);
+  g_async_queue_unref (walk->done);
+}
+
+
+
+/* adds the counters of all workers that are between two folders */
+static void
+thunar_deep_count_job_merge (ThunarDeepCountJob  *job,
+                             ThunarDeepCountWalk *walk)
+{
+  ThunarDeepCountSlot *slot;
+  GPtrArray           *slots;
+  guint                n;
+
+  slots = g_ptr_array_sized_new (walk->n_slots);
+
+  while ((slot = g_async_queue_try_pop (walk->slots)) != NULL)
+    {
+      job->total_size += slot->total_size;
+      job->allocated_size += slot->allocated_size;
+      job->file_count += slot->file_count;
+      job->directory_count += slot->directory_count;
+      job->unreadable_directory_count += slot->unreadable_directory_count;
+
+      for (n = 0; n < slot->links->len; ++n)
+        thunar_deep_count_job_add_link (job, &g_array_index (slot->links, ThunarSizeCacheLink, n));
+
+      slot->total_size = 0;
+      slot->allocated_size = 0;
+      slot->file_count = 0;
+      slot->directory_count = 0;
+      slot->unreadable_directory_count = 0;
+      g_array_set_size (slot->links, 0);
+
+      g_ptr_array_add (slots, slot);
+    }
+
+  /* hand them back to the workers */
+  for (n = 0; n < slots->len; ++n)
+    g_async_queue_push (walk->slots, g_ptr_array_index (slots, n));
+
+  g_ptr_array_free (slots, TRUE);
+}
+
+
+
+static void
+thunar_deep_count_job_wait (ThunarDeepCountJob  *job,
+                            ThunarDeepCountWalk *walk)
+{
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  GTimeVal end_time;
+#endif
+
+  while (g_atomic_int_get (&walk->n_pending) > 0)
+    {
+#if GLIB_CHECK_VERSION (2, 32, 0)
+      g_async_queue_timeout_pop (walk->done, STATUS_INTERVAL);
+#else
+      g_get_current_time (&end_time);
+      g_time_val_add (&end_time, STATUS_INTERVAL);
+      g_async_queue_timed_pop (walk->done, &end_time);
+#endif
+
+      thunar_deep_count_job_merge (job, walk);
+
+      if (!exo_job_is_cancelled (EXO_JOB (job)))
+        thunar_deep_count_job_status_update (job);
+    }
+
+  /* all workers are done, so all counters are free again */
+  thunar_deep_count_job_merge (job, walk);
+}
+
+
+
+static gboolean
+thunar_deep_count_job_process_native (ThunarDeepCountJob  *job,
+                                      ThunarDeepCountWalk *walk,
+                                      const gchar         *path,
+                                      gboolean             only_file,
+                                      GError             **error)
+{
+  ThunarDeepCountTask *task;
+  ThunarSizeCacheLink  link;
+  gboolean             is_dir;
+  guint                n_links;
+  gchar               *display_name;
+  gint                 errsv;
+  gint                 fd;
+
+  if (!thunar_deep_count_job_stat (AT_FDCWD, path, &is_dir, &n_links, &link))
+    {
+      errsv = errno;
+      display_name = g_filename_display_name (path);
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Failed to open \"%s\": %s"), display_name, g_strerror (errsv));
+      g_free (display_name);
+      return FALSE;
+    }
+
+  if (!is_dir)
+    {
+      if (n_links > 1)
+        {
+          thunar_deep_count_job_add_link (job, &link);
+        }
+      else
+        {
+          job->file_count++;
+          job->total_size += link.size;
+          job->allocated_size += link.allocated_size;
+        }
+
+      return TRUE;
+    }
+
+  fd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0)
+    {
+      errsv = errno;
+      job->unreadable_directory_count++;
+
+      /* we only bail out if the job file is unreadable */
+      if (only_file)
+        {
+          display_name = g_filename_display_name (path);
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                       _("Failed to open \"%s\": %s"), display_name, g_strerror (errsv));
+          g_free (display_name);
+          return FALSE;
+        }
+
+      return TRUE;
+    }
+
+  task = g_slice_new (ThunarDeepCountTask);
+  task->path = g_strdup (path);
+  task->dev = link.dev;
+  task->fd = fd;
+
+  g_atomic_int_inc (&walk->n_pending);
+  g_thread_pool_push (walk->pool, task, NULL);
+
+  return TRUE;
+}
+#endif
+
+
+
 static gboolean
 thunar_deep_count_job_execute (ExoJob  *job,
                                GError **error)
 {
-  ThunarDeepCountJob *count_job = THUNAR_DEEP_COUNT_JOB (job);
-  gboolean            success = TRUE;
-  GError             *err = NULL;
-  GList              *lp;
-  GFile              *gfile;
+  ThunarDeepCountJob  *count_job = THUNAR_DEEP_COUNT_JOB (job);
+#ifdef DEEP_COUNT_NATIVE
+  ThunarDeepCountWalk  walk;
+  ThunarSizeCacheTotal total;
+  gchar               *path;
+#endif
+  gboolean             success = TRUE;
+  GError              *err = NULL;
+  GList               *lp;
+  GFile               *gfile;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -355,20 +992,71 @@ thunar_deep_count_job_execute (ExoJob  *job,
 
   /* reset counters */
   count_job->total_size = 0;
+  count_job->allocated_size = 0;
   count_job->file_count = 0;
   count_job->directory_count = 0;
   count_job->unreadable_directory_count = 0;
   count_job->last_time = 0;
+  g_hash_table_remove_all (count_job->links);
+
+#ifdef DEEP_COUNT_NATIVE
+  walk.pool = NULL;
+#endif
 
   /* count files, directories and compute size of the job files */
   for (lp = count_job->files; lp != NULL; lp = lp->next)
     {
       gfile = thunar_file_get_file (THUNAR_FILE (lp->data));
-      success = thunar_deep_count_job_process (job, gfile, NULL, NULL, &err);
+
+#ifdef DEEP_COUNT_NATIVE
+      /* read local folders in parallel */
+      if (count_job->n_threads > 1
+          && (count_job->query_flags & G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS) != 0
+          && (path = g_file_get_path (gfile)) != NULL)
+        {
+          if (walk.pool == NULL)
+            thunar_deep_count_walk_init (&walk, count_job);
+
+          success = thunar_deep_count_job_process_native (count_job, &walk, path,
+                                                          count_job->files->next == NULL,
+                                                          &err);
+          g_free (path);
+        }
+      else
+#endif
+        {
+          success = thunar_deep_count_job_process (job, gfile, NULL, NULL, &err);
+        }
+
       if (G_UNLIKELY (!success))
         break;
     }
 
+#ifdef DEEP_COUNT_NATIVE
+  if (walk.pool != NULL)
+    {
+      /* wait for the workers, which also stop when cancelled */
+      thunar_deep_count_job_wait (count_job, &walk);
+      thunar_deep_count_walk_free (&walk);
+
+      if (exo_job_is_cancelled (job))
+        success = FALSE;
+
+      /* remember the result for the next time the folder is shown */
+      if (success && count_job->files->next == NULL)
+        {
+          total.total_size = count_job->total_size;
+          total.allocated_size = count_job->allocated_size;
+          total.file_count = count_job->file_count;
+          total.directory_count = count_job->directory_count;
+          total.unreadable_directory_count = count_job->unreadable_directory_count;
+          thunar_size_cache_store_total (count_job->size_cache,
+                                         thunar_file_get_file (THUNAR_FILE (count_job->files->data)),
+                                         &total);
+        }
+    }
+#endif
+
   if (!success)
     {
       g_assert (err != NULL || exo_job_is_cancelled (job));
@@ -402,6 +1090,7 @@ thunar_deep_count_job_new (GList               *files,
                            GFileQueryInfoFlags  flags)
 {
   ThunarDeepCountJob *job;
+  ThunarPreferences  *preferences;
 
   _thunar_return_val_if_fail (files != NULL, NULL);
 
@@ -409,6 +1098,11 @@ thunar_deep_count_job_new (GList               *files,
   job->files = g_list_copy (files);
   job->query_flags = flags;
 
+  /* number of local folders to read in parallel */
+  preferences = thunar_preferences_get ();
+  g_object_get (G_OBJECT (preferences), "misc-deep-count-threads", &job->n_threads, NULL);
+  g_object_unref (preferences);
+
   g_list_foreach (job->files, (GFunc) g_object_ref, NULL);
 
   return job;
@@ -236,6 +236,12 @@ thunar_details_view_init (ThunarDetailsView *details_view)
   g_signal_connect_after (G_OBJECT (THUNAR_STANDARD_VIEW (details_view)->model), "row-changed",
                           G_CALLBACK (thunar_details_view_row_changed), details_view);
 
+  /* only the details view shows the size of folders */
+  exo_binding_new (G_OBJECT (THUNAR_STANDARD_VIEW (details_view)->preferences),
+                   "misc-folder-sizes",
+                   G_OBJECT (THUNAR_STANDARD_VIEW (details_view)->model),
+                   "folder-sizes");
+
   /* allocate the shared right-aligned text renderer */
   right_aligned_renderer = g_object_new (THUNAR_TYPE_TEXT_RENDERER, "xalign", 1.0f, NULL);
   g_object_ref_sink (G_OBJECT (right_aligned_renderer));
@@ -214,6 +214,29 @@ thunar_thumbnail_mode_get_type (void)
 
 
 
+GType
+thunar_transfer_sync_mode_get_type (void)
+{
+  static GType type = G_TYPE_INVALID;
+
+  if (G_UNLIKELY (type == G_TYPE_INVALID))
+    {
+      static const GEnumValue values[] =
+      {
+        { THUNAR_TRANSFER_SYNC_MODE_NEVER,      "THUNAR_TRANSFER_SYNC_MODE_NEVER",      "never",      },
+        { THUNAR_TRANSFER_SYNC_MODE_SIZE_MTIME, "THUNAR_TRANSFER_SYNC_MODE_SIZE_MTIME", "size-mtime", },
+        { THUNAR_TRANSFER_SYNC_MODE_CONTENTS,   "THUNAR_TRANSFER_SYNC_MODE_CONTENTS",   "contents",   },
+        { 0,                                    NULL,                                   NULL,         },
+      };
+
+      type = g_enum_register_static (I_("ThunarTransferSyncMode"), values);
+    }
+
+  return type;
+}
+
+
+
 /**
  * thunar_zoom_level_to_icon_size:
  * @zoom_level : a #ThunarZoomLevel.
@@ -180,6 +180,26 @@ typedef enum
 GType thunar_recursive_permissions_get_type (void) G_GNUC_CONST;
 
 
+#define THUNAR_TYPE_TRANSFER_SYNC_MODE (thunar_transfer_sync_mode_get_type ())
+
+/**
+ * ThunarTransferSyncMode:
+ * @THUNAR_TRANSFER_SYNC_MODE_NEVER      : always copy, ask before replacing existing files.
+ * @THUNAR_TRANSFER_SYNC_MODE_SIZE_MTIME : skip files whose size and modification time match.
+ * @THUNAR_TRANSFER_SYNC_MODE_CONTENTS   : skip files whose size and contents match.
+ *
+ * How a copy job treats files that already exist at the destination.
+ **/
+typedef enum
+{
+  THUNAR_TRANSFER_SYNC_MODE_NEVER,
+  THUNAR_TRANSFER_SYNC_MODE_SIZE_MTIME,
+  THUNAR_TRANSFER_SYNC_MODE_CONTENTS,
+} ThunarTransferSyncMode;
+
+GType thunar_transfer_sync_mode_get_type (void) G_GNUC_CONST;
+
+
 #define THUNAR_TYPE_ZOOM_LEVEL (thunar_zoom_level_get_type ())
 
 /**
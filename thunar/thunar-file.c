@@ -175,12 +175,19 @@ struct _ThunarFile
   gchar                *basename;
   gchar                *thumbnail_path;
 
+  /* interned emblem names, see thunar_file_peek_emblem_names() */
+  const gchar         **emblem_names;
+
   /* sorting */
   gchar                *collate_key;
   gchar                *collate_key_nocase;
 
   /* flags for thumbnail state etc */
   ThunarFileFlags       flags;
+
+  /* the last known thumb state and the modification time it is valid for */
+  ThunarFileThumbState  thumb_known_state;
+  guint64               thumb_known_mtime;
 };
 
 typedef struct
@@ -461,6 +468,9 @@ thunar_file_finalize (GObject *object)
   /* free the thumbnail path */
   g_free (file->thumbnail_path);
 
+  /* free the emblem names */
+  g_free (file->emblem_names);
+
   /* release file */
   g_object_unref (file->gfile);
 
@@ -903,6 +913,10 @@ thunar_file_set_emblem_names_ready (GObject      *source_object,
       g_error_free (error);
 
       g_file_info_remove_attribute (file->info, "metadata::emblems");
+
+      /* the emblems have to be determined again */
+      g_free (file->emblem_names);
+      file->emblem_names = NULL;
     }
 
   thunar_file_changed (file);
@@ -954,6 +968,10 @@ thunar_file_info_clear (ThunarFile *file)
   g_free (file->thumbnail_path);
   file->thumbnail_path = NULL;
 
+  /* free the emblem names */
+  g_free (file->emblem_names);
+  file->emblem_names = NULL;
+
   /* assume the file is mounted by default */
   FLAG_SET (file, THUNAR_FILE_FLAG_IS_MOUNTED);
 
@@ -1095,6 +1113,13 @@ thunar_file_info_reload (ThunarFile   *file,
 
   /* cleanup */
   g_free (casefold);
+
+  /* the thumbnail is still the same if the file did not change */
+  if (file->thumb_known_mtime != 0
+      && file->thumb_known_mtime == thunar_file_get_date (file, THUNAR_FILE_DATE_MODIFIED))
+    FLAG_SET_THUMB_STATE (file, file->thumb_known_state);
+  else
+    file->thumb_known_mtime = 0;
 }
 
 
@@ -3280,27 +3305,27 @@ thunar_file_can_be_trashed (const ThunarFile *file)
 
 
 /**
- * thunar_file_get_emblem_names:
+ * thunar_file_peek_emblem_names:
  * @file : a #ThunarFile instance.
  *
  * Determines the names of the emblems that should be displayed for
- * @file. The returned list is owned by the caller, but the list
- * items - the name strings - are owned by @file. So the caller
- * must call g_list_free(), but don't g_free() the list items.
+ * @file. The names are interned strings, so two emblem names can
+ * be compared by their pointers.
  *
- * Note that the strings contained in the returned list are
- * not garantied to exist over the next iteration of the main
- * loop. So in case you need the list of emblem names for
- * a longer time, you'll need to take a copy of the strings.
+ * The array is computed once and owned by @file. It is only valid
+ * until the next iteration of the main loop, as it is released when
+ * the information or the emblems of @file change.
  *
- * Return value: the names of the emblems for @file.
+ * Return value: the %NULL-terminated names of the emblems for
+ *               @file, or %NULL if @file has no information.
  **/
-GList*
-thunar_file_get_emblem_names (ThunarFile *file)
+const gchar**
+thunar_file_peek_emblem_names (ThunarFile *file)
 {
   guint32   uid;
   gchar   **emblem_names;
-  GList    *emblems = NULL;
+  guint     n_emblem_names;
+  guint     n = 0;
 
   _thunar_return_val_if_fail (THUNAR_IS_FILE (file), NULL);
 
@@ -3308,22 +3333,20 @@ thunar_file_get_emblem_names (ThunarFile *file)
   if (file->info == NULL)
     return NULL;
 
+  /* check if we already determined the emblems */
+  if (G_LIKELY (file->emblem_names != NULL))
+    return file->emblem_names;
+
   /* determine the custom emblems */
   emblem_names = g_file_info_get_attribute_stringv (file->info, "metadata::emblems");
-  if (G_UNLIKELY (emblem_names != NULL))
-    {
-      for (; *emblem_names != NULL; ++emblem_names)
-        emblems = g_list_append (emblems, *emblem_names);
-    }
+  n_emblem_names = (emblem_names != NULL) ? g_strv_length (emblem_names) : 0;
 
-  if (thunar_file_is_symlink (file))
-    emblems = g_list_prepend (emblems, THUNAR_FILE_EMBLEM_NAME_SYMBOLIC_LINK);
+  /* room for the custom emblems, the two special emblems and the terminator */
+  file->emblem_names = g_new (const gchar *, n_emblem_names + 3);
 
   /* determine the user ID of the file owner */
   /* TODO what are we going to do here on non-UNIX systems? */
-  uid = file->info != NULL 
-        ? g_file_info_get_attribute_uint32 (file->info, G_FILE_ATTRIBUTE_UNIX_UID) 
-        : 0;
+  uid = g_file_info_get_attribute_uint32 (file->info, G_FILE_ATTRIBUTE_UNIX_UID);
 
   /* we add "cant-read" if either (a) the file is not readable or (b) a directory, that lacks the
    * x-bit, see http://bugzilla.xfce.org/show_bug.cgi?id=1408 for the details about this change.
@@ -3334,14 +3357,55 @@ thunar_file_get_emblem_names (ThunarFile *file)
                                                          THUNAR_FILE_MODE_GRP_EXEC,
                                                          THUNAR_FILE_MODE_OTH_EXEC)))
     {
-      emblems = g_list_prepend (emblems, THUNAR_FILE_EMBLEM_NAME_CANT_READ);
+      file->emblem_names[n++] = g_intern_static_string (THUNAR_FILE_EMBLEM_NAME_CANT_READ);
     }
   else if (G_UNLIKELY (uid == effective_user_id && !thunar_file_is_writable (file)))
     {
       /* we own the file, but we cannot write to it, that's why we mark it as "cant-write", so
        * users won't be surprised when opening the file in a text editor, but are unable to save.
        */
-      emblems = g_list_prepend (emblems, THUNAR_FILE_EMBLEM_NAME_CANT_WRITE);
+      file->emblem_names[n++] = g_intern_static_string (THUNAR_FILE_EMBLEM_NAME_CANT_WRITE);
+    }
+
+  if (thunar_file_is_symlink (file))
+    file->emblem_names[n++] = g_intern_static_string (THUNAR_FILE_EMBLEM_NAME_SYMBOLIC_LINK);
+
+  /* append the custom emblems */
+  for (; n_emblem_names > 0; --n_emblem_names, ++emblem_names)
+    file->emblem_names[n++] = g_intern_string (*emblem_names);
+
+  file->emblem_names[n] = NULL;
+
+  return file->emblem_names;
+}
+
+
+
+/**
+ * thunar_file_get_emblem_names:
+ * @file : a #ThunarFile instance.
+ *
+ * Determines the names of the emblems that should be displayed for
+ * @file. The returned list is owned by the caller, but the list
+ * items - the name strings - are interned strings. So the caller
+ * must call g_list_free(), but don't g_free() the list items.
+ *
+ * Return value: the names of the emblems for @file.
+ **/
+GList*
+thunar_file_get_emblem_names (ThunarFile *file)
+{
+  const gchar **emblem_names;
+  GList        *emblems = NULL;
+  guint         n;
+
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), NULL);
+
+  emblem_names = thunar_file_peek_emblem_names (file);
+  if (G_LIKELY (emblem_names != NULL))
+    {
+      for (n = g_strv_length ((gchar **) emblem_names); n > 0; --n)
+        emblems = g_list_prepend (emblems, (gpointer) emblem_names[n - 1]);
     }
 
   return emblems;
@@ -3386,6 +3450,10 @@ thunar_file_set_emblem_names (ThunarFile *file,
       emblems[n++] = g_strdup (lp->data);
     }
 
+  /* the emblems have to be determined again */
+  g_free (file->emblem_names);
+  file->emblem_names = NULL;
+
   /* set the value in the current info */
   if (n == 0)
     g_file_info_remove_attribute (file->info, "metadata::emblems");
@@ -3574,6 +3642,15 @@ thunar_file_set_thumb_state (ThunarFile          *file,
 {
   _thunar_return_if_fail (THUNAR_IS_FILE (file));
 
+  /* remember a final state for this version of the file, so
+   * reloading the file does not forget it */
+  if (state == THUNAR_FILE_THUMB_STATE_READY
+      || state == THUNAR_FILE_THUMB_STATE_NONE)
+    {
+      file->thumb_known_state = state;
+      file->thumb_known_mtime = thunar_file_get_date (file, THUNAR_FILE_DATE_MODIFIED);
+    }
+
   /* check if the state changes */
   if (thunar_file_get_thumb_state (file) == state)
     return;
@@ -3596,6 +3673,28 @@ thunar_file_set_thumb_state (ThunarFile          *file,
 
 
 
+/**
+ * thunar_file_is_thumb_state_known:
+ * @file : a #ThunarFile.
+ *
+ * Returns %TRUE if the thumbnail state of @file is final and was
+ * determined for the current version of @file, so the thumbnail
+ * cache does not need to be checked again.
+ *
+ * Return value: %TRUE if the thumbnail state of @file is up to date.
+ **/
+gboolean
+thunar_file_is_thumb_state_known (const ThunarFile *file)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), FALSE);
+
+  return (file->thumb_known_mtime != 0
+          && file->thumb_known_state == FLAG_GET_THUMB_STATE (file)
+          && file->thumb_known_mtime == thunar_file_get_date (file, THUNAR_FILE_DATE_MODIFIED));
+}
+
+
+
 /**
  * thunar_file_get_custom_icon:
  * @file : a #ThunarFile instance.
@@ -217,6 +217,7 @@ gboolean          thunar_file_is_chmodable               (const ThunarFile
 gboolean          thunar_file_is_renameable              (const ThunarFile       *file);
 gboolean          thunar_file_can_be_trashed             (const ThunarFile       *file);
 
+const gchar     **thunar_file_peek_emblem_names          (ThunarFile              *file);
 GList            *thunar_file_get_emblem_names           (ThunarFile              *file);
 void              thunar_file_set_emblem_names           (ThunarFile              *file,
                                                           GList                   *emblem_names);
@@ -230,6 +231,7 @@ const gchar     *thunar_file_get_thumbnail_path          (ThunarFile
 ThunarFileThumbState thunar_file_get_thumb_state         (const ThunarFile        *file);
 void             thunar_file_set_thumb_state             (ThunarFile              *file, 
                                                           ThunarFileThumbState     state);
+gboolean         thunar_file_is_thumb_state_known        (const ThunarFile        *file);
 GIcon            *thunar_file_get_preview_icon           (const ThunarFile        *file);
 GFilesystemPreviewType thunar_file_get_preview_type      (const ThunarFile *file);
 const gchar      *thunar_file_get_icon_name              (ThunarFile              *file,
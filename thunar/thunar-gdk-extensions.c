@@ -43,6 +43,16 @@ static const cairo_user_data_key_t cairo_key;
 
 
 
+static inline guint32
+thunar_gdk_premultiply (guint c,
+                        guint a)
+{
+  guint t = c * a + 0x7f;
+  return ((t >> 8) + t) >> 8;
+}
+
+
+
 static cairo_surface_t *
 thunar_gdk_cairo_create_surface (const GdkPixbuf *pixbuf)
 {
@@ -56,8 +66,10 @@ thunar_gdk_cairo_create_surface (const GdkPixbuf *pixbuf)
   cairo_format_t   format;
   cairo_surface_t *surface;
   gint             j;
-  guchar          *p, *q;
+  guchar          *p;
   guchar          *end;
+  guint32         *q;
+  guint            a;
 
   _thunar_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
 
@@ -80,28 +92,19 @@ thunar_gdk_cairo_create_surface (const GdkPixbuf *pixbuf)
                                                  width, height, cairo_stride);
   cairo_surface_set_user_data (surface, &cairo_key, cairo_pixels, g_free);
 
-  /* convert format */
+  /* convert format, cairo stores whole pixels in native byte order */
   if (G_UNLIKELY (n_channels == 3))
     {
       for (j = height; j; j--)
         {
           p = gdk_pixels;
-          q = cairo_pixels;
+          q = (guint32 *) cairo_pixels;
           end = p + 3 * width;
 
           while (p < end)
             {
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-              q[0] = p[2];
-              q[1] = p[1];
-              q[2] = p[0];
-#else
-              q[1] = p[0];
-              q[2] = p[1];
-              q[3] = p[2];
-#endif
+              *q++ = ((guint32) p[0] << 16) | ((guint32) p[1] << 8) | p[2];
               p += 3;
-              q += 4;
             }
 
           gdk_pixels += gdk_rowstride;
@@ -110,35 +113,32 @@ thunar_gdk_cairo_create_surface (const GdkPixbuf *pixbuf)
     }
   else
     {
-#define MULT(d,c,a) G_STMT_START { guint t = c * a + 0x7f; d = ((t >> 8) + t) >> 8; } G_STMT_END
       for (j = height; j; j--)
         {
           p = gdk_pixels;
-          q = cairo_pixels;
+          q = (guint32 *) cairo_pixels;
           end = p + 4 * width;
 
           while (p < end)
             {
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-              MULT(q[0], p[2], p[3]);
-              MULT(q[1], p[1], p[3]);
-              MULT(q[2], p[0], p[3]);
-              q[3] = p[3];
-#else
-              q[0] = p[3];
-              MULT(q[1], p[0], p[3]);
-              MULT(q[2], p[1], p[3]);
-              MULT(q[3], p[2], p[3]);
-#endif
+              /* thumbnails and icons are mostly opaque or fully
+               * transparent, which needs no premultiplication */
+              a = p[3];
+              if (G_LIKELY (a == 0xff))
+                *q = 0xff000000u | ((guint32) p[0] << 16) | ((guint32) p[1] << 8) | p[2];
+              else if (a == 0)
+                *q = 0;
+              else
+                *q = (a << 24) | (thunar_gdk_premultiply (p[0], a) << 16)
+                     | (thunar_gdk_premultiply (p[1], a) << 8) | thunar_gdk_premultiply (p[2], a);
 
               p += 4;
-              q += 4;
+              q += 1;
             }
 
           gdk_pixels += gdk_rowstride;
           cairo_pixels += cairo_stride;
         }
-#undef MULT
     }
 
   return surface;
@@ -0,0 +1,381 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The cache holds the icons of a ThunarIconFactory, both the named
+ * icons of the icon theme and the icons of single files, keyed by
+ * their source (icon name or file), size and state. Icons of files
+ * additionally carry a tag, which the factory derives from the state
+ * of the file; an entry with another tag is outdated.
+ *
+ * The cache stays within a memory budget by dropping the least
+ * recently used icons. Icons that are still in use elsewhere only
+ * lose the reference of the cache. Icons of files that share the
+ * pixbuf of a named icon are only charged their bookkeeping, so
+ * the budget also bounds the number of entries.
+ *
+ * The cache is only used from the main thread.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <thunar/thunar-icon-cache.h>
+#include <thunar/thunar-private.h>
+
+
+
+/* memory charged for an entry in addition to its pixbuf */
+#define ENTRY_OVERHEAD (128)
+
+
+
+typedef struct _ThunarIconCacheKey   ThunarIconCacheKey;
+typedef struct _ThunarIconCacheEntry ThunarIconCacheEntry;
+
+
+
+struct _ThunarIconCacheKey
+{
+  gchar *name;
+  GFile *file;
+  gint   size;
+  gint   state;
+};
+
+struct _ThunarIconCacheEntry
+{
+  ThunarIconCacheKey key;
+  guint              tag;
+  GdkPixbuf         *icon;
+  gsize              n_bytes;
+
+  /* link in the LRU queue, the head is the most recently used */
+  GList              link;
+};
+
+struct _ThunarIconCache
+{
+  GHashTable *entries;
+  GQueue      lru;
+
+  gsize       n_bytes;
+  gsize       max_bytes;
+
+  guint64     hits;
+  guint64     misses;
+  guint64     evictions;
+};
+
+
+
+static guint
+thunar_icon_cache_key_hash (gconstpointer data)
+{
+  const ThunarIconCacheKey *key = data;
+  guint                     h;
+
+  h = (key->file != NULL) ? g_file_hash (key->file) : g_str_hash (key->name);
+
+  return (h * 31 + (guint) key->size) * 31 + (guint) key->state;
+}
+
+
+
+static gboolean
+thunar_icon_cache_key_equal (gconstpointer a,
+                             gconstpointer b)
+{
+  const ThunarIconCacheKey *a_key = a;
+  const ThunarIconCacheKey *b_key = b;
+
+  /* compare sizes and states first */
+  if (a_key->size != b_key->size || a_key->state != b_key->state)
+    return FALSE;
+
+  if (a_key->file != NULL || b_key->file != NULL)
+    return (a_key->file != NULL && b_key->file != NULL && g_file_equal (a_key->file, b_key->file));
+
+  return (strcmp (a_key->name, b_key->name) == 0);
+}
+
+
+
+static void
+thunar_icon_cache_entry_free (gpointer data)
+{
+  ThunarIconCacheEntry *entry = data;
+
+  g_free (entry->key.name);
+  if (entry->key.file != NULL)
+    g_object_unref (entry->key.file);
+  g_object_unref (entry->icon);
+  g_slice_free (ThunarIconCacheEntry, entry);
+}
+
+
+
+static void
+thunar_icon_cache_remove (ThunarIconCache      *cache,
+                          ThunarIconCacheEntry *entry)
+{
+  g_queue_unlink (&cache->lru, &entry->link);
+  cache->n_bytes -= entry->n_bytes;
+
+  /* releases the entry */
+  g_hash_table_remove (cache->entries, &entry->key);
+}
+
+
+
+static void
+thunar_icon_cache_trim (ThunarIconCache *cache)
+{
+  ThunarIconCacheEntry *entry;
+
+  /* drop the least recently used icons, but always keep the last one */
+  while (cache->n_bytes > cache->max_bytes && cache->lru.length > 1)
+    {
+      entry = cache->lru.tail->data;
+      thunar_icon_cache_remove (cache, entry);
+      cache->evictions++;
+    }
+}
+
+
+
+/**
+ * thunar_icon_cache_new:
+ * @max_bytes : the memory budget in bytes.
+ *
+ * Allocates a new, empty #ThunarIconCache.
+ *
+ * Return value: the newly allocated #ThunarIconCache.
+ **/
+ThunarIconCache*
+thunar_icon_cache_new (gsize max_bytes)
+{
+  ThunarIconCache *cache;
+
+  cache = g_slice_new0 (ThunarIconCache);
+  cache->entries = g_hash_table_new_full (thunar_icon_cache_key_hash, thunar_icon_cache_key_equal,
+                                          NULL, thunar_icon_cache_entry_free);
+  cache->max_bytes = max_bytes;
+  g_queue_init (&cache->lru);
+
+  return cache;
+}
+
+
+
+/**
+ * thunar_icon_cache_free:
+ * @cache : a #ThunarIconCache.
+ *
+ * Releases @cache and all icons in it.
+ **/
+void
+thunar_icon_cache_free (ThunarIconCache *cache)
+{
+  g_hash_table_destroy (cache->entries);
+  g_slice_free (ThunarIconCache, cache);
+}
+
+
+
+/**
+ * thunar_icon_cache_set_max_bytes:
+ * @cache     : a #ThunarIconCache.
+ * @max_bytes : the new memory budget in bytes.
+ *
+ * Changes the memory budget of @cache, dropping icons if
+ * the cache uses more than @max_bytes.
+ **/
+void
+thunar_icon_cache_set_max_bytes (ThunarIconCache *cache,
+                                 gsize            max_bytes)
+{
+  cache->max_bytes = max_bytes;
+  thunar_icon_cache_trim (cache);
+}
+
+
+
+/**
+ * thunar_icon_cache_lookup:
+ * @cache : a #ThunarIconCache.
+ * @name  : the icon name, or %NULL for the icon of @file.
+ * @file  : the file, or %NULL for the icon @name.
+ * @size  : the icon size.
+ * @state : the icon state.
+ * @tag   : the tag the icon must have been stored with.
+ *
+ * Looks up an icon in @cache and marks it as recently used. An
+ * icon with another @tag is outdated and dropped.
+ *
+ * Return value: the cached icon, which is owned by @cache,
+ *               or %NULL.
+ **/
+GdkPixbuf*
+thunar_icon_cache_lookup (ThunarIconCache *cache,
+                          const gchar     *name,
+                          GFile           *file,
+                          gint             size,
+                          gint             state,
+                          guint            tag)
+{
+  ThunarIconCacheEntry *entry;
+  ThunarIconCacheKey    key;
+
+  _thunar_return_val_if_fail ((name != NULL) != (file != NULL), NULL);
+
+  key.name = (gchar *) name;
+  key.file = file;
+  key.size = size;
+  key.state = state;
+
+  entry = g_hash_table_lookup (cache->entries, &key);
+  if (entry != NULL && entry->tag != tag)
+    {
+      thunar_icon_cache_remove (cache, entry);
+      entry = NULL;
+    }
+
+  if (G_UNLIKELY (entry == NULL))
+    {
+      cache->misses++;
+      return NULL;
+    }
+
+  /* move the icon to the front of the queue */
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+
+  cache->hits++;
+
+  return entry->icon;
+}
+
+
+
+/**
+ * thunar_icon_cache_insert:
+ * @cache  : a #ThunarIconCache.
+ * @name   : the icon name, or %NULL for the icon of @file.
+ * @file   : the file, or %NULL for the icon @name.
+ * @size   : the icon size.
+ * @state  : the icon state.
+ * @tag    : the tag to validate the icon with.
+ * @icon   : the icon.
+ * @shared : %TRUE if @icon is also stored under its icon name,
+ *           so it is not charged twice.
+ *
+ * Stores @icon in @cache, replacing the previous icon for the key,
+ * and drops the least recently used icons if @cache grows beyond
+ * its budget.
+ **/
+void
+thunar_icon_cache_insert (ThunarIconCache *cache,
+                          const gchar     *name,
+                          GFile           *file,
+                          gint             size,
+                          gint             state,
+                          guint            tag,
+                          GdkPixbuf       *icon,
+                          gboolean         shared)
+{
+  ThunarIconCacheEntry *entry;
+  ThunarIconCacheKey    key;
+
+  _thunar_return_if_fail ((name != NULL) != (file != NULL));
+  _thunar_return_if_fail (GDK_IS_PIXBUF (icon));
+
+  /* drop the previous icon */
+  key.name = (gchar *) name;
+  key.file = file;
+  key.size = size;
+  key.state = state;
+  entry = g_hash_table_lookup (cache->entries, &key);
+  if (entry != NULL)
+    thunar_icon_cache_remove (cache, entry);
+
+  entry = g_slice_new0 (ThunarIconCacheEntry);
+  entry->key.name = g_strdup (name);
+  entry->key.file = (file != NULL) ? g_object_ref (file) : NULL;
+  entry->key.size = size;
+  entry->key.state = state;
+  entry->tag = tag;
+  entry->icon = g_object_ref (icon);
+  entry->link.data = entry;
+
+  entry->n_bytes = ENTRY_OVERHEAD;
+  if (!shared)
+    entry->n_bytes += (gsize) gdk_pixbuf_get_rowstride (icon) * gdk_pixbuf_get_height (icon);
+
+  g_hash_table_insert (cache->entries, &entry->key, entry);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->n_bytes += entry->n_bytes;
+
+  thunar_icon_cache_trim (cache);
+}
+
+
+
+/**
+ * thunar_icon_cache_clear:
+ * @cache : a #ThunarIconCache.
+ *
+ * Drops all icons from @cache.
+ **/
+void
+thunar_icon_cache_clear (ThunarIconCache *cache)
+{
+  g_hash_table_remove_all (cache->entries);
+  g_queue_init (&cache->lru);
+  cache->n_bytes = 0;
+}
+
+
+
+/**
+ * thunar_icon_cache_get_stats:
+ * @cache : a #ThunarIconCache.
+ * @stats : return location for the counters.
+ *
+ * Stores the current counters of @cache in @stats.
+ **/
+void
+thunar_icon_cache_get_stats (ThunarIconCache      *cache,
+                             ThunarIconCacheStats *stats)
+{
+  _thunar_return_if_fail (stats != NULL);
+
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->evictions = cache->evictions;
+  stats->n_icons = cache->lru.length;
+  stats->n_bytes = cache->n_bytes;
+  stats->max_bytes = cache->max_bytes;
+}
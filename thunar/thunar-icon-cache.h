@@ -0,0 +1,81 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __THUNAR_ICON_CACHE_H__
+#define __THUNAR_ICON_CACHE_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _ThunarIconCacheStats ThunarIconCacheStats;
+typedef struct _ThunarIconCache      ThunarIconCache;
+
+/**
+ * ThunarIconCacheStats:
+ * @hits      : number of lookups that found a valid icon.
+ * @misses    : number of lookups that found no or an outdated icon.
+ * @evictions : number of icons dropped to stay within the budget.
+ * @n_icons   : number of icons in the cache.
+ * @n_bytes   : memory used by the icons in the cache.
+ * @max_bytes : the memory budget of the cache.
+ *
+ * The counters of a #ThunarIconCache.
+ **/
+struct _ThunarIconCacheStats
+{
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+  guint   n_icons;
+  gsize   n_bytes;
+  gsize   max_bytes;
+};
+
+ThunarIconCache *thunar_icon_cache_new           (gsize                 max_bytes) G_GNUC_MALLOC;
+void             thunar_icon_cache_free          (ThunarIconCache      *cache);
+
+void             thunar_icon_cache_set_max_bytes (ThunarIconCache      *cache,
+                                                  gsize                 max_bytes);
+
+GdkPixbuf       *thunar_icon_cache_lookup        (ThunarIconCache      *cache,
+                                                  const gchar          *name,
+                                                  GFile                *file,
+                                                  gint                  size,
+                                                  gint                  state,
+                                                  guint                 tag);
+void             thunar_icon_cache_insert        (ThunarIconCache      *cache,
+                                                  const gchar          *name,
+                                                  GFile                *file,
+                                                  gint                  size,
+                                                  gint                  state,
+                                                  guint                 tag,
+                                                  GdkPixbuf            *icon,
+                                                  gboolean              shared);
+
+void             thunar_icon_cache_clear         (ThunarIconCache      *cache);
+
+void             thunar_icon_cache_get_stats     (ThunarIconCache      *cache,
+                                                  ThunarIconCacheStats *stats);
+
+G_END_DECLS;
+
+#endif /* !__THUNAR_ICON_CACHE_H__ */
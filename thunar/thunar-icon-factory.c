@@ -31,6 +31,7 @@
 #endif
 
 #include <thunar/thunar-gobject-extensions.h>
+#include <thunar/thunar-icon-cache.h>
 #include <thunar/thunar-icon-factory.h>
 #include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
@@ -38,8 +39,12 @@
 
 
 
-/* the timeout until the sweeper is run (in seconds) */
-#define THUNAR_ICON_FACTORY_SWEEP_TIMEOUT (30)
+/* number of threads that decode thumbnails in the background */
+#define THUNAR_ICON_FACTORY_LOAD_THREADS (2)
+
+/* size under which the decoded thumbnail of a file is cached,
+ * the icons for the zoom levels are derived from it */
+#define THUNAR_ICON_FACTORY_NATIVE_SIZE (0)
 
 
 
@@ -47,17 +52,17 @@
 enum
 {
   PROP_0,
+  PROP_ICON_CACHE_SIZE,
   PROP_ICON_THEME,
   PROP_THUMBNAIL_MODE,
 };
 
 
 
-typedef struct _ThunarIconKey ThunarIconKey;
+typedef struct _ThunarIconLoad ThunarIconLoad;
 
 
 
-static void       thunar_icon_factory_dispose               (GObject                  *object);
 static void       thunar_icon_factory_finalize              (GObject                  *object);
 static void       thunar_icon_factory_get_property          (GObject                  *object,
                                                              guint                     prop_id,
@@ -71,8 +76,9 @@ static gboolean   thunar_icon_factory_changed               (GSignalInvocationHi
                                                              guint                     n_param_values,
                                                              const GValue             *param_values,
                                                              gpointer                  user_data);
-static gboolean   thunar_icon_factory_sweep_timer           (gpointer                  user_data);
-static void       thunar_icon_factory_sweep_timer_destroy   (gpointer                  user_data);
+static GdkPixbuf *thunar_icon_factory_load_native          (const gchar              *path);
+static GdkPixbuf *thunar_icon_factory_scale_native          (GdkPixbuf                *native,
+                                                             gint                      size);
 static GdkPixbuf *thunar_icon_factory_load_from_file        (ThunarIconFactory        *factory,
                                                              const gchar              *path,
                                                              gint                      size);
@@ -80,12 +86,12 @@ static GdkPixbuf *thunar_icon_factory_lookup_icon           (ThunarIconFactory
                                                              const gchar              *name,
                                                              gint                      size,
                                                              gboolean                  wants_default);
-static guint      thunar_icon_key_hash                      (gconstpointer             data);
-static gboolean   thunar_icon_key_equal                     (gconstpointer             a,
-                                                             gconstpointer             b);
-static void       thunar_icon_key_free                      (gpointer                  data);
+static void       thunar_icon_load_free                     (gpointer                  data);
 static GdkPixbuf *thunar_icon_factory_load_fallback         (ThunarIconFactory        *factory,
                                                              gint                      size);
+static void       thunar_icon_factory_load_thread           (gpointer                  data,
+                                                             gpointer                  user_data);
+static gboolean   thunar_icon_factory_load_idle             (gpointer                  user_data);
 
 
 
@@ -100,40 +106,59 @@ struct _ThunarIconFactory
 
   ThunarPreferences   *preferences;
 
-  GHashTable          *icon_cache;
+  /* named icons and the icons of files */
+  ThunarIconCache     *icon_cache;
+  guint                icon_cache_size;
 
   GtkIconTheme        *icon_theme;
 
   ThunarThumbnailMode  thumbnail_mode;
 
-  guint                sweep_timer_id;
-
   gulong               changed_hook_id;
 
-  /* stamp that gets bumped when the theme changes */
-  guint                theme_stamp;
-};
-
-struct _ThunarIconKey
-{
-  gchar *name;
-  gint   size;
+  /* thumbnails that are decoded in the background, the table of
+   * pending loads (ThunarFile -> ThunarIconLoad) is only used in the
+   * main thread, the finished loads are protected by the lock */
+  GThreadPool         *load_pool;
+  GHashTable          *load_table;
+  GSList              *load_finished;
+  guint                load_idle_id;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  GMutex               load_lock;
+#else
+  GMutex              *load_lock;
+#endif
 };
 
-typedef struct
+struct _ThunarIconLoad
 {
-  ThunarFileIconState   icon_state;
-  ThunarFileThumbState  thumb_state;
+  ThunarFile           *file;
+  gchar                *path;
   gint                  icon_size;
-  guint                 stamp;
+  ThunarFileIconState   icon_state;
+  GdkPixbuf            *native;
   GdkPixbuf            *icon;
-}
-ThunarIconStore;
+
+  /* set when the icon is no longer wanted, under the lock */
+  gboolean              cancelled;
+};
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define _load_lock(factory)   g_mutex_lock (&((factory)->load_lock))
+#define _load_unlock(factory) g_mutex_unlock (&((factory)->load_lock))
+#else
+#define _load_lock(factory)   g_mutex_lock ((factory)->load_lock)
+#define _load_unlock(factory) g_mutex_unlock ((factory)->load_lock)
+#endif
 
 
 
 static GQuark thunar_icon_factory_quark = 0;
-static GQuark thunar_icon_factory_store_quark = 0;
+static GQuark thunar_icon_factory_serial_quark = 0;
+static GQuark thunar_icon_factory_frame_quark = 0;
+
+/* last serial handed out to a file, see thunar_icon_factory_file_tag() */
+static guint  thunar_icon_factory_serial = 0;
 
 
 
@@ -146,14 +171,27 @@ thunar_icon_factory_class_init (ThunarIconFactoryClass *klass)
 {
   GObjectClass *gobject_class;
 
-  thunar_icon_factory_store_quark = g_quark_from_static_string ("thunar-icon-factory-store");
+  thunar_icon_factory_serial_quark = g_quark_from_static_string ("thunar-icon-factory-serial");
+  thunar_icon_factory_frame_quark = g_quark_from_static_string ("thunar-icon-factory-frame");
 
   gobject_class = G_OBJECT_CLASS (klass);
-  gobject_class->dispose = thunar_icon_factory_dispose;
   gobject_class->finalize = thunar_icon_factory_finalize;
   gobject_class->get_property = thunar_icon_factory_get_property;
   gobject_class->set_property = thunar_icon_factory_set_property;
 
+  /**
+   * ThunarIconFactory:icon-cache-size:
+   *
+   * The memory budget of the icon cache in MiB.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_ICON_CACHE_SIZE,
+                                   g_param_spec_uint ("icon-cache-size",
+                                                      "icon-cache-size",
+                                                      "icon-cache-size",
+                                                      1u, 4096u, 64u,
+                                                      EXO_PARAM_READWRITE));
+
   /**
    * ThunarIconFactory:icon-theme:
    *
@@ -198,24 +236,19 @@ thunar_icon_factory_init (ThunarIconFactory *factory)
   factory->changed_hook_id = g_signal_add_emission_hook (g_signal_lookup ("changed", GTK_TYPE_ICON_THEME),
                                                          0, thunar_icon_factory_changed, factory, NULL);
 
-  /* allocate the hash table for the icon cache */
-  factory->icon_cache = g_hash_table_new_full (thunar_icon_key_hash, thunar_icon_key_equal,
-                                               thunar_icon_key_free, g_object_unref);
-}
-
-
-
-static void
-thunar_icon_factory_dispose (GObject *object)
-{
-  ThunarIconFactory *factory = THUNAR_ICON_FACTORY (object);
-
-  _thunar_return_if_fail (THUNAR_IS_ICON_FACTORY (factory));
-
-  if (G_UNLIKELY (factory->sweep_timer_id != 0))
-    g_source_remove (factory->sweep_timer_id);
-
-  (*G_OBJECT_CLASS (thunar_icon_factory_parent_class)->dispose) (object);
+  /* allocate the icon cache */
+  factory->icon_cache_size = 64;
+  factory->icon_cache = thunar_icon_cache_new (factory->icon_cache_size << 20);
+
+  /* setup the background thumbnail loading */
+  factory->load_table = g_hash_table_new (g_direct_hash, g_direct_equal);
+  factory->load_pool = g_thread_pool_new (thunar_icon_factory_load_thread, factory,
+                                          THUNAR_ICON_FACTORY_LOAD_THREADS, FALSE, NULL);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_mutex_init (&factory->load_lock);
+#else
+  factory->load_lock = g_mutex_new ();
+#endif
 }
 
 
@@ -224,11 +257,35 @@ static void
 thunar_icon_factory_finalize (GObject *object)
 {
   ThunarIconFactory *factory = THUNAR_ICON_FACTORY (object);
+  GHashTableIter     iter;
+  ThunarIconLoad    *load;
 
   _thunar_return_if_fail (THUNAR_IS_ICON_FACTORY (factory));
 
-  /* clear the icon cache hash table */
-  g_hash_table_destroy (factory->icon_cache);
+  /* cancel the pending loads, the threads hand them back */
+  _load_lock (factory);
+  g_hash_table_iter_init (&iter, factory->load_table);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) &load))
+    load->cancelled = TRUE;
+  _load_unlock (factory);
+
+  /* wait for the threads to finish */
+  g_thread_pool_free (factory->load_pool, FALSE, TRUE);
+  g_hash_table_destroy (factory->load_table);
+
+  /* release the finished loads */
+  if (G_UNLIKELY (factory->load_idle_id != 0))
+    g_source_remove (factory->load_idle_id);
+  g_slist_free_full (factory->load_finished, thunar_icon_load_free);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_mutex_clear (&factory->load_lock);
+#else
+  g_mutex_free (factory->load_lock);
+#endif
+
+  /* release the icon cache */
+  thunar_icon_cache_free (factory->icon_cache);
 
   /* remove the "changed" emission hook from the GtkIconTheme class */
   g_signal_remove_emission_hook (g_signal_lookup ("changed", GTK_TYPE_ICON_THEME), factory->changed_hook_id);
@@ -258,6 +315,10 @@ thunar_icon_factory_get_property (GObject    *object,
 
   switch (prop_id)
     {
+    case PROP_ICON_CACHE_SIZE:
+      g_value_set_uint (value, factory->icon_cache_size);
+      break;
+
     case PROP_ICON_THEME:
       g_value_set_object (value, factory->icon_theme);
       break;
@@ -284,6 +345,11 @@ thunar_icon_factory_set_property (GObject      *object,
 
   switch (prop_id)
     {
+    case PROP_ICON_CACHE_SIZE:
+      factory->icon_cache_size = g_value_get_uint (value);
+      thunar_icon_cache_set_max_bytes (factory->icon_cache, (gsize) factory->icon_cache_size << 20);
+      break;
+
     case PROP_THUMBNAIL_MODE:
       factory->thumbnail_mode = g_value_get_enum (value);
       break;
@@ -304,11 +370,8 @@ thunar_icon_factory_changed (GSignalInvocationHint *ihint,
 {
   ThunarIconFactory *factory = THUNAR_ICON_FACTORY (user_data);
 
-  /* drop all items from the icon cache */
-  g_hash_table_remove_all (factory->icon_cache);
-
-  /* bump the stamp so all file icons are reloaded */
-  factory->theme_stamp++;
+  /* drop all items from the icon cache, including the file icons */
+  thunar_icon_cache_clear (factory->icon_cache);
 
   /* keep the emission hook alive */
   return TRUE;
@@ -316,38 +379,27 @@ thunar_icon_factory_changed (GSignalInvocationHint *ihint,
 
 
 
-static gboolean
-thunar_icon_check_sweep (ThunarIconKey *key,
-                         GdkPixbuf     *pixbuf)
-{
-  return (G_OBJECT (pixbuf)->ref_count == 1);
-}
+/* the alpha byte of an RGBA pixel read as a 32 bit word */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define THUMBNAIL_ALPHA_MASK (0xff000000u)
+#else
+#define THUMBNAIL_ALPHA_MASK (0x000000ffu)
+#endif
 
 
 
-static gboolean
-thunar_icon_factory_sweep_timer (gpointer user_data)
+static inline gboolean
+thumbnail_row_is_opaque (const guint32 *pixels,
+                         gint           width)
 {
-  ThunarIconFactory *factory = THUNAR_ICON_FACTORY (user_data);
-
-  _thunar_return_val_if_fail (THUNAR_IS_ICON_FACTORY (factory), FALSE);
-
-  GDK_THREADS_ENTER ();
-
-  /* ditch all icons whose ref_count is 1 */
-  g_hash_table_foreach_remove (factory->icon_cache, (GHRFunc) thunar_icon_check_sweep, factory);
-
-  GDK_THREADS_LEAVE ();
-
-  return FALSE;
-}
+  guint32 opaque = THUMBNAIL_ALPHA_MASK;
+  gint    n;
 
+  /* no early exit, so the compiler can vectorize the loop */
+  for (n = 0; n < width; ++n)
+    opaque &= pixels[n];
 
-
-static void
-thunar_icon_factory_sweep_timer_destroy (gpointer user_data)
-{
-  THUNAR_ICON_FACTORY (user_data)->sweep_timer_id = 0;
+  return ((opaque & THUMBNAIL_ALPHA_MASK) == THUMBNAIL_ALPHA_MASK);
 }
 
 
@@ -358,6 +410,7 @@ thumbnail_needs_frame (const GdkPixbuf *thumbnail,
                        gint             height)
 {
   const guchar *pixels;
+  guint32       opaque;
   gint          rowstride;
   gint          n;
 
@@ -369,94 +422,113 @@ thumbnail_needs_frame (const GdkPixbuf *thumbnail,
   if (G_LIKELY (!gdk_pixbuf_get_has_alpha (thumbnail)))
     return TRUE;
 
-  /* get a pointer to the thumbnail data */
+  /* get a pointer to the thumbnail data, the rows of pixbufs
+   * with alpha channel are aligned to whole pixels */
   pixels = gdk_pixbuf_get_pixels (thumbnail);
-
-  /* check if we have a transparent pixel on the first row */
-  for (n = width * 4; n > 0; n -= 4)
-    if (pixels[n - 1] < 255u)
-      return FALSE;
-
-  /* determine the rowstride */
   rowstride = gdk_pixbuf_get_rowstride (thumbnail);
 
-  /* skip the first row */
-  pixels += rowstride;
+  /* check if we have a transparent pixel on the first or last row */
+  if (!thumbnail_row_is_opaque ((const guint32 *) pixels, width)
+      || !thumbnail_row_is_opaque ((const guint32 *) (pixels + (height - 1) * rowstride), width))
+    return FALSE;
 
   /* check if we have a transparent pixel in the first or last column */
-  for (n = height - 2; n > 0; --n, pixels += rowstride)
-    if (pixels[3] < 255u || pixels[width * 4 - 1] < 255u)
-      return FALSE;
+  opaque = THUMBNAIL_ALPHA_MASK;
+  for (n = 1, pixels += rowstride; n < height - 1; ++n, pixels += rowstride)
+    opaque &= ((const guint32 *) pixels)[0] & ((const guint32 *) pixels)[width - 1];
 
-  /* check if we have a transparent pixel on the last row */
-  for (n = width * 4; n > 0; n -= 4)
-    if (pixels[n - 1] < 255u)
-      return FALSE;
+  return ((opaque & THUMBNAIL_ALPHA_MASK) == THUMBNAIL_ALPHA_MASK);
+}
 
-  return TRUE;
+
+
+static GdkPixbuf*
+thunar_icon_factory_get_frame (void)
+{
+  static gsize frame = 0;
+
+  /* the frame is shared by all threads that scale thumbnails */
+  if (g_once_init_enter (&frame))
+    g_once_init_leave (&frame, (gsize) gdk_pixbuf_new_from_inline (-1, thunar_thumbnail_frame, FALSE, NULL));
+
+  return GDK_PIXBUF (frame);
 }
 
 
 
 static GdkPixbuf*
-thunar_icon_factory_load_from_file (ThunarIconFactory *factory,
-                                    const gchar       *path,
-                                    gint               size)
+thunar_icon_factory_load_native (const gchar *path)
 {
   GdkPixbuf *pixbuf;
-  GdkPixbuf *frame;
-  GdkPixbuf *tmp;
   gboolean   needs_frame;
-  gint       max_width;
-  gint       max_height;
-  gint       width;
-  gint       height;
 
   /* try to load the image from the file */
   pixbuf = gdk_pixbuf_new_from_file (path, NULL);
   if (G_LIKELY (pixbuf != NULL))
     {
-      /* determine the dimensions of the pixbuf */
-      width = gdk_pixbuf_get_width (pixbuf);
-      height = gdk_pixbuf_get_height (pixbuf);
-
-      /* check if we want to add a frame to the image (we really don't
-       * want to do this for icons displayed in the details view).
-       */
+      /* check if we want to add a frame to the image, this only depends
+       * on the decoded image, so remember it for all derived sizes */
       needs_frame = (strstr (path, G_DIR_SEPARATOR_S ".thumbnails" G_DIR_SEPARATOR_S) != NULL)
-                 && (size >= 32) && thumbnail_needs_frame (pixbuf, width, height);
+                 && thumbnail_needs_frame (pixbuf, gdk_pixbuf_get_width (pixbuf),
+                                           gdk_pixbuf_get_height (pixbuf));
+      g_object_set_qdata (G_OBJECT (pixbuf), thunar_icon_factory_frame_quark,
+                          GINT_TO_POINTER (needs_frame));
+    }
 
-      /* be sure to make framed thumbnails fit into the size */
-      if (G_LIKELY (needs_frame))
-        {
-          max_width = size - (3 + 6);
-          max_height = size - (3 + 6);
-        }
-      else
-        {
-          max_width = size;
-          max_height = size;
-        }
+  return pixbuf;
+}
 
-      /* scale down the icon (if required) */
-      if (G_LIKELY (width > max_width || height > max_height))
-        {
-          /* scale down to the required size */
-          tmp = exo_gdk_pixbuf_scale_down (pixbuf, TRUE, MAX (1, max_height), MAX (1, max_height));
-          g_object_unref (G_OBJECT (pixbuf));
-          pixbuf = tmp;
-        }
 
-      /* add a frame around thumbnail (large) images */
-      if (G_LIKELY (needs_frame))
-        {
-          /* add a frame to the thumbnail */
-          frame = gdk_pixbuf_new_from_inline (-1, thunar_thumbnail_frame, FALSE, NULL);
-          tmp = exo_gdk_pixbuf_frame (pixbuf, frame, 4, 3, 5, 6);
-          g_object_unref (G_OBJECT (pixbuf));
-          g_object_unref (G_OBJECT (frame));
-          pixbuf = tmp;
-        }
+
+static GdkPixbuf*
+thunar_icon_factory_scale_native (GdkPixbuf *native,
+                                  gint       size)
+{
+  GdkPixbuf *pixbuf;
+  GdkPixbuf *tmp;
+  gboolean   needs_frame;
+  gint       max_size;
+
+  /* we really don't want frames for icons displayed in the details view */
+  needs_frame = (size >= 32)
+             && GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (native), thunar_icon_factory_frame_quark));
+
+  /* be sure to make framed thumbnails fit into the size */
+  max_size = needs_frame ? size - (3 + 6) : size;
+
+  /* scale down the icon (if required) */
+  if (G_LIKELY (gdk_pixbuf_get_width (native) > max_size || gdk_pixbuf_get_height (native) > max_size))
+    pixbuf = exo_gdk_pixbuf_scale_down (native, TRUE, MAX (1, max_size), MAX (1, max_size));
+  else
+    pixbuf = g_object_ref (G_OBJECT (native));
+
+  /* add a frame around thumbnail (large) images */
+  if (G_LIKELY (needs_frame))
+    {
+      /* add a frame to the thumbnail */
+      tmp = exo_gdk_pixbuf_frame (pixbuf, thunar_icon_factory_get_frame (), 4, 3, 5, 6);
+      g_object_unref (G_OBJECT (pixbuf));
+      pixbuf = tmp;
+    }
+
+  return pixbuf;
+}
+
+
+
+static GdkPixbuf*
+thunar_icon_factory_load_from_file (ThunarIconFactory *factory,
+                                    const gchar       *path,
+                                    gint               size)
+{
+  GdkPixbuf *native;
+  GdkPixbuf *pixbuf = NULL;
+
+  native = thunar_icon_factory_load_native (path);
+  if (G_LIKELY (native != NULL))
+    {
+      pixbuf = thunar_icon_factory_scale_native (native, size);
+      g_object_unref (G_OBJECT (native));
     }
 
   return pixbuf;
@@ -470,21 +542,16 @@ thunar_icon_factory_lookup_icon (ThunarIconFactory *factory,
                                  gint               size,
                                  gboolean           wants_default)
 {
-  ThunarIconKey  lookup_key;
-  ThunarIconKey *key;
   GtkIconInfo   *icon_info;
-  GdkPixbuf     *pixbuf = NULL;
+  GdkPixbuf     *pixbuf;
 
   _thunar_return_val_if_fail (THUNAR_IS_ICON_FACTORY (factory), NULL);
   _thunar_return_val_if_fail (name != NULL && *name != '\0', NULL);
   _thunar_return_val_if_fail (size > 0, NULL);
 
-  /* prepare the lookup key */
-  lookup_key.name = (gchar *) name;
-  lookup_key.size = size;
-
   /* check if we already have a cached version of the icon */
-  if (!g_hash_table_lookup_extended (factory->icon_cache, &lookup_key, NULL, (gpointer) &pixbuf))
+  pixbuf = thunar_icon_cache_lookup (factory->icon_cache, name, NULL, size, 0, 0);
+  if (pixbuf == NULL)
     {
       /* check if we have to load a file instead of a themed icon */
       if (G_UNLIKELY (g_path_is_absolute (name)))
@@ -516,21 +583,9 @@ thunar_icon_factory_lookup_icon (ThunarIconFactory *factory,
             return thunar_icon_factory_load_fallback (factory, size);
         }
 
-      /* generate a key for the new cached icon */
-      key = g_slice_new (ThunarIconKey);
-      key->size = size;
-      key->name = g_strdup (name);
-
       /* insert the new icon into the cache */
-      g_hash_table_insert (factory->icon_cache, key, pixbuf);
-    }
-
-  /* schedule the sweeper */
-  if (G_UNLIKELY (factory->sweep_timer_id == 0))
-    {
-      factory->sweep_timer_id = g_timeout_add_seconds_full (G_PRIORITY_LOW, THUNAR_ICON_FACTORY_SWEEP_TIMEOUT,
-                                                            thunar_icon_factory_sweep_timer, factory,
-                                                            thunar_icon_factory_sweep_timer_destroy);
+      thunar_icon_cache_insert (factory->icon_cache, name, NULL, size, 0, 0, pixbuf, FALSE);
+      return pixbuf;
     }
 
   return g_object_ref (G_OBJECT (pixbuf));
@@ -538,68 +593,183 @@ thunar_icon_factory_lookup_icon (ThunarIconFactory *factory,
 
 
 
-static guint
-thunar_icon_key_hash (gconstpointer data)
+static GdkPixbuf*
+thunar_icon_factory_load_fallback (ThunarIconFactory *factory,
+                                   gint               size)
 {
-  const ThunarIconKey *key = data;
-  const gchar         *p;
-  guint                h;
+  return thunar_icon_factory_lookup_icon (factory, "text-x-generic", size, FALSE);
+}
 
-  h = (guint) key->size << 5;
 
-  for (p = key->name; *p != '\0'; ++p)
-    h = (h << 5) - h + *p;
 
-  return h;
+static void
+thunar_icon_load_free (gpointer data)
+{
+  ThunarIconLoad *load = data;
+
+  g_object_unref (load->file);
+  if (load->native != NULL)
+    g_object_unref (load->native);
+  if (load->icon != NULL)
+    g_object_unref (load->icon);
+  g_free (load->path);
+  g_slice_free (ThunarIconLoad, load);
 }
 
 
 
-static gboolean
-thunar_icon_key_equal (gconstpointer a,
-                       gconstpointer b)
+static guint
+thunar_icon_factory_file_tag (ThunarFile *file)
 {
-  const ThunarIconKey *a_key = a;
-  const ThunarIconKey *b_key = b;
+  guint serial;
 
-  /* compare sizes first */
-  if (a_key->size != b_key->size)
-    return FALSE;
+  /* the icon of a file is outdated once its thumbnail state
+   * changes or thunar_icon_factory_clear_pixmap_cache() is called */
+  serial = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (file), thunar_icon_factory_serial_quark));
+  if (G_UNLIKELY (serial == 0))
+    {
+      /* don't pick up icons of a previous file at the same location */
+      serial = ++thunar_icon_factory_serial;
+      g_object_set_qdata (G_OBJECT (file), thunar_icon_factory_serial_quark, GUINT_TO_POINTER (serial));
+    }
 
-  /* do a full string comparison on the names */
-  return exo_str_is_equal (a_key->name, b_key->name);
+  return (serial << 2) | thunar_file_get_thumb_state (file);
 }
 
 
 
 static void
-thunar_icon_key_free (gpointer data)
+thunar_icon_factory_store_icon (ThunarIconFactory  *factory,
+                                ThunarFile         *file,
+                                ThunarFileIconState icon_state,
+                                gint                icon_size,
+                                GdkPixbuf          *icon,
+                                gboolean            shared)
 {
-  ThunarIconKey *key = data;
-
-  g_free (key->name);
-  g_slice_free (ThunarIconKey, key);
+  thunar_icon_cache_insert (factory->icon_cache, NULL, thunar_file_get_file (file),
+                            icon_size, icon_state, thunar_icon_factory_file_tag (file),
+                            icon, shared);
 }
 
 
 
 static void
-thunar_icon_store_free (gpointer data)
+thunar_icon_factory_load_thread (gpointer data,
+                                 gpointer user_data)
 {
-  ThunarIconStore *store = data;
+  ThunarIconFactory *factory = THUNAR_ICON_FACTORY (user_data);
+  ThunarIconLoad    *load = data;
+  gboolean           cancelled;
+
+  /* skip loads for rows that scrolled away in the meantime */
+  _load_lock (factory);
+  cancelled = load->cancelled;
+  _load_unlock (factory);
 
-  if (store->icon != NULL)
-    g_object_unref (store->icon);
-  g_slice_free (ThunarIconStore, store);
+  /* decode, scale and frame the thumbnail */
+  if (G_LIKELY (!cancelled))
+    {
+      load->native = thunar_icon_factory_load_native (load->path);
+      if (G_LIKELY (load->native != NULL))
+        load->icon = thunar_icon_factory_scale_native (load->native, load->icon_size);
+    }
+
+  /* hand the icon over to the main thread, which also releases
+   * cancelled loads, since they may hold the last file reference */
+  _load_lock (factory);
+  factory->load_finished = g_slist_prepend (factory->load_finished, load);
+  if (factory->load_idle_id == 0)
+    factory->load_idle_id = g_idle_add_full (G_PRIORITY_LOW, thunar_icon_factory_load_idle, factory, NULL);
+  _load_unlock (factory);
 }
 
 
 
-static GdkPixbuf*
-thunar_icon_factory_load_fallback (ThunarIconFactory *factory,
-                                   gint               size)
+static gboolean
+thunar_icon_factory_load_idle (gpointer user_data)
 {
-  return thunar_icon_factory_lookup_icon (factory, "text-x-generic", size, FALSE);
+  ThunarIconFactory *factory = THUNAR_ICON_FACTORY (user_data);
+  ThunarIconLoad    *load;
+  const gchar       *icon_name;
+  GdkPixbuf         *icon;
+  gboolean           shared;
+  GSList            *finished;
+  GSList            *lp;
+  GList             *changed = NULL;
+  GList             *fp;
+
+  GDK_THREADS_ENTER ();
+
+  /* take all loads that finished since the last run */
+  _load_lock (factory);
+  finished = factory->load_finished;
+  factory->load_finished = NULL;
+  factory->load_idle_id = 0;
+  _load_unlock (factory);
+
+  /* loads are only cancelled in the main thread, so
+   * there's no need to hold the lock from here on */
+  for (lp = finished; lp != NULL; lp = lp->next)
+    {
+      load = lp->data;
+      if (load->cancelled)
+        continue;
+
+      g_hash_table_remove (factory->load_table, load->file);
+
+      /* the thumbnail may have changed in the meantime */
+      if (thunar_file_get_thumb_state (load->file) != THUNAR_FILE_THUMB_STATE_READY
+          || g_strcmp0 (thunar_file_get_thumbnail_path (load->file), load->path) != 0)
+        continue;
+
+      if (G_LIKELY (load->icon != NULL))
+        {
+          /* keep the decoded thumbnail for other zoom levels */
+          thunar_icon_factory_store_icon (factory, load->file, 0, THUNAR_ICON_FACTORY_NATIVE_SIZE,
+                                          load->native, FALSE);
+
+          icon = g_object_ref (load->icon);
+          shared = (load->icon == load->native);
+        }
+      else
+        {
+          /* the thumbnail is broken, stick to the regular icon */
+          icon_name = thunar_file_get_icon_name (load->file, load->icon_state, factory->icon_theme);
+          icon = thunar_icon_factory_load_icon (factory, icon_name, load->icon_size, TRUE);
+          shared = TRUE;
+        }
+
+      thunar_icon_factory_store_icon (factory, load->file, load->icon_state,
+                                      load->icon_size, icon, shared);
+      g_object_unref (icon);
+
+      changed = g_list_prepend (changed, g_object_ref (load->file));
+    }
+
+  g_slist_free_full (finished, thunar_icon_load_free);
+
+  /* redraw the rows of all files at once */
+  for (fp = changed; fp != NULL; fp = fp->next)
+    thunar_file_changed (fp->data);
+  g_list_free_full (changed, g_object_unref);
+
+  GDK_THREADS_LEAVE ();
+
+  return FALSE;
+}
+
+
+
+static void
+thunar_icon_factory_load_cancel (ThunarIconFactory *factory,
+                                 ThunarIconLoad    *load)
+{
+  /* the idle source releases the load */
+  g_hash_table_remove (factory->load_table, load->file);
+
+  _load_lock (factory);
+  load->cancelled = TRUE;
+  _load_unlock (factory);
 }
 
 
@@ -670,6 +840,8 @@ thunar_icon_factory_get_for_icon_theme (GtkIconTheme *icon_theme)
 
       /* connect the "show-thumbnails" property to the global preference */
       factory->preferences = thunar_preferences_get ();
+      exo_binding_new (G_OBJECT (factory->preferences), "misc-icon-cache-size",
+                       G_OBJECT (factory), "icon-cache-size");
       exo_binding_new (G_OBJECT (factory->preferences), "misc-thumbnail-mode",
                        G_OBJECT (factory), "thumbnail-mode");
     }
@@ -769,46 +941,39 @@ thunar_icon_factory_load_icon (ThunarIconFactory        *factory,
 
 
 /**
- * thunar_icon_factory_load_file_icon:
+ * thunar_icon_factory_load_file_icon_real:
  * @factory    : a #ThunarIconFactory instance.
  * @file       : a #ThunarFile.
  * @icon_state : the desired icon state.
  * @icon_size  : the desired icon size.
- *
- * The caller is responsible to free the returned object using
- * g_object_unref() when no longer needed.
+ * @wait       : %FALSE to decode thumbnails in the background.
  *
  * Return value: the #GdkPixbuf icon.
  **/
-GdkPixbuf*
-thunar_icon_factory_load_file_icon (ThunarIconFactory  *factory,
-                                    ThunarFile         *file,
-                                    ThunarFileIconState icon_state,
-                                    gint                icon_size)
+static GdkPixbuf*
+thunar_icon_factory_load_file_icon_real (ThunarIconFactory  *factory,
+                                         ThunarFile         *file,
+                                         ThunarFileIconState icon_state,
+                                         gint                icon_size,
+                                         gboolean            wait)
 {
   GInputStream    *stream;
   GtkIconInfo     *icon_info;
   const gchar     *thumbnail_path;
   GdkPixbuf       *icon = NULL;
+  GdkPixbuf       *native;
   GIcon           *gicon;
   const gchar     *icon_name;
   const gchar     *custom_icon;
-  ThunarIconStore *store;
+  ThunarIconLoad  *load;
+  gboolean         pending = FALSE;
+  gboolean         shared = TRUE;
 
-  _thunar_return_val_if_fail (THUNAR_IS_ICON_FACTORY (factory), NULL);
-  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), NULL);
-  _thunar_return_val_if_fail (icon_size > 0, NULL);
-
-  /* check if we have a stored icon on the file and it is still valid */
-  store = g_object_get_qdata (G_OBJECT (file), thunar_icon_factory_store_quark);
-  if (store != NULL
-      && store->icon_state == icon_state
-      && store->icon_size == icon_size
-      && store->stamp == factory->theme_stamp
-      && store->thumb_state == thunar_file_get_thumb_state (file))
-    {
-      return g_object_ref (store->icon);
-    }
+  /* check if we have a cached icon for the file and it is still valid */
+  icon = thunar_icon_cache_lookup (factory->icon_cache, NULL, thunar_file_get_file (file),
+                                   icon_size, icon_state, thunar_icon_factory_file_tag (file));
+  if (icon != NULL)
+    return g_object_ref (icon);
 
   /* check if we have a custom icon for this file */
   custom_icon = thunar_file_get_custom_icon (file);
@@ -876,11 +1041,60 @@ thunar_icon_factory_load_file_icon (ThunarIconFactory  *factory,
            * the filename of the thumbnail */
           thumbnail_path = thunar_file_get_thumbnail_path (file);
 
-          /* check if we have a valid path */
+          /* check if the thumbnail was already decoded, e.g. for another zoom level */
+          native = NULL;
           if (thumbnail_path != NULL)
+            {
+              native = thunar_icon_cache_lookup (factory->icon_cache, NULL, thunar_file_get_file (file),
+                                                 THUNAR_ICON_FACTORY_NATIVE_SIZE, 0,
+                                                 thunar_icon_factory_file_tag (file));
+              if (native != NULL)
+                g_object_ref (G_OBJECT (native));
+            }
+
+          /* check if we have a valid path */
+          if (native == NULL && thumbnail_path != NULL && wait)
             {
               /* try to load the thumbnail */
-              icon = thunar_icon_factory_load_from_file (factory, thumbnail_path, icon_size);
+              native = thunar_icon_factory_load_native (thumbnail_path);
+              if (G_LIKELY (native != NULL))
+                thunar_icon_factory_store_icon (factory, file, 0, THUNAR_ICON_FACTORY_NATIVE_SIZE, native, FALSE);
+            }
+
+          if (native != NULL)
+            {
+              /* scaling and framing the decoded thumbnail is cheap */
+              icon = thunar_icon_factory_scale_native (native, icon_size);
+              shared = (icon == native);
+              g_object_unref (G_OBJECT (native));
+            }
+          else if (thumbnail_path != NULL && !wait)
+            {
+              /* check if the thumbnail is already being loaded */
+              load = g_hash_table_lookup (factory->load_table, file);
+              if (load != NULL
+                  && (load->icon_size != icon_size
+                      || strcmp (load->path, thumbnail_path) != 0))
+                {
+                  thunar_icon_factory_load_cancel (factory, load);
+                  load = NULL;
+                }
+
+              /* decode the thumbnail in the background */
+              if (load == NULL)
+                {
+                  load = g_slice_new0 (ThunarIconLoad);
+                  load->file = g_object_ref (file);
+                  load->path = g_strdup (thumbnail_path);
+                  load->icon_size = icon_size;
+                  load->icon_state = icon_state;
+
+                  g_hash_table_insert (factory->load_table, file, load);
+                  g_thread_pool_push (factory->load_pool, load, NULL);
+                }
+
+              /* show the regular icon until the thumbnail is ready */
+              pending = TRUE;
             }
         }
     }
@@ -892,24 +1106,144 @@ thunar_icon_factory_load_file_icon (ThunarIconFactory  *factory,
       icon = thunar_icon_factory_load_icon (factory, icon_name, icon_size, TRUE);
     }
 
-  if (G_LIKELY (icon != NULL))
-    {
-      store = g_slice_new (ThunarIconStore);
-      store->icon_size = icon_size;
-      store->icon_state = icon_state;
-      store->stamp = factory->theme_stamp;
-      store->thumb_state = thunar_file_get_thumb_state (file);
-      store->icon = g_object_ref (icon);
-
-      g_object_set_qdata_full (G_OBJECT (file), thunar_icon_factory_store_quark,
-                               store, thunar_icon_store_free);
-    }
+  /* placeholders are not stored, the thumbnail replaces them */
+  if (G_LIKELY (icon != NULL && !pending))
+    thunar_icon_factory_store_icon (factory, file, icon_state, icon_size, icon, shared);
 
   return icon;
 }
 
 
 
+/**
+ * thunar_icon_factory_load_file_icon:
+ * @factory    : a #ThunarIconFactory instance.
+ * @file       : a #ThunarFile.
+ * @icon_state : the desired icon state.
+ * @icon_size  : the desired icon size.
+ *
+ * The caller is responsible to free the returned object using
+ * g_object_unref() when no longer needed.
+ *
+ * Return value: the #GdkPixbuf icon.
+ **/
+GdkPixbuf*
+thunar_icon_factory_load_file_icon (ThunarIconFactory  *factory,
+                                    ThunarFile         *file,
+                                    ThunarFileIconState icon_state,
+                                    gint                icon_size)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_ICON_FACTORY (factory), NULL);
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), NULL);
+  _thunar_return_val_if_fail (icon_size > 0, NULL);
+
+  return thunar_icon_factory_load_file_icon_real (factory, file, icon_state, icon_size, TRUE);
+}
+
+
+
+/**
+ * thunar_icon_factory_peek_file_icon:
+ * @factory    : a #ThunarIconFactory instance.
+ * @file       : a #ThunarFile.
+ * @icon_state : the desired icon state.
+ * @icon_size  : the desired icon size.
+ *
+ * Like thunar_icon_factory_load_file_icon(), but never decodes a
+ * thumbnail in the calling thread. Thumbnails that are not loaded
+ * yet are decoded in the background while the regular icon of @file
+ * is returned, and the "changed" signal is emitted on @file once the
+ * thumbnail is available. Meant to be used while drawing.
+ *
+ * The caller is responsible to free the returned object using
+ * g_object_unref() when no longer needed.
+ *
+ * Return value: the #GdkPixbuf icon.
+ **/
+GdkPixbuf*
+thunar_icon_factory_peek_file_icon (ThunarIconFactory  *factory,
+                                    ThunarFile         *file,
+                                    ThunarFileIconState icon_state,
+                                    gint                icon_size)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_ICON_FACTORY (factory), NULL);
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), NULL);
+  _thunar_return_val_if_fail (icon_size > 0, NULL);
+
+  return thunar_icon_factory_load_file_icon_real (factory, file, icon_state, icon_size, FALSE);
+}
+
+
+
+/**
+ * thunar_icon_factory_cancel_thumbnails:
+ * @factory : a #ThunarIconFactory instance.
+ * @folder  : the folder of the files.
+ * @files   : the #ThunarFile<!---->s to keep loading.
+ *
+ * Cancels the background loads of thumbnails of files in @folder
+ * that are not in @files, usually because they were scrolled out of
+ * view. They are loaded again once they are drawn.
+ **/
+void
+thunar_icon_factory_cancel_thumbnails (ThunarIconFactory *factory,
+                                       ThunarFile        *folder,
+                                       GList             *files)
+{
+  GHashTableIter  iter;
+  ThunarIconLoad *load;
+  GHashTable     *keep;
+  GFile          *parent;
+  GList          *cancelled = NULL;
+  GList          *lp;
+
+  _thunar_return_if_fail (THUNAR_IS_ICON_FACTORY (factory));
+  _thunar_return_if_fail (THUNAR_IS_FILE (folder));
+
+  if (g_hash_table_size (factory->load_table) == 0)
+    return;
+
+  keep = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (lp = files; lp != NULL; lp = lp->next)
+    g_hash_table_insert (keep, lp->data, lp->data);
+
+  parent = thunar_file_get_file (folder);
+
+  g_hash_table_iter_init (&iter, factory->load_table);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) &load))
+    if (g_hash_table_lookup (keep, load->file) == NULL
+        && g_file_has_parent (thunar_file_get_file (load->file), parent))
+      cancelled = g_list_prepend (cancelled, load);
+
+  for (lp = cancelled; lp != NULL; lp = lp->next)
+    thunar_icon_factory_load_cancel (factory, lp->data);
+
+  g_list_free (cancelled);
+  g_hash_table_destroy (keep);
+}
+
+
+
+/**
+ * thunar_icon_factory_get_cache_stats:
+ * @factory : a #ThunarIconFactory instance.
+ * @stats   : return location for the counters.
+ *
+ * Stores the hit, miss and eviction counters and the memory
+ * usage of the icon cache of @factory in @stats.
+ **/
+void
+thunar_icon_factory_get_cache_stats (ThunarIconFactory    *factory,
+                                     ThunarIconCacheStats *stats)
+{
+  _thunar_return_if_fail (THUNAR_IS_ICON_FACTORY (factory));
+  _thunar_return_if_fail (stats != NULL);
+
+  thunar_icon_cache_get_stats (factory->icon_cache, stats);
+}
+
+
+
 /**
  * thunar_icon_factory_clear_pixmap_cache:
  * @file : a #ThunarFile.
@@ -921,7 +1255,8 @@ thunar_icon_factory_clear_pixmap_cache (ThunarFile *file)
 {
   _thunar_return_if_fail (THUNAR_IS_FILE (file));
 
-  /* unset the data */
-  if (thunar_icon_factory_store_quark != 0)
-    g_object_set_qdata (G_OBJECT (file), thunar_icon_factory_store_quark, NULL);
+  /* a new serial outdates the cached icons of the file */
+  if (thunar_icon_factory_serial_quark != 0)
+    g_object_set_qdata (G_OBJECT (file), thunar_icon_factory_serial_quark,
+                        GUINT_TO_POINTER (++thunar_icon_factory_serial));
 }
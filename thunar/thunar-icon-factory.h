@@ -21,6 +21,7 @@
 #define __THUNAR_ICON_FACTORY_H__
 
 #include <thunar/thunar-file.h>
+#include <thunar/thunar-icon-cache.h>
 
 G_BEGIN_DECLS;
 
@@ -60,6 +61,17 @@ GdkPixbuf             *thunar_icon_factory_load_file_icon     (ThunarIconFactory
                                                                ThunarFile               *file,
                                                                ThunarFileIconState       icon_state,
                                                                gint                      icon_size);
+GdkPixbuf             *thunar_icon_factory_peek_file_icon     (ThunarIconFactory        *factory,
+                                                               ThunarFile               *file,
+                                                               ThunarFileIconState       icon_state,
+                                                               gint                      icon_size);
+
+void                   thunar_icon_factory_cancel_thumbnails  (ThunarIconFactory        *factory,
+                                                               ThunarFile               *folder,
+                                                               GList                    *files);
+
+void                   thunar_icon_factory_get_cache_stats    (ThunarIconFactory        *factory,
+                                                               ThunarIconCacheStats     *stats);
 
 void                   thunar_icon_factory_clear_pixmap_cache (ThunarFile               *file);
 
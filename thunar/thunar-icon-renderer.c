@@ -21,6 +21,10 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
 #include <thunar/thunar-clipboard-manager.h>
 #include <thunar/thunar-gobject-extensions.h>
 #include <thunar/thunar-gdk-extensions.h>
@@ -30,6 +34,11 @@
 
 
 
+/* number of emblem overlays remembered per icon */
+#define MAX_EMBLEM_OVERLAYS (4)
+
+
+
 enum
 {
   PROP_0,
@@ -68,6 +77,30 @@ static void thunar_icon_renderer_render        (GtkCellRenderer         *rendere
 
 
 
+typedef struct
+{
+  /* the interned emblem names and layout the overlay was made for */
+  const gchar **emblem_names;
+  gint          size;
+  gint          icon_width;
+  gint          icon_height;
+  gint          cell_width;
+  gint          cell_height;
+
+  /* the composited emblems, relative to the icon, or %NULL
+   * if none of the emblems is available in the icon theme */
+  GdkPixbuf    *pixbuf;
+  gint          x_offset;
+  gint          y_offset;
+}
+ThunarEmblemOverlay;
+
+
+
+static GQuark thunar_icon_renderer_overlay_quark = 0;
+
+
+
 G_DEFINE_TYPE (ThunarIconRenderer, thunar_icon_renderer, GTK_TYPE_CELL_RENDERER)
 
 
@@ -78,6 +111,8 @@ thunar_icon_renderer_class_init (ThunarIconRendererClass *klass)
   GtkCellRendererClass *gtkcell_renderer_class;
   GObjectClass         *gobject_class;
 
+  thunar_icon_renderer_overlay_quark = g_quark_from_static_string ("thunar-icon-renderer-overlay");
+
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->finalize = thunar_icon_renderer_finalize;
   gobject_class->get_property = thunar_icon_renderer_get_property;
@@ -350,6 +385,195 @@ thunar_icon_renderer_color_lighten (cairo_t   *cr,
 
 
 
+static void
+thunar_emblem_overlay_free (gpointer data)
+{
+  ThunarEmblemOverlay *overlay = data;
+
+  if (overlay->pixbuf != NULL)
+    g_object_unref (G_OBJECT (overlay->pixbuf));
+  g_free (overlay->emblem_names);
+  g_slice_free (ThunarEmblemOverlay, overlay);
+}
+
+
+
+static void
+thunar_emblem_overlay_list_free (gpointer data)
+{
+  g_slist_free_full (data, thunar_emblem_overlay_free);
+}
+
+
+
+static gboolean
+thunar_emblem_names_equal (const gchar **a,
+                           const gchar **b)
+{
+  /* the names are interned, so we can compare the pointers */
+  for (; *a != NULL && *a == *b; ++a, ++b)
+    ;
+
+  return (*a == *b);
+}
+
+
+
+static ThunarEmblemOverlay*
+thunar_icon_renderer_get_overlay (ThunarIconRenderer *icon_renderer,
+                                  ThunarIconFactory  *icon_factory,
+                                  GdkPixbuf          *icon,
+                                  const gchar       **emblem_names,
+                                  const GdkRectangle *icon_area,
+                                  const GdkRectangle *cell_area)
+{
+  ThunarEmblemOverlay *overlay;
+  GdkRectangle         emblem_areas[4];
+  GdkRectangle         overlay_area;
+  GdkPixbuf           *emblems[4];
+  GdkPixbuf           *emblem;
+  GdkPixbuf           *temp;
+  GSList              *overlays;
+  GSList              *lp;
+  guint                n_emblem_names;
+  gint                 max_emblems;
+  gint                 emblem_size;
+  gint                 position;
+  gint                 n;
+
+  /* check if we already composited these emblems for the icon */
+  overlays = g_object_get_qdata (G_OBJECT (icon), thunar_icon_renderer_overlay_quark);
+  for (lp = overlays; lp != NULL; lp = lp->next)
+    {
+      overlay = lp->data;
+      if (overlay->size == icon_renderer->size
+          && overlay->icon_width == icon_area->width
+          && overlay->icon_height == icon_area->height
+          && overlay->cell_width == cell_area->width
+          && overlay->cell_height == cell_area->height
+          && thunar_emblem_names_equal (overlay->emblem_names, emblem_names))
+        return overlay;
+    }
+
+  overlay = g_slice_new0 (ThunarEmblemOverlay);
+  n_emblem_names = g_strv_length ((gchar **) emblem_names) + 1;
+  overlay->emblem_names = g_new (const gchar *, n_emblem_names);
+  memcpy (overlay->emblem_names, emblem_names, n_emblem_names * sizeof (gchar *));
+  overlay->size = icon_renderer->size;
+  overlay->icon_width = icon_area->width;
+  overlay->icon_height = icon_area->height;
+  overlay->cell_width = cell_area->width;
+  overlay->cell_height = cell_area->height;
+
+  /* render up to four emblems for sizes from 48 onwards, else up to 2 emblems */
+  max_emblems = (icon_renderer->size < 48) ? 2 : 4;
+
+  /* calculate the emblem size */
+  emblem_size = MIN ((2 * icon_renderer->size) / 3, 32);
+
+  for (n = 0, position = 0; emblem_names[n] != NULL && position < max_emblems; ++n)
+    {
+      /* check if we have the emblem in the icon theme */
+      emblem = thunar_icon_factory_load_icon (icon_factory, emblem_names[n], emblem_size, FALSE);
+      if (G_UNLIKELY (emblem == NULL))
+        continue;
+
+      /* shrink insane emblems */
+      if (G_UNLIKELY (MAX (gdk_pixbuf_get_width (emblem), gdk_pixbuf_get_height (emblem)) > emblem_size))
+        {
+          /* scale down the emblem */
+          temp = exo_gdk_pixbuf_scale_ratio (emblem, emblem_size);
+          g_object_unref (G_OBJECT (emblem));
+          emblem = temp;
+        }
+
+      /* determine the dimensions of the emblem */
+      emblems[position] = emblem;
+      emblem_areas[position].width = gdk_pixbuf_get_width (emblem);
+      emblem_areas[position].height = gdk_pixbuf_get_height (emblem);
+
+      /* determine a good position for the emblem, depending on the position index */
+      switch (position)
+        {
+        case 0: /* right/bottom */
+          emblem_areas[0].x = MIN (icon_area->x + icon_area->width - emblem_areas[0].width / 2,
+                                   cell_area->x + cell_area->width - emblem_areas[0].width);
+          emblem_areas[0].y = MIN (icon_area->y + icon_area->height - emblem_areas[0].height / 2,
+                                   cell_area->y + cell_area->height -emblem_areas[0].height);
+          break;
+
+        case 1: /* left/bottom */
+          emblem_areas[1].x = MAX (icon_area->x - emblem_areas[1].width / 2,
+                                   cell_area->x);
+          emblem_areas[1].y = MIN (icon_area->y + icon_area->height - emblem_areas[1].height / 2,
+                                   cell_area->y + cell_area->height -emblem_areas[1].height);
+          break;
+
+        case 2: /* left/top */
+          emblem_areas[2].x = MAX (icon_area->x - emblem_areas[2].width / 2,
+                                   cell_area->x);
+          emblem_areas[2].y = MAX (icon_area->y - emblem_areas[2].height / 2,
+                                   cell_area->y);
+          break;
+
+        case 3: /* right/top */
+          emblem_areas[3].x = MIN (icon_area->x + icon_area->width - emblem_areas[3].width / 2,
+                                   cell_area->x + cell_area->width - emblem_areas[3].width);
+          emblem_areas[3].y = MAX (icon_area->y - emblem_areas[3].height / 2,
+                                   cell_area->y);
+          break;
+
+        default:
+          _thunar_assert_not_reached ();
+        }
+
+      /* determine the area covered by all emblems */
+      if (position == 0)
+        overlay_area = emblem_areas[0];
+      else
+        gdk_rectangle_union (&overlay_area, &emblem_areas[position], &overlay_area);
+
+      /* advance the position index */
+      ++position;
+    }
+
+  if (G_LIKELY (position > 0))
+    {
+      /* composite the emblems in order into a single pixbuf */
+      overlay->pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, overlay_area.width, overlay_area.height);
+      gdk_pixbuf_fill (overlay->pixbuf, 0x00000000);
+      overlay->x_offset = overlay_area.x - icon_area->x;
+      overlay->y_offset = overlay_area.y - icon_area->y;
+
+      for (n = 0; n < position; ++n)
+        {
+          gdk_pixbuf_composite (emblems[n], overlay->pixbuf,
+                                emblem_areas[n].x - overlay_area.x, emblem_areas[n].y - overlay_area.y,
+                                emblem_areas[n].width, emblem_areas[n].height,
+                                emblem_areas[n].x - overlay_area.x, emblem_areas[n].y - overlay_area.y,
+                                1.0, 1.0, GDK_INTERP_NEAREST, 255);
+          g_object_unref (G_OBJECT (emblems[n]));
+        }
+    }
+
+  /* remember the overlay on the icon, which is shared by all files with
+   * this icon and dropped together with it, e.g. on theme changes */
+  overlays = g_object_steal_qdata (G_OBJECT (icon), thunar_icon_renderer_overlay_quark);
+  overlays = g_slist_prepend (overlays, overlay);
+  lp = g_slist_nth (overlays, MAX_EMBLEM_OVERLAYS - 1);
+  if (G_UNLIKELY (lp != NULL && lp->next != NULL))
+    {
+      thunar_emblem_overlay_list_free (lp->next);
+      lp->next = NULL;
+    }
+  g_object_set_qdata_full (G_OBJECT (icon), thunar_icon_renderer_overlay_quark,
+                           overlays, thunar_emblem_overlay_list_free);
+
+  return overlay;
+}
+
+
+
 static void
 thunar_icon_renderer_render (GtkCellRenderer     *renderer,
                              GdkWindow           *window,
@@ -363,21 +587,18 @@ thunar_icon_renderer_render (GtkCellRenderer     *renderer,
   ThunarFileIconState     icon_state;
   ThunarIconRenderer     *icon_renderer = THUNAR_ICON_RENDERER (renderer);
   ThunarIconFactory      *icon_factory;
+  ThunarEmblemOverlay    *overlay;
   GtkIconSource          *icon_source;
   GtkIconTheme           *icon_theme;
   GdkRectangle            emblem_area;
   GdkRectangle            icon_area;
   GdkRectangle            draw_area;
-  GdkPixbuf              *emblem;
+  GdkPixbuf              *base;
   GdkPixbuf              *icon;
   GdkPixbuf              *temp;
-  GList                  *emblems;
-  GList                  *lp;
-  gint                    max_emblems;
-  gint                    position;
+  const gchar           **emblem_names;
   cairo_t                *cr;
   gdouble                 alpha;
-  gint                    emblem_size;
   gboolean                color_selected;
   gboolean                color_lighten;
 
@@ -394,13 +615,16 @@ thunar_icon_renderer_render (GtkCellRenderer     *renderer,
   /* load the main icon */
   icon_theme = gtk_icon_theme_get_for_screen (gdk_drawable_get_screen (window));
   icon_factory = thunar_icon_factory_get_for_icon_theme (icon_theme);
-  icon = thunar_icon_factory_load_file_icon (icon_factory, icon_renderer->file, icon_state, icon_renderer->size);
+  icon = thunar_icon_factory_peek_file_icon (icon_factory, icon_renderer->file, icon_state, icon_renderer->size);
   if (G_UNLIKELY (icon == NULL))
     {
       g_object_unref (G_OBJECT (icon_factory));
       return;
     }
 
+  /* the emblem overlays are stored on the icon of the factory */
+  base = g_object_ref (G_OBJECT (icon));
+
   /* pre-light the item if we're dragging about it */
   if (G_UNLIKELY (icon_state == THUNAR_FILE_ICON_STATE_DROP))
     flags |= GTK_CELL_RENDERER_PRELIT;
@@ -492,81 +716,24 @@ thunar_icon_renderer_render (GtkCellRenderer     *renderer,
   /* check if we should render emblems as well */
   if (G_LIKELY (icon_renderer->emblems))
     {
-      /* display the primary emblem as well (if any) */
-      emblems = thunar_file_get_emblem_names (icon_renderer->file);
-      if (G_UNLIKELY (emblems != NULL))
+      /* display the emblems as well (if any), composited once per icon */
+      emblem_names = thunar_file_peek_emblem_names (icon_renderer->file);
+      if (G_UNLIKELY (emblem_names != NULL && *emblem_names != NULL))
         {
-          /* render up to four emblems for sizes from 48 onwards, else up to 2 emblems */
-          max_emblems = (icon_renderer->size < 48) ? 2 : 4;
-
-          /* render the emblems */
-          for (lp = emblems, position = 0; lp != NULL && position < max_emblems; lp = lp->next)
+          overlay = thunar_icon_renderer_get_overlay (icon_renderer, icon_factory, base,
+                                                      emblem_names, &icon_area, cell_area);
+          if (G_LIKELY (overlay->pixbuf != NULL))
             {
-              /* calculate the emblem size */
-              emblem_size = MIN ((2 * icon_renderer->size) / 3, 32);
-
-              /* check if we have the emblem in the icon theme */
-              emblem = thunar_icon_factory_load_icon (icon_factory, lp->data, emblem_size, FALSE);
-              if (G_UNLIKELY (emblem == NULL))
-                continue;
-
-              /* determine the dimensions of the emblem */
-              emblem_area.width = gdk_pixbuf_get_width (emblem);
-              emblem_area.height = gdk_pixbuf_get_height (emblem);
+              emblem_area.x = icon_area.x + overlay->x_offset;
+              emblem_area.y = icon_area.y + overlay->y_offset;
+              emblem_area.width = gdk_pixbuf_get_width (overlay->pixbuf);
+              emblem_area.height = gdk_pixbuf_get_height (overlay->pixbuf);
 
-              /* shrink insane emblems */
-              if (G_UNLIKELY (MAX (emblem_area.width, emblem_area.height) > emblem_size))
-                {
-                  /* scale down the emblem */
-                  temp = exo_gdk_pixbuf_scale_ratio (emblem, emblem_size);
-                  g_object_unref (G_OBJECT (emblem));
-                  emblem = temp;
-
-                  /* determine the size again */
-                  emblem_area.width = gdk_pixbuf_get_width (emblem);
-                  emblem_area.height = gdk_pixbuf_get_height (emblem);
-                }
-
-              /* determine a good position for the emblem, depending on the position index */
-              switch (position)
-                {
-                case 0: /* right/bottom */
-                  emblem_area.x = MIN (icon_area.x + icon_area.width - emblem_area.width / 2,
-                                       cell_area->x + cell_area->width - emblem_area.width);
-                  emblem_area.y = MIN (icon_area.y + icon_area.height - emblem_area.height / 2,
-                                       cell_area->y + cell_area->height -emblem_area.height);
-                  break;
-
-                case 1: /* left/bottom */
-                  emblem_area.x = MAX (icon_area.x - emblem_area.width / 2,
-                                       cell_area->x);
-                  emblem_area.y = MIN (icon_area.y + icon_area.height - emblem_area.height / 2,
-                                       cell_area->y + cell_area->height -emblem_area.height);
-                  break;
-
-                case 2: /* left/top */
-                  emblem_area.x = MAX (icon_area.x - emblem_area.width / 2,
-                                       cell_area->x);
-                  emblem_area.y = MAX (icon_area.y - emblem_area.height / 2,
-                                       cell_area->y);
-                  break;
-
-                case 3: /* right/top */
-                  emblem_area.x = MIN (icon_area.x + icon_area.width - emblem_area.width / 2,
-                                       cell_area->x + cell_area->width - emblem_area.width);
-                  emblem_area.y = MAX (icon_area.y - emblem_area.height / 2,
-                                       cell_area->y);
-                  break;
-
-                default:
-                  _thunar_assert_not_reached ();
-                }
-
-              /* render the emblem */
+              /* render the emblems */
               if (gdk_rectangle_intersect (expose_area, &emblem_area, &draw_area))
                 {
-                  /* render the invalid parts of the icon */
-                  thunar_gdk_cairo_set_source_pixbuf (cr, emblem, emblem_area.x, emblem_area.y);
+                  /* render the invalid parts of the emblems */
+                  thunar_gdk_cairo_set_source_pixbuf (cr, overlay->pixbuf, emblem_area.x, emblem_area.y);
                   gdk_cairo_rectangle (cr, &draw_area);
                   cairo_paint (cr);
 
@@ -578,19 +745,13 @@ thunar_icon_renderer_render (GtkCellRenderer     *renderer,
                   if (color_selected)
                     thunar_icon_renderer_color_selected (cr, widget);
                 }
-
-              /* release the emblem */
-              g_object_unref (G_OBJECT (emblem));
-
-              /* advance the position index */
-              ++position;
             }
-
-          /* release the emblem name list */
-          g_list_free (emblems);
         }
     }
 
+  /* release the icon of the factory */
+  g_object_unref (G_OBJECT (base));
+
   /* destroy the context */
   cairo_destroy (cr);
 
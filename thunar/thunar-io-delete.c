@@ -0,0 +1,600 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+
+#include <exo/exo.h>
+
+#include <thunar/thunar-gio-extensions.h>
+#include <thunar/thunar-io-delete.h>
+#include <thunar/thunar-io-jobs-util.h>
+#include <thunar/thunar-private.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+
+
+/* interval between two progress updates, in microseconds */
+#define PROGRESS_INTERVAL (100 * 1000)
+
+
+
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_UNLINKAT)
+typedef struct _ThunarIoDelete        ThunarIoDelete;
+typedef struct _ThunarIoDeleteTask    ThunarIoDeleteTask;
+typedef struct _ThunarIoDeleteMessage ThunarIoDeleteMessage;
+
+struct _ThunarIoDelete
+{
+  /* %NULL for quiet deletions in the background */
+  ThunarJob    *job;
+  GCancellable *cancellable;
+
+  /* number of deleted files, updated atomically */
+  volatile gint n_deleted;
+  gint64        last_update;
+
+  /* workers for the subtrees of the toplevel folders, or %NULL */
+  GThreadPool  *pool;
+
+  /* messages from the workers to the job thread */
+  GAsyncQueue  *messages;
+  guint         n_tasks;
+};
+
+/* a subtree deleted by a worker */
+struct _ThunarIoDeleteTask
+{
+  gint   parent_fd;
+  gchar *name;
+  gchar *path;
+};
+
+struct _ThunarIoDeleteMessage
+{
+  /* the error to ask the user about, %NULL if the
+   * worker is done with its task */
+  gchar       *text;
+  GAsyncQueue *reply;
+};
+
+
+
+static void thunar_io_delete_entry (ThunarIoDelete *del,
+                                    gint            parent_fd,
+                                    const gchar    *name,
+                                    gboolean        is_dir,
+                                    GString        *path,
+                                    GAsyncQueue    *reply,
+                                    gboolean        spawn);
+
+
+
+static void
+thunar_io_delete_progress (ThunarIoDelete *del)
+{
+  gint64 now;
+  gint   n_deleted;
+
+  /* nobody to report to */
+  if (del->job == NULL)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (now - del->last_update < PROGRESS_INTERVAL)
+    return;
+
+  del->last_update = now;
+
+  n_deleted = g_atomic_int_get (&del->n_deleted);
+  exo_job_info_message (EXO_JOB (del->job),
+                        ngettext ("Deleted %d file", "Deleted %d files", n_deleted),
+                        n_deleted);
+}
+
+
+
+/* handles the messages of the workers, must be called from the job thread */
+static void
+thunar_io_delete_process_messages (ThunarIoDelete *del,
+                                   gboolean        block)
+{
+  ThunarIoDeleteMessage *message;
+  ThunarJobResponse      response;
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  GTimeVal               end_time;
+#endif
+
+  if (block)
+    {
+#if GLIB_CHECK_VERSION (2, 32, 0)
+      message = g_async_queue_timeout_pop (del->messages, PROGRESS_INTERVAL);
+#else
+      g_get_current_time (&end_time);
+      g_time_val_add (&end_time, PROGRESS_INTERVAL);
+      message = g_async_queue_timed_pop (del->messages, &end_time);
+#endif
+    }
+  else
+    {
+      message = g_async_queue_try_pop (del->messages);
+    }
+
+  for (; message != NULL; message = g_async_queue_try_pop (del->messages))
+    {
+      if (message->text != NULL)
+        {
+          /* ask on behalf of the worker, which waits for the answer */
+          response = thunar_job_ask_skip (del->job, "%s", message->text);
+          g_async_queue_push (message->reply, GUINT_TO_POINTER (response));
+          g_free (message->text);
+        }
+      else
+        {
+          _thunar_assert (del->n_tasks > 0);
+          del->n_tasks--;
+        }
+
+      g_slice_free (ThunarIoDeleteMessage, message);
+    }
+
+  thunar_io_delete_progress (del);
+}
+
+
+
+static ThunarJobResponse
+thunar_io_delete_ask (ThunarIoDelete *del,
+                      const gchar    *path,
+                      gint            errsv,
+                      GAsyncQueue    *reply)
+{
+  ThunarIoDeleteMessage *message;
+  ThunarJobResponse      response;
+  gchar                 *display_name;
+  gchar                 *text;
+
+  /* quiet deletions skip whatever cannot be deleted */
+  if (del->job == NULL)
+    return THUNAR_JOB_RESPONSE_YES;
+
+  display_name = g_filename_display_basename (path);
+  text = g_strdup_printf (_("Could not delete file \"%s\": %s"), display_name, g_strerror (errsv));
+  g_free (display_name);
+
+  if (reply == NULL)
+    {
+      /* we are in the job thread */
+      response = thunar_job_ask_skip (del->job, "%s", text);
+      g_free (text);
+    }
+  else
+    {
+      /* let the job thread ask the user */
+      message = g_slice_new (ThunarIoDeleteMessage);
+      message->text = text;
+      message->reply = reply;
+      g_async_queue_push (del->messages, message);
+
+      response = GPOINTER_TO_UINT (g_async_queue_pop (reply));
+    }
+
+  return response;
+}
+
+
+
+/* deletes everything in the folder @dir_fd, which is closed afterwards */
+static void
+thunar_io_delete_contents (ThunarIoDelete *del,
+                           gint            dir_fd,
+                           GString        *path,
+                           GAsyncQueue    *reply,
+                           gboolean        spawn)
+{
+  ThunarIoDeleteTask *task;
+  struct dirent      *entry;
+  struct stat         statb;
+  gboolean            is_dir;
+  gsize               path_len;
+  DIR                *dir;
+
+  dir = fdopendir (dir_fd);
+  if (G_UNLIKELY (dir == NULL))
+    {
+      thunar_io_delete_ask (del, path->str, errno, reply);
+      close (dir_fd);
+      return;
+    }
+
+  path_len = path->len;
+
+  while (!g_cancellable_is_cancelled (del->cancellable))
+    {
+      errno = 0;
+      entry = readdir (dir);
+      if (entry == NULL)
+        {
+          if (G_UNLIKELY (errno != 0))
+            thunar_io_delete_ask (del, path->str, errno, reply);
+          break;
+        }
+
+      if (strcmp (entry->d_name, ".") == 0 || strcmp (entry->d_name, "..") == 0)
+        continue;
+
+      g_string_append_c (path, G_DIR_SEPARATOR);
+      g_string_append (path, entry->d_name);
+
+      /* avoid the stat() where the folder tells us the type */
+#ifdef _DIRENT_HAVE_D_TYPE
+      if (entry->d_type != DT_UNKNOWN)
+        is_dir = (entry->d_type == DT_DIR);
+      else
+#endif
+        is_dir = (fstatat (dirfd (dir), entry->d_name, &statb, AT_SYMLINK_NOFOLLOW) == 0
+                  && S_ISDIR (statb.st_mode));
+
+      if (is_dir && spawn)
+        {
+          /* let a worker delete the subtree */
+          task = g_slice_new (ThunarIoDeleteTask);
+          task->parent_fd = dirfd (dir);
+          task->name = g_strdup (entry->d_name);
+          task->path = g_strdup (path->str);
+
+          del->n_tasks++;
+          g_thread_pool_push (del->pool, task, NULL);
+        }
+      else
+        {
+          thunar_io_delete_entry (del, dirfd (dir), entry->d_name, is_dir, path, reply, FALSE);
+        }
+
+      g_string_truncate (path, path_len);
+
+      if (spawn)
+        thunar_io_delete_process_messages (del, FALSE);
+      else if (reply == NULL)
+        thunar_io_delete_progress (del);
+    }
+
+  /* the workers use our folder, so wait for them to finish */
+  if (spawn)
+    while (del->n_tasks > 0)
+      thunar_io_delete_process_messages (del, TRUE);
+
+  closedir (dir);
+}
+
+
+
+/* deletes @name in @parent_fd in post-order, asking the user on errors */
+static void
+thunar_io_delete_entry (ThunarIoDelete *del,
+                        gint            parent_fd,
+                        const gchar    *name,
+                        gboolean        is_dir,
+                        GString        *path,
+                        GAsyncQueue    *reply,
+                        gboolean        spawn)
+{
+  gint errsv;
+  gint fd;
+
+again:
+  if (g_cancellable_is_cancelled (del->cancellable))
+    return;
+
+  if (is_dir)
+    {
+      fd = openat (parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd >= 0)
+        {
+          thunar_io_delete_contents (del, fd, path, reply, spawn);
+
+          if (g_cancellable_is_cancelled (del->cancellable))
+            return;
+        }
+      else if (errno == ENOENT)
+        {
+          /* someone else was faster */
+          return;
+        }
+      else if (errno == ENOTDIR || errno == ELOOP)
+        {
+          /* replaced by a file in the meantime */
+          is_dir = FALSE;
+        }
+      else
+        {
+          errsv = errno;
+          if (thunar_io_delete_ask (del, path->str, errsv, reply) == THUNAR_JOB_RESPONSE_RETRY)
+            goto again;
+          return;
+        }
+    }
+
+  if (unlinkat (parent_fd, name, is_dir ? AT_REMOVEDIR : 0) == 0 || errno == ENOENT)
+    {
+      g_atomic_int_inc (&del->n_deleted);
+      return;
+    }
+
+  errsv = errno;
+
+  /* replaced by a folder in the meantime */
+  if (!is_dir && (errsv == EISDIR || errsv == EPERM))
+    {
+      struct stat statb;
+
+      if (fstatat (parent_fd, name, &statb, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR (statb.st_mode))
+        {
+          is_dir = TRUE;
+          goto again;
+        }
+    }
+
+  if (thunar_io_delete_ask (del, path->str, errsv, reply) == THUNAR_JOB_RESPONSE_RETRY)
+    goto again;
+}
+
+
+
+static void
+thunar_io_delete_worker (gpointer data,
+                         gpointer user_data)
+{
+  ThunarIoDeleteMessage *message;
+  ThunarIoDeleteTask    *task = data;
+  ThunarIoDelete        *del = user_data;
+  GAsyncQueue           *reply;
+  GString               *path;
+
+  /* the pool threads are shared, so take over the I/O priority of the job */
+  thunar_io_jobs_util_set_io_priority (del->job == NULL
+                                       || thunar_job_get_priority (del->job) >= THUNAR_JOB_PRIORITY_DEEP_COUNT);
+
+  reply = g_async_queue_new ();
+  path = g_string_new (task->path);
+
+  thunar_io_delete_entry (del, task->parent_fd, task->name, TRUE, path, reply, FALSE);
+
+  g_string_free (path, TRUE);
+  g_async_queue_unref (reply);
+
+  thunar_io_jobs_util_set_io_priority (FALSE);
+
+  g_free (task->name);
+  g_free (task->path);
+  g_slice_free (ThunarIoDeleteTask, task);
+
+  /* tell the job thread we're done */
+  message = g_slice_new0 (ThunarIoDeleteMessage);
+  g_async_queue_push (del->messages, message);
+}
+#endif
+
+
+
+/**
+ * thunar_io_delete_files:
+ * @job       : a #ThunarJob.
+ * @file_list : a list of local #GFile<!---->s.
+ * @n_threads : number of threads to delete the subfolders of a
+ *              toplevel folder in parallel, or %1.
+ * @error     : return location for errors or %NULL.
+ *
+ * Recursively deletes the files in @file_list, without following
+ * symlinks. The folders are walked relative to their file descriptors
+ * and each file is deleted as soon as it is found, so neither the
+ * whole tree is kept in memory nor are full paths resolved again
+ * for every file. Progress is reported as the number of deleted
+ * files.
+ *
+ * Errors for single files are presented to the user, who can choose
+ * to skip the file, retry or cancel the @job.
+ *
+ * Return value: %TRUE on success, %FALSE if the @job was cancelled
+ *               or if the system lacks the functions to walk the
+ *               folders, in which case @error is set to
+ *               %G_IO_ERROR_NOT_SUPPORTED.
+ **/
+gboolean
+thunar_io_delete_files (ThunarJob *job,
+                        GList     *file_list,
+                        guint      n_threads,
+                        GError   **error)
+{
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_UNLINKAT)
+  ThunarIoDelete del;
+  struct stat    statb;
+  GString       *path;
+  GList         *lp;
+  gchar         *dirname;
+  gchar         *basename;
+  gchar         *filename;
+  gint           parent_fd;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  del.job = job;
+  del.cancellable = exo_job_get_cancellable (EXO_JOB (job));
+  del.n_deleted = 0;
+  del.last_update = 0;
+  del.n_tasks = 0;
+  del.messages = g_async_queue_new ();
+  del.pool = NULL;
+
+  if (n_threads > 1)
+    del.pool = g_thread_pool_new (thunar_io_delete_worker, &del, n_threads, FALSE, NULL);
+
+  path = g_string_new (NULL);
+
+  for (lp = file_list; lp != NULL && !g_cancellable_is_cancelled (del.cancellable); lp = lp->next)
+    {
+      /* skip root folders which cannot be deleted anyway */
+      if (thunar_g_file_is_root (lp->data))
+        continue;
+
+      filename = g_file_get_path (lp->data);
+      if (G_UNLIKELY (filename == NULL))
+        continue;
+
+      dirname = g_path_get_dirname (filename);
+      basename = g_path_get_basename (filename);
+      g_string_assign (path, filename);
+
+      for (;;)
+        {
+          parent_fd = open (dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+          if (parent_fd >= 0 || errno == ENOENT)
+            break;
+
+          if (thunar_io_delete_ask (&del, filename, errno, NULL) != THUNAR_JOB_RESPONSE_RETRY)
+            break;
+        }
+
+      if (parent_fd >= 0)
+        {
+          if (fstatat (parent_fd, basename, &statb, AT_SYMLINK_NOFOLLOW) == 0)
+            {
+              thunar_io_delete_entry (&del, parent_fd, basename, S_ISDIR (statb.st_mode),
+                                      path, NULL, del.pool != NULL);
+            }
+
+          close (parent_fd);
+        }
+
+      g_free (basename);
+      g_free (dirname);
+      g_free (filename);
+    }
+
+  g_string_free (path, TRUE);
+
+  _thunar_assert (del.n_tasks == 0);
+
+  if (del.pool != NULL)
+    g_thread_pool_free (del.pool, FALSE, TRUE);
+  g_async_queue_unref (del.messages);
+
+  return !exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+#else
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "Deleting relative to folder descriptors is not supported");
+  return FALSE;
+#endif
+}
+
+
+
+/**
+ * thunar_io_delete_tree:
+ * @path        : an absolute local path.
+ * @cancellable : a #GCancellable or %NULL.
+ *
+ * Recursively deletes @path like thunar_io_delete_files(), but
+ * without a job: nothing is reported and files that cannot be
+ * deleted are skipped. This is meant for cleanups in the background,
+ * where nobody could be asked anyway.
+ **/
+void
+thunar_io_delete_tree (const gchar  *path,
+                       GCancellable *cancellable)
+{
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_UNLINKAT)
+  ThunarIoDelete del;
+  struct stat    statb;
+  GString       *string;
+  gchar         *dirname;
+  gchar         *basename;
+  gint           parent_fd;
+
+  _thunar_return_if_fail (g_path_is_absolute (path));
+
+  del.job = NULL;
+  del.cancellable = cancellable;
+  del.n_deleted = 0;
+  del.last_update = 0;
+  del.n_tasks = 0;
+  del.messages = NULL;
+  del.pool = NULL;
+
+  dirname = g_path_get_dirname (path);
+  basename = g_path_get_basename (path);
+
+  parent_fd = open (dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (parent_fd >= 0)
+    {
+      if (fstatat (parent_fd, basename, &statb, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+          string = g_string_new (path);
+          thunar_io_delete_entry (&del, parent_fd, basename, S_ISDIR (statb.st_mode),
+                                  string, NULL, FALSE);
+          g_string_free (string, TRUE);
+        }
+
+      close (parent_fd);
+    }
+
+  g_free (basename);
+  g_free (dirname);
+#endif
+}
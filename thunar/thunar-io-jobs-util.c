@@ -22,6 +22,20 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <gio/gio.h>
 
 #include <thunar/thunar-gio-extensions.h>
@@ -32,46 +46,191 @@
 
 
 
+/* names of the files in a folder, plus the next copy/link number to
+ * try for each source file, so duplicating the same file again doesn't
+ * walk over the names taken before */
+typedef struct
+{
+  GHashTable *names;
+  GHashTable *next_number;
+} ThunarIoJobsUtilFolder;
+
+
+
+static void
+thunar_io_jobs_util_folder_free (gpointer data)
+{
+  ThunarIoJobsUtilFolder *folder = data;
+
+  g_hash_table_destroy (folder->names);
+  g_hash_table_destroy (folder->next_number);
+  g_slice_free (ThunarIoJobsUtilFolder, folder);
+}
+
+
+
+static ThunarIoJobsUtilFolder *
+thunar_io_jobs_util_folder_lookup (ThunarJob  *job,
+                                   GHashTable *name_index,
+                                   GFile      *parent_file,
+                                   GError    **error)
+{
+  ThunarIoJobsUtilFolder *folder;
+  GFileEnumerator        *enumerator;
+  GFileInfo              *info;
+  GError                 *err = NULL;
+
+  folder = g_hash_table_lookup (name_index, parent_file);
+  if (G_LIKELY (folder != NULL))
+    return folder;
+
+  folder = g_slice_new (ThunarIoJobsUtilFolder);
+  folder->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  folder->next_number = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* read the folder contents once. if that fails, the index starts out
+   * empty and learns about the existing names as the job hits them */
+  enumerator = g_file_enumerate_children (parent_file, G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          exo_job_get_cancellable (EXO_JOB (job)),
+                                          &err);
+  if (G_LIKELY (enumerator != NULL))
+    {
+      while (err == NULL)
+        {
+          info = g_file_enumerator_next_file (enumerator, exo_job_get_cancellable (EXO_JOB (job)), &err);
+          if (info == NULL)
+            break;
+
+          g_hash_table_insert (folder->names, g_strdup (g_file_info_get_name (info)), NULL);
+          g_object_unref (info);
+        }
+
+      g_object_unref (enumerator);
+    }
+
+  /* only the cancellation is fatal */
+  if (err != NULL)
+    {
+      if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+        {
+          g_error_free (err);
+          thunar_io_jobs_util_folder_free (folder);
+          return NULL;
+        }
+
+      g_error_free (err);
+    }
+
+  g_hash_table_insert (name_index, g_object_ref (parent_file), folder);
+
+  return folder;
+}
+
+
+
+/**
+ * thunar_io_jobs_util_name_index_new:
+ *
+ * Allocates a new name index to pass to
+ * thunar_io_jobs_util_next_duplicate_file(). The index remembers the
+ * names of the files in every folder a job creates duplicates in, so
+ * each of these folders is enumerated only once.
+ *
+ * The caller is responsible to free the returned index using
+ * g_hash_table_destroy() when no longer needed.
+ *
+ * Return value: the newly allocated name index.
+ **/
+GHashTable *
+thunar_io_jobs_util_name_index_new (void)
+{
+  return g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                g_object_unref, thunar_io_jobs_util_folder_free);
+}
+
+
+
+/**
+ * thunar_io_jobs_util_name_index_add:
+ * @name_index : a name index.
+ * @file       : a #GFile that was created.
+ *
+ * Records @file as existing in the @name_index, if the index
+ * knows about its parent folder.
+ **/
+void
+thunar_io_jobs_util_name_index_add (GHashTable *name_index,
+                                    GFile      *file)
+{
+  ThunarIoJobsUtilFolder *folder;
+  GFile                  *parent_file;
+
+  _thunar_return_if_fail (name_index != NULL);
+  _thunar_return_if_fail (G_IS_FILE (file));
+
+  parent_file = g_file_get_parent (file);
+  if (G_UNLIKELY (parent_file == NULL))
+    return;
+
+  folder = g_hash_table_lookup (name_index, parent_file);
+  if (folder != NULL)
+    g_hash_table_insert (folder->names, g_file_get_basename (file), NULL);
+
+  g_object_unref (parent_file);
+}
+
+
+
 /**
  * thunar_io_jobs_util_next_duplicate_file:
- * @job   : a #ThunarJob.
- * @file  : the source #GFile.
- * @type  : the operation type (copy or link).
- * @n     : the @n<!---->th copy/link to create the #GFile for.
- * @error : return location for errors or %NULL.
+ * @job        : a #ThunarJob.
+ * @name_index : the name index of the @job, see
+ *               thunar_io_jobs_util_name_index_new().
+ * @file       : the source #GFile.
+ * @copy       : the operation type (copy or link).
+ * @error      : return location for errors or %NULL.
  *
- * Determines the #GFile for the next copy/link of/to @file.
+ * Determines the #GFile for the next copy/link of/to @file, that is
+ * not taken in the folder of @file according to @name_index.
  *
  * Copies of a file called X are named "X (copy 1)"
  *
  * Links follow have a bit different scheme, since the first link
  * is renamed to "link to #" and after that "link Y to X".
  *
+ * The returned file is not added to @name_index. Callers should use
+ * thunar_io_jobs_util_name_index_add() once the file was created, or
+ * if creating it failed because it exists after all.
+ *
  * If there are errors or the job was cancelled, the return value
  * will be %NULL and @error will be set.
  *
- * Return value: the #GFile referencing the @n<!---->th copy or link
+ * Return value: the #GFile referencing the next copy or link
  *               of @file or %NULL on error/cancellation.
  **/
 GFile *
-thunar_io_jobs_util_next_duplicate_file (ThunarJob *job,
-                                         GFile     *file,
-                                         gboolean   copy,
-                                         guint      n,
-                                         GError   **error)
+thunar_io_jobs_util_next_duplicate_file (ThunarJob  *job,
+                                         GHashTable *name_index,
+                                         GFile      *file,
+                                         gboolean    copy,
+                                         GError    **error)
 {
-  GFileInfo   *info;
-  GError      *err = NULL;
-  GFile       *duplicate_file = NULL;
-  GFile       *parent_file = NULL;
-  const gchar *old_display_name;
-  gchar       *display_name;
-  gchar       *file_basename;
-  gchar       *dot = NULL;
-  
+  ThunarIoJobsUtilFolder *folder;
+  GFileInfo              *info;
+  GError                 *err = NULL;
+  GFile                  *duplicate_file = NULL;
+  GFile                  *parent_file = NULL;
+  const gchar            *old_display_name;
+  gchar                  *display_name;
+  gchar                  *file_basename;
+  gchar                  *source_name;
+  gchar                  *dot = NULL;
+  guint                   n;
+
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), NULL);
+  _thunar_return_val_if_fail (name_index != NULL, NULL);
   _thunar_return_val_if_fail (G_IS_FILE (file), NULL);
-  _thunar_return_val_if_fail (0 < n, NULL);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
   _thunar_return_val_if_fail (!thunar_g_file_is_root (file), NULL);
 
@@ -92,52 +251,133 @@ thunar_io_jobs_util_next_duplicate_file (ThunarJob *job,
       return NULL;
     }
 
-  old_display_name = g_file_info_get_display_name (info);
-  if (copy)
+  /* get the names in the folder of the source file */
+  parent_file = g_file_get_parent (file);
+  folder = thunar_io_jobs_util_folder_lookup (job, name_index, parent_file, error);
+  if (G_UNLIKELY (folder == NULL))
     {
-      /* get file extension if file is not a directory */
-      if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
-        dot = thunar_util_str_get_extension (old_display_name);
+      g_object_unref (parent_file);
+      g_object_unref (info);
+      return NULL;
+    }
+
+  /* continue after the last number used for this file */
+  source_name = g_file_get_basename (file);
+  n = GPOINTER_TO_UINT (g_hash_table_lookup (folder->next_number, source_name));
+  if (n == 0)
+    n = 1;
+
+  old_display_name = g_file_info_get_display_name (info);
+
+  /* get file extension if file is not a directory */
+  if (copy && g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+    dot = thunar_util_str_get_extension (old_display_name);
 
-      if (dot != NULL)
+  for (;; ++n)
+    {
+      if (copy)
         {
-          file_basename = g_strndup (old_display_name, dot - old_display_name);
-          /* I18N: put " (copy #) between basename and extension */
-          display_name = g_strdup_printf (_("%s (copy %u)%s"), file_basename, n, dot);
-          g_free(file_basename);
+          if (dot != NULL)
+            {
+              file_basename = g_strndup (old_display_name, dot - old_display_name);
+              /* I18N: put " (copy #) between basename and extension */
+              display_name = g_strdup_printf (_("%s (copy %u)%s"), file_basename, n, dot);
+              g_free(file_basename);
+            }
+          else
+            {
+              /* I18N: put " (copy #)" after filename (for files without extension) */
+              display_name = g_strdup_printf (_("%s (copy %u)"), old_display_name, n);
+            }
         }
       else
         {
-          /* I18N: put " (copy #)" after filename (for files without extension) */
-          display_name = g_strdup_printf (_("%s (copy %u)"), old_display_name, n);
-        }
-    }
-  else
-    {
-      /* create name for link */
-      if (n == 1)
-        {
-          /* I18N: name for first link to basename */
-          display_name = g_strdup_printf (_("link to %s"), old_display_name);
+          /* create name for link */
+          if (n == 1)
+            {
+              /* I18N: name for first link to basename */
+              display_name = g_strdup_printf (_("link to %s"), old_display_name);
+            }
+          else
+            {
+              /* I18N: name for nth link to basename */
+              display_name = g_strdup_printf (_("link %u to %s"), n, old_display_name);
+            }
         }
-      else
+
+      /* create the GFile for the copy/link */
+      duplicate_file = g_file_get_child (parent_file, display_name);
+      g_free (display_name);
+
+      /* stop at the first name not taken yet */
+      file_basename = g_file_get_basename (duplicate_file);
+      if (!g_hash_table_lookup_extended (folder->names, file_basename, NULL, NULL))
         {
-          /* I18N: name for nth link to basename */
-          display_name = g_strdup_printf (_("link %u to %s"), n, old_display_name);
+          g_free (file_basename);
+          break;
         }
+
+      g_free (file_basename);
+      g_object_unref (duplicate_file);
     }
 
-  /* create the GFile for the copy/link */
-  parent_file = g_file_get_parent (file);
-  duplicate_file = g_file_get_child (parent_file, display_name);
-  g_object_unref (parent_file);
+  /* remember where to continue next time */
+  g_hash_table_insert (folder->next_number, source_name, GUINT_TO_POINTER (n));
 
   /* free resources */
+  g_object_unref (parent_file);
   g_object_unref (info);
-  g_free (display_name);
 
   return duplicate_file;
 }
 
 
 
+/**
+ * thunar_io_jobs_util_set_background_priority:
+ *
+ * Lowers the CPU and, where supported, the I/O priority of the calling
+ * thread, so that work nobody waits for does not slow down the rest of
+ * the system. On Linux only the calling thread is affected, elsewhere
+ * this may apply to the whole process and is therefore a no-op.
+ **/
+void
+thunar_io_jobs_util_set_background_priority (void)
+{
+#if defined (__linux__) && defined (HAVE_SYS_SYSCALL_H) && defined (SYS_gettid)
+  pid_t tid = syscall (SYS_gettid);
+
+#ifdef HAVE_SYS_RESOURCE_H
+  /* Linux applies the nice value to single threads */
+  setpriority (PRIO_PROCESS, tid, 19);
+#endif
+
+#ifdef SYS_ioprio_set
+  /* IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT */
+  syscall (SYS_ioprio_set, 1, tid, 3 << 13);
+#endif
+#endif
+}
+
+
+
+/**
+ * thunar_io_jobs_util_set_io_priority:
+ * @background : %TRUE for the lowest best-effort I/O priority,
+ *               %FALSE for the default one.
+ *
+ * Changes the I/O priority of the calling thread on Linux. Unlike
+ * thunar_io_jobs_util_set_background_priority() this can be undone,
+ * so it is also used for threads that are shared between jobs.
+ **/
+void
+thunar_io_jobs_util_set_io_priority (gboolean background)
+{
+#if defined (__linux__) && defined (HAVE_SYS_SYSCALL_H) && defined (SYS_gettid) && defined (SYS_ioprio_set)
+  pid_t tid = syscall (SYS_gettid);
+
+  /* IOPRIO_WHO_PROCESS, with the lowest level of IOPRIO_CLASS_BE or
+   * IOPRIO_CLASS_NONE, which derives the priority from the nice value */
+  syscall (SYS_ioprio_set, 1, tid, background ? (2 << 13) | 7 : 0);
+#endif
+}
@@ -25,11 +25,18 @@
 
 G_BEGIN_DECLS
 
-GFile *thunar_io_jobs_util_next_duplicate_file (ThunarJob *job,
-                                                GFile     *file,
-                                                gboolean   copy,
-                                                guint      n,
-                                                GError   **error) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
+GHashTable *thunar_io_jobs_util_name_index_new           (void) G_GNUC_MALLOC;
+void        thunar_io_jobs_util_name_index_add           (GHashTable *name_index,
+                                                          GFile      *file);
+
+GFile      *thunar_io_jobs_util_next_duplicate_file      (ThunarJob  *job,
+                                                          GHashTable *name_index,
+                                                          GFile      *file,
+                                                          gboolean    copy,
+                                                          GError    **error) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
+
+void        thunar_io_jobs_util_set_background_priority  (void);
+void        thunar_io_jobs_util_set_io_priority          (gboolean    background);
 
 G_END_DECLS
 
@@ -27,10 +27,14 @@
 #include <thunar/thunar-application.h>
 #include <thunar/thunar-enum-types.h>
 #include <thunar/thunar-gio-extensions.h>
+#include <thunar/thunar-io-delete.h>
 #include <thunar/thunar-io-scan-directory.h>
 #include <thunar/thunar-io-jobs.h>
 #include <thunar/thunar-io-jobs-util.h>
+#include <thunar/thunar-io-permissions.h>
+#include <thunar/thunar-io-trash.h>
 #include <thunar/thunar-job.h>
+#include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-simple-job.h>
 #include <thunar/thunar-thumbnail-cache.h>
@@ -38,6 +42,36 @@
 
 
 
+static gboolean
+_tij_all_native (GList *file_list)
+{
+  GList *lp;
+
+  for (lp = file_list; lp != NULL; lp = lp->next)
+    if (!g_file_is_native (lp->data))
+      return FALSE;
+
+  return TRUE;
+}
+
+
+
+/* number of folders the permission jobs walk in parallel */
+static guint
+_tij_get_n_threads (void)
+{
+  ThunarPreferences *preferences;
+  guint              n_threads;
+
+  preferences = thunar_preferences_get ();
+  g_object_get (G_OBJECT (preferences), "misc-permissions-threads", &n_threads, NULL);
+  g_object_unref (preferences);
+
+  return n_threads;
+}
+
+
+
 static GList *
 _tij_collect_nofollow (ThunarJob *job,
                        GList     *base_file_list,
@@ -98,18 +132,23 @@ _thunar_io_jobs_create (ThunarJob  *job,
   gchar             *display_name;
   GFile             *template_file;
   GFileInputStream  *template_stream = NULL;
+  guint              n_processed;
+  guint              n_total;
   
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (param_values != NULL, FALSE);
   _thunar_return_val_if_fail (param_values->len == 2, FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* a slow file system must not hold back the metadata jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_METADATA);
+
   /* get the file list */
   file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
   template_file = g_value_get_object (&g_array_index (param_values, GValue, 1));
 
   /* we know the total amount of files to be processed */
-  thunar_job_set_total_files (THUNAR_JOB (job), file_list);
+  n_total = g_list_length (file_list);
 
   /* check if we need to open the template */
   if (template_file != NULL)
@@ -124,14 +163,14 @@ _thunar_io_jobs_create (ThunarJob  *job,
     }
 
   /* iterate over all files in the list */
-  for (lp = file_list; 
+  for (lp = file_list, n_processed = 0; 
        err == NULL && lp != NULL && !exo_job_is_cancelled (EXO_JOB (job)); 
-       lp = lp->next)
+       lp = lp->next, ++n_processed)
     {
       g_assert (G_IS_FILE (lp->data));
 
       /* update progress information */
-      thunar_job_processing_file (THUNAR_JOB (job), lp);
+      thunar_job_progress (THUNAR_JOB (job), lp->data, n_processed, n_total, 0, 0);
 
 again:
       /* try to create the file */
@@ -227,6 +266,9 @@ again:
         }
     }
 
+  /* report the final progress */
+  thunar_job_progress (THUNAR_JOB (job), NULL, n_processed, n_total, 0, 0);
+
   if (template_stream != NULL)
     g_object_unref (template_stream);
 
@@ -272,25 +314,30 @@ _thunar_io_jobs_mkdir (ThunarJob  *job,
   GList            *lp;
   gchar            *base_name;
   gchar            *display_name;
+  guint             n_processed;
+  guint             n_total;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (param_values != NULL, FALSE);
   _thunar_return_val_if_fail (param_values->len == 1, FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* a slow file system must not hold back the metadata jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_METADATA);
+
   file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
 
-  /* we know the total list of files to process */
-  thunar_job_set_total_files (THUNAR_JOB (job), file_list);
+  /* we know the total number of files to process */
+  n_total = g_list_length (file_list);
 
-  for (lp = file_list; 
+  for (lp = file_list, n_processed = 0; 
        err == NULL && lp != NULL && !exo_job_is_cancelled (EXO_JOB (job));
-       lp = lp->next)
+       lp = lp->next, ++n_processed)
     {
       g_assert (G_IS_FILE (lp->data));
 
       /* update progress information */
-      thunar_job_processing_file (THUNAR_JOB (job), lp);
+      thunar_job_progress (THUNAR_JOB (job), lp->data, n_processed, n_total, 0, 0);
 
 again:
       /* try to create the directory */
@@ -368,6 +415,9 @@ again:
         }
     }
 
+  /* report the final progress */
+  thunar_job_progress (THUNAR_JOB (job), NULL, n_processed, n_total, 0, 0);
+
   /* check if we have failed */
   if (err != NULL)
     {
@@ -397,27 +447,19 @@ thunar_io_jobs_make_directories (GList *file_list)
 
 
 static gboolean
-_thunar_io_jobs_unlink (ThunarJob  *job,
-                        GArray     *param_values,
-                        GError    **error)
+_thunar_io_jobs_unlink_gio (ThunarJob            *job,
+                            GList                *file_list,
+                            ThunarThumbnailCache *thumbnail_cache,
+                            GError              **error)
 {
-  ThunarThumbnailCache *thumbnail_cache;
-  ThunarApplication    *application;
   ThunarJobResponse     response;
   GFileInfo            *info;
   GError               *err = NULL;
-  GList                *file_list;
   GList                *lp;
   gchar                *base_name;
   gchar                *display_name;
-
-  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
-  _thunar_return_val_if_fail (param_values != NULL, FALSE);
-  _thunar_return_val_if_fail (param_values->len == 1, FALSE);
-  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-  /* get the file list */
-  file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
+  guint                 n_processed;
+  guint                 n_total;
 
   /* tell the user that we're preparing to unlink the files */
   exo_job_info_message (EXO_JOB (job), _("Preparing..."));
@@ -437,19 +479,19 @@ _thunar_io_jobs_unlink (ThunarJob  *job,
       return FALSE;
     }
 
-  /* we know the total list of files to process */
-  thunar_job_set_total_files (THUNAR_JOB (job), file_list);
-
-  /* take a reference on the thumbnail cache */
-  application = thunar_application_get ();
-  thumbnail_cache = thunar_application_get_thumbnail_cache (application);
-  g_object_unref (application);
+  /* we know the total number of files to process */
+  n_total = g_list_length (file_list);
 
   /* remove all the files */
-  for (lp = file_list; lp != NULL && !exo_job_is_cancelled (EXO_JOB (job)); lp = lp->next)
+  for (lp = file_list, n_processed = 0;
+       lp != NULL && !exo_job_is_cancelled (EXO_JOB (job));
+       lp = lp->next, ++n_processed)
     {
       g_assert (G_IS_FILE (lp->data));
 
+      /* update progress information */
+      thunar_job_progress (THUNAR_JOB (job), lp->data, n_processed, n_total, 0, 0);
+
       /* skip root folders which cannot be deleted anyway */
       if (thunar_g_file_is_root (lp->data))
         continue;
@@ -506,16 +548,95 @@ again:
         }
     }
 
-  /* release the thumbnail cache */
-  g_object_unref (thumbnail_cache);
+  /* report the final progress */
+  thunar_job_progress (THUNAR_JOB (job), NULL, n_processed, n_total, 0, 0);
 
   /* release the file list */
   thunar_g_file_list_free (file_list);
 
-  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
-    return FALSE;
-  else
-    return TRUE;
+  return !exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+}
+
+
+
+static gboolean
+_thunar_io_jobs_unlink (ThunarJob  *job,
+                        GArray     *param_values,
+                        GError    **error)
+{
+  ThunarThumbnailCache *thumbnail_cache;
+  ThunarApplication    *application;
+  GError               *err = NULL;
+  GList                *file_list;
+  GList                *native_list = NULL;
+  GList                *gio_list = NULL;
+  GList                *lp;
+  guint                 n_threads;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (param_values != NULL, FALSE);
+  _thunar_return_val_if_fail (param_values->len == 2, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* file operations share the limits of the transfer jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_TRANSFER);
+
+  /* get the file list and the number of threads */
+  file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
+  n_threads = g_value_get_uint (&g_array_index (param_values, GValue, 1));
+
+  /* local files are deleted while walking the folders, everything
+   * else is collected first and deleted through GIO */
+  for (lp = file_list; lp != NULL; lp = lp->next)
+    {
+      if (g_file_is_native (lp->data))
+        native_list = g_list_prepend (native_list, lp->data);
+      else
+        gio_list = g_list_prepend (gio_list, lp->data);
+    }
+
+  native_list = g_list_reverse (native_list);
+  gio_list = g_list_reverse (gio_list);
+
+  /* take a reference on the thumbnail cache */
+  application = thunar_application_get ();
+  thumbnail_cache = thunar_application_get_thumbnail_cache (application);
+  g_object_unref (application);
+
+  if (native_list != NULL)
+    {
+      if (thunar_io_delete_files (job, native_list, n_threads, &err))
+        {
+          /* notify the thumbnail cache that the corresponding thumbnails
+           * can also be deleted now */
+          for (lp = native_list; lp != NULL; lp = lp->next)
+            thunar_thumbnail_cache_delete_file (thumbnail_cache, lp->data);
+        }
+      else if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        {
+          /* fall back to GIO for all files */
+          g_clear_error (&err);
+          gio_list = g_list_concat (native_list, gio_list);
+          native_list = NULL;
+        }
+    }
+
+  if (err == NULL && gio_list != NULL)
+    _thunar_io_jobs_unlink_gio (job, gio_list, thumbnail_cache, &err);
+
+  /* release the thumbnail cache */
+  g_object_unref (thumbnail_cache);
+
+  g_list_free (native_list);
+  g_list_free (gio_list);
+
+  if (err != NULL)
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
 }
 
 
@@ -523,8 +644,17 @@ again:
 ThunarJob *
 thunar_io_jobs_unlink_files (GList *file_list)
 {
-  return thunar_simple_job_launch (_thunar_io_jobs_unlink, 1,
-                                   THUNAR_TYPE_G_FILE_LIST, file_list);
+  ThunarPreferences *preferences;
+  guint              n_threads;
+
+  /* number of threads to delete subfolders in parallel */
+  preferences = thunar_preferences_get ();
+  g_object_get (G_OBJECT (preferences), "misc-delete-threads", &n_threads, NULL);
+  g_object_unref (preferences);
+
+  return thunar_simple_job_launch (_thunar_io_jobs_unlink, 2,
+                                   THUNAR_TYPE_G_FILE_LIST, file_list,
+                                   G_TYPE_UINT, n_threads);
 }
 
 
@@ -565,20 +695,39 @@ thunar_io_jobs_copy_files (GList *source_file_list,
 
 
 
+ThunarJob *
+thunar_io_jobs_resume_transfer (const gchar *journal_path,
+                                GError     **error)
+{
+  ThunarJob *job;
+
+  _thunar_return_val_if_fail (journal_path != NULL, NULL);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  job = thunar_transfer_job_new_from_journal (journal_path, error);
+  if (G_UNLIKELY (job == NULL))
+    return NULL;
+
+  return THUNAR_JOB (exo_job_launch (EXO_JOB (job)));
+}
+
+
+
 static GFile *
-_thunar_io_jobs_link_file (ThunarJob *job,
-                           GFile     *source_file,
-                           GFile     *target_file,
-                           GError   **error)
+_thunar_io_jobs_link_file (ThunarJob  *job,
+                           GHashTable *name_index,
+                           GFile      *source_file,
+                           GFile      *target_file,
+                           GError    **error)
 {
   ThunarJobResponse response;
   GError           *err = NULL;
   gchar            *base_name;
   gchar            *display_name;
   gchar            *source_path;
-  gint              n;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), NULL);
+  _thunar_return_val_if_fail (name_index != NULL, NULL);
   _thunar_return_val_if_fail (G_IS_FILE (source_file), NULL);
   _thunar_return_val_if_fail (G_IS_FILE (target_file), NULL);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
@@ -613,18 +762,21 @@ _thunar_io_jobs_link_file (ThunarJob *job,
               /* release the source path */
               g_free (source_path);
 
+              /* keep the duplicate names in sync */
+              thunar_io_jobs_util_name_index_add (name_index, target_file);
+
               /* return the real target file */
               return g_object_ref (target_file);
             }
         }
       else
         {
-          for (n = 1; err == NULL; ++n)
+          while (err == NULL)
             {
               GFile *duplicate_file = thunar_io_jobs_util_next_duplicate_file (job,
+                                                                               name_index,
                                                                                source_file,
-                                                                               FALSE, n,
-                                                                               &err);
+                                                                               FALSE, &err);
 
               if (err == NULL)
                 {
@@ -636,19 +788,23 @@ _thunar_io_jobs_link_file (ThunarJob *job,
                       /* release the source path */
                       g_free (source_path);
 
+                      thunar_io_jobs_util_name_index_add (name_index, duplicate_file);
+
                       /* return the real target file */
                       return duplicate_file;
                     }
-                  
+
+                  if (err->domain == G_IO_ERROR && err->code == G_IO_ERROR_EXISTS)
+                    {
+                      /* this duplicate was created behind our back => clear
+                       * the error and try the next alternative */
+                      thunar_io_jobs_util_name_index_add (name_index, duplicate_file);
+                      g_clear_error (&err);
+                    }
+
                   /* release the duplicate file, we no longer need it */
                   g_object_unref (duplicate_file);
                 }
-
-              if (err != NULL && err->domain == G_IO_ERROR && err->code == G_IO_ERROR_EXISTS)
-                {
-                  /* this duplicate already exists => clear the error and try the next alternative */
-                  g_clear_error (&err);
-                }
             }
         }
 
@@ -700,41 +856,50 @@ _thunar_io_jobs_link (ThunarJob  *job,
   ThunarApplication    *application;
   GError               *err = NULL;
   GFile                *real_target_file;
+  GHashTable           *name_index;
   GList                *new_files_list = NULL;
   GList                *source_file_list;
   GList                *sp;
   GList                *target_file_list;
   GList                *tp;
+  guint                 n_processed;
+  guint                 n_total;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (param_values != NULL, FALSE);
   _thunar_return_val_if_fail (param_values->len == 2, FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* a slow file system must not hold back the metadata jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_METADATA);
+
   source_file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
   target_file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 1));
 
-  /* we know the total list of paths to process */
-  thunar_job_set_total_files (THUNAR_JOB (job), source_file_list);
+  /* we know the total number of paths to process */
+  n_total = g_list_length (source_file_list);
 
   /* take a reference on the thumbnail cache */
   application = thunar_application_get ();
   thumbnail_cache = thunar_application_get_thumbnail_cache (application);
   g_object_unref (application);
 
+  /* names of the files in the folders we create duplicates in */
+  name_index = thunar_io_jobs_util_name_index_new ();
+
   /* process all files */
-  for (sp = source_file_list, tp = target_file_list;
+  for (sp = source_file_list, tp = target_file_list, n_processed = 0;
        err == NULL && sp != NULL && tp != NULL;
-       sp = sp->next, tp = tp->next)
+       sp = sp->next, tp = tp->next, ++n_processed)
     {
       _thunar_assert (G_IS_FILE (sp->data));
       _thunar_assert (G_IS_FILE (tp->data));
 
       /* update progress information */
-      thunar_job_processing_file (THUNAR_JOB (job), sp);
+      thunar_job_progress (THUNAR_JOB (job), sp->data, n_processed, n_total, 0, 0);
 
       /* try to create the symbolic link */
-      real_target_file = _thunar_io_jobs_link_file (job, sp->data, tp->data, &err);
+      real_target_file = _thunar_io_jobs_link_file (job, name_index, sp->data, tp->data, &err);
       if (real_target_file != NULL)
         {
           /* queue the file for the folder update unless it was skipped */
@@ -755,6 +920,11 @@ _thunar_io_jobs_link (ThunarJob  *job,
         }
     }
 
+  /* report the final progress */
+  thunar_job_progress (THUNAR_JOB (job), NULL, n_processed, n_total, 0, 0);
+
+  g_hash_table_destroy (name_index);
+
   /* release the thumbnail cache */
   g_object_unref (thumbnail_cache);
 
@@ -798,13 +968,16 @@ _thunar_io_jobs_trash (ThunarJob  *job,
   ThunarApplication    *application;
   GError               *err = NULL;
   GList                *file_list;
-  GList                *lp;
+  GList                *trashed_list;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (param_values != NULL, FALSE);
   _thunar_return_val_if_fail (param_values->len == 1, FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* file operations share the limits of the transfer jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_TRANSFER);
+
   file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
 
   if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
@@ -815,16 +988,12 @@ _thunar_io_jobs_trash (ThunarJob  *job,
   thumbnail_cache = thunar_application_get_thumbnail_cache (application);
   g_object_unref (application);
 
-  for (lp = file_list; err == NULL && lp != NULL; lp = lp->next)
-    {
-      _thunar_assert (G_IS_FILE (lp->data));
-
-      /* trash the file or folder */
-      g_file_trash (lp->data, exo_job_get_cancellable (EXO_JOB (job)), &err);
+  /* trash the files and folders */
+  thunar_io_trash_files (job, file_list, &trashed_list, &err);
 
-      /* update the thumbnail cache */
-      thunar_thumbnail_cache_cleanup_file (thumbnail_cache, lp->data);
-    }
+  /* update the thumbnail cache for everything that was moved, in one batch */
+  thunar_thumbnail_cache_cleanup_files (thumbnail_cache, trashed_list);
+  g_list_free (trashed_list);
 
   /* release the thumbnail cache */
   g_object_unref (thumbnail_cache);
@@ -853,6 +1022,66 @@ thunar_io_jobs_trash_files (GList *file_list)
 
 
 
+static gboolean
+_thunar_io_jobs_empty_trash (ThunarJob  *job,
+                             GArray     *param_values,
+                             GError    **error)
+{
+  ThunarThumbnailCache *thumbnail_cache;
+  ThunarApplication    *application;
+  GError               *err = NULL;
+  GList                 file_list;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (param_values != NULL, FALSE);
+  _thunar_return_val_if_fail (param_values->len == 0, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* file operations share the limits of the transfer jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_TRANSFER);
+
+  /* move the contents of the local trash folders aside, they
+   * are deleted in the background afterwards */
+  if (!thunar_io_trash_empty (job, error))
+    return FALSE;
+
+  /* take a reference on the thumbnail cache */
+  application = thunar_application_get ();
+  thumbnail_cache = thunar_application_get_thumbnail_cache (application);
+  g_object_unref (application);
+
+  /* delete whatever is still in the trash, the root
+   * folder itself will never be unlinked */
+  file_list.data = thunar_g_file_new_for_trash ();
+  file_list.next = NULL;
+  file_list.prev = NULL;
+
+  _thunar_io_jobs_unlink_gio (job, &file_list, thumbnail_cache, &err);
+
+  g_object_unref (file_list.data);
+
+  /* release the thumbnail cache */
+  g_object_unref (thumbnail_cache);
+
+  if (err != NULL)
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+ThunarJob *
+thunar_io_jobs_empty_trash (void)
+{
+  return thunar_simple_job_launch (_thunar_io_jobs_empty_trash, 0);
+}
+
+
+
 ThunarJob *
 thunar_io_jobs_restore_files (GList *source_file_list,
                               GList *target_file_list)
@@ -885,19 +1114,41 @@ _thunar_io_jobs_chown (ThunarJob  *job,
   GList            *lp;
   gint              uid;
   gint              gid;
+  guint             n_processed;
+  guint             n_threads;
+  guint             n_total;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (param_values != NULL, FALSE);
-  _thunar_return_val_if_fail (param_values->len == 4, FALSE);
+  _thunar_return_val_if_fail (param_values->len == 5, FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* file operations share the limits of the transfer jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_TRANSFER);
+
   file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
   uid = g_value_get_int (&g_array_index (param_values, GValue, 1));
   gid = g_value_get_int (&g_array_index (param_values, GValue, 2));
   recursive = g_value_get_boolean (&g_array_index (param_values, GValue, 3));
+  n_threads = g_value_get_uint (&g_array_index (param_values, GValue, 4));
 
   _thunar_assert ((uid >= 0 || gid >= 0) && !(uid >= 0 && gid >= 0));
 
+  /* walk local folders in parallel, without collecting the files first */
+  if (recursive && _tij_all_native (file_list))
+    {
+      if (thunar_io_permissions_change_owner (job, file_list, uid, gid, n_threads, &err))
+        return TRUE;
+
+      if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        {
+          g_propagate_error (error, err);
+          return FALSE;
+        }
+
+      g_clear_error (&err);
+    }
+
   /* collect the files for the chown operation */
   if (recursive)
     file_list = _tij_collect_nofollow (job, file_list, FALSE, &err);
@@ -910,14 +1161,14 @@ _thunar_io_jobs_chown (ThunarJob  *job,
       return FALSE;
     }
 
-  /* we know the total list of files to process */
-  thunar_job_set_total_files (THUNAR_JOB (job), file_list);
+  /* we know the total number of files to process */
+  n_total = g_list_length (file_list);
 
   /* change the ownership of all files */
-  for (lp = file_list; lp != NULL && err == NULL; lp = lp->next)
+  for (lp = file_list, n_processed = 0; lp != NULL && err == NULL; lp = lp->next, ++n_processed)
     {
       /* update progress information */
-      thunar_job_processing_file (THUNAR_JOB (job), lp);
+      thunar_job_progress (THUNAR_JOB (job), lp->data, n_processed, n_total, 0, 0);
 
       /* try to query information about the file */
       info = g_file_query_info (lp->data, 
@@ -973,6 +1224,9 @@ retry_chown:
       g_object_unref (info);
     }
 
+  /* report the final progress */
+  thunar_job_progress (THUNAR_JOB (job), NULL, n_processed, n_total, 0, 0);
+
   /* release the file list */
   thunar_g_file_list_free (file_list);
 
@@ -999,11 +1253,12 @@ thunar_io_jobs_change_group (GList    *files,
   /* files are released when the list if destroyed */
   g_list_foreach (files, (GFunc) g_object_ref, NULL);
 
-  return thunar_simple_job_launch (_thunar_io_jobs_chown, 4,
+  return thunar_simple_job_launch (_thunar_io_jobs_chown, 5,
                                    THUNAR_TYPE_G_FILE_LIST, files,
                                    G_TYPE_INT, -1,
                                    G_TYPE_INT, (gint) gid,
-                                   G_TYPE_BOOLEAN, recursive);
+                                   G_TYPE_BOOLEAN, recursive,
+                                   G_TYPE_UINT, _tij_get_n_threads ());
 }
 
 
@@ -1027,18 +1282,41 @@ _thunar_io_jobs_chmod (ThunarJob  *job,
   ThunarFileMode    mode;
   ThunarFileMode    old_mode;
   ThunarFileMode    new_mode;
+  guint             n_processed;
+  guint             n_threads;
+  guint             n_total;
 
   _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
   _thunar_return_val_if_fail (param_values != NULL, FALSE);
-  _thunar_return_val_if_fail (param_values->len == 6, FALSE);
+  _thunar_return_val_if_fail (param_values->len == 7, FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* file operations share the limits of the transfer jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_TRANSFER);
+
   file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
   dir_mask = g_value_get_flags (&g_array_index (param_values, GValue, 1));
   dir_mode = g_value_get_flags (&g_array_index (param_values, GValue, 2));
   file_mask = g_value_get_flags (&g_array_index (param_values, GValue, 3));
   file_mode = g_value_get_flags (&g_array_index (param_values, GValue, 4));
   recursive = g_value_get_boolean (&g_array_index (param_values, GValue, 5));
+  n_threads = g_value_get_uint (&g_array_index (param_values, GValue, 6));
+
+  /* walk local folders in parallel, without collecting the files first */
+  if (recursive && _tij_all_native (file_list))
+    {
+      if (thunar_io_permissions_change_mode (job, file_list, dir_mask, dir_mode,
+                                             file_mask, file_mode, n_threads, &err))
+        return TRUE;
+
+      if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        {
+          g_propagate_error (error, err);
+          return FALSE;
+        }
+
+      g_clear_error (&err);
+    }
 
   /* collect the files for the chown operation */
   if (recursive)
@@ -1052,14 +1330,14 @@ _thunar_io_jobs_chmod (ThunarJob  *job,
       return FALSE;
     }
 
-  /* we know the total list of files to process */
-  thunar_job_set_total_files (THUNAR_JOB (job), file_list);
+  /* we know the total number of files to process */
+  n_total = g_list_length (file_list);
 
   /* change the ownership of all files */
-  for (lp = file_list; lp != NULL && err == NULL; lp = lp->next)
+  for (lp = file_list, n_processed = 0; lp != NULL && err == NULL; lp = lp->next, ++n_processed)
     {
       /* update progress information */
-      thunar_job_processing_file (THUNAR_JOB (job), lp);
+      thunar_job_progress (THUNAR_JOB (job), lp->data, n_processed, n_total, 0, 0);
 
       /* try to query information about the file */
       info = g_file_query_info (lp->data, 
@@ -1124,6 +1402,9 @@ retry_chown:
       g_object_unref (info);
     }
 
+  /* report the final progress */
+  thunar_job_progress (THUNAR_JOB (job), NULL, n_processed, n_total, 0, 0);
+
   /* release the file list */
   thunar_g_file_list_free (file_list);
 
@@ -1154,13 +1435,14 @@ thunar_io_jobs_change_mode (GList         *files,
   /* files are released when the list if destroyed */
   g_list_foreach (files, (GFunc) g_object_ref, NULL);
 
-  return thunar_simple_job_launch (_thunar_io_jobs_chmod, 6,
+  return thunar_simple_job_launch (_thunar_io_jobs_chmod, 7,
                                    THUNAR_TYPE_G_FILE_LIST, files,
                                    THUNAR_TYPE_FILE_MODE, dir_mask,
                                    THUNAR_TYPE_FILE_MODE, dir_mode,
                                    THUNAR_TYPE_FILE_MODE, file_mask,
                                    THUNAR_TYPE_FILE_MODE, file_mode,
-                                   G_TYPE_BOOLEAN, recursive);
+                                   G_TYPE_BOOLEAN, recursive,
+                                   G_TYPE_UINT, _tij_get_n_threads ());
 }
 
 
@@ -1274,6 +1556,9 @@ _thunar_io_jobs_rename (ThunarJob  *job,
   _thunar_return_val_if_fail (G_VALUE_HOLDS_STRING (&g_array_index (param_values, GValue, 1)), FALSE);
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+  /* a slow file system must not hold back the metadata jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_METADATA);
+
   if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
     return FALSE;
 
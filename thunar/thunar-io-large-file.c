@@ -0,0 +1,448 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* fallocate(), sync_file_range() and SEEK_DATA/SEEK_HOLE are GNU extensions */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <exo/exo.h>
+
+#include <thunar/thunar-io-large-file.h>
+#include <thunar/thunar-private.h>
+
+
+
+/* amount of data written between two checkpoints */
+#define CHECKPOINT_SIZE (256 * 1024 * 1024)
+
+
+
+#if defined (HAVE_PREAD) && defined (HAVE_PWRITE)
+static void
+thunar_io_large_file_set_error (GError     **error,
+                                gint         errsv,
+                                const gchar *format,
+                                GFile       *file)
+{
+  gchar *display_name;
+
+  display_name = g_file_get_parse_name (file);
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               format, display_name, g_strerror (errsv));
+  g_free (display_name);
+}
+
+
+
+static void
+thunar_io_large_file_drop_cache (gint     source_fd,
+                                 gint     target_fd,
+                                 goffset  offset,
+                                 goffset  length,
+                                 goffset *flushed)
+{
+#ifdef HAVE_POSIX_FADVISE
+  /* the source range is not going to be read again */
+  posix_fadvise (source_fd, offset, length, POSIX_FADV_DONTNEED);
+#endif
+
+#ifdef HAVE_SYNC_FILE_RANGE
+  /* start the writeback of the range we just wrote */
+  sync_file_range (target_fd, offset, length, SYNC_FILE_RANGE_WRITE);
+
+  /* wait for the ranges written before, so their pages are clean
+   * and can actually be dropped from the page cache */
+  if (*flushed < offset)
+    {
+      sync_file_range (target_fd, *flushed, offset - *flushed,
+                       SYNC_FILE_RANGE_WAIT_BEFORE
+                       | SYNC_FILE_RANGE_WRITE
+                       | SYNC_FILE_RANGE_WAIT_AFTER);
+#ifdef HAVE_POSIX_FADVISE
+      posix_fadvise (target_fd, *flushed, offset - *flushed, POSIX_FADV_DONTNEED);
+#endif
+      *flushed = offset;
+    }
+#endif
+}
+
+
+
+static gboolean
+thunar_io_large_file_sync (gint fd)
+{
+#ifdef HAVE_FDATASYNC
+  return fdatasync (fd) == 0;
+#else
+  return fsync (fd) == 0;
+#endif
+}
+#endif
+
+
+
+/**
+ * thunar_io_large_file_copy:
+ * @source_file            : the local regular #GFile to copy.
+ * @target_file            : the local destination #GFile.
+ * @flags                  : #GFileCopyFlags, only %G_FILE_COPY_OVERWRITE and
+ *                           the metadata flags are honored.
+ * @buffer_size            : size of the copy buffer in bytes.
+ * @resume_offset          : offset to continue a partial copy from, or %0.
+ * @cancellable            : a #GCancellable or %NULL.
+ * @progress_callback      : a #GFileProgressCallback or %NULL.
+ * @checkpoint_callback    : a #GFileProgressCallback or %NULL.
+ * @progress_callback_data : user data for @progress_callback and
+ *                           @checkpoint_callback.
+ * @error                  : return location for errors or %NULL.
+ *
+ * Copies @source_file to @target_file, like g_file_copy() does, but
+ * tuned for very large files: the target is preallocated to avoid
+ * fragmentation, the source is read sequentially with a large buffer
+ * and the ranges already copied are dropped from the page cache, so
+ * copying a multi-GB file does not evict the cache of the whole system.
+ * Holes in sparse files are preserved.
+ *
+ * When replacing an existing file, the data is written to a temporary
+ * file next to @target_file, which is renamed over it once complete.
+ *
+ * Otherwise the data is written to @target_file directly and
+ * @checkpoint_callback is invoked once the file is created and then
+ * every few hundred MB, each time with the offset up to which the data
+ * is known to be on disk. If @resume_offset is non-zero, @target_file
+ * must be such a partial copy and the copy continues from that offset.
+ * A partial copy is not removed if the copy is cancelled or fails, so
+ * it can be resumed later.
+ *
+ * If the files are not local or the platform lacks the required
+ * system calls, %G_IO_ERROR_NOT_SUPPORTED is returned before anything
+ * is written and the caller should fall back to g_file_copy().
+ *
+ * Return value: %TRUE on success, %FALSE with @error set otherwise.
+ **/
+gboolean
+thunar_io_large_file_copy (GFile                *source_file,
+                           GFile                *target_file,
+                           GFileCopyFlags        flags,
+                           gsize                 buffer_size,
+                           goffset               resume_offset,
+                           GCancellable         *cancellable,
+                           GFileProgressCallback progress_callback,
+                           GFileProgressCallback checkpoint_callback,
+                           gpointer              progress_callback_data,
+                           GError              **error)
+{
+#if defined (HAVE_PREAD) && defined (HAVE_PWRITE)
+  struct stat statb;
+  gboolean    sparse = FALSE;
+  gboolean    resumable;
+  GError     *err = NULL;
+  guchar     *buffer;
+  goffset     size;
+  goffset     offset;
+  goffset     data_end;
+  goffset     flushed;
+  goffset     checkpoint;
+  goffset     position;
+  gssize      n_read;
+  gssize      n_written;
+  gssize      n;
+  gchar      *source_path;
+  gchar      *target_path;
+  gchar      *write_path;
+  gint        source_fd;
+  gint        target_fd;
+  gint        open_flags;
+
+  _thunar_return_val_if_fail (G_IS_FILE (source_file), FALSE);
+  _thunar_return_val_if_fail (G_IS_FILE (target_file), FALSE);
+  _thunar_return_val_if_fail (buffer_size > 0, FALSE);
+  _thunar_return_val_if_fail (resume_offset >= 0, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
+  source_path = g_file_get_path (source_file);
+  target_path = g_file_get_path (target_file);
+  if (G_UNLIKELY (source_path == NULL || target_path == NULL))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Not a local file");
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  /* open the source file */
+  open_flags = O_RDONLY;
+#ifdef O_NOFOLLOW
+  open_flags |= O_NOFOLLOW;
+#endif
+  source_fd = g_open (source_path, open_flags, 0);
+  if (G_UNLIKELY (source_fd < 0))
+    {
+      thunar_io_large_file_set_error (error, errno, _("Failed to open \"%s\": %s"), source_file);
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  if (fstat (source_fd, &statb) < 0 || !S_ISREG (statb.st_mode))
+    {
+      close (source_fd);
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Not a regular file");
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  size = statb.st_size;
+
+#ifdef SEEK_HOLE
+  /* files using fewer blocks than their size have holes */
+  sparse = ((goffset) statb.st_blocks * 512 < size);
+#endif
+
+  /* a partial copy is continued in place */
+  if (resume_offset > 0)
+    {
+      if (resume_offset > size)
+        {
+          close (source_fd);
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                               "Resume offset beyond the end of the file");
+          g_free (source_path);
+          g_free (target_path);
+          return FALSE;
+        }
+
+      write_path = g_strdup (target_path);
+      target_fd = g_open (write_path, O_WRONLY, 0);
+    }
+  /* replace existing files through a temporary file, so the old
+   * contents survive if the copy fails halfway */
+  else if ((flags & G_FILE_COPY_OVERWRITE) != 0)
+    {
+      write_path = g_strconcat (target_path, ".XXXXXX", NULL);
+      target_fd = g_mkstemp_full (write_path, O_WRONLY, statb.st_mode & 0777);
+    }
+  else
+    {
+      write_path = g_strdup (target_path);
+      target_fd = g_open (write_path, O_WRONLY | O_CREAT | O_EXCL, statb.st_mode & 0777);
+    }
+
+  if (G_UNLIKELY (target_fd < 0))
+    {
+      thunar_io_large_file_set_error (error, errno, _("Failed to create \"%s\": %s"), target_file);
+      close (source_fd);
+      g_free (write_path);
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  /* only copies written to the target itself can be resumed */
+  resumable = (g_strcmp0 (write_path, target_path) == 0);
+
+  /* tell the caller the target now belongs to this copy */
+  if (resumable && resume_offset == 0 && checkpoint_callback != NULL)
+    (*checkpoint_callback) (0, size, progress_callback_data);
+
+#ifdef HAVE_FALLOCATE
+  /* reserve the space in one go to avoid fragmentation, unless the file
+   * is sparse, in which case this would materialize the holes */
+  if (!sparse && size > resume_offset && fallocate (target_fd, 0, 0, size) < 0
+      && (errno == ENOSPC || errno == EDQUOT))
+    thunar_io_large_file_set_error (&err, errno, _("Failed to write to \"%s\": %s"), target_file);
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+  /* enable aggressive read-ahead on the source */
+  posix_fadvise (source_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  buffer = g_malloc (buffer_size);
+
+  flushed = checkpoint = resume_offset;
+
+  for (offset = resume_offset; err == NULL && offset < size; offset = data_end)
+    {
+      data_end = size;
+
+#ifdef SEEK_HOLE
+      if (sparse)
+        {
+          /* jump to the next range with data */
+          position = lseek (source_fd, offset, SEEK_DATA);
+          if (position < 0 && errno == ENXIO)
+            {
+              /* only a hole is left until the end of the file */
+              break;
+            }
+          else if (position < 0)
+            {
+              /* holes cannot be detected, copy the rest as plain data */
+              sparse = FALSE;
+            }
+          else
+            {
+              offset = position;
+              position = lseek (source_fd, offset, SEEK_HOLE);
+              if (position > offset && position < size)
+                data_end = position;
+            }
+        }
+#endif
+
+      /* copy the data range in buffer sized chunks */
+      while (offset < data_end)
+        {
+          if (g_cancellable_set_error_if_cancelled (cancellable, &err))
+            break;
+
+          n_read = pread (source_fd, buffer, MIN ((goffset) buffer_size, data_end - offset), offset);
+          if (G_UNLIKELY (n_read < 0))
+            {
+              if (errno == EINTR)
+                continue;
+
+              thunar_io_large_file_set_error (&err, errno, _("Failed to read from \"%s\": %s"), source_file);
+              break;
+            }
+          else if (G_UNLIKELY (n_read == 0))
+            {
+              /* the source file was truncated while copying */
+              size = data_end = offset;
+              break;
+            }
+
+          /* write the chunk to the same offset, which keeps the holes in place */
+          for (n = 0; err == NULL && n < n_read; n += n_written)
+            {
+              n_written = pwrite (target_fd, buffer + n, n_read - n, offset + n);
+              if (G_UNLIKELY (n_written < 0))
+                {
+                  n_written = 0;
+                  if (errno != EINTR)
+                    thunar_io_large_file_set_error (&err, errno, _("Failed to write to \"%s\": %s"), target_file);
+                }
+            }
+
+          if (G_UNLIKELY (err != NULL))
+            break;
+
+          thunar_io_large_file_drop_cache (source_fd, target_fd, offset, n_read, &flushed);
+
+          offset += n_read;
+
+          /* make the data written so far durable and report it */
+          if (resumable && checkpoint_callback != NULL
+              && offset - checkpoint >= CHECKPOINT_SIZE
+              && thunar_io_large_file_sync (target_fd))
+            {
+              checkpoint = offset;
+              (*checkpoint_callback) (offset, size, progress_callback_data);
+            }
+
+          if (progress_callback != NULL)
+            (*progress_callback) (offset, size, progress_callback_data);
+        }
+    }
+
+  g_free (buffer);
+
+  /* set the final size, this also creates a trailing hole if needed
+   * and releases space preallocated beyond a truncated source */
+  if (err == NULL && ftruncate (target_fd, size) < 0)
+    thunar_io_large_file_set_error (&err, errno, _("Failed to write to \"%s\": %s"), target_file);
+
+  close (source_fd);
+
+  /* errors on close are possible for network filesystems */
+  if (close (target_fd) < 0 && err == NULL)
+    thunar_io_large_file_set_error (&err, errno, _("Failed to write to \"%s\": %s"), target_file);
+
+  /* move the temporary file in place */
+  if (err == NULL && g_strcmp0 (write_path, target_path) != 0
+      && g_rename (write_path, target_path) < 0)
+    thunar_io_large_file_set_error (&err, errno, _("Failed to create \"%s\": %s"), target_file);
+
+  if (G_LIKELY (err == NULL))
+    {
+      if (progress_callback != NULL)
+        (*progress_callback) (size, size, progress_callback_data);
+
+      /* copy the default set of attributes, failing to do so
+       * is not fatal, just like for g_file_copy() */
+      g_file_copy_attributes (source_file, target_file,
+                              flags & (G_FILE_COPY_NOFOLLOW_SYMLINKS | G_FILE_COPY_ALL_METADATA),
+                              cancellable, NULL);
+    }
+  else if (!resumable || checkpoint_callback == NULL)
+    {
+      /* don't leave a partial file behind, unless it can be resumed */
+      g_unlink (write_path);
+    }
+
+  g_free (write_path);
+  g_free (source_path);
+  g_free (target_path);
+
+  if (G_UNLIKELY (err != NULL))
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
+#else
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "Operation not supported");
+  return FALSE;
+#endif
+}
@@ -0,0 +1,624 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+
+#include <exo/exo.h>
+
+#include <thunar/thunar-io-jobs-util.h>
+#include <thunar/thunar-io-permissions.h>
+#include <thunar/thunar-private.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+
+
+/* interval between two progress updates, in microseconds */
+#define PROGRESS_INTERVAL (250 * 1000)
+
+
+
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_FSTATAT) \
+ && defined (HAVE_FCHMODAT) && defined (HAVE_FCHOWNAT)
+typedef struct _ThunarIoPermissions        ThunarIoPermissions;
+typedef struct _ThunarIoPermissionsFolder  ThunarIoPermissionsFolder;
+typedef struct _ThunarIoPermissionsMessage ThunarIoPermissionsMessage;
+
+struct _ThunarIoPermissions
+{
+  ThunarJob     *job;
+  GCancellable  *cancellable;
+
+  /* the change to apply, uid/gid -1 if unchanged */
+  gboolean       change_mode;
+  gint           uid;
+  gint           gid;
+  ThunarFileMode dir_mask;
+  ThunarFileMode dir_mode;
+  ThunarFileMode file_mask;
+  ThunarFileMode file_mode;
+
+  /* number of processed files, updated atomically */
+  volatile gint  n_processed;
+  gint64         start_time;
+  gint64         last_update;
+
+  /* folders waiting for a walker or being walked, each folder is a
+   * task of the pool, so idle walkers pick up the pending folders
+   * found by the busy ones. the deepest folders are walked first,
+   * which keeps the number of open folders low */
+  GThreadPool   *pool;
+  volatile gint  n_folders;
+
+  /* messages from the walkers to the job thread */
+  GAsyncQueue   *messages;
+};
+
+struct _ThunarIoPermissionsFolder
+{
+  ThunarIoPermissionsFolder *parent;
+  guint                      depth;
+
+  /* the name relative to the parent, or the path at the top. the
+   * full path is only used for messages */
+  gchar                     *name;
+  gchar                     *path;
+
+  /* the opened folder, kept until its subfolders are done, as
+   * they are opened and changed relative to its descriptor */
+  DIR                       *dir;
+
+  /* 1 while the folder is read, plus 1 for each unfinished subfolder.
+   * the folder itself is changed once this drops to 0, so removing
+   * the permission to enter it doesn't lock us out of its contents */
+  volatile gint              pending;
+};
+
+struct _ThunarIoPermissionsMessage
+{
+  /* the error to ask the user about, or %NULL to wake up the job thread */
+  gchar       *text;
+  GAsyncQueue *reply;
+};
+
+
+
+static void
+thunar_io_permissions_progress (ThunarIoPermissions *perm)
+{
+  gint64 now;
+  gint   n_processed;
+  gint   rate = 0;
+
+  now = g_get_monotonic_time ();
+  if (now - perm->last_update < PROGRESS_INTERVAL)
+    return;
+
+  perm->last_update = now;
+
+  /* report the throughput, the total is unknown until we're done */
+  n_processed = g_atomic_int_get (&perm->n_processed);
+  if (now > perm->start_time)
+    rate = (gint) ((gint64) n_processed * G_USEC_PER_SEC / (now - perm->start_time));
+
+  exo_job_info_message (EXO_JOB (perm->job),
+                        ngettext ("%d file processed, %d per second",
+                                  "%d files processed, %d per second",
+                                  n_processed),
+                        n_processed, rate);
+}
+
+
+
+static void
+thunar_io_permissions_process_messages (ThunarIoPermissions *perm)
+{
+  ThunarIoPermissionsMessage *message;
+  ThunarJobResponse           response;
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  GTimeVal                    end_time;
+#endif
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  message = g_async_queue_timeout_pop (perm->messages, PROGRESS_INTERVAL);
+#else
+  g_get_current_time (&end_time);
+  g_time_val_add (&end_time, PROGRESS_INTERVAL);
+  message = g_async_queue_timed_pop (perm->messages, &end_time);
+#endif
+
+  for (; message != NULL; message = g_async_queue_try_pop (perm->messages))
+    {
+      if (message->text != NULL)
+        {
+          /* ask on behalf of the walker, which waits for the answer */
+          response = thunar_job_ask_skip (perm->job, "%s", message->text);
+          g_async_queue_push (message->reply, GUINT_TO_POINTER (response));
+          g_free (message->text);
+        }
+
+      g_slice_free (ThunarIoPermissionsMessage, message);
+    }
+
+  thunar_io_permissions_progress (perm);
+}
+
+
+
+static ThunarJobResponse
+thunar_io_permissions_ask (ThunarIoPermissions *perm,
+                           const gchar         *path,
+                           gint                 errsv,
+                           GAsyncQueue         *reply)
+{
+  ThunarIoPermissionsMessage *message;
+  ThunarJobResponse           response;
+  const gchar                *format;
+  gchar                      *display_name;
+  gchar                      *text;
+
+  if (perm->change_mode)
+    format = _("Failed to change the permissions of \"%s\": %s");
+  else if (perm->uid >= 0)
+    format = _("Failed to change the owner of \"%s\": %s");
+  else
+    format = _("Failed to change the group of \"%s\": %s");
+
+  display_name = g_filename_display_basename (path);
+  text = g_strdup_printf (format, display_name, g_strerror (errsv));
+  g_free (display_name);
+
+  if (reply == NULL)
+    {
+      /* we are in the job thread */
+      response = thunar_job_ask_skip (perm->job, "%s", text);
+      g_free (text);
+    }
+  else
+    {
+      /* let the job thread ask the user */
+      message = g_slice_new (ThunarIoPermissionsMessage);
+      message->text = text;
+      message->reply = reply;
+      g_async_queue_push (perm->messages, message);
+
+      response = GPOINTER_TO_UINT (g_async_queue_pop (reply));
+    }
+
+  return response;
+}
+
+
+
+/* changes @name in @dir_fd, asking the user on errors */
+static void
+thunar_io_permissions_apply (ThunarIoPermissions *perm,
+                             gint                 dir_fd,
+                             const gchar         *name,
+                             const gchar         *path,
+                             GAsyncQueue         *reply)
+{
+  ThunarFileMode mask;
+  ThunarFileMode mode;
+  struct stat    statb;
+  mode_t         new_mode;
+  gint           errsv;
+
+again:
+  if (g_cancellable_is_cancelled (perm->cancellable))
+    return;
+
+  if (perm->change_mode)
+    {
+      if (fstatat (dir_fd, name, &statb, AT_SYMLINK_NOFOLLOW) < 0)
+        goto failed;
+
+      /* the permissions of symlinks are never used */
+      if (S_ISLNK (statb.st_mode))
+        goto done;
+
+      if (S_ISDIR (statb.st_mode))
+        {
+          mask = perm->dir_mask;
+          mode = perm->dir_mode;
+        }
+      else
+        {
+          mask = perm->file_mask;
+          mode = perm->file_mode;
+        }
+
+      new_mode = ((statb.st_mode & ~mask) | mode) & 07777;
+      if (new_mode != (statb.st_mode & 07777)
+          && fchmodat (dir_fd, name, new_mode, 0) < 0)
+        goto failed;
+    }
+  else
+    {
+      if (fchownat (dir_fd, name, (uid_t) perm->uid, (gid_t) perm->gid, AT_SYMLINK_NOFOLLOW) < 0)
+        goto failed;
+    }
+
+done:
+  g_atomic_int_inc (&perm->n_processed);
+  return;
+
+failed:
+  errsv = errno;
+  if (thunar_io_permissions_ask (perm, path, errsv, reply) == THUNAR_JOB_RESPONSE_RETRY)
+    goto again;
+}
+
+
+
+static void
+thunar_io_permissions_folder_done (ThunarIoPermissions       *perm,
+                                   ThunarIoPermissionsFolder *folder,
+                                   GAsyncQueue               *reply)
+{
+  ThunarIoPermissionsFolder  *parent;
+  ThunarIoPermissionsMessage *message;
+
+  /* change the folders whose contents are all done, bottom up */
+  while (folder != NULL && g_atomic_int_dec_and_test (&folder->pending))
+    {
+      if (folder->dir != NULL)
+        closedir (folder->dir);
+
+      parent = folder->parent;
+      thunar_io_permissions_apply (perm, (parent != NULL) ? dirfd (parent->dir) : AT_FDCWD,
+                                   folder->name, folder->path, reply);
+
+      g_free (folder->name);
+      g_free (folder->path);
+      g_slice_free (ThunarIoPermissionsFolder, folder);
+      folder = parent;
+
+      /* wake up the job thread if this was the last folder */
+      if (g_atomic_int_dec_and_test (&perm->n_folders))
+        {
+          message = g_slice_new0 (ThunarIoPermissionsMessage);
+          g_async_queue_push (perm->messages, message);
+        }
+    }
+}
+
+
+
+static void
+thunar_io_permissions_walk (gpointer data,
+                            gpointer user_data)
+{
+  ThunarIoPermissionsFolder *folder = data;
+  ThunarIoPermissionsFolder *child;
+  ThunarIoPermissions       *perm = user_data;
+  struct dirent             *entry;
+  struct stat                statb;
+  GAsyncQueue               *reply;
+  gboolean                   is_dir;
+  gchar                     *path;
+  gint                       parent_fd;
+  gint                       errsv;
+  gint                       fd;
+
+  /* the pool threads are shared, so take over the I/O priority of the job */
+  thunar_io_jobs_util_set_io_priority (thunar_job_get_priority (perm->job) >= THUNAR_JOB_PRIORITY_DEEP_COUNT);
+
+  reply = g_async_queue_new ();
+
+  /* the parent stays open until this folder is done */
+  parent_fd = (folder->parent != NULL) ? dirfd (folder->parent->dir) : AT_FDCWD;
+
+  while (!g_cancellable_is_cancelled (perm->cancellable))
+    {
+      fd = openat (parent_fd, folder->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd >= 0)
+        {
+          folder->dir = fdopendir (fd);
+          if (folder->dir != NULL)
+            break;
+
+          errsv = errno;
+          close (fd);
+        }
+      else
+        {
+          errsv = errno;
+        }
+
+      if (thunar_io_permissions_ask (perm, folder->path, errsv, reply) != THUNAR_JOB_RESPONSE_RETRY)
+        break;
+    }
+
+  while (folder->dir != NULL && !g_cancellable_is_cancelled (perm->cancellable))
+    {
+      entry = readdir (folder->dir);
+      if (entry == NULL)
+        break;
+
+      if (strcmp (entry->d_name, ".") == 0 || strcmp (entry->d_name, "..") == 0)
+        continue;
+
+      path = g_build_filename (folder->path, entry->d_name, NULL);
+
+#ifdef _DIRENT_HAVE_D_TYPE
+      if (entry->d_type != DT_UNKNOWN)
+        is_dir = (entry->d_type == DT_DIR);
+      else
+#endif
+        is_dir = (fstatat (dirfd (folder->dir), entry->d_name, &statb, AT_SYMLINK_NOFOLLOW) == 0
+                  && S_ISDIR (statb.st_mode));
+
+      if (is_dir)
+        {
+          /* hand the subfolder to the next idle walker */
+          child = g_slice_new (ThunarIoPermissionsFolder);
+          child->parent = folder;
+          child->depth = folder->depth + 1;
+          child->name = g_strdup (entry->d_name);
+          child->path = path;
+          child->dir = NULL;
+          child->pending = 1;
+
+          g_atomic_int_inc (&folder->pending);
+          g_atomic_int_inc (&perm->n_folders);
+          g_thread_pool_push (perm->pool, child, NULL);
+        }
+      else
+        {
+          thunar_io_permissions_apply (perm, dirfd (folder->dir), entry->d_name, path, reply);
+          g_free (path);
+        }
+    }
+
+  thunar_io_permissions_folder_done (perm, folder, reply);
+
+  g_async_queue_unref (reply);
+
+  thunar_io_jobs_util_set_io_priority (FALSE);
+}
+
+
+
+static gint
+thunar_io_permissions_compare (gconstpointer a,
+                               gconstpointer b,
+                               gpointer      user_data)
+{
+  const ThunarIoPermissionsFolder *folder_a = a;
+  const ThunarIoPermissionsFolder *folder_b = b;
+
+  /* walk the deepest folders first */
+  if (folder_a->depth != folder_b->depth)
+    return (folder_a->depth > folder_b->depth) ? -1 : 1;
+
+  return 0;
+}
+
+
+
+static gboolean
+thunar_io_permissions_run (ThunarIoPermissions *perm,
+                           GList               *file_list,
+                           guint                n_threads,
+                           GError             **error)
+{
+  ThunarIoPermissionsFolder *folder;
+  struct stat                statb;
+  GList                     *lp;
+  gchar                     *path;
+
+  perm->cancellable = exo_job_get_cancellable (EXO_JOB (perm->job));
+  perm->n_processed = 0;
+  perm->n_folders = 0;
+  perm->start_time = g_get_monotonic_time ();
+  perm->last_update = perm->start_time;
+  perm->messages = g_async_queue_new ();
+  perm->pool = g_thread_pool_new (thunar_io_permissions_walk, perm, MAX (n_threads, 1), FALSE, NULL);
+  g_thread_pool_set_sort_function (perm->pool, thunar_io_permissions_compare, NULL);
+
+  for (lp = file_list; lp != NULL && !g_cancellable_is_cancelled (perm->cancellable); lp = lp->next)
+    {
+      path = g_file_get_path (lp->data);
+      if (G_UNLIKELY (path == NULL))
+        continue;
+
+      if (lstat (path, &statb) == 0 && S_ISDIR (statb.st_mode))
+        {
+          /* let the walkers handle the folder and its contents */
+          folder = g_slice_new (ThunarIoPermissionsFolder);
+          folder->parent = NULL;
+          folder->depth = 0;
+          folder->name = g_strdup (path);
+          folder->path = path;
+          folder->dir = NULL;
+          folder->pending = 1;
+
+          g_atomic_int_inc (&perm->n_folders);
+          g_thread_pool_push (perm->pool, folder, NULL);
+        }
+      else
+        {
+          thunar_io_permissions_apply (perm, AT_FDCWD, path, path, NULL);
+          g_free (path);
+        }
+    }
+
+  /* answer the questions of the walkers until they are done */
+  while (g_atomic_int_get (&perm->n_folders) > 0)
+    thunar_io_permissions_process_messages (perm);
+
+  g_thread_pool_free (perm->pool, FALSE, TRUE);
+  g_async_queue_unref (perm->messages);
+
+  return !exo_job_set_error_if_cancelled (EXO_JOB (perm->job), error);
+}
+#endif
+
+
+
+/**
+ * thunar_io_permissions_change_owner:
+ * @job       : a #ThunarJob.
+ * @file_list : a list of local #GFile<!---->s.
+ * @uid       : the new owner or -1.
+ * @gid       : the new group or -1.
+ * @n_threads : number of folders to walk in parallel.
+ * @error     : return location for errors or %NULL.
+ *
+ * Recursively changes the owner or group of the files in @file_list,
+ * without following symlinks. The folders are walked by a pool of
+ * @n_threads threads, and the files and subfolders are opened and
+ * changed relative to the descriptor of their folder.
+ *
+ * Errors for single files are presented to the user, who can choose
+ * to skip the file, retry or cancel the @job.
+ *
+ * Return value: %TRUE on success, %FALSE if the @job was cancelled
+ *               or if the system lacks the functions to walk the
+ *               folders, in which case @error is set to
+ *               %G_IO_ERROR_NOT_SUPPORTED.
+ **/
+gboolean
+thunar_io_permissions_change_owner (ThunarJob *job,
+                                    GList     *file_list,
+                                    gint       uid,
+                                    gint       gid,
+                                    guint      n_threads,
+                                    GError   **error)
+{
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_FSTATAT) \
+ && defined (HAVE_FCHMODAT) && defined (HAVE_FCHOWNAT)
+  ThunarIoPermissions perm;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (uid >= 0 || gid >= 0, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  perm.job = job;
+  perm.change_mode = FALSE;
+  perm.uid = uid;
+  perm.gid = gid;
+
+  return thunar_io_permissions_run (&perm, file_list, n_threads, error);
+#else
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "Changing files relative to folder descriptors is not supported");
+  return FALSE;
+#endif
+}
+
+
+
+/**
+ * thunar_io_permissions_change_mode:
+ * @job       : a #ThunarJob.
+ * @file_list : a list of local #GFile<!---->s.
+ * @dir_mask  : the bits to change on folders.
+ * @dir_mode  : the new values of the @dir_mask bits.
+ * @file_mask : the bits to change on other files.
+ * @file_mode : the new values of the @file_mask bits.
+ * @n_threads : number of folders to walk in parallel.
+ * @error     : return location for errors or %NULL.
+ *
+ * Like thunar_io_permissions_change_owner(), but changes the
+ * permissions. Folders are changed after their contents, so
+ * removing the permission to enter them is safe. Symlinks are
+ * left alone.
+ *
+ * Return value: %TRUE on success, %FALSE if the @job was cancelled
+ *               or if the system lacks the functions to walk the
+ *               folders, in which case @error is set to
+ *               %G_IO_ERROR_NOT_SUPPORTED.
+ **/
+gboolean
+thunar_io_permissions_change_mode (ThunarJob     *job,
+                                   GList         *file_list,
+                                   ThunarFileMode dir_mask,
+                                   ThunarFileMode dir_mode,
+                                   ThunarFileMode file_mask,
+                                   ThunarFileMode file_mode,
+                                   guint          n_threads,
+                                   GError       **error)
+{
+#if defined (HAVE_FDOPENDIR) && defined (HAVE_OPENAT) && defined (HAVE_FSTATAT) \
+ && defined (HAVE_FCHMODAT) && defined (HAVE_FCHOWNAT)
+  ThunarIoPermissions perm;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  perm.job = job;
+  perm.change_mode = TRUE;
+  perm.uid = -1;
+  perm.gid = -1;
+  perm.dir_mask = dir_mask;
+  perm.dir_mode = dir_mode;
+  perm.file_mask = file_mask;
+  perm.file_mode = file_mode;
+
+  return thunar_io_permissions_run (&perm, file_list, n_threads, error);
+#else
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "Changing files relative to folder descriptors is not supported");
+  return FALSE;
+#endif
+}
@@ -0,0 +1,46 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __THUNAR_IO_PERMISSIONS_H__
+#define __THUNAR_IO_PERMISSIONS_H__
+
+#include <thunar/thunar-enum-types.h>
+#include <thunar/thunar-job.h>
+
+G_BEGIN_DECLS
+
+gboolean thunar_io_permissions_change_owner (ThunarJob     *job,
+                                             GList         *file_list,
+                                             gint           uid,
+                                             gint           gid,
+                                             guint          n_threads,
+                                             GError       **error);
+gboolean thunar_io_permissions_change_mode  (ThunarJob     *job,
+                                             GList         *file_list,
+                                             ThunarFileMode dir_mask,
+                                             ThunarFileMode dir_mode,
+                                             ThunarFileMode file_mask,
+                                             ThunarFileMode file_mode,
+                                             guint          n_threads,
+                                             GError       **error);
+
+G_END_DECLS
+
+#endif /* !__THUNAR_IO_PERMISSIONS_H__ */
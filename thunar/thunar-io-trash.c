@@ -0,0 +1,851 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+#ifdef HAVE_GIO_UNIX
+#include <gio/gunixmounts.h>
+#endif
+
+#include <exo/exo.h>
+
+#include <thunar/thunar-io-delete.h>
+#include <thunar/thunar-io-jobs-util.h>
+#include <thunar/thunar-io-trash.h>
+#include <thunar/thunar-private.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+
+
+
+#if defined (HAVE_OPENAT) && defined (HAVE_FSTATAT) && defined (HAVE_RENAMEAT) && defined (HAVE_UNLINKAT) && defined (HAVE_REALPATH)
+#define THUNAR_IO_TRASH_NATIVE 1
+#endif
+
+
+
+#ifdef THUNAR_IO_TRASH_NATIVE
+typedef struct _ThunarIoTrash    ThunarIoTrash;
+typedef struct _ThunarIoTrashDir ThunarIoTrashDir;
+
+struct _ThunarIoTrash
+{
+  /* trash directories by device, resolved once per job */
+  GHashTable *dirs;
+};
+
+struct _ThunarIoTrashDir
+{
+  gint64  dev;
+
+  /* mount point of a per-mount trash, NULL for the home trash */
+  gchar  *topdir;
+
+  /* the "files" and "info" folders, -1 if there is no usable
+   * trash on this device and GIO has to deal with it */
+  gint    files_fd;
+  gint    info_fd;
+};
+
+
+
+static ThunarIoTrashDir *
+thunar_io_trash_dir_new (gint64       dev,
+                         const gchar *path,
+                         const gchar *topdir)
+{
+  ThunarIoTrashDir *dir;
+  struct stat       statb;
+  gchar            *files_path;
+  gchar            *info_path;
+  gint              files_fd = -1;
+  gint              info_fd = -1;
+
+  dir = g_slice_new0 (ThunarIoTrashDir);
+  dir->dev = dev;
+  dir->topdir = g_strdup (topdir);
+  dir->files_fd = -1;
+  dir->info_fd = -1;
+
+  if (path == NULL)
+    return dir;
+
+  files_path = g_build_filename (path, "files", NULL);
+  info_path = g_build_filename (path, "info", NULL);
+
+  if ((mkdir (files_path, 0700) == 0 || errno == EEXIST)
+      && (mkdir (info_path, 0700) == 0 || errno == EEXIST))
+    {
+      files_fd = open (files_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      info_fd = open (info_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+  /* files can only be renamed into a trash on the same device */
+  if (files_fd >= 0 && info_fd >= 0
+      && fstat (files_fd, &statb) == 0
+      && (gint64) statb.st_dev == dev)
+    {
+      dir->files_fd = files_fd;
+      dir->info_fd = info_fd;
+    }
+  else
+    {
+      if (files_fd >= 0)
+        close (files_fd);
+      if (info_fd >= 0)
+        close (info_fd);
+    }
+
+  g_free (files_path);
+  g_free (info_path);
+
+  return dir;
+}
+
+
+
+static void
+thunar_io_trash_dir_free (gpointer data)
+{
+  ThunarIoTrashDir *dir = data;
+
+  if (dir->files_fd >= 0)
+    close (dir->files_fd);
+  if (dir->info_fd >= 0)
+    close (dir->info_fd);
+
+  g_free (dir->topdir);
+  g_slice_free (ThunarIoTrashDir, dir);
+}
+
+
+
+static gchar *
+thunar_io_trash_find_topdir (const gchar *dirname,
+                             gint64       dev)
+{
+  struct stat statb;
+  gchar      *topdir;
+  gchar      *parent;
+
+  /* walk up until the parent folder is on another device */
+  topdir = g_strdup (dirname);
+  while (strcmp (topdir, G_DIR_SEPARATOR_S) != 0)
+    {
+      parent = g_path_get_dirname (topdir);
+      if (stat (parent, &statb) != 0 || (gint64) statb.st_dev != dev)
+        {
+          g_free (parent);
+          break;
+        }
+
+      g_free (topdir);
+      topdir = parent;
+    }
+
+  return topdir;
+}
+
+
+
+static gchar *
+thunar_io_trash_topdir_path (const gchar *topdir)
+{
+  struct stat statb;
+  gchar      *shared_path;
+  gchar      *path;
+  uid_t       uid = getuid ();
+
+  /* $topdir/.Trash/$uid, only if the administrator created a
+   * sticky, non-symlinked $topdir/.Trash */
+  shared_path = g_build_filename (topdir, ".Trash", NULL);
+  if (lstat (shared_path, &statb) == 0
+      && S_ISDIR (statb.st_mode)
+      && (statb.st_mode & S_ISVTX) != 0)
+    {
+      path = g_strdup_printf ("%s/%lu", shared_path, (gulong) uid);
+      if ((mkdir (path, 0700) == 0 || errno == EEXIST)
+          && lstat (path, &statb) == 0
+          && S_ISDIR (statb.st_mode)
+          && statb.st_uid == uid)
+        {
+          g_free (shared_path);
+          return path;
+        }
+      g_free (path);
+    }
+  g_free (shared_path);
+
+  /* $topdir/.Trash-$uid, which must be a folder owned by the user */
+  path = g_strdup_printf ("%s/.Trash-%lu", strcmp (topdir, G_DIR_SEPARATOR_S) == 0 ? "" : topdir, (gulong) uid);
+  if ((mkdir (path, 0700) == 0 || errno == EEXIST)
+      && lstat (path, &statb) == 0
+      && S_ISDIR (statb.st_mode)
+      && statb.st_uid == uid)
+    {
+      return path;
+    }
+  g_free (path);
+
+  return NULL;
+}
+
+
+
+static void
+thunar_io_trash_init (ThunarIoTrash *trash)
+{
+  ThunarIoTrashDir *dir;
+  struct stat       statb;
+  gchar            *path;
+
+  trash->dirs = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, thunar_io_trash_dir_free);
+
+  /* files on the same device as the home trash always go there */
+  path = g_build_filename (g_get_user_data_dir (), "Trash", NULL);
+  g_mkdir_with_parents (path, 0700);
+
+  if (stat (path, &statb) == 0)
+    dir = thunar_io_trash_dir_new (statb.st_dev, path, NULL);
+  else if (stat (g_get_user_data_dir (), &statb) == 0)
+    dir = thunar_io_trash_dir_new (statb.st_dev, NULL, NULL);
+  else
+    dir = NULL;
+
+  if (dir != NULL)
+    g_hash_table_insert (trash->dirs, &dir->dev, dir);
+
+  g_free (path);
+}
+
+
+
+static ThunarIoTrashDir *
+thunar_io_trash_lookup (ThunarIoTrash *trash,
+                        gint64         dev,
+                        const gchar   *dirname)
+{
+  ThunarIoTrashDir *dir;
+  gchar            *topdir;
+  gchar            *path;
+
+  dir = g_hash_table_lookup (trash->dirs, &dev);
+  if (dir == NULL)
+    {
+      topdir = thunar_io_trash_find_topdir (dirname, dev);
+      path = thunar_io_trash_topdir_path (topdir);
+
+      dir = thunar_io_trash_dir_new (dev, path, topdir);
+      g_hash_table_insert (trash->dirs, &dir->dev, dir);
+
+      g_free (topdir);
+      g_free (path);
+    }
+
+  return dir;
+}
+
+
+
+static gboolean
+thunar_io_trash_write (gint         fd,
+                       const gchar *contents,
+                       gsize        length)
+{
+  gssize n;
+
+  while (length > 0)
+    {
+      n = write (fd, contents, length);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+
+      contents += n;
+      length -= n;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+thunar_io_trash_set_error (GError     **error,
+                           const gchar *filename,
+                           gint         errsv)
+{
+  gchar *display_name;
+
+  display_name = g_filename_display_name (filename);
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               _("Failed to move \"%s\" to the trash: %s"),
+               display_name, g_strerror (errsv));
+  g_free (display_name);
+}
+
+
+
+static gboolean
+thunar_io_trash_move (ThunarIoTrashDir *dir,
+                      const gchar      *filename,
+                      const gchar      *original_path,
+                      GError          **error)
+{
+  struct stat statb;
+  GDateTime  *now;
+  gchar      *basename;
+  gchar      *trashname = NULL;
+  gchar      *infoname = NULL;
+  gchar      *escaped;
+  gchar      *date;
+  gchar      *contents;
+  guint       n;
+  gint        errsv = 0;
+  gint        fd = -1;
+
+  /* Path= is URL-escaped, DeletionDate= is local time without zone */
+  escaped = g_uri_escape_string (original_path, "/", FALSE);
+  now = g_date_time_new_now_local ();
+  date = g_date_time_format (now, "%Y-%m-%dT%H:%M:%S");
+  contents = g_strdup_printf ("[Trash Info]\nPath=%s\nDeletionDate=%s\n", escaped, date);
+  g_date_time_unref (now);
+  g_free (escaped);
+  g_free (date);
+
+  /* reserve a name by exclusively creating the .trashinfo file, the
+   * same scheme GIO uses: "name", "name.2", "name.3", ... */
+  basename = g_path_get_basename (filename);
+  for (n = 1; fd < 0; ++n)
+    {
+      g_free (trashname);
+      g_free (infoname);
+
+      trashname = (n == 1) ? g_strdup (basename) : g_strdup_printf ("%s.%u", basename, n);
+      infoname = g_strconcat (trashname, ".trashinfo", NULL);
+
+      fd = openat (dir->info_fd, infoname, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+      if (fd < 0)
+        {
+          if (errno != EEXIST)
+            {
+              errsv = errno;
+              break;
+            }
+        }
+      else if (fstatat (dir->files_fd, trashname, &statb, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+          /* stale entry in the files folder without info, don't overwrite it */
+          close (fd);
+          unlinkat (dir->info_fd, infoname, 0);
+          fd = -1;
+        }
+    }
+  g_free (basename);
+
+  if (fd >= 0)
+    {
+      if (!thunar_io_trash_write (fd, contents, strlen (contents)))
+        errsv = errno;
+
+      if (close (fd) != 0 && errsv == 0)
+        errsv = errno;
+
+      /* move the file into the trash, it stays where it was if anything failed */
+      if (errsv == 0 && renameat (AT_FDCWD, filename, dir->files_fd, trashname) != 0)
+        errsv = errno;
+
+      if (errsv != 0)
+        unlinkat (dir->info_fd, infoname, 0);
+    }
+
+  g_free (contents);
+  g_free (trashname);
+  g_free (infoname);
+
+  if (errsv != 0)
+    {
+      thunar_io_trash_set_error (error, filename, errsv);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+/* returns FALSE if the file has to be trashed through GIO, otherwise
+ * TRUE and error is set if the file could not be moved to the trash */
+static gboolean
+thunar_io_trash_native (ThunarIoTrash *trash,
+                        GFile         *file,
+                        GError       **error)
+{
+  ThunarIoTrashDir *dir;
+  struct stat       statb;
+  struct stat       parent_statb;
+  const gchar      *relative;
+  gboolean          handled = FALSE;
+  gchar            *filename;
+  gchar            *dirname;
+  gchar            *canonical;
+  gchar            *basename;
+  gchar            *path;
+
+  filename = g_file_get_path (file);
+  if (G_UNLIKELY (filename == NULL))
+    return FALSE;
+
+  dirname = g_path_get_dirname (filename);
+
+  /* leave errors for missing files and mount points to GIO */
+  if (lstat (filename, &statb) == 0
+      && stat (dirname, &parent_statb) == 0
+      && statb.st_dev == parent_statb.st_dev)
+    {
+      canonical = realpath (dirname, NULL);
+      if (G_LIKELY (canonical != NULL))
+        {
+          dir = thunar_io_trash_lookup (trash, statb.st_dev, canonical);
+          if (dir->files_fd >= 0)
+            {
+              handled = TRUE;
+
+              if (dir->topdir == NULL)
+                {
+                  /* the home trash stores absolute paths */
+                  thunar_io_trash_move (dir, filename, filename, error);
+                }
+              else
+                {
+                  /* per-mount trashes store paths relative to the mount point */
+                  basename = g_path_get_basename (filename);
+                  path = g_build_filename (canonical, basename, NULL);
+
+                  relative = path + strlen (dir->topdir);
+                  while (*relative == G_DIR_SEPARATOR)
+                    ++relative;
+
+                  thunar_io_trash_move (dir, filename, relative, error);
+
+                  g_free (basename);
+                  g_free (path);
+                }
+            }
+
+          free (canonical);
+        }
+    }
+
+  g_free (dirname);
+  g_free (filename);
+
+  return handled;
+}
+#endif
+
+
+
+/**
+ * thunar_io_trash_files:
+ * @job          : a #ThunarJob.
+ * @file_list    : the #GFile<!---->s to move to the trash.
+ * @trashed_list : return location for the files that were trashed.
+ * @error        : return location for errors or %NULL.
+ *
+ * Moves the files in @file_list to the trash and stops at the first
+ * error. Local files are renamed into the home or per-mount trash
+ * directly, with the trash of each device resolved only once. Everything
+ * else falls back to g_file_trash().
+ *
+ * The files that were moved are returned in @trashed_list, which
+ * borrows the items of @file_list and must be freed with g_list_free().
+ *
+ * Return value: %TRUE if all files were moved to the trash.
+ **/
+gboolean
+thunar_io_trash_files (ThunarJob *job,
+                       GList     *file_list,
+                       GList    **trashed_list,
+                       GError   **error)
+{
+#ifdef THUNAR_IO_TRASH_NATIVE
+  ThunarIoTrash trash;
+#endif
+  GCancellable *cancellable;
+  gboolean      handled;
+  GError       *err = NULL;
+  GList        *lp;
+  guint         n_processed;
+  guint         n_total;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (trashed_list != NULL, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  cancellable = exo_job_get_cancellable (EXO_JOB (job));
+  n_total = g_list_length (file_list);
+  *trashed_list = NULL;
+
+#ifdef THUNAR_IO_TRASH_NATIVE
+  thunar_io_trash_init (&trash);
+#endif
+
+  for (lp = file_list, n_processed = 0; err == NULL && lp != NULL; lp = lp->next, ++n_processed)
+    {
+      _thunar_assert (G_IS_FILE (lp->data));
+
+      if (exo_job_set_error_if_cancelled (EXO_JOB (job), &err))
+        break;
+
+      /* update progress information */
+      thunar_job_progress (job, lp->data, n_processed, n_total, 0, 0);
+
+      handled = FALSE;
+#ifdef THUNAR_IO_TRASH_NATIVE
+      if (g_file_is_native (lp->data))
+        handled = thunar_io_trash_native (&trash, lp->data, &err);
+#endif
+
+      /* trash the file or folder */
+      if (!handled)
+        g_file_trash (lp->data, cancellable, &err);
+
+      if (err == NULL)
+        *trashed_list = g_list_prepend (*trashed_list, lp->data);
+    }
+
+  /* report the final progress */
+  thunar_job_progress (job, NULL, n_processed, n_total, 0, 0);
+
+#ifdef THUNAR_IO_TRASH_NATIVE
+  g_hash_table_destroy (trash.dirs);
+#endif
+
+  *trashed_list = g_list_reverse (*trashed_list);
+
+  if (err != NULL)
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+/* the folder inside a trash where emptied contents wait for the purge */
+#define EXPUNGED_NAME "expunged"
+
+
+
+G_LOCK_DEFINE_STATIC (purge);
+static gboolean purge_running = FALSE;
+static gboolean purge_again = FALSE;
+
+
+
+static void
+thunar_io_trash_add_dir (GList      **dirs,
+                         const gchar *path)
+{
+  struct stat statb;
+
+  /* only folders owned by the user, never follow symlinks */
+  if (lstat (path, &statb) == 0
+      && S_ISDIR (statb.st_mode)
+      && statb.st_uid == getuid ())
+    {
+      *dirs = g_list_prepend (*dirs, g_strdup (path));
+    }
+}
+
+
+
+/* lists the existing local trash folders, without creating any */
+static GList *
+thunar_io_trash_list_dirs (void)
+{
+#ifdef HAVE_GIO_UNIX
+  GUnixMountEntry *entry;
+  const gchar     *topdir;
+  GList           *mounts;
+  GList           *lp;
+#endif
+  GList           *dirs = NULL;
+  gchar           *path;
+
+  path = g_build_filename (g_get_user_data_dir (), "Trash", NULL);
+  thunar_io_trash_add_dir (&dirs, path);
+  g_free (path);
+
+#ifdef HAVE_GIO_UNIX
+  mounts = g_unix_mounts_get (NULL);
+  for (lp = mounts; lp != NULL; lp = lp->next)
+    {
+      entry = lp->data;
+      topdir = g_unix_mount_get_mount_path (entry);
+
+      if (!g_unix_mount_is_system_internal (entry))
+        {
+          path = g_strdup_printf ("%s/.Trash/%lu", strcmp (topdir, G_DIR_SEPARATOR_S) == 0 ? "" : topdir, (gulong) getuid ());
+          thunar_io_trash_add_dir (&dirs, path);
+          g_free (path);
+
+          path = g_strdup_printf ("%s/.Trash-%lu", strcmp (topdir, G_DIR_SEPARATOR_S) == 0 ? "" : topdir, (gulong) getuid ());
+          thunar_io_trash_add_dir (&dirs, path);
+          g_free (path);
+        }
+
+      g_unix_mount_free (entry);
+    }
+  g_list_free (mounts);
+#endif
+
+  return g_list_reverse (dirs);
+}
+
+
+
+/* moves the contents of the trash at @trash_path into a new
+ * folder below EXPUNGED_NAME and leaves an empty trash behind */
+static gboolean
+thunar_io_trash_expunge (const gchar *trash_path)
+{
+  static const gchar *names[] = { "files", "info", "directorysizes" };
+  gboolean            succeed = TRUE;
+  gchar              *expunged;
+  gchar              *batch = NULL;
+  gchar              *source;
+  gchar              *target;
+  guint               n;
+
+  expunged = g_build_filename (trash_path, EXPUNGED_NAME, NULL);
+  if (mkdir (expunged, 0700) != 0 && errno != EEXIST)
+    {
+      g_free (expunged);
+      return FALSE;
+    }
+
+  /* a folder of its own for every emptying, the purge may be busy
+   * with an older one */
+  for (n = 0; batch == NULL; ++n)
+    {
+      batch = g_strdup_printf ("%s/%" G_GINT64_FORMAT "-%u", expunged, g_get_real_time (), n);
+      if (mkdir (batch, 0700) != 0)
+        {
+          g_free (batch);
+          batch = NULL;
+
+          if (errno != EEXIST)
+            break;
+        }
+    }
+  g_free (expunged);
+
+  if (batch == NULL)
+    return FALSE;
+
+  /* "files" goes first, that is what the trash shows */
+  for (n = 0; succeed && n < G_N_ELEMENTS (names); ++n)
+    {
+      source = g_build_filename (trash_path, names[n], NULL);
+      target = g_build_filename (batch, names[n], NULL);
+
+      if (rename (source, target) != 0 && errno != ENOENT)
+        succeed = FALSE;
+
+      g_free (source);
+      g_free (target);
+    }
+  g_free (batch);
+
+  /* recreate the empty trash, GIO would do so anyway */
+  for (n = 0; n < 2; ++n)
+    {
+      source = g_build_filename (trash_path, names[n], NULL);
+      mkdir (source, 0700);
+      g_free (source);
+    }
+
+  return succeed;
+}
+
+
+
+/**
+ * thunar_io_trash_empty:
+ * @job   : a #ThunarJob.
+ * @error : return location for errors or %NULL.
+ *
+ * Empties the local trash folders at once by renaming their "files"
+ * and "info" folders aside, and starts thunar_io_trash_purge() to
+ * delete them in the background. Trash folders that could not be
+ * emptied this way are left untouched, the caller should delete
+ * whatever is left in the trash afterwards.
+ *
+ * Return value: %FALSE if the @job was cancelled.
+ **/
+gboolean
+thunar_io_trash_empty (ThunarJob *job,
+                       GError   **error)
+{
+  gboolean expunged = FALSE;
+  GList   *dirs;
+  GList   *lp;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  dirs = thunar_io_trash_list_dirs ();
+  for (lp = dirs; lp != NULL && !exo_job_is_cancelled (EXO_JOB (job)); lp = lp->next)
+    if (thunar_io_trash_expunge (lp->data))
+      expunged = TRUE;
+  g_list_free_full (dirs, g_free);
+
+  if (expunged)
+    thunar_io_trash_purge ();
+
+  return !exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+}
+
+
+
+static gpointer
+thunar_io_trash_purge_thread (gpointer data)
+{
+  GList       *dirs;
+  GList       *lp;
+  GDir        *dir;
+  const gchar *name;
+  gchar       *expunged;
+  gchar       *path;
+
+  /* nobody waits for this */
+  thunar_io_jobs_util_set_background_priority ();
+
+  for (;;)
+    {
+      G_LOCK (purge);
+      if (!purge_again)
+        {
+          purge_running = FALSE;
+          G_UNLOCK (purge);
+          break;
+        }
+      purge_again = FALSE;
+      G_UNLOCK (purge);
+
+      dirs = thunar_io_trash_list_dirs ();
+      for (lp = dirs; lp != NULL; lp = lp->next)
+        {
+          expunged = g_build_filename (lp->data, EXPUNGED_NAME, NULL);
+
+          /* delete the emptied contents one by one, the folder itself
+           * stays in case the trash is emptied again meanwhile */
+          dir = g_dir_open (expunged, 0, NULL);
+          if (dir != NULL)
+            {
+              while ((name = g_dir_read_name (dir)) != NULL)
+                {
+                  path = g_build_filename (expunged, name, NULL);
+                  thunar_io_delete_tree (path, NULL);
+                  g_free (path);
+                }
+
+              g_dir_close (dir);
+            }
+
+          g_free (expunged);
+        }
+      g_list_free_full (dirs, g_free);
+    }
+
+  return NULL;
+}
+
+
+
+/**
+ * thunar_io_trash_purge:
+ *
+ * Deletes whatever thunar_io_trash_empty() moved aside, in a thread
+ * with low CPU and I/O priority. As the contents stay in the trash
+ * folders until they are deleted, this picks up purges that were
+ * interrupted by quitting Thunar when called again later.
+ *
+ * May be called from any thread.
+ **/
+void
+thunar_io_trash_purge (void)
+{
+  G_LOCK (purge);
+
+  /* let a running purge take another round */
+  purge_again = TRUE;
+
+  if (!purge_running)
+    {
+      purge_running = TRUE;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+      g_thread_unref (g_thread_new ("thunar-trash-purge", thunar_io_trash_purge_thread, NULL));
+#else
+      g_thread_create (thunar_io_trash_purge_thread, NULL, FALSE, NULL);
+#endif
+    }
+
+  G_UNLOCK (purge);
+}
@@ -32,6 +32,7 @@
 #include <exo/exo.h>
 
 #include <thunar/thunar-enum-types.h>
+#include <thunar/thunar-io-jobs-util.h>
 #include <thunar/thunar-job.h>
 #include <thunar/thunar-marshal.h>
 #include <thunar/thunar-private.h>
@@ -40,6 +41,23 @@
 
 #define THUNAR_JOB_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), THUNAR_TYPE_JOB, ThunarJobPrivate))
 
+/* minimum interval between two progress updates, in microseconds */
+#define PROGRESS_INTERVAL (100 * 1000)
+
+#define N_PRIORITIES (THUNAR_JOB_PRIORITY_TRANSFER + 1)
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define _executor_lock(executor)   g_mutex_lock (&((executor)->lock))
+#define _executor_unlock(executor) g_mutex_unlock (&((executor)->lock))
+#define _executor_wait(executor)   g_cond_wait (&((executor)->cond), &((executor)->lock))
+#define _executor_signal(executor) g_cond_broadcast (&((executor)->cond))
+#else
+#define _executor_lock(executor)   g_mutex_lock ((executor)->lock)
+#define _executor_unlock(executor) g_mutex_unlock ((executor)->lock)
+#define _executor_wait(executor)   g_cond_wait ((executor)->cond, (executor)->lock)
+#define _executor_signal(executor) g_cond_broadcast ((executor)->cond)
+#endif
+
 
 
 /* Signal identifiers */
@@ -55,6 +73,8 @@ enum
 
 
 static void              thunar_job_finalize            (GObject            *object);
+static gboolean          thunar_job_execute             (ExoJob             *job,
+                                                         GError            **error);
 static ThunarJobResponse thunar_job_real_ask            (ThunarJob          *job,
                                                          const gchar        *message,
                                                          ThunarJobResponse   choices);
@@ -69,7 +89,40 @@ struct _ThunarJobPrivate
   ThunarJobResponse earlier_ask_create_response;
   ThunarJobResponse earlier_ask_overwrite_response;
   ThunarJobResponse earlier_ask_skip_response;
-  GList            *total_files;
+  gint64            last_progress_time;
+
+  /* the priority class and whether the job holds a slot of it */
+  ThunarJobPriority priority;
+  gboolean          executing;
+};
+
+/* all ExoJob<!---->s get a thread of their own from the GIOScheduler,
+ * the executor decides which of them may start working */
+typedef struct
+{
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  GMutex lock;
+  GCond  cond;
+#else
+  GMutex *lock;
+  GCond  *cond;
+#endif
+
+  guint  n_running[N_PRIORITIES];
+  guint  n_waiting[N_PRIORITIES];
+} ThunarJobExecutor;
+
+
+
+/* number of jobs of each class that may run at the same time. listings
+ * never wait and transfers are already limited per device by the
+ * ThunarTransferQueue, so waiting here would only starve other devices */
+static const guint executor_limits[N_PRIORITIES] =
+{
+  G_MAXUINT, /* THUNAR_JOB_PRIORITY_INTERACTIVE */
+  4,         /* THUNAR_JOB_PRIORITY_METADATA */
+  2,         /* THUNAR_JOB_PRIORITY_DEEP_COUNT */
+  G_MAXUINT, /* THUNAR_JOB_PRIORITY_TRANSFER */
 };
 
 
@@ -98,6 +151,7 @@ static void
 thunar_job_class_init (ThunarJobClass *klass)
 {
   GObjectClass *gobject_class;
+  ExoJobClass  *exojob_class;
 
   /* add our private data for this class */
   g_type_class_add_private (klass, sizeof (ThunarJobPrivate));
@@ -105,6 +159,11 @@ thunar_job_class_init (ThunarJobClass *klass)
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->finalize = thunar_job_finalize;
 
+  /* subclasses implement ThunarJobClass::execute, which
+   * runs once the executor has a slot for the job */
+  exojob_class = EXO_JOB_CLASS (klass);
+  exojob_class->execute = thunar_job_execute;
+
   klass->ask = thunar_job_real_ask;
   klass->ask_replace = thunar_job_real_ask_replace;
 
@@ -213,6 +272,9 @@ thunar_job_init (ThunarJob *job)
   job->priv->earlier_ask_create_response = 0;
   job->priv->earlier_ask_overwrite_response = 0;
   job->priv->earlier_ask_skip_response = 0;
+  job->priv->last_progress_time = 0;
+  job->priv->priority = THUNAR_JOB_PRIORITY_INTERACTIVE;
+  job->priv->executing = FALSE;
 }
 
 
@@ -225,6 +287,155 @@ thunar_job_finalize (GObject *object)
 
 
 
+static ThunarJobExecutor *
+thunar_job_executor_get (void)
+{
+  static gsize executor = 0;
+  ThunarJobExecutor *new_executor;
+
+  if (g_once_init_enter (&executor))
+    {
+      new_executor = g_new0 (ThunarJobExecutor, 1);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+      g_mutex_init (&new_executor->lock);
+      g_cond_init (&new_executor->cond);
+#else
+      new_executor->lock = g_mutex_new ();
+      new_executor->cond = g_cond_new ();
+#endif
+      g_once_init_leave (&executor, (gsize) new_executor);
+    }
+
+  return (ThunarJobExecutor *) executor;
+}
+
+
+
+/* must be called with the executor lock held */
+static gboolean
+thunar_job_executor_can_start (ThunarJobExecutor *executor,
+                               ThunarJobPriority  priority)
+{
+  guint n;
+
+  if (executor->n_running[priority] >= executor_limits[priority])
+    return FALSE;
+
+  /* classes without a limit never queue */
+  if (executor_limits[priority] == G_MAXUINT)
+    return TRUE;
+
+  /* listings preempt the queue, so let them finish first */
+  if (executor->n_running[THUNAR_JOB_PRIORITY_INTERACTIVE] > 0)
+    return FALSE;
+
+  /* queued jobs of a higher class start first */
+  for (n = 0; n < priority; ++n)
+    if (executor->n_waiting[n] > 0)
+      return FALSE;
+
+  return TRUE;
+}
+
+
+
+static void
+thunar_job_executor_cancelled (GCancellable      *cancellable,
+                               ThunarJobExecutor *executor)
+{
+  /* wake up the waiting jobs, so the cancelled one can leave */
+  _executor_lock (executor);
+  _executor_signal (executor);
+  _executor_unlock (executor);
+}
+
+
+
+/* waits for a slot of the class of @job, which it takes even
+ * if the job was cancelled in the meantime */
+static void
+thunar_job_executor_enter (ThunarJob *job)
+{
+  ThunarJobExecutor *executor = thunar_job_executor_get ();
+  ThunarJobPriority  priority = job->priv->priority;
+  GCancellable      *cancellable;
+  gulong             handler_id;
+
+  cancellable = exo_job_get_cancellable (EXO_JOB (job));
+  handler_id = g_cancellable_connect (cancellable, G_CALLBACK (thunar_job_executor_cancelled), executor, NULL);
+
+  _executor_lock (executor);
+
+  if (!thunar_job_executor_can_start (executor, priority))
+    {
+      executor->n_waiting[priority]++;
+
+      while (!g_cancellable_is_cancelled (cancellable)
+             && !thunar_job_executor_can_start (executor, priority))
+        _executor_wait (executor);
+
+      executor->n_waiting[priority]--;
+
+      /* lower classes may have waited for this job */
+      _executor_signal (executor);
+    }
+
+  executor->n_running[priority]++;
+
+  _executor_unlock (executor);
+
+  g_cancellable_disconnect (cancellable, handler_id);
+
+  /* the threads are shared, so always set the I/O priority */
+  thunar_io_jobs_util_set_io_priority (priority >= THUNAR_JOB_PRIORITY_DEEP_COUNT);
+
+  job->priv->executing = TRUE;
+}
+
+
+
+static void
+thunar_job_executor_leave (ThunarJob *job)
+{
+  ThunarJobExecutor *executor = thunar_job_executor_get ();
+
+  job->priv->executing = FALSE;
+
+  thunar_io_jobs_util_set_io_priority (FALSE);
+
+  _executor_lock (executor);
+  executor->n_running[job->priv->priority]--;
+  _executor_signal (executor);
+  _executor_unlock (executor);
+}
+
+
+
+static gboolean
+thunar_job_execute (ExoJob  *job,
+                    GError **error)
+{
+  ThunarJob *thunar_job = THUNAR_JOB (job);
+  gboolean   succeed;
+
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (THUNAR_JOB_GET_CLASS (job)->execute != NULL, FALSE);
+
+  /* wait until the job may start */
+  thunar_job_executor_enter (thunar_job);
+
+  if (exo_job_set_error_if_cancelled (job, error))
+    succeed = FALSE;
+  else
+    succeed = (*THUNAR_JOB_GET_CLASS (job)->execute) (job, error);
+
+  thunar_job_executor_leave (thunar_job);
+
+  return succeed;
+}
+
+
+
 static ThunarJobResponse 
 thunar_job_real_ask (ThunarJob        *job,
                      const gchar      *message,
@@ -589,54 +800,117 @@ thunar_job_new_files (ThunarJob   *job,
 
 
 
+/**
+ * thunar_job_get_priority:
+ * @job : a #ThunarJob.
+ *
+ * Returns the priority class of @job.
+ *
+ * Return value: the #ThunarJobPriority of @job.
+ **/
+ThunarJobPriority
+thunar_job_get_priority (ThunarJob *job)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), THUNAR_JOB_PRIORITY_INTERACTIVE);
+  return job->priv->priority;
+}
+
+
+
+/**
+ * thunar_job_set_priority:
+ * @job      : a #ThunarJob.
+ * @priority : the new #ThunarJobPriority.
+ *
+ * Moves @job to the priority class @priority. Jobs of the lower
+ * classes wait for jobs of higher classes, run with a lower I/O
+ * priority and only a few of them run at the same time.
+ *
+ * Should be called before the @job is launched. Jobs whose class
+ * is only known once they run, like the ones launched with
+ * thunar_simple_job_launch(), may also call this from the job
+ * thread, which then waits for a free slot of the new class.
+ **/
 void
-thunar_job_set_total_files (ThunarJob *job,
-                            GList     *total_files)
+thunar_job_set_priority (ThunarJob        *job,
+                         ThunarJobPriority priority)
 {
   _thunar_return_if_fail (THUNAR_IS_JOB (job));
-  _thunar_return_if_fail (job->priv->total_files == NULL);
-  _thunar_return_if_fail (total_files != NULL);
+  _thunar_return_if_fail (priority <= THUNAR_JOB_PRIORITY_TRANSFER);
+
+  if (job->priv->priority == priority)
+    return;
 
-  job->priv->total_files = total_files;
+  if (job->priv->executing)
+    {
+      /* give up the slot of the old class */
+      thunar_job_executor_leave (job);
+      job->priv->priority = priority;
+      thunar_job_executor_enter (job);
+    }
+  else
+    {
+      job->priv->priority = priority;
+    }
 }
 
 
 
+/**
+ * thunar_job_progress:
+ * @job             : a #ThunarJob.
+ * @current_file    : the #GFile being processed or %NULL.
+ * @n_processed     : number of files processed so far.
+ * @n_total         : total number of files to process, or %0 if unknown.
+ * @bytes_processed : number of bytes processed so far.
+ * @bytes_total     : total number of bytes to process, or %0 to
+ *                    base the percentage on the file counts.
+ *
+ * Reports the progress of the @job. The name of @current_file is
+ * shown as info message and the percentage is computed from the
+ * byte counts if available, else from the file counts.
+ *
+ * Updates are sent to the user interface at most every 100ms, apart
+ * from the first and the last one, so this is cheap to call for
+ * every file. Callers that report a file before processing it call
+ * this once more with @n_processed equal to @n_total when done.
+ **/
 void
-thunar_job_processing_file (ThunarJob *job,
-                            GList     *current_file)
+thunar_job_progress (ThunarJob *job,
+                     GFile     *current_file,
+                     guint      n_processed,
+                     guint      n_total,
+                     guint64    bytes_processed,
+                     guint64    bytes_total)
 {
-  GList *lp;
-  gchar *base_name;
-  gchar *display_name;
-  guint  n_processed;
-  guint  n_total;
+  gint64  now;
+  gchar  *base_name;
+  gchar  *display_name;
 
   _thunar_return_if_fail (THUNAR_IS_JOB (job));
-  _thunar_return_if_fail (current_file != NULL);
+  _thunar_return_if_fail (current_file == NULL || G_IS_FILE (current_file));
 
-  base_name = g_file_get_basename (current_file->data);
-  display_name = g_filename_display_name (base_name);
-  g_free (base_name);
+  /* rate limit the updates, but never drop the last one */
+  now = g_get_monotonic_time ();
+  if (job->priv->last_progress_time != 0
+      && now - job->priv->last_progress_time < PROGRESS_INTERVAL
+      && (n_total == 0 || n_processed + 1 < n_total))
+    return;
 
-  exo_job_info_message (EXO_JOB (job), "%s", display_name);
-  g_free (display_name);
+  job->priv->last_progress_time = now;
 
-  /* verify that we have total files set */
-  if (G_LIKELY (job->priv->total_files != NULL))
+  if (current_file != NULL)
     {
-      /* determine the number of files processed so far */
-      for (lp = job->priv->total_files, n_processed = 0;
-           lp != current_file;
-           lp = lp->next);
-
-      /* emit only if n_processed is a multiple of 8 */
-      if ((n_processed % 8) == 0)
-        {
-          /* determine the total_number of files */
-          n_total = g_list_length (job->priv->total_files);
+      base_name = g_file_get_basename (current_file);
+      display_name = g_filename_display_name (base_name);
+      g_free (base_name);
 
-          exo_job_percent (EXO_JOB (job), (n_processed * 100.0) / n_total);
-        }
+      exo_job_info_message (EXO_JOB (job), "%s", display_name);
+      g_free (display_name);
     }
+
+  if (bytes_total > 0)
+    exo_job_percent (EXO_JOB (job), MIN (bytes_processed, bytes_total) * 100.0 / bytes_total);
+  else if (n_total > 0)
+    exo_job_percent (EXO_JOB (job), MIN (n_processed, n_total) * 100.0 / n_total);
 }
@@ -35,6 +35,25 @@ typedef struct _ThunarJobPrivate ThunarJobPrivate;
 typedef struct _ThunarJobClass   ThunarJobClass;
 typedef struct _ThunarJob        ThunarJob;
 
+/**
+ * ThunarJobPriority:
+ * @THUNAR_JOB_PRIORITY_INTERACTIVE : folder listings and other jobs the user waits for.
+ * @THUNAR_JOB_PRIORITY_METADATA    : thumbnails, templates, other file information and
+ *                                    single file operations like renames.
+ * @THUNAR_JOB_PRIORITY_DEEP_COUNT  : computing the size of folders.
+ * @THUNAR_JOB_PRIORITY_TRANSFER    : copying, moving, deleting and other bulk operations.
+ *
+ * The priority classes of #ThunarJob<!---->s, from the highest to
+ * the lowest priority.
+ **/
+typedef enum
+{
+  THUNAR_JOB_PRIORITY_INTERACTIVE,
+  THUNAR_JOB_PRIORITY_METADATA,
+  THUNAR_JOB_PRIORITY_DEEP_COUNT,
+  THUNAR_JOB_PRIORITY_TRANSFER,
+} ThunarJobPriority;
+
 #define THUNAR_TYPE_JOB            (thunar_job_get_type ())
 #define THUNAR_JOB(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), THUNAR_TYPE_JOB, ThunarJob))
 #define THUNAR_JOB_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), THUNAR_TYPE_JOB, ThunarJobClass))
@@ -49,6 +68,10 @@ struct _ThunarJobClass
 
   /*< public >*/
 
+  /* virtual methods */
+  gboolean          (*execute)     (ExoJob           *job,
+                                    GError          **error);
+
   /* signals */
   ThunarJobResponse (*ask)         (ThunarJob        *job,
                                     const gchar      *message,
@@ -66,10 +89,15 @@ struct _ThunarJob
 };
 
 GType             thunar_job_get_type               (void) G_GNUC_CONST;
-void              thunar_job_set_total_files        (ThunarJob       *job,
-                                                     GList           *total_files);
-void              thunar_job_processing_file        (ThunarJob       *job,
-                                                     GList           *current_file);
+ThunarJobPriority thunar_job_get_priority           (ThunarJob       *job);
+void              thunar_job_set_priority           (ThunarJob       *job,
+                                                     ThunarJobPriority priority);
+void              thunar_job_progress               (ThunarJob       *job,
+                                                     GFile           *current_file,
+                                                     guint            n_processed,
+                                                     guint            n_total,
+                                                     guint64          bytes_processed,
+                                                     guint64          bytes_total);
 
 ThunarJobResponse thunar_job_ask_create             (ThunarJob       *job,
                                                      const gchar     *format,
@@ -31,11 +31,13 @@
 #endif
 
 #include <thunar/thunar-application.h>
+#include <thunar/thunar-deep-count-job.h>
 #include <thunar/thunar-file-monitor.h>
 #include <thunar/thunar-gobject-extensions.h>
 #include <thunar/thunar-list-model.h>
 #include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
+#include <thunar/thunar-size-cache.h>
 #include <thunar/thunar-user.h>
 
 
@@ -47,6 +49,7 @@ enum
   PROP_CASE_SENSITIVE,
   PROP_DATE_STYLE,
   PROP_FOLDER,
+  PROP_FOLDER_SIZES,
   PROP_FOLDERS_FIRST,
   PROP_NUM_FILES,
   PROP_SHOW_HIDDEN,
@@ -63,10 +66,17 @@ enum
 
 
 
+/* maximum number of folders waiting for their size */
+#define FOLDER_SIZE_MAX_QUEUED (32)
+
+
+
 typedef gint (*ThunarSortFunc) (const ThunarFile *a,
                                 const ThunarFile *b,
                                 gboolean          case_sensitive);
 
+typedef struct _ThunarListModelFolderSize ThunarListModelFolderSize;
+
 
 
 static void               thunar_list_model_tree_model_init       (GtkTreeModelIface      *iface);
@@ -144,6 +154,8 @@ static void               thunar_list_model_sort                  (ThunarListMod
 static void               thunar_list_model_file_changed          (ThunarFileMonitor      *file_monitor,
                                                                    ThunarFile             *file,
                                                                    ThunarListModel        *store);
+static void               thunar_list_model_row_changed           (ThunarListModel        *store,
+                                                                   ThunarFile             *file);
 static void               thunar_list_model_folder_destroy        (ThunarFolder           *folder,
                                                                    ThunarListModel        *store);
 static void               thunar_list_model_folder_error          (ThunarFolder           *folder,
@@ -188,6 +200,16 @@ static void               thunar_list_model_set_date_style        (ThunarListMod
                                                                    ThunarDateStyle         date_style);
 static gint               thunar_list_model_get_num_files         (ThunarListModel        *store);
 static gboolean           thunar_list_model_get_folders_first     (ThunarListModel        *store);
+static void               thunar_list_model_set_folder_sizes      (ThunarListModel        *store,
+                                                                   gboolean                folder_sizes);
+static gchar             *thunar_list_model_folder_size_string    (ThunarListModel        *store,
+                                                                   ThunarFile             *file);
+static gint               thunar_list_model_cmp_folder_sizes      (ThunarListModel        *store,
+                                                                   ThunarFile             *a,
+                                                                   ThunarFile             *b);
+static void               thunar_list_model_folder_size_reset     (ThunarListModel        *store);
+static void               thunar_list_model_folder_size_free      (gpointer                data);
+static void               thunar_list_model_folder_size_schedule  (ThunarListModel        *store);
 
 
 
@@ -235,6 +257,33 @@ struct _ThunarListModel
   gboolean       sort_folders_first : 1;
   gint           sort_sign;   /* 1 = ascending, -1 descending */
   ThunarSortFunc sort_func;
+
+  /* total size of the folders, counted one folder at a time
+   * in the order the rows became visible, most recent first.
+   */
+  gboolean            folder_sizes;
+  GHashTable         *folder_size_table;
+  GQueue              folder_size_queue;
+  ThunarDeepCountJob *folder_size_job;
+  ThunarFile         *folder_size_file;
+  guint64             folder_size_total;
+  gboolean            folder_size_failed;
+  guint               folder_size_idle_id;
+  ThunarSizeCache    *size_cache;
+};
+
+struct _ThunarListModelFolderSize
+{
+  guint64 size;
+
+  /* whether size was counted before */
+  guint   known : 1;
+
+  /* whether size is up to date */
+  guint   valid : 1;
+
+  /* whether the folder is waiting or being counted */
+  guint   queued : 1;
 };
 
 
@@ -299,6 +348,19 @@ thunar_list_model_class_init (ThunarListModelClass *klass)
                            THUNAR_TYPE_FOLDER,
                            EXO_PARAM_READWRITE);
 
+  /**
+   * ThunarListModel:folder-sizes:
+   *
+   * Tells whether the total size of folders is counted and
+   * shown in the size column.
+   **/
+  list_model_props[PROP_FOLDER_SIZES] =
+      g_param_spec_boolean ("folder-sizes",
+                            "folder-sizes",
+                            "folder-sizes",
+                            FALSE,
+                            EXO_PARAM_READWRITE);
+
   /**
    * ThunarListModel::folders-first:
    *
@@ -427,6 +489,11 @@ thunar_list_model_init (ThunarListModel *store)
   store->sort_func = thunar_file_compare_by_name;
   store->rows = g_sequence_new (g_object_unref);
 
+  store->folder_size_table = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref,
+                                                    thunar_list_model_folder_size_free);
+  g_queue_init (&store->folder_size_queue);
+  store->size_cache = thunar_size_cache_get ();
+
   /* connect to the shared ThunarFileMonitor, so we don't need to
    * connect "changed" to every single ThunarFile we own.
    */
@@ -455,6 +522,11 @@ thunar_list_model_finalize (GObject *object)
 
   g_sequence_free (store->rows);
 
+  /* release the folder sizes */
+  thunar_list_model_folder_size_reset (store);
+  g_hash_table_destroy (store->folder_size_table);
+  g_object_unref (store->size_cache);
+
   /* disconnect from the file monitor */
   g_signal_handlers_disconnect_by_func (G_OBJECT (store->file_monitor), thunar_list_model_file_changed, store);
   g_object_unref (G_OBJECT (store->file_monitor));
@@ -486,6 +558,10 @@ thunar_list_model_get_property (GObject    *object,
       g_value_set_object (value, thunar_list_model_get_folder (store));
       break;
 
+    case PROP_FOLDER_SIZES:
+      g_value_set_boolean (value, thunar_list_model_get_folder_sizes (store));
+      break;
+
     case PROP_FOLDERS_FIRST:
       g_value_set_boolean (value, thunar_list_model_get_folders_first (store));
       break;
@@ -532,6 +608,10 @@ thunar_list_model_set_property (GObject      *object,
       thunar_list_model_set_folder (store, g_value_get_object (value));
       break;
 
+    case PROP_FOLDER_SIZES:
+      thunar_list_model_set_folder_sizes (store, g_value_get_boolean (value));
+      break;
+
     case PROP_FOLDERS_FIRST:
       thunar_list_model_set_folders_first (store, g_value_get_boolean (value));
       break;
@@ -743,7 +823,10 @@ thunar_list_model_get_value (GtkTreeModel *model,
 
     case THUNAR_COLUMN_SIZE:
       g_value_init (value, G_TYPE_STRING);
-      g_value_take_string (value, thunar_file_get_size_string_formatted (file, THUNAR_LIST_MODEL (model)->file_size_binary));
+      if (G_UNLIKELY (THUNAR_LIST_MODEL (model)->folder_sizes) && thunar_file_is_directory (file))
+        g_value_take_string (value, thunar_list_model_folder_size_string (THUNAR_LIST_MODEL (model), file));
+      else
+        g_value_take_string (value, thunar_file_get_size_string_formatted (file, THUNAR_LIST_MODEL (model)->file_size_binary));
       break;
 
     case THUNAR_COLUMN_TYPE:
@@ -1108,6 +1191,10 @@ thunar_list_model_cmp_func (gconstpointer a,
         return isdir_a ? -1 : 1;
     }
 
+  /* the size of folders is only known to the model */
+  if (G_UNLIKELY (store->folder_sizes) && store->sort_func == sort_by_size)
+    return thunar_list_model_cmp_folder_sizes (store, THUNAR_FILE (a), THUNAR_FILE (b)) * store->sort_sign;
+
   return (*store->sort_func) (a, b, store->sort_case_sensitive) * store->sort_sign;
 }
 
@@ -1175,6 +1262,27 @@ static void
 thunar_list_model_file_changed (ThunarFileMonitor *file_monitor,
                                 ThunarFile        *file,
                                 ThunarListModel   *store)
+{
+  ThunarListModelFolderSize *folder_size;
+
+  _thunar_return_if_fail (THUNAR_IS_FILE_MONITOR (file_monitor));
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+  _thunar_return_if_fail (THUNAR_IS_FILE (file));
+
+  /* count the folder again the next time it is visible, but
+   * keep showing the old size until then */
+  folder_size = g_hash_table_lookup (store->folder_size_table, file);
+  if (G_UNLIKELY (folder_size != NULL))
+    folder_size->valid = FALSE;
+
+  thunar_list_model_row_changed (store, file);
+}
+
+
+
+static void
+thunar_list_model_row_changed (ThunarListModel *store,
+                               ThunarFile      *file)
 {
   GSequenceIter *row;
   GSequenceIter *end;
@@ -1186,7 +1294,6 @@ thunar_list_model_file_changed (ThunarFileMonitor *file_monitor,
   GtkTreePath   *path;
   GtkTreeIter    iter;
 
-  _thunar_return_if_fail (THUNAR_IS_FILE_MONITOR (file_monitor));
   _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
   _thunar_return_if_fail (THUNAR_IS_FILE (file));
 
@@ -1362,6 +1469,9 @@ thunar_list_model_files_removed (ThunarFolder    *folder,
   /* drop all the referenced files from the model */
   for (lp = files; lp != NULL; lp = lp->next)
     {
+      /* forget the size of the folder, queued entries are skipped */
+      g_hash_table_remove (store->folder_size_table, lp->data);
+
       row = g_sequence_get_begin_iter (store->rows);
       end = g_sequence_get_end_iter (store->rows);
 
@@ -1681,6 +1791,250 @@ sort_by_type (const ThunarFile *a,
 
 
 
+static void
+thunar_list_model_folder_size_free (gpointer data)
+{
+  g_slice_free (ThunarListModelFolderSize, data);
+}
+
+
+
+static void
+thunar_list_model_folder_size_reset (ThunarListModel *store)
+{
+  ThunarFile *file;
+
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+
+  /* cancel the running count (if any) */
+  if (G_UNLIKELY (store->folder_size_job != NULL))
+    {
+      g_signal_handlers_disconnect_matched (G_OBJECT (store->folder_size_job), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, store);
+      exo_job_cancel (EXO_JOB (store->folder_size_job));
+      g_object_unref (G_OBJECT (store->folder_size_job));
+      store->folder_size_job = NULL;
+
+      g_object_unref (G_OBJECT (store->folder_size_file));
+      store->folder_size_file = NULL;
+    }
+
+  /* stop the pending start of the next count */
+  if (G_UNLIKELY (store->folder_size_idle_id != 0))
+    {
+      g_source_remove (store->folder_size_idle_id);
+      store->folder_size_idle_id = 0;
+    }
+
+  /* forget the queued folders and the known sizes */
+  while ((file = g_queue_pop_head (&store->folder_size_queue)) != NULL)
+    g_object_unref (G_OBJECT (file));
+  g_hash_table_remove_all (store->folder_size_table);
+}
+
+
+
+static void
+thunar_list_model_folder_size_error (ExoJob          *job,
+                                     const GError    *error,
+                                     ThunarListModel *store)
+{
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+  _thunar_return_if_fail (store->folder_size_job == THUNAR_DEEP_COUNT_JOB (job));
+
+  /* the folder is not readable, leave the size empty */
+  store->folder_size_failed = TRUE;
+}
+
+
+
+static void
+thunar_list_model_folder_size_status_update (ThunarDeepCountJob *job,
+                                             guint64             total_size,
+                                             guint64             allocated_size,
+                                             guint               file_count,
+                                             guint               directory_count,
+                                             guint               unreadable_directory_count,
+                                             ThunarListModel    *store)
+{
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+  _thunar_return_if_fail (store->folder_size_job == job);
+
+  /* the last update has the final size, like the file
+   * sizes we show the size of the contents, not the
+   * space used on disk */
+  store->folder_size_total = total_size;
+}
+
+
+
+static void
+thunar_list_model_folder_size_finished (ExoJob          *job,
+                                        ThunarListModel *store)
+{
+  ThunarListModelFolderSize *folder_size;
+  ThunarFile                *file;
+
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+  _thunar_return_if_fail (store->folder_size_job == THUNAR_DEEP_COUNT_JOB (job));
+
+  /* disconnect from the job */
+  g_signal_handlers_disconnect_matched (G_OBJECT (store->folder_size_job), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, store);
+  g_object_unref (G_OBJECT (store->folder_size_job));
+  store->folder_size_job = NULL;
+
+  file = store->folder_size_file;
+  store->folder_size_file = NULL;
+
+  /* the folder could have been removed in the meantime */
+  folder_size = g_hash_table_lookup (store->folder_size_table, file);
+  if (G_LIKELY (folder_size != NULL))
+    {
+      folder_size->queued = FALSE;
+      folder_size->valid = TRUE;
+
+      if (G_LIKELY (!store->folder_size_failed))
+        {
+          folder_size->size = store->folder_size_total;
+          folder_size->known = TRUE;
+        }
+
+      /* redraw the row and move it if sorted by size */
+      thunar_list_model_row_changed (store, file);
+    }
+
+  g_object_unref (G_OBJECT (file));
+
+  /* continue with the next folder */
+  thunar_list_model_folder_size_schedule (store);
+}
+
+
+
+static gboolean
+thunar_list_model_folder_size_next (gpointer user_data)
+{
+  ThunarListModelFolderSize *folder_size;
+  ThunarListModel           *store = THUNAR_LIST_MODEL (user_data);
+  ThunarFile                *file;
+  GList                     *files;
+
+  _thunar_return_val_if_fail (THUNAR_IS_LIST_MODEL (store), FALSE);
+  _thunar_return_val_if_fail (store->folder_size_job == NULL, FALSE);
+
+  store->folder_size_idle_id = 0;
+
+  /* take the most recently shown folder that is still in the model */
+  while ((file = g_queue_pop_head (&store->folder_size_queue)) != NULL)
+    {
+      folder_size = g_hash_table_lookup (store->folder_size_table, file);
+      if (G_LIKELY (folder_size != NULL && folder_size->queued))
+        break;
+
+      g_object_unref (G_OBJECT (file));
+    }
+
+  if (G_UNLIKELY (file == NULL))
+    return FALSE;
+
+  /* the queue reference is released when the job has finished */
+  store->folder_size_file = file;
+  store->folder_size_total = 0;
+  store->folder_size_failed = FALSE;
+
+  /* count the folder (not following symlinks) */
+  files = g_list_prepend (NULL, file);
+  store->folder_size_job = thunar_deep_count_job_new (files, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS);
+  g_list_free (files);
+
+  g_signal_connect (G_OBJECT (store->folder_size_job), "error", G_CALLBACK (thunar_list_model_folder_size_error), store);
+  g_signal_connect (G_OBJECT (store->folder_size_job), "finished", G_CALLBACK (thunar_list_model_folder_size_finished), store);
+  g_signal_connect (G_OBJECT (store->folder_size_job), "status-update", G_CALLBACK (thunar_list_model_folder_size_status_update), store);
+
+  exo_job_launch (EXO_JOB (store->folder_size_job));
+
+  return FALSE;
+}
+
+
+
+static void
+thunar_list_model_folder_size_schedule (ThunarListModel *store)
+{
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+
+  /* only one folder is counted at a time, and only
+   * when there is nothing else to do */
+  if (store->folder_size_job == NULL
+      && store->folder_size_idle_id == 0
+      && !g_queue_is_empty (&store->folder_size_queue))
+    {
+      store->folder_size_idle_id = g_idle_add_full (G_PRIORITY_LOW, thunar_list_model_folder_size_next, store, NULL);
+    }
+}
+
+
+
+static gchar *
+thunar_list_model_folder_size_string (ThunarListModel *store,
+                                      ThunarFile      *file)
+{
+  ThunarListModelFolderSize *folder_size;
+
+  _thunar_return_val_if_fail (THUNAR_IS_LIST_MODEL (store), NULL);
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), NULL);
+
+  /* leave the size empty until the folder was counted */
+  folder_size = g_hash_table_lookup (store->folder_size_table, file);
+  if (folder_size == NULL || !folder_size->known)
+    return NULL;
+
+  return g_format_size_full (folder_size->size, store->file_size_binary ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT);
+}
+
+
+
+static gint
+thunar_list_model_cmp_folder_sizes (ThunarListModel *store,
+                                    ThunarFile      *a,
+                                    ThunarFile      *b)
+{
+  ThunarListModelFolderSize *folder_size;
+  guint64                    size_a = 0;
+  guint64                    size_b = 0;
+
+  /* folders that were not counted yet sort as empty */
+  if (thunar_file_is_directory (a))
+    {
+      folder_size = g_hash_table_lookup (store->folder_size_table, a);
+      if (folder_size != NULL && folder_size->known)
+        size_a = folder_size->size;
+    }
+  else
+    {
+      size_a = thunar_file_get_size (a);
+    }
+
+  if (thunar_file_is_directory (b))
+    {
+      folder_size = g_hash_table_lookup (store->folder_size_table, b);
+      if (folder_size != NULL && folder_size->known)
+        size_b = folder_size->size;
+    }
+  else
+    {
+      size_b = thunar_file_get_size (b);
+    }
+
+  if (size_a < size_b)
+    return -1;
+  else if (size_a > size_b)
+    return 1;
+
+  return thunar_file_compare_by_name (a, b, store->sort_case_sensitive);
+}
+
+
+
 /**
  * thunar_list_model_new:
  *
@@ -1870,6 +2224,9 @@ thunar_list_model_set_folder (ThunarListModel *store,
       g_slist_free_full (store->hidden, g_object_unref);
       store->hidden = NULL;
 
+      /* stop counting the folders */
+      thunar_list_model_folder_size_reset (store);
+
       /* unregister signals and drop the reference */
       g_signal_handlers_disconnect_matched (G_OBJECT (store->folder), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, store);
       g_object_unref (G_OBJECT (store->folder));
@@ -2123,6 +2480,145 @@ thunar_list_model_set_file_size_binary (ThunarListModel *store,
 
 
 
+/**
+ * thunar_list_model_get_folder_sizes:
+ * @store : a valid #ThunarListModel object.
+ *
+ * Returns %TRUE if the total size of folders is shown.
+ *
+ * Return value: %TRUE if folder sizes are shown.
+ **/
+gboolean
+thunar_list_model_get_folder_sizes (ThunarListModel *store)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_LIST_MODEL (store), FALSE);
+  return store->folder_sizes;
+}
+
+
+
+/**
+ * thunar_list_model_set_folder_sizes:
+ * @store        : a valid #ThunarListModel object.
+ * @folder_sizes : %TRUE to show the total size of folders.
+ *
+ * If @folder_sizes is %TRUE, the folders passed to
+ * thunar_list_model_request_folder_sizes() are counted
+ * and their total size is shown in the size column.
+ **/
+static void
+thunar_list_model_set_folder_sizes (ThunarListModel *store,
+                                    gboolean         folder_sizes)
+{
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+
+  /* normalize the setting */
+  folder_sizes = !!folder_sizes;
+
+  /* check if we have a new setting */
+  if (store->folder_sizes != folder_sizes)
+    {
+      /* apply the new setting */
+      store->folder_sizes = folder_sizes;
+
+      /* stop counting and forget the sizes */
+      if (!folder_sizes)
+        thunar_list_model_folder_size_reset (store);
+
+      /* resort the model with the new setting */
+      if (store->sort_func == sort_by_size)
+        thunar_list_model_sort (store);
+
+      /* notify listeners */
+      g_object_notify_by_pspec (G_OBJECT (store), list_model_props[PROP_FOLDER_SIZES]);
+
+      /* emit a "changed" signal for each row, so the display is
+         reloaded with the new setting */
+      gtk_tree_model_foreach (GTK_TREE_MODEL (store),
+                              (GtkTreeModelForeachFunc) gtk_tree_model_row_changed,
+                              NULL);
+    }
+}
+
+
+
+/**
+ * thunar_list_model_request_folder_sizes:
+ * @store : a valid #ThunarListModel object.
+ * @files : the #ThunarFile<!---->s currently visible in the view.
+ *
+ * The folders in @files are counted from last to first, so the
+ * view passes them from the bottom up.
+ *
+ * Queues the folders in @files that were not counted since they
+ * last changed, so their total size is counted in the background,
+ * one folder at a time. Folders that were counted by an earlier
+ * deep count show that result until they are counted again.
+ *
+ * Only the most recently requested folders are kept in the queue,
+ * the others are requested again when they become visible again.
+ * Does nothing unless #ThunarListModel:folder-sizes is enabled.
+ **/
+void
+thunar_list_model_request_folder_sizes (ThunarListModel *store,
+                                        GList           *files)
+{
+  ThunarListModelFolderSize *folder_size;
+  ThunarSizeCacheTotal       total;
+  ThunarFile                *file;
+  GList                     *lp;
+
+  _thunar_return_if_fail (THUNAR_IS_LIST_MODEL (store));
+
+  if (!store->folder_sizes)
+    return;
+
+  for (lp = files; lp != NULL; lp = lp->next)
+    {
+      file = THUNAR_FILE (lp->data);
+      if (!thunar_file_is_directory (file))
+        continue;
+
+      folder_size = g_hash_table_lookup (store->folder_size_table, file);
+      if (folder_size == NULL)
+        {
+          folder_size = g_slice_new0 (ThunarListModelFolderSize);
+          g_hash_table_insert (store->folder_size_table, g_object_ref (G_OBJECT (file)), folder_size);
+
+          /* show the result of an earlier count right away, this only
+           * looks at the memory and the queued count validates it */
+          if (thunar_file_is_local (file)
+              && thunar_size_cache_lookup_total (store->size_cache, thunar_file_get_file (file), &total))
+            {
+              folder_size->size = total.total_size;
+              folder_size->known = TRUE;
+              thunar_list_model_row_changed (store, file);
+            }
+        }
+
+      if (folder_size->valid || folder_size->queued)
+        continue;
+
+      /* the last file in @files ends up first in the queue */
+      folder_size->queued = TRUE;
+      g_queue_push_head (&store->folder_size_queue, g_object_ref (G_OBJECT (file)));
+    }
+
+  /* forget the folders requested longest ago */
+  while (g_queue_get_length (&store->folder_size_queue) > FOLDER_SIZE_MAX_QUEUED)
+    {
+      file = g_queue_pop_tail (&store->folder_size_queue);
+      folder_size = g_hash_table_lookup (store->folder_size_table, file);
+      if (folder_size != NULL)
+        folder_size->queued = FALSE;
+      g_object_unref (G_OBJECT (file));
+    }
+
+  thunar_list_model_folder_size_schedule (store);
+}
+
+
+
 /**
  * thunar_list_model_get_file:
  * @store : a #ThunarListModel.
@@ -53,6 +53,10 @@ gboolean         thunar_list_model_get_file_size_binary   (ThunarListModel  *sto
 void             thunar_list_model_set_file_size_binary   (ThunarListModel  *store,
                                                            gboolean          file_size_binary);
 
+gboolean         thunar_list_model_get_folder_sizes       (ThunarListModel  *store);
+void             thunar_list_model_request_folder_sizes   (ThunarListModel  *store,
+                                                           GList            *files);
+
 ThunarFile      *thunar_list_model_get_file               (ThunarListModel  *store,
                                                            GtkTreeIter      *iter);
 
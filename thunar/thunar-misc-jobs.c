@@ -47,6 +47,9 @@ _thunar_misc_jobs_load_templates (ThunarJob  *job,
   _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
   _thunar_return_val_if_fail (param_values != NULL && param_values->len == 1, FALSE);
 
+  /* nobody waits for the templates menu */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_METADATA);
+
   menu = g_value_get_object (&g_array_index (param_values, GValue, 0));
   g_object_set_data (G_OBJECT (job), "menu", menu);
 
@@ -75,12 +75,18 @@ enum
   PROP_MISC_VOLUME_MANAGEMENT,
   PROP_MISC_CASE_SENSITIVE,
   PROP_MISC_DATE_STYLE,
+  PROP_MISC_DEEP_COUNT_THREADS,
+  PROP_MISC_DELETE_THREADS,
+  PROP_MISC_EMPTY_TRASH_IN_BACKGROUND,
   PROP_EXEC_SHELL_SCRIPTS_BY_DEFAULT,
+  PROP_MISC_FOLDER_SIZES,
   PROP_MISC_FOLDERS_FIRST,
   PROP_MISC_FULL_PATH_IN_TITLE,
   PROP_MISC_HORIZONTAL_WHEEL_NAVIGATES,
+  PROP_MISC_ICON_CACHE_SIZE,
   PROP_MISC_IMAGE_SIZE_IN_STATUSBAR,
   PROP_MISC_MIDDLE_CLICK_IN_TAB,
+  PROP_MISC_PERMISSIONS_THREADS,
   PROP_MISC_RECURSIVE_PERMISSIONS,
   PROP_MISC_REMEMBER_GEOMETRY,
   PROP_MISC_SHOW_ABOUT_TEMPLATES,
@@ -90,6 +96,14 @@ enum
   PROP_MISC_TAB_CLOSE_MIDDLE_CLICK,
   PROP_MISC_TEXT_BESIDE_ICONS,
   PROP_MISC_THUMBNAIL_MODE,
+  PROP_MISC_THUMBNAILER_THREADS,
+  PROP_MISC_TRANSFER_CONCURRENCY_REMOTE,
+  PROP_MISC_TRANSFER_CONCURRENCY_ROTATIONAL,
+  PROP_MISC_TRANSFER_CONCURRENCY_SOLID_STATE,
+  PROP_MISC_TRANSFER_JOURNAL,
+  PROP_MISC_TRANSFER_LARGE_FILE_BUFFER_SIZE,
+  PROP_MISC_TRANSFER_LARGE_FILE_THRESHOLD,
+  PROP_MISC_TRANSFER_SYNC_MODE,
   PROP_MISC_FILE_SIZE_BINARY,
   PROP_SHORTCUTS_ICON_EMBLEMS,
   PROP_SHORTCUTS_ICON_SIZE,
@@ -492,6 +506,48 @@ thunar_preferences_class_init (ThunarPreferencesClass *klass)
                          THUNAR_DATE_STYLE_SIMPLE,
                          EXO_PARAM_READWRITE);
 
+  /**
+   * ThunarPreferences:misc-deep-count-threads:
+   *
+   * Number of local folders read in parallel when the size of a
+   * folder is computed. With %1 the folders are read one after
+   * another through GIO.
+   **/
+  preferences_props[PROP_MISC_DEEP_COUNT_THREADS] =
+      g_param_spec_uint ("misc-deep-count-threads",
+                         NULL,
+                         NULL,
+                         1u, 64u, 4u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-delete-threads:
+   *
+   * Number of threads used to delete the subfolders of a local
+   * folder in parallel. The default of %1 deletes one file after
+   * another, which is the fastest for rotational disks.
+   **/
+  preferences_props[PROP_MISC_DELETE_THREADS] =
+      g_param_spec_uint ("misc-delete-threads",
+                         NULL,
+                         NULL,
+                         1u, 64u, 1u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-empty-trash-in-background:
+   *
+   * Whether "Empty Trash" renames the contents of the local trash
+   * folders aside, so the Trash is empty at once, and deletes them
+   * in the background with a low priority.
+   **/
+  preferences_props[PROP_MISC_EMPTY_TRASH_IN_BACKGROUND] =
+      g_param_spec_boolean ("misc-empty-trash-in-background",
+                            NULL,
+                            NULL,
+                            TRUE,
+                            EXO_PARAM_READWRITE);
+
   /**
    * ThunarPreferences:misc-execute-shell-scripts-by-default:
    *
@@ -508,6 +564,19 @@ thunar_preferences_class_init (ThunarPreferencesClass *klass)
                             FALSE,
                             EXO_PARAM_READWRITE);
 
+  /**
+   * ThunarPreferences:misc-folder-sizes:
+   *
+   * Whether the details view shows the total size of folders,
+   * which are counted in the background while they are visible.
+   **/
+  preferences_props[PROP_MISC_FOLDER_SIZES] =
+      g_param_spec_boolean ("misc-folder-sizes",
+                            NULL,
+                            NULL,
+                            FALSE,
+                            EXO_PARAM_READWRITE);
+
   /**
    * ThunarPreferences:misc-folders-first:
    *
@@ -546,6 +615,19 @@ thunar_preferences_class_init (ThunarPreferencesClass *klass)
                             FALSE,
                             EXO_PARAM_READWRITE);
 
+  /**
+   * ThunarPreferences:misc-icon-cache-size:
+   *
+   * Memory budget in MiB for the icons and thumbnails kept in
+   * memory. The least recently used icons are dropped first.
+   **/
+  preferences_props[PROP_MISC_ICON_CACHE_SIZE] =
+      g_param_spec_uint ("misc-icon-cache-size",
+                         NULL,
+                         NULL,
+                         1u, 4096u, 64u,
+                         EXO_PARAM_READWRITE);
+
   /**
    * ThunarPreferences:misc-image-size-in-statusbar:
    *
@@ -572,6 +654,19 @@ thunar_preferences_class_init (ThunarPreferencesClass *klass)
                             FALSE,
                             EXO_PARAM_READWRITE);
 
+  /**
+   * ThunarPreferences:misc-permissions-threads:
+   *
+   * Number of folders walked in parallel when the permissions or
+   * ownership of local folders are changed recursively.
+   **/
+  preferences_props[PROP_MISC_PERMISSIONS_THREADS] =
+      g_param_spec_uint ("misc-permissions-threads",
+                         NULL,
+                         NULL,
+                         1u, 64u, 4u,
+                         EXO_PARAM_READWRITE);
+
   /**
    * ThunarPreferences:misc-recursive-permissions:
    *
@@ -693,6 +788,117 @@ thunar_preferences_class_init (ThunarPreferencesClass *klass)
                          THUNAR_THUMBNAIL_MODE_ONLY_LOCAL,
                          EXO_PARAM_READWRITE);
 
+  /**
+   * ThunarPreferences:misc-thumbnailer-threads:
+   *
+   * Number of threads of the built-in thumbnailer, which creates
+   * thumbnails for local images if no thumbnailer service handles
+   * them. A value of %0 disables the built-in thumbnailer.
+   **/
+  preferences_props[PROP_MISC_THUMBNAILER_THREADS] =
+      g_param_spec_uint ("misc-thumbnailer-threads",
+                         NULL,
+                         NULL,
+                         0u, 16u, 2u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-concurrency-remote:
+   *
+   * Number of transfers that may run at the same time on a single
+   * network share. Further transfers touching the share wait in the
+   * queue. A value of %0 disables the queue for remote shares.
+   **/
+  preferences_props[PROP_MISC_TRANSFER_CONCURRENCY_REMOTE] =
+      g_param_spec_uint ("misc-transfer-concurrency-remote",
+                         NULL,
+                         NULL,
+                         0u, 64u, 2u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-concurrency-rotational:
+   *
+   * Number of transfers that may run at the same time on a single
+   * rotational disk. Concurrent transfers make the disk seek between
+   * them, so by default they run one after another.
+   **/
+  preferences_props[PROP_MISC_TRANSFER_CONCURRENCY_ROTATIONAL] =
+      g_param_spec_uint ("misc-transfer-concurrency-rotational",
+                         NULL,
+                         NULL,
+                         0u, 64u, 1u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-concurrency-solid-state:
+   *
+   * Number of transfers that may run at the same time on a single
+   * solid state drive.
+   **/
+  preferences_props[PROP_MISC_TRANSFER_CONCURRENCY_SOLID_STATE] =
+      g_param_spec_uint ("misc-transfer-concurrency-solid-state",
+                         NULL,
+                         NULL,
+                         0u, 64u, 2u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-journal:
+   *
+   * Whether copy and move jobs keep a journal of their progress in the
+   * cache directory, so an interrupted transfer can be resumed later
+   * without copying the completed files again.
+   **/
+  preferences_props[PROP_MISC_TRANSFER_JOURNAL] =
+      g_param_spec_boolean ("misc-transfer-journal",
+                            NULL,
+                            NULL,
+                            FALSE,
+                            EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-large-file-buffer-size:
+   *
+   * Size of the copy buffer in KiB used for files above the
+   * "misc-transfer-large-file-threshold".
+   **/
+  preferences_props[PROP_MISC_TRANSFER_LARGE_FILE_BUFFER_SIZE] =
+      g_param_spec_uint ("misc-transfer-large-file-buffer-size",
+                         NULL,
+                         NULL,
+                         64u, 256u * 1024u, 4096u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-large-file-threshold:
+   *
+   * Local files of at least this size in MiB are copied with
+   * preallocation and without filling the page cache. A value
+   * of %0 always uses the default GIO copy.
+   **/
+  preferences_props[PROP_MISC_TRANSFER_LARGE_FILE_THRESHOLD] =
+      g_param_spec_uint ("misc-transfer-large-file-threshold",
+                         NULL,
+                         NULL,
+                         0u, G_MAXUINT, 128u,
+                         EXO_PARAM_READWRITE);
+
+  /**
+   * ThunarPreferences:misc-transfer-sync-mode:
+   *
+   * Whether copy jobs should skip files that are already present and
+   * unchanged at the destination, instead of asking to replace them.
+   * Useful to re-synchronize a folder with an earlier copy of it.
+   **/
+  preferences_props[PROP_MISC_TRANSFER_SYNC_MODE] =
+      g_param_spec_enum ("misc-transfer-sync-mode",
+                         NULL,
+                         NULL,
+                         THUNAR_TYPE_TRANSFER_SYNC_MODE,
+                         THUNAR_TRANSFER_SYNC_MODE_NEVER,
+                         EXO_PARAM_READWRITE);
+
   /**
    * ThunarPreferences:misc-file-size-binary:
    *
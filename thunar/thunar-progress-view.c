@@ -31,6 +31,7 @@
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-util.h>
 #include <thunar/thunar-transfer-job.h>
+#include <thunar/thunar-transfer-queue.h>
 #include <thunar/thunar-progress-view.h>
 
 
@@ -56,6 +57,9 @@ static void              thunar_progress_view_set_property (GObject            *
                                                             const GValue       *value,
                                                             GParamSpec         *pspec);
 static void              thunar_progress_view_cancel_job   (ThunarProgressView *view);
+static void              thunar_progress_view_run_now      (ThunarProgressView *view);
+static void              thunar_progress_view_move_up      (ThunarProgressView *view);
+static void              thunar_progress_view_move_down    (ThunarProgressView *view);
 static ThunarJobResponse thunar_progress_view_ask          (ThunarProgressView *view,
                                                             const gchar        *message,
                                                             ThunarJobResponse   choices,
@@ -75,6 +79,9 @@ static void              thunar_progress_view_info_message (ThunarProgressView *
 static void              thunar_progress_view_percent      (ThunarProgressView *view,
                                                             gdouble             percent,
                                                             ExoJob             *job);
+static void              thunar_progress_view_queued       (ThunarProgressView *view,
+                                                            gboolean            queued,
+                                                            ThunarJob          *job);
 static ThunarJob        *thunar_progress_view_get_job      (ThunarProgressView *view);
 static void              thunar_progress_view_set_job      (ThunarProgressView *view,
                                                             ThunarJob          *job);
@@ -95,6 +102,7 @@ struct _ThunarProgressView
   GtkWidget *progress_bar;
   GtkWidget *progress_label;
   GtkWidget *message_label;
+  GtkWidget *queue_box;
 
   gchar     *icon_name;
   gchar     *title;
@@ -225,6 +233,43 @@ thunar_progress_view_init (ThunarProgressView *view)
   gtk_box_pack_start (GTK_BOX (vbox3), view->progress_label, FALSE, TRUE, 0);
   gtk_widget_show (view->progress_label);
 
+  /* controls for transfers waiting in the queue, hidden until the job is queued */
+  view->queue_box = gtk_hbox_new (FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (hbox), view->queue_box, FALSE, TRUE, 0);
+
+  button = gtk_button_new ();
+  gtk_widget_set_tooltip_text (button, _("Move this transfer up in the queue"));
+  g_signal_connect_swapped (button, "clicked", G_CALLBACK (thunar_progress_view_move_up), view);
+  gtk_box_pack_start (GTK_BOX (view->queue_box), button, FALSE, TRUE, 0);
+  gtk_widget_set_can_focus (button, FALSE);
+  gtk_widget_show (button);
+
+  image = gtk_image_new_from_stock (GTK_STOCK_GO_UP, GTK_ICON_SIZE_BUTTON);
+  gtk_container_add (GTK_CONTAINER (button), image);
+  gtk_widget_show (image);
+
+  button = gtk_button_new ();
+  gtk_widget_set_tooltip_text (button, _("Move this transfer down in the queue"));
+  g_signal_connect_swapped (button, "clicked", G_CALLBACK (thunar_progress_view_move_down), view);
+  gtk_box_pack_start (GTK_BOX (view->queue_box), button, FALSE, TRUE, 0);
+  gtk_widget_set_can_focus (button, FALSE);
+  gtk_widget_show (button);
+
+  image = gtk_image_new_from_stock (GTK_STOCK_GO_DOWN, GTK_ICON_SIZE_BUTTON);
+  gtk_container_add (GTK_CONTAINER (button), image);
+  gtk_widget_show (image);
+
+  button = gtk_button_new ();
+  gtk_widget_set_tooltip_text (button, _("Start this transfer now"));
+  g_signal_connect_swapped (button, "clicked", G_CALLBACK (thunar_progress_view_run_now), view);
+  gtk_box_pack_start (GTK_BOX (view->queue_box), button, FALSE, TRUE, 0);
+  gtk_widget_set_can_focus (button, FALSE);
+  gtk_widget_show (button);
+
+  image = gtk_image_new_from_stock (GTK_STOCK_MEDIA_PLAY, GTK_ICON_SIZE_BUTTON);
+  gtk_container_add (GTK_CONTAINER (button), image);
+  gtk_widget_show (image);
+
   button = gtk_button_new ();
   g_signal_connect_swapped (button, "clicked", G_CALLBACK (thunar_progress_view_cancel_job), view);
   gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, TRUE, 0);
@@ -357,6 +402,51 @@ thunar_progress_view_cancel_job (ThunarProgressView *view)
 
 
 
+static void
+thunar_progress_view_run_now (ThunarProgressView *view)
+{
+  ThunarTransferQueue *queue;
+
+  _thunar_return_if_fail (THUNAR_IS_PROGRESS_VIEW (view));
+  _thunar_return_if_fail (THUNAR_IS_JOB (view->job));
+
+  queue = thunar_transfer_queue_get ();
+  thunar_transfer_queue_run_now (queue, view->job);
+  g_object_unref (queue);
+}
+
+
+
+static void
+thunar_progress_view_move_up (ThunarProgressView *view)
+{
+  ThunarTransferQueue *queue;
+
+  _thunar_return_if_fail (THUNAR_IS_PROGRESS_VIEW (view));
+  _thunar_return_if_fail (THUNAR_IS_JOB (view->job));
+
+  queue = thunar_transfer_queue_get ();
+  thunar_transfer_queue_move (queue, view->job, -1);
+  g_object_unref (queue);
+}
+
+
+
+static void
+thunar_progress_view_move_down (ThunarProgressView *view)
+{
+  ThunarTransferQueue *queue;
+
+  _thunar_return_if_fail (THUNAR_IS_PROGRESS_VIEW (view));
+  _thunar_return_if_fail (THUNAR_IS_JOB (view->job));
+
+  queue = thunar_transfer_queue_get ();
+  thunar_transfer_queue_move (queue, view->job, 1);
+  g_object_unref (queue);
+}
+
+
+
 static ThunarJobResponse
 thunar_progress_view_ask (ThunarProgressView *view,
                           const gchar        *message,
@@ -489,6 +579,25 @@ thunar_progress_view_percent (ThunarProgressView *view,
 
 
 
+static void
+thunar_progress_view_queued (ThunarProgressView *view,
+                             gboolean            queued,
+                             ThunarJob          *job)
+{
+  _thunar_return_if_fail (THUNAR_IS_PROGRESS_VIEW (view));
+  _thunar_return_if_fail (THUNAR_IS_JOB (job));
+  _thunar_return_if_fail (view->job == job);
+
+  gtk_widget_set_visible (view->queue_box, queued);
+
+  if (queued)
+    gtk_label_set_text (GTK_LABEL (view->progress_label), _("Queued"));
+  else
+    gtk_label_set_text (GTK_LABEL (view->progress_label), "");
+}
+
+
+
 /**
  * thunar_progress_view_new_with_job:
  * @job : a #ThunarJob or %NULL.
@@ -563,6 +672,9 @@ thunar_progress_view_set_job (ThunarProgressView *view,
       g_signal_connect_swapped (job, "finished", G_CALLBACK (thunar_progress_view_finished), view);
       g_signal_connect_swapped (job, "info-message", G_CALLBACK (thunar_progress_view_info_message), view);
       g_signal_connect_swapped (job, "percent", G_CALLBACK (thunar_progress_view_percent), view);
+
+      if (THUNAR_IS_TRANSFER_JOB (job))
+        g_signal_connect_swapped (job, "queued", G_CALLBACK (thunar_progress_view_queued), view);
     }
 
   g_object_notify (G_OBJECT (view), "job");
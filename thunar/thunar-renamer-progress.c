@@ -21,24 +21,24 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-renamer-progress.h>
+#include <thunar/thunar-simple-job.h>
 
 
 
-/* Signal identifiers */
-enum
-{
-  FINISHED,
-  LAST_SIGNAL,
-};
+/* number of renamed files after which the views are notified */
+#define RENAME_BATCH_SIZE (64)
 
 
 
-static void     thunar_renamer_progress_finalize          (GObject                    *object);
-static void     thunar_renamer_progress_destroy           (GtkObject                  *object);
-static gboolean thunar_renamer_progress_next_idle         (gpointer                    user_data);
-static void     thunar_renamer_progress_next_idle_destroy (gpointer                    user_data);
+static void     thunar_renamer_progress_finalize (GObject                    *object);
+static void     thunar_renamer_progress_destroy  (GtkObject                  *object);
+static void     thunar_renamer_progress_launch   (ThunarRenamerProgress      *renamer_progress);
 
 
 
@@ -53,14 +53,29 @@ struct _ThunarRenamerProgress
   GtkWidget   *bar;
 
   GList       *pairs_done;
-  guint        n_pairs_done;
   GList       *pairs_todo;
-  guint        n_pairs_todo;
   gboolean     pairs_undo;  /* whether we're undoing previous changes */
 
-  /* internal main loop for the _rename() method */
-  guint        next_idle_id;
-  GMainLoop   *next_idle_loop;
+  /* files that were moved to a temporary name to break
+   * a rename cycle, mapped to their original names */
+  GHashTable  *original_names;
+
+  /* the progress of the current pass */
+  guint        n_pairs_processed;
+  guint        n_pairs_total;
+
+  /* the job that renames the files in the background */
+  ThunarJob   *job;
+  GError      *job_error;
+  gboolean     cancelled;
+  gboolean     restoring;
+
+  /* set once the widget is destroyed, the files that
+   * are left with a temporary name are restored silently */
+  gboolean     destroyed;
+
+  /* internal main loop for the _run() method */
+  GMainLoop   *loop;
 };
 
 
@@ -89,7 +104,10 @@ thunar_renamer_progress_init (ThunarRenamerProgress *renamer_progress)
 {
   gtk_alignment_set (GTK_ALIGNMENT (renamer_progress), 0.5f, 0.5f, 1.0f, 0.0f);
 
-  renamer_progress->bar = gtk_progress_bar_new ();
+  renamer_progress->original_names = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, g_free);
+
+  /* the bar outlives its destruction while files are restored */
+  renamer_progress->bar = g_object_ref_sink (gtk_progress_bar_new ());
   gtk_container_add (GTK_CONTAINER (renamer_progress), renamer_progress->bar);
   gtk_widget_show (renamer_progress->bar);
 }
@@ -102,13 +120,17 @@ thunar_renamer_progress_finalize (GObject *object)
   ThunarRenamerProgress *renamer_progress = THUNAR_RENAMER_PROGRESS (object);
 
   /* make sure we're not finalized while the main loop is active */
-  _thunar_assert (renamer_progress->next_idle_id == 0);
-  _thunar_assert (renamer_progress->next_idle_loop == NULL);
+  _thunar_assert (renamer_progress->job == NULL);
+  _thunar_assert (renamer_progress->loop == NULL);
 
   /* release the pairs */
   thunar_renamer_pair_list_free (renamer_progress->pairs_done);
   thunar_renamer_pair_list_free (renamer_progress->pairs_todo);
 
+  g_hash_table_destroy (renamer_progress->original_names);
+
+  g_object_unref (renamer_progress->bar);
+
   (*G_OBJECT_CLASS (thunar_renamer_progress_parent_class)->finalize) (object);
 }
 
@@ -119,7 +141,8 @@ thunar_renamer_progress_destroy (GtkObject *object)
 {
   ThunarRenamerProgress *renamer_progress = THUNAR_RENAMER_PROGRESS (object);
 
-  /* exit the internal main loop on destroy */
+  /* stop the rename operation on destroy */
+  renamer_progress->destroyed = TRUE;
   thunar_renamer_progress_cancel (renamer_progress);
 
   (*GTK_OBJECT_CLASS (thunar_renamer_progress_parent_class)->destroy) (object);
@@ -128,125 +151,183 @@ thunar_renamer_progress_destroy (GtkObject *object)
 
 
 static gboolean
-thunar_renamer_progress_next_idle (gpointer user_data)
+thunar_renamer_progress_is_desktop_file (ThunarFile *file)
 {
-  ThunarRenamerProgress *renamer_progress = THUNAR_RENAMER_PROGRESS (user_data);
-  ThunarRenamerPair     *pair;
-  GtkWindow             *toplevel;
-  GtkWidget             *message;
-  GError                *error = NULL;
-  gchar                 *oldname;
-  gchar                  text[128];
-  gint                   response;
-  guint                  n_done;
-  guint                  n_total;
-  GList                 *first;
+  gboolean is_secure;
+
+  /* thunar_file_rename() changes the Name of trusted launchers
+   * instead of the file name, so they take no part in cycles */
+  return thunar_file_is_desktop_file (file, &is_secure) && is_secure;
+}
 
-  GDK_THREADS_ENTER ();
 
-  /* check if we have still pairs to go */
-  if (G_LIKELY (renamer_progress->pairs_todo != NULL))
+
+static gboolean
+thunar_renamer_progress_notify (gpointer user_data)
+{
+  GList *lp;
+
+  /* emit the file changed signal for the renamed files */
+  for (lp = user_data; lp != NULL; lp = lp->next)
+    thunar_file_changed (lp->data);
+
+  return FALSE;
+}
+
+
+
+static void
+thunar_renamer_progress_flush (ThunarJob  *job,
+                               GList     **renamed_files)
+{
+  if (*renamed_files == NULL)
+    return;
+
+  /* let the views pick up the new names */
+  exo_job_send_to_mainloop (EXO_JOB (job), thunar_renamer_progress_notify,
+                            *renamed_files, (GDestroyNotify) thunarx_file_info_list_free);
+  *renamed_files = NULL;
+}
+
+
+
+static gboolean
+thunar_renamer_progress_move_aside (ThunarRenamerProgress *renamer_progress,
+                                    ThunarRenamerPair     *pair,
+                                    GCancellable          *cancellable,
+                                    GError               **error)
+{
+  GError *err = NULL;
+  gchar  *original_name;
+  gchar  *temp_name;
+  guint   n;
+
+  original_name = g_strdup (thunar_file_get_display_name (pair->file));
+
+  /* try a few random names, in case one is already taken */
+  for (n = 0; n < 10; ++n)
     {
-      /* pop the first pair from the todo list */
-      first = g_list_first (renamer_progress->pairs_todo);
-      pair = first->data;
-      renamer_progress->pairs_todo = g_list_delete_link (renamer_progress->pairs_todo, first);
+      temp_name = g_strdup_printf (".thunar-rename-%08x", g_random_int ());
+      if (thunar_file_rename (pair->file, temp_name, cancellable, TRUE, &err))
+        {
+          /* remember the name to restore on cancel or revert */
+          g_hash_table_insert (renamer_progress->original_names, g_object_ref (pair->file), original_name);
+          g_free (temp_name);
+          return TRUE;
+        }
+      g_free (temp_name);
+
+      if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_EXISTS))
+        break;
+      g_clear_error (&err);
+    }
+
+  g_propagate_error (error, err);
+  g_free (original_name);
+  return FALSE;
+}
+
 
-      /* update item count */
-      renamer_progress->n_pairs_todo--;
-      _thunar_assert (g_list_length (renamer_progress->pairs_todo) == renamer_progress->n_pairs_todo);
 
-      /* determine the done/todo items */
-      n_done = renamer_progress->n_pairs_done + 1;
-      n_total = n_done + renamer_progress->n_pairs_todo;
+static gboolean
+thunar_renamer_progress_execute (ThunarJob *job,
+                                 GArray    *param_values,
+                                 GError   **error)
+{
+  ThunarRenamerProgress *renamer_progress;
+  ThunarRenamerPair     *pair;
+  GCancellable          *cancellable;
+  GHashTable            *targets;
+  GError                *err = NULL;
+  GFile                 *parent;
+  GFile                 *target;
+  GList                 *renamed_files = NULL;
+  GList                 *lp;
+  gchar                 *oldname;
+  guint                  n_renamed = 0;
 
-      /* update the progress bar text */
-      g_snprintf (text, sizeof (text), "%d/%d", n_done, n_total);
-      gtk_progress_bar_set_text (GTK_PROGRESS_BAR (renamer_progress->bar), text);
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (param_values != NULL && param_values->len == 1, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-      /* update the progress bar fraction */
-      gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (renamer_progress->bar), CLAMP ((gdouble) n_done / MAX (n_total, 1), 0.0, 1.0));
+  /* a bulk rename must not hold back the listings and metadata jobs */
+  thunar_job_set_priority (job, THUNAR_JOB_PRIORITY_TRANSFER);
 
-      /* remember the old file name (for undo) */
-      oldname = g_strdup (thunar_file_get_display_name (pair->file));
+  /* the main thread leaves the pairs alone until the job is finished */
+  renamer_progress = g_value_get_pointer (&g_array_index (param_values, GValue, 0));
+  cancellable = exo_job_get_cancellable (EXO_JOB (job));
 
-      /* try to rename the file */
-      if (!thunar_file_rename (pair->file, pair->name, NULL, FALSE, &error))
+  /* collect the names the files will get */
+  targets = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal, g_object_unref, NULL);
+  for (lp = renamer_progress->pairs_todo; lp != NULL; lp = lp->next)
+    {
+      pair = lp->data;
+      if (thunar_renamer_progress_is_desktop_file (pair->file))
+        continue;
+
+      parent = g_file_get_parent (thunar_file_get_file (pair->file));
+      if (G_UNLIKELY (parent == NULL))
+        continue;
+
+      target = g_file_get_child_for_display_name (parent, pair->name, NULL);
+      if (target != NULL && !g_file_equal (target, thunar_file_get_file (pair->file)))
+        g_hash_table_insert (targets, target, pair);
+      else if (target != NULL)
+        g_object_unref (target);
+      g_object_unref (parent);
+    }
+
+  /* first move the files that are in the way of another
+   * rename to a temporary name, which resolves cycles like
+   * A -> B, B -> A and chains like A -> B, B -> C alike */
+  for (lp = renamer_progress->pairs_todo; err == NULL && lp != NULL; lp = lp->next)
+    {
+      pair = lp->data;
+      if (g_hash_table_lookup (targets, thunar_file_get_file (pair->file)) == NULL
+          || thunar_renamer_progress_is_desktop_file (pair->file))
+        continue;
+
+      if (!exo_job_set_error_if_cancelled (EXO_JOB (job), &err))
+        thunar_renamer_progress_move_aside (renamer_progress, pair, cancellable, &err);
+
+      /* move the failed pair to the front */
+      if (err != NULL)
         {
-          /* determine the toplevel widget */
-          toplevel = (GtkWindow *) gtk_widget_get_toplevel (GTK_WIDGET (renamer_progress));
-
-          /* tell the user that we failed */
-          message = gtk_message_dialog_new (toplevel,
-                                            GTK_DIALOG_DESTROY_WITH_PARENT
-                                            | GTK_DIALOG_MODAL,
-                                            GTK_MESSAGE_ERROR,
-                                            GTK_BUTTONS_NONE,
-                                            _("Failed to rename \"%s\" to \"%s\"."),
-                                            oldname, pair->name);
-
-          /* check if we should provide undo */
-          if (!renamer_progress->pairs_undo && renamer_progress->pairs_done != NULL)
-            {
-              gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
-                                                        _("You can either choose to skip this file and continue to rename the "
-                                                          "remaining files, or revert the previously renamed files to their "
-                                                          "previous names, or cancel the operation without reverting previous "
-                                                          "changes."));
-              gtk_dialog_add_button (GTK_DIALOG (message), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Revert Changes"), GTK_RESPONSE_REJECT);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Skip This File"), GTK_RESPONSE_ACCEPT);
-              gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_ACCEPT);
-            }
-          else if (renamer_progress->pairs_todo != NULL)
-            {
-              gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
-                                                        _("Do you want to skip this file and continue to rename the "
-                                                          "remaining files?"));
-              gtk_dialog_add_button (GTK_DIALOG (message), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Skip This File"), GTK_RESPONSE_ACCEPT);
-              gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_ACCEPT);
-            }
-          else
-            {
-              gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message), "%s.", error->message);
-              gtk_dialog_add_button (GTK_DIALOG (message), GTK_STOCK_CLOSE, GTK_RESPONSE_CANCEL);
-            }
-
-          /* run the dialog */
-          response = gtk_dialog_run (GTK_DIALOG (message));
-          if (response == GTK_RESPONSE_REJECT)
-            {
-              /* undo previous changes */
-              renamer_progress->pairs_undo = TRUE;
-
-              /* release the todo pairs and use the done as todo */
-              thunar_renamer_pair_list_free (renamer_progress->pairs_todo);
-              renamer_progress->pairs_todo = renamer_progress->pairs_done;
-              renamer_progress->pairs_done = NULL;
-
-              renamer_progress->n_pairs_done = 0;
-              renamer_progress->n_pairs_todo = g_list_length (renamer_progress->pairs_todo);
-            }
-          else if (response != GTK_RESPONSE_ACCEPT)
-            {
-              /* canceled, just exit the main loop */
-              g_main_loop_quit (renamer_progress->next_idle_loop);
-            }
-
-          /* release the pair */
-          thunar_renamer_pair_free (pair);
+          renamer_progress->pairs_todo = g_list_remove_link (renamer_progress->pairs_todo, lp);
+          renamer_progress->pairs_todo = g_list_concat (lp, renamer_progress->pairs_todo);
+        }
+    }
+
+  g_hash_table_destroy (targets);
 
-          /* destroy the dialog */
-          gtk_widget_destroy (message);
+  /* then give all files their new names */
+  while (err == NULL && renamer_progress->pairs_todo != NULL)
+    {
+      if (exo_job_set_error_if_cancelled (EXO_JOB (job), &err))
+        break;
+
+      pair = renamer_progress->pairs_todo->data;
 
-          /* clear the error */
-          g_clear_error (&error);
+      /* the name before the rename, for undo */
+      if (!g_hash_table_lookup_extended (renamer_progress->original_names, pair->file, NULL, (gpointer *) &oldname))
+        oldname = (gchar *) thunar_file_get_display_name (pair->file);
+      oldname = g_strdup (oldname);
 
-          /* release old name */
+      if (!thunar_file_rename (pair->file, pair->name, cancellable, TRUE, &err))
+        {
+          /* leave the pair on the todo list for the error dialog */
           g_free (oldname);
+          break;
         }
-      else
+
+      renamer_progress->pairs_todo = g_list_delete_link (renamer_progress->pairs_todo, renamer_progress->pairs_todo);
+      g_hash_table_remove (renamer_progress->original_names, pair->file);
+
+      renamed_files = g_list_prepend (renamed_files, g_object_ref (pair->file));
+      if (++n_renamed % RENAME_BATCH_SIZE == 0)
+        thunar_renamer_progress_flush (job, &renamed_files);
+
+      if (G_LIKELY (strcmp (oldname, pair->name) != 0))
         {
           /* replace the newname with the oldname for the pair (-> undo) */
           g_free (pair->name);
@@ -254,29 +335,289 @@ thunar_renamer_progress_next_idle (gpointer user_data)
 
           /* move the pair to the list of completed pairs */
           renamer_progress->pairs_done = g_list_prepend (renamer_progress->pairs_done, pair);
-
-          /* update counter */
-          renamer_progress->n_pairs_done++;
-          _thunar_assert (g_list_length (renamer_progress->pairs_done) == renamer_progress->n_pairs_done);
         }
+      else
+        {
+          /* restored to its original name, nothing to undo */
+          thunar_renamer_pair_free (pair);
+          g_free (oldname);
+        }
+
+      renamer_progress->n_pairs_processed++;
+      thunar_job_progress (job, NULL, renamer_progress->n_pairs_processed, renamer_progress->n_pairs_total, 0, 0);
+    }
+
+  thunar_renamer_progress_flush (job, &renamed_files);
+
+  if (err != NULL)
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+thunar_renamer_progress_update (ThunarRenamerProgress *renamer_progress)
+{
+  gchar text[128];
+
+  /* update the progress bar text */
+  g_snprintf (text, sizeof (text), "%d/%d", renamer_progress->n_pairs_processed, renamer_progress->n_pairs_total);
+  gtk_progress_bar_set_text (GTK_PROGRESS_BAR (renamer_progress->bar), text);
+
+  /* update the progress bar fraction */
+  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (renamer_progress->bar),
+                                 CLAMP ((gdouble) renamer_progress->n_pairs_processed / MAX (renamer_progress->n_pairs_total, 1), 0.0, 1.0));
+}
+
+
+
+static void
+thunar_renamer_progress_percent (ExoJob                *job,
+                                 gdouble                percent,
+                                 ThunarRenamerProgress *renamer_progress)
+{
+  guint n_done;
+  gchar text[128];
+
+  _thunar_return_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress));
+  _thunar_return_if_fail (renamer_progress->job == THUNAR_JOB (job));
+
+  /* the counter itself belongs to the job thread */
+  n_done = (percent * renamer_progress->n_pairs_total / 100.0) + 0.5;
+
+  g_snprintf (text, sizeof (text), "%d/%d", n_done, renamer_progress->n_pairs_total);
+  gtk_progress_bar_set_text (GTK_PROGRESS_BAR (renamer_progress->bar), text);
+  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (renamer_progress->bar), CLAMP (percent / 100.0, 0.0, 1.0));
+}
+
+
+
+static void
+thunar_renamer_progress_error (ExoJob                *job,
+                               const GError          *error,
+                               ThunarRenamerProgress *renamer_progress)
+{
+  _thunar_return_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress));
+  _thunar_return_if_fail (renamer_progress->job == THUNAR_JOB (job));
+
+  /* handled once the job is finished */
+  g_clear_error (&renamer_progress->job_error);
+  renamer_progress->job_error = g_error_copy (error);
+}
+
+
+
+static GList *
+thunar_renamer_progress_take_restores (ThunarRenamerProgress *renamer_progress)
+{
+  ThunarRenamerPair *pair;
+  const gchar       *original_name;
+  GList             *restores = NULL;
+  GList             *lp;
+
+  /* turn the pairs with a temporary name into pairs back to the
+   * original name, and drop the pairs that weren't touched yet */
+  for (lp = renamer_progress->pairs_todo; lp != NULL; lp = lp->next)
+    {
+      pair = lp->data;
+      original_name = g_hash_table_lookup (renamer_progress->original_names, pair->file);
+      if (original_name != NULL)
+        restores = g_list_prepend (restores, thunar_renamer_pair_new (pair->file, original_name));
     }
 
-  /* be sure to cancel the internal loop once we're done */
+  thunar_renamer_pair_list_free (renamer_progress->pairs_todo);
+  renamer_progress->pairs_todo = NULL;
+
+  return restores;
+}
+
+
+
+static gboolean
+thunar_renamer_progress_failed (ThunarRenamerProgress *renamer_progress)
+{
+  ThunarRenamerPair *pair;
+  const gchar       *original_name;
+  GtkWindow         *toplevel;
+  GtkWidget         *message;
+  gchar             *oldname;
+  gint               response;
+
   if (G_UNLIKELY (renamer_progress->pairs_todo == NULL))
-    g_main_loop_quit (renamer_progress->next_idle_loop);
+    return FALSE;
+
+  /* the failed pair is the first one on the todo list */
+  pair = renamer_progress->pairs_todo->data;
+  renamer_progress->pairs_todo = g_list_delete_link (renamer_progress->pairs_todo, renamer_progress->pairs_todo);
+
+  /* the file may have been moved to a temporary name */
+  original_name = g_hash_table_lookup (renamer_progress->original_names, pair->file);
+  if (G_LIKELY (original_name == NULL))
+    oldname = g_strdup (thunar_file_get_display_name (pair->file));
+  else
+    oldname = g_strdup (original_name);
+
+  /* without a window to show the dialog, skip the files that can't be
+   * restored and give up on everything else */
+  if (G_UNLIKELY (renamer_progress->destroyed))
+    {
+      response = renamer_progress->restoring ? GTK_RESPONSE_ACCEPT : GTK_RESPONSE_CANCEL;
+      message = NULL;
+      goto done;
+    }
+
+  /* determine the toplevel widget */
+  toplevel = (GtkWindow *) gtk_widget_get_toplevel (GTK_WIDGET (renamer_progress));
+
+  /* tell the user that we failed */
+  message = gtk_message_dialog_new (toplevel,
+                                    GTK_DIALOG_DESTROY_WITH_PARENT
+                                    | GTK_DIALOG_MODAL,
+                                    GTK_MESSAGE_ERROR,
+                                    GTK_BUTTONS_NONE,
+                                    _("Failed to rename \"%s\" to \"%s\"."),
+                                    oldname, pair->name);
+
+  /* check if we should provide undo */
+  if (!renamer_progress->pairs_undo && renamer_progress->pairs_done != NULL)
+    {
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
+                                                _("You can either choose to skip this file and continue to rename the "
+                                                  "remaining files, or revert the previously renamed files to their "
+                                                  "previous names, or cancel the operation without reverting previous "
+                                                  "changes."));
+      gtk_dialog_add_button (GTK_DIALOG (message), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
+      gtk_dialog_add_button (GTK_DIALOG (message), _("_Revert Changes"), GTK_RESPONSE_REJECT);
+      gtk_dialog_add_button (GTK_DIALOG (message), _("_Skip This File"), GTK_RESPONSE_ACCEPT);
+      gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_ACCEPT);
+    }
+  else if (renamer_progress->pairs_todo != NULL)
+    {
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
+                                                _("Do you want to skip this file and continue to rename the "
+                                                  "remaining files?"));
+      gtk_dialog_add_button (GTK_DIALOG (message), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
+      gtk_dialog_add_button (GTK_DIALOG (message), _("_Skip This File"), GTK_RESPONSE_ACCEPT);
+      gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_ACCEPT);
+    }
+  else
+    {
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message), "%s.", renamer_progress->job_error->message);
+      gtk_dialog_add_button (GTK_DIALOG (message), GTK_STOCK_CLOSE, GTK_RESPONSE_CANCEL);
+    }
+
+  /* run the dialog */
+  response = gtk_dialog_run (GTK_DIALOG (message));
 
-  GDK_THREADS_LEAVE ();
+done:
+  /* whatever happens next, don't leave the file with a temporary name */
+  if (original_name != NULL && strcmp (original_name, pair->name) != 0)
+    {
+      renamer_progress->pairs_todo = g_list_prepend (renamer_progress->pairs_todo, thunar_renamer_pair_new (pair->file, original_name));
+      renamer_progress->n_pairs_total++;
+    }
+
+  if (response == GTK_RESPONSE_REJECT)
+    {
+      /* undo previous changes */
+      renamer_progress->pairs_undo = TRUE;
+
+      /* put the files with a temporary name back first */
+      renamer_progress->pairs_todo = g_list_concat (thunar_renamer_progress_take_restores (renamer_progress),
+                                                    renamer_progress->pairs_done);
+      renamer_progress->pairs_done = NULL;
+
+      renamer_progress->n_pairs_processed = 0;
+      renamer_progress->n_pairs_total = g_list_length (renamer_progress->pairs_todo);
+    }
+  else if (response == GTK_RESPONSE_ACCEPT)
+    {
+      /* skip this file */
+      renamer_progress->n_pairs_processed++;
+    }
+  else
+    {
+      /* canceled, without reverting previous changes */
+      renamer_progress->cancelled = TRUE;
+    }
+
+  /* release the pair */
+  thunar_renamer_pair_free (pair);
+  g_free (oldname);
+
+  /* destroy the dialog */
+  if (G_LIKELY (message != NULL))
+    gtk_widget_destroy (message);
+
+  return (response == GTK_RESPONSE_REJECT || response == GTK_RESPONSE_ACCEPT);
+}
+
+
+
+static void
+thunar_renamer_progress_finished (ExoJob                *job,
+                                  ThunarRenamerProgress *renamer_progress)
+{
+  _thunar_return_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress));
+  _thunar_return_if_fail (renamer_progress->job == THUNAR_JOB (job));
+
+  /* disconnect from the job */
+  g_signal_handlers_disconnect_matched (G_OBJECT (renamer_progress->job), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, renamer_progress);
+  g_object_unref (G_OBJECT (renamer_progress->job));
+  renamer_progress->job = NULL;
 
-  /* keep the idle source alive as long as we have anything to do */
-  return (renamer_progress->pairs_todo != NULL);
+  thunar_renamer_progress_update (renamer_progress);
+
+  /* ask the user how to continue after a failed rename */
+  if (renamer_progress->job_error != NULL
+      && (renamer_progress->restoring || !renamer_progress->cancelled))
+    {
+      if (!thunar_renamer_progress_failed (renamer_progress)
+          && renamer_progress->restoring)
+        {
+          /* the user gave up restoring as well */
+          thunar_renamer_pair_list_free (renamer_progress->pairs_todo);
+          renamer_progress->pairs_todo = NULL;
+        }
+    }
+  g_clear_error (&renamer_progress->job_error);
+
+  /* never leave files behind with a temporary name */
+  if (renamer_progress->cancelled && !renamer_progress->restoring)
+    {
+      renamer_progress->restoring = TRUE;
+      renamer_progress->pairs_undo = TRUE;
+      renamer_progress->pairs_todo = thunar_renamer_progress_take_restores (renamer_progress);
+      renamer_progress->n_pairs_processed = 0;
+      renamer_progress->n_pairs_total = g_list_length (renamer_progress->pairs_todo);
+    }
+
+  /* continue with the remaining files or leave the internal loop */
+  if (renamer_progress->pairs_todo != NULL)
+    thunar_renamer_progress_launch (renamer_progress);
+  else
+    g_main_loop_quit (renamer_progress->loop);
 }
 
 
 
 static void
-thunar_renamer_progress_next_idle_destroy (gpointer user_data)
+thunar_renamer_progress_launch (ThunarRenamerProgress *renamer_progress)
 {
-  THUNAR_RENAMER_PROGRESS (user_data)->next_idle_id = 0;
+  _thunar_return_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress));
+  _thunar_return_if_fail (renamer_progress->job == NULL);
+
+  renamer_progress->job = thunar_simple_job_launch (thunar_renamer_progress_execute, 1,
+                                                    G_TYPE_POINTER, renamer_progress);
+
+  g_signal_connect (G_OBJECT (renamer_progress->job), "error", G_CALLBACK (thunar_renamer_progress_error), renamer_progress);
+  g_signal_connect (G_OBJECT (renamer_progress->job), "finished", G_CALLBACK (thunar_renamer_progress_finished), renamer_progress);
+  g_signal_connect (G_OBJECT (renamer_progress->job), "percent", G_CALLBACK (thunar_renamer_progress_percent), renamer_progress);
 }
 
 
@@ -300,16 +641,21 @@ thunar_renamer_progress_new (void)
  * thunar_renamer_progress_cancel:
  * @renamer_progress : a #ThunarRenamerProgress.
  *
- * Cancels any pending rename operation for @renamer_progress.
+ * Cancels any pending rename operation for @renamer_progress. Files
+ * that were moved to a temporary name get their original name back
+ * before thunar_renamer_progress_run() returns.
  **/
 void
 thunar_renamer_progress_cancel (ThunarRenamerProgress *renamer_progress)
 {
   _thunar_return_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress));
 
-  /* exit the internal main loop (if any) */
-  if (G_UNLIKELY (renamer_progress->next_idle_loop != NULL))
-    g_main_loop_quit (renamer_progress->next_idle_loop);
+  /* stop the job, the internal loop exits once it is finished */
+  if (G_UNLIKELY (renamer_progress->job != NULL && !renamer_progress->restoring))
+    {
+      renamer_progress->cancelled = TRUE;
+      exo_job_cancel (EXO_JOB (renamer_progress->job));
+    }
 }
 
 
@@ -326,7 +672,7 @@ gboolean
 thunar_renamer_progress_running (ThunarRenamerProgress *renamer_progress)
 {
   _thunar_return_val_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress), FALSE);
-  return (renamer_progress->next_idle_loop != NULL);
+  return (renamer_progress->loop != NULL);
 }
 
 
@@ -339,6 +685,10 @@ thunar_renamer_progress_running (ThunarRenamerProgress *renamer_progress)
  * Renames all #ThunarRenamePair<!---->s in the specified @pair_list
  * using the @renamer_progress.
  *
+ * The files are renamed by a #ThunarJob. Files that are in the way
+ * of another rename are moved to a temporary name first, so the
+ * @pair_list may swap names or rename files in a cycle.
+ *
  * This method starts a new main loop, and returns only after the
  * rename operation is done (or cancelled by a "destroy" signal).
  **/
@@ -349,8 +699,8 @@ thunar_renamer_progress_run (ThunarRenamerProgress *renamer_progress,
   _thunar_return_if_fail (THUNAR_IS_RENAMER_PROGRESS (renamer_progress));
 
   /* make sure we're not already renaming */
-  if (G_UNLIKELY (renamer_progress->next_idle_id != 0
-      || renamer_progress->next_idle_loop != NULL))
+  if (G_UNLIKELY (renamer_progress->job != NULL
+      || renamer_progress->loop != NULL))
     return;
 
   /* take an additional reference on the progress */
@@ -363,21 +713,26 @@ thunar_renamer_progress_run (ThunarRenamerProgress *renamer_progress,
   /* set the pairs on the todo list */
   thunar_renamer_pair_list_free (renamer_progress->pairs_todo);
   renamer_progress->pairs_todo = thunar_renamer_pair_list_copy (pairs);
-  renamer_progress->n_pairs_todo = g_list_length (renamer_progress->pairs_todo);
-
-  /* schedule the idle source */
-  renamer_progress->next_idle_id = g_idle_add_full (G_PRIORITY_LOW, thunar_renamer_progress_next_idle,
-                                                    renamer_progress, thunar_renamer_progress_next_idle_destroy);
+  renamer_progress->pairs_undo = FALSE;
+  renamer_progress->cancelled = FALSE;
+  renamer_progress->restoring = FALSE;
+  g_hash_table_remove_all (renamer_progress->original_names);
 
-  /* run the inner main loop */
-  renamer_progress->next_idle_loop = g_main_loop_new (NULL, FALSE);
-  g_main_loop_run (renamer_progress->next_idle_loop);
-  g_main_loop_unref (renamer_progress->next_idle_loop);
-  renamer_progress->next_idle_loop = NULL;
+  renamer_progress->n_pairs_processed = 0;
+  renamer_progress->n_pairs_total = g_list_length (renamer_progress->pairs_todo);
+  thunar_renamer_progress_update (renamer_progress);
 
-  /* be sure to cancel any pending idle source */
-  if (G_UNLIKELY (renamer_progress->next_idle_id != 0))
-    g_source_remove (renamer_progress->next_idle_id);
+  if (G_LIKELY (renamer_progress->pairs_todo != NULL))
+    {
+      /* start renaming in the background */
+      thunar_renamer_progress_launch (renamer_progress);
+
+      /* run the inner main loop */
+      renamer_progress->loop = g_main_loop_new (NULL, FALSE);
+      g_main_loop_run (renamer_progress->loop);
+      g_main_loop_unref (renamer_progress->loop);
+      renamer_progress->loop = NULL;
+    }
 
   /* release the list of completed items */
   thunar_renamer_pair_list_free (renamer_progress->pairs_done);
@@ -387,8 +742,8 @@ thunar_renamer_progress_run (ThunarRenamerProgress *renamer_progress,
   thunar_renamer_pair_list_free (renamer_progress->pairs_todo);
   renamer_progress->pairs_todo = NULL;
 
+  g_hash_table_remove_all (renamer_progress->original_names);
+
   /* release the additional reference on the progress */
   g_object_unref (G_OBJECT (renamer_progress));
 }
-
-
@@ -69,14 +69,14 @@ G_DEFINE_TYPE (ThunarSimpleJob, thunar_simple_job, THUNAR_TYPE_JOB)
 static void
 thunar_simple_job_class_init (ThunarSimpleJobClass *klass)
 {
-  GObjectClass *gobject_class;
-  ExoJobClass  *exojob_class;
+  GObjectClass   *gobject_class;
+  ThunarJobClass *thunarjob_class;
 
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->finalize = thunar_simple_job_finalize;
 
-  exojob_class = EXO_JOB_CLASS (klass);
-  exojob_class->execute = thunar_simple_job_execute;
+  thunarjob_class = THUNAR_JOB_CLASS (klass);
+  thunarjob_class->execute = thunar_simple_job_execute;
 }
 
 
@@ -0,0 +1,997 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The cache remembers the direct contents of every folder a deep count
+ * has read, keyed by device and inode and validated by the modification
+ * time of the folder. As the modification time of a folder changes
+ * whenever an entry is added, removed or renamed, a later deep count
+ * only has to stat the folders of an unchanged tree instead of every
+ * file in it. Files that were rewritten in place without touching
+ * their folder are not noticed until the folder changes.
+ *
+ * The cache also keeps the last result of deep counts of single
+ * folders, which are shown until a new count is done. These are
+ * looked up by path from the main thread, without touching the disk,
+ * so they may belong to a folder that was replaced in the meantime.
+ *
+ * It is stored in $XDG_CACHE_HOME/Thunar/dirsizes, a binary file in
+ * host byte order that starts with SIZE_CACHE_MAGIC, followed by one
+ * record per folder, the most recently used first. A file that does
+ * not start with the magic, or is cut short, is ignored. The file is
+ * read by a thread of its own once the cache is created, and written
+ * a while after the last change, so a series of deep counts only
+ * rewrites it once. The least recently used folders are dropped once
+ * the cache holds SIZE_CACHE_MAX_ENTRIES folders.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <gio/gio.h>
+
+#include <thunar/thunar-private.h>
+#include <thunar/thunar-size-cache.h>
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define _size_cache_lock(cache)   g_mutex_lock (&((cache)->lock))
+#define _size_cache_unlock(cache) g_mutex_unlock (&((cache)->lock))
+#else
+#define _size_cache_lock(cache)   g_mutex_lock ((cache)->lock)
+#define _size_cache_unlock(cache) g_mutex_unlock ((cache)->lock)
+#endif
+
+
+
+/* file format identifier, the last digit is the version */
+#define SIZE_CACHE_MAGIC "THUNAR-SIZE-CACHE 2\n"
+
+/* folders not looked at for this many seconds are dropped on save */
+#define SIZE_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+
+/* maximum number of folders in the cache */
+#define SIZE_CACHE_MAX_ENTRIES (50000)
+
+/* seconds to wait after a change before the cache is written */
+#define SIZE_CACHE_SAVE_DELAY (30)
+
+/* record flags */
+#define SIZE_CACHE_HAS_FOLDER (1 << 0)
+#define SIZE_CACHE_HAS_TOTAL  (1 << 1)
+
+
+
+typedef struct _ThunarSizeCacheEntry  ThunarSizeCacheEntry;
+typedef struct _ThunarSizeCacheReader ThunarSizeCacheReader;
+
+
+
+static void     thunar_size_cache_finalize    (GObject              *object);
+static void     thunar_size_cache_entry_free  (gpointer              data);
+static void     thunar_size_cache_load        (ThunarSizeCache      *cache);
+static gpointer thunar_size_cache_load_thread (gpointer              data);
+static gpointer thunar_size_cache_save_thread (gpointer              data);
+
+
+
+struct _ThunarSizeCacheClass
+{
+  GObjectClass __parent__;
+};
+
+struct _ThunarSizeCache
+{
+  GObject     __parent__;
+
+  /* ThunarSizeCacheEntry<!---->s, keyed by their device and inode */
+  GHashTable *entries;
+
+  /* the entries with a total, keyed by their path */
+  GHashTable *totals;
+
+  /* the entries, the most recently used first */
+  GQueue      lru;
+
+  gboolean    loaded;
+  gboolean    dirty;
+  guint       save_id;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  GMutex      lock;
+#else
+  GMutex     *lock;
+#endif
+};
+
+struct _ThunarSizeCacheEntry
+{
+  /* the key, must be the first members */
+  guint64               dev;
+  guint64               ino;
+
+  guint64               mtime;
+  gint64                last_used;
+  guint                 flags;
+
+  ThunarSizeCacheFolder folder;
+  ThunarSizeCacheTotal  total;
+
+  /* the path of the folder that was counted, with SIZE_CACHE_HAS_TOTAL */
+  gchar                *path;
+
+  /* link in the LRU queue */
+  GList                 link;
+};
+
+struct _ThunarSizeCacheReader
+{
+  const gchar *data;
+  const gchar *end;
+};
+
+
+
+/* the cache file is read once and writes to it are serialized */
+G_LOCK_DEFINE_STATIC (load);
+G_LOCK_DEFINE_STATIC (save);
+
+
+
+G_DEFINE_TYPE (ThunarSizeCache, thunar_size_cache, G_TYPE_OBJECT)
+
+
+
+static void
+thunar_size_cache_class_init (ThunarSizeCacheClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = thunar_size_cache_finalize;
+}
+
+
+
+static guint
+thunar_size_cache_key_hash (gconstpointer key)
+{
+  const guint64 *k = key;
+
+  return (guint) (k[1] ^ (k[1] >> 32) ^ k[0]);
+}
+
+
+
+static gboolean
+thunar_size_cache_key_equal (gconstpointer a,
+                             gconstpointer b)
+{
+  const guint64 *k_a = a;
+  const guint64 *k_b = b;
+
+  return k_a[0] == k_b[0] && k_a[1] == k_b[1];
+}
+
+
+
+static void
+thunar_size_cache_init (ThunarSizeCache *cache)
+{
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_mutex_init (&cache->lock);
+#else
+  cache->lock = g_mutex_new ();
+#endif
+
+  cache->entries = g_hash_table_new_full (thunar_size_cache_key_hash,
+                                          thunar_size_cache_key_equal,
+                                          NULL, thunar_size_cache_entry_free);
+  cache->totals = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&cache->lru);
+}
+
+
+
+static void
+thunar_size_cache_finalize (GObject *object)
+{
+  ThunarSizeCache *cache = THUNAR_SIZE_CACHE (object);
+
+  /* write the pending changes right away */
+  if (cache->save_id != 0)
+    {
+      g_source_remove (cache->save_id);
+      cache->save_id = 0;
+    }
+  thunar_size_cache_save (cache);
+
+  g_hash_table_destroy (cache->totals);
+  g_hash_table_destroy (cache->entries);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_mutex_clear (&cache->lock);
+#else
+  g_mutex_free (cache->lock);
+#endif
+
+  (*G_OBJECT_CLASS (thunar_size_cache_parent_class)->finalize) (object);
+}
+
+
+
+static void
+thunar_size_cache_entry_free (gpointer data)
+{
+  ThunarSizeCacheEntry *entry = data;
+
+  thunar_size_cache_folder_clear (&entry->folder);
+  g_free (entry->path);
+  g_slice_free (ThunarSizeCacheEntry, entry);
+}
+
+
+
+/* must be called with the cache lock held */
+static void
+thunar_size_cache_entry_set_path (ThunarSizeCache      *cache,
+                                  ThunarSizeCacheEntry *entry,
+                                  const gchar          *path)
+{
+  ThunarSizeCacheEntry *other;
+
+  if (g_strcmp0 (entry->path, path) == 0)
+    return;
+
+  if (entry->path != NULL)
+    {
+      if (g_hash_table_lookup (cache->totals, entry->path) == entry)
+        g_hash_table_remove (cache->totals, entry->path);
+      g_free (entry->path);
+      entry->path = NULL;
+    }
+
+  if (path != NULL)
+    {
+      /* another folder was counted at this path before */
+      other = g_hash_table_lookup (cache->totals, path);
+      if (other != NULL)
+        {
+          g_hash_table_remove (cache->totals, path);
+          g_free (other->path);
+          other->path = NULL;
+          other->flags &= ~SIZE_CACHE_HAS_TOTAL;
+        }
+
+      entry->path = g_strdup (path);
+      g_hash_table_insert (cache->totals, entry->path, entry);
+    }
+}
+
+
+
+/* must be called with the cache lock held */
+static void
+thunar_size_cache_entry_remove (ThunarSizeCache      *cache,
+                                ThunarSizeCacheEntry *entry)
+{
+  thunar_size_cache_entry_set_path (cache, entry, NULL);
+  g_queue_unlink (&cache->lru, &entry->link);
+
+  /* releases the entry */
+  g_hash_table_remove (cache->entries, &entry->dev);
+}
+
+
+
+/* must be called with the cache lock held */
+static void
+thunar_size_cache_entry_touch (ThunarSizeCache      *cache,
+                               ThunarSizeCacheEntry *entry)
+{
+  entry->last_used = g_get_real_time () / G_USEC_PER_SEC;
+
+  /* move the entry to the front of the queue */
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+}
+
+
+
+static gpointer
+thunar_size_cache_save_thread (gpointer data)
+{
+  ThunarSizeCache *cache = THUNAR_SIZE_CACHE (data);
+
+  thunar_size_cache_save (cache);
+  g_object_unref (G_OBJECT (cache));
+
+  return NULL;
+}
+
+
+
+static gboolean
+thunar_size_cache_save_timeout (gpointer user_data)
+{
+  ThunarSizeCache *cache = THUNAR_SIZE_CACHE (user_data);
+
+  _size_cache_lock (cache);
+  cache->save_id = 0;
+  _size_cache_unlock (cache);
+
+  /* write the file in the background */
+  g_object_ref (G_OBJECT (cache));
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_thread_unref (g_thread_new ("thunar-size-cache", thunar_size_cache_save_thread, cache));
+#else
+  g_thread_create (thunar_size_cache_save_thread, cache, FALSE, NULL);
+#endif
+
+  return FALSE;
+}
+
+
+
+/* must be called with the cache lock held */
+static void
+thunar_size_cache_changed (ThunarSizeCache *cache)
+{
+  ThunarSizeCacheEntry *entry;
+
+  /* drop the least recently used folders */
+  while (cache->lru.length > SIZE_CACHE_MAX_ENTRIES)
+    {
+      entry = cache->lru.tail->data;
+      thunar_size_cache_entry_remove (cache, entry);
+    }
+
+  cache->dirty = TRUE;
+
+  /* wait for more changes before writing the file */
+  if (cache->save_id == 0)
+    cache->save_id = g_timeout_add_seconds (SIZE_CACHE_SAVE_DELAY, thunar_size_cache_save_timeout, cache);
+}
+
+
+
+static ThunarSizeCacheEntry *
+thunar_size_cache_entry_get (ThunarSizeCache *cache,
+                             guint64          dev,
+                             guint64          ino)
+{
+  ThunarSizeCacheEntry *entry;
+  guint64               key[2] = { dev, ino };
+
+  entry = g_hash_table_lookup (cache->entries, key);
+  if (entry == NULL)
+    {
+      entry = g_slice_new0 (ThunarSizeCacheEntry);
+      entry->dev = dev;
+      entry->ino = ino;
+      entry->link.data = entry;
+      g_hash_table_insert (cache->entries, &entry->dev, entry);
+      g_queue_push_head_link (&cache->lru, &entry->link);
+    }
+
+  return entry;
+}
+
+
+
+static gchar *
+thunar_size_cache_get_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "Thunar", "dirsizes", NULL);
+}
+
+
+
+static void
+thunar_size_cache_folder_copy (const ThunarSizeCacheFolder *src,
+                               ThunarSizeCacheFolder       *dst)
+{
+  dst->total_size = src->total_size;
+  dst->allocated_size = src->allocated_size;
+  dst->file_count = src->file_count;
+  dst->subfolders = g_strdupv (src->subfolders);
+  dst->links = g_array_sized_new (FALSE, FALSE, sizeof (ThunarSizeCacheLink),
+                                  src->links != NULL ? src->links->len : 0);
+  if (src->links != NULL)
+    g_array_append_vals (dst->links, src->links->data, src->links->len);
+}
+
+
+
+static void
+thunar_size_cache_write (GByteArray    *array,
+                         gconstpointer  data,
+                         gsize          length)
+{
+  g_byte_array_append (array, data, length);
+}
+
+
+
+static gboolean
+thunar_size_cache_read (ThunarSizeCacheReader *reader,
+                        gpointer               data,
+                        gsize                  length)
+{
+  if ((gsize) (reader->end - reader->data) < length)
+    return FALSE;
+
+  memcpy (data, reader->data, length);
+  reader->data += length;
+
+  return TRUE;
+}
+
+
+
+static gboolean
+thunar_size_cache_read_entry (ThunarSizeCacheReader *reader,
+                              ThunarSizeCacheEntry  *entry)
+{
+  ThunarSizeCacheLink link;
+  guint32             n_items;
+  guint32             length;
+  guint32             n;
+
+  if (!thunar_size_cache_read (reader, &entry->dev, sizeof (entry->dev))
+      || !thunar_size_cache_read (reader, &entry->ino, sizeof (entry->ino))
+      || !thunar_size_cache_read (reader, &entry->mtime, sizeof (entry->mtime))
+      || !thunar_size_cache_read (reader, &entry->last_used, sizeof (entry->last_used))
+      || !thunar_size_cache_read (reader, &entry->flags, sizeof (entry->flags)))
+    return FALSE;
+
+  if ((entry->flags & SIZE_CACHE_HAS_FOLDER) != 0)
+    {
+      if (!thunar_size_cache_read (reader, &entry->folder.total_size, sizeof (entry->folder.total_size))
+          || !thunar_size_cache_read (reader, &entry->folder.allocated_size, sizeof (entry->folder.allocated_size))
+          || !thunar_size_cache_read (reader, &entry->folder.file_count, sizeof (entry->folder.file_count))
+          || !thunar_size_cache_read (reader, &n_items, sizeof (n_items))
+          || n_items > (gsize) (reader->end - reader->data) / sizeof (link))
+        return FALSE;
+
+      entry->folder.links = g_array_sized_new (FALSE, FALSE, sizeof (ThunarSizeCacheLink), n_items);
+      for (n = 0; n < n_items; ++n)
+        {
+          if (!thunar_size_cache_read (reader, &link, sizeof (link)))
+            return FALSE;
+          g_array_append_val (entry->folder.links, link);
+        }
+
+      if (!thunar_size_cache_read (reader, &n_items, sizeof (n_items))
+          || n_items > (gsize) (reader->end - reader->data))
+        return FALSE;
+
+      entry->folder.subfolders = g_new0 (gchar *, n_items + 1);
+      for (n = 0; n < n_items; ++n)
+        {
+          if (!thunar_size_cache_read (reader, &length, sizeof (length))
+              || length > (gsize) (reader->end - reader->data))
+            return FALSE;
+
+          entry->folder.subfolders[n] = g_strndup (reader->data, length);
+          reader->data += length;
+        }
+    }
+
+  if ((entry->flags & SIZE_CACHE_HAS_TOTAL) != 0)
+    {
+      if (!thunar_size_cache_read (reader, &entry->total, sizeof (entry->total))
+          || !thunar_size_cache_read (reader, &length, sizeof (length))
+          || length > (gsize) (reader->end - reader->data))
+        return FALSE;
+
+      entry->path = g_strndup (reader->data, length);
+      reader->data += length;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+thunar_size_cache_write_entry (GByteArray                 *array,
+                               const ThunarSizeCacheEntry *entry)
+{
+  guint32 n_items;
+  guint32 length;
+  guint32 n;
+
+  thunar_size_cache_write (array, &entry->dev, sizeof (entry->dev));
+  thunar_size_cache_write (array, &entry->ino, sizeof (entry->ino));
+  thunar_size_cache_write (array, &entry->mtime, sizeof (entry->mtime));
+  thunar_size_cache_write (array, &entry->last_used, sizeof (entry->last_used));
+  thunar_size_cache_write (array, &entry->flags, sizeof (entry->flags));
+
+  if ((entry->flags & SIZE_CACHE_HAS_FOLDER) != 0)
+    {
+      thunar_size_cache_write (array, &entry->folder.total_size, sizeof (entry->folder.total_size));
+      thunar_size_cache_write (array, &entry->folder.allocated_size, sizeof (entry->folder.allocated_size));
+      thunar_size_cache_write (array, &entry->folder.file_count, sizeof (entry->folder.file_count));
+
+      n_items = entry->folder.links->len;
+      thunar_size_cache_write (array, &n_items, sizeof (n_items));
+      thunar_size_cache_write (array, entry->folder.links->data, n_items * sizeof (ThunarSizeCacheLink));
+
+      n_items = g_strv_length (entry->folder.subfolders);
+      thunar_size_cache_write (array, &n_items, sizeof (n_items));
+      for (n = 0; n < n_items; ++n)
+        {
+          length = strlen (entry->folder.subfolders[n]);
+          thunar_size_cache_write (array, &length, sizeof (length));
+          thunar_size_cache_write (array, entry->folder.subfolders[n], length);
+        }
+    }
+
+  if ((entry->flags & SIZE_CACHE_HAS_TOTAL) != 0)
+    {
+      length = strlen (entry->path);
+      thunar_size_cache_write (array, &entry->total, sizeof (entry->total));
+      thunar_size_cache_write (array, &length, sizeof (length));
+      thunar_size_cache_write (array, entry->path, length);
+    }
+}
+
+
+
+/* reads the cache file unless this was done before, blocks
+ * until the file is read if another thread is reading it */
+static void
+thunar_size_cache_load (ThunarSizeCache *cache)
+{
+  ThunarSizeCacheReader reader;
+  ThunarSizeCacheEntry *entry;
+  GQueue                loaded = G_QUEUE_INIT;
+  gchar                *contents;
+  gchar                *path;
+  gchar                *entry_path;
+  gsize                 length;
+
+  G_LOCK (load);
+
+  if (G_LIKELY (cache->loaded))
+    {
+      G_UNLOCK (load);
+      return;
+    }
+
+  /* read the file without holding up the users of the cache */
+  path = thunar_size_cache_get_path ();
+  if (g_file_get_contents (path, &contents, &length, NULL))
+    {
+      if (length >= strlen (SIZE_CACHE_MAGIC)
+          && strncmp (contents, SIZE_CACHE_MAGIC, strlen (SIZE_CACHE_MAGIC)) == 0)
+        {
+          reader.data = contents + strlen (SIZE_CACHE_MAGIC);
+          reader.end = contents + length;
+
+          while (reader.data < reader.end)
+            {
+              entry = g_slice_new0 (ThunarSizeCacheEntry);
+              entry->link.data = entry;
+              if (!thunar_size_cache_read_entry (&reader, entry))
+                {
+                  /* the file was cut short */
+                  thunar_size_cache_entry_free (entry);
+                  break;
+                }
+
+              g_queue_push_tail_link (&loaded, &entry->link);
+            }
+        }
+
+      g_free (contents);
+    }
+  g_free (path);
+
+  _size_cache_lock (cache);
+
+  /* the folders stored in the meantime are newer, the
+   * ones from the file are used less recently */
+  while ((entry = g_queue_peek_head (&loaded)) != NULL)
+    {
+      g_queue_unlink (&loaded, &entry->link);
+
+      if (g_hash_table_lookup (cache->entries, &entry->dev) != NULL
+          || cache->lru.length >= SIZE_CACHE_MAX_ENTRIES)
+        {
+          thunar_size_cache_entry_free (entry);
+          continue;
+        }
+
+      g_hash_table_insert (cache->entries, &entry->dev, entry);
+      g_queue_push_tail_link (&cache->lru, &entry->link);
+
+      /* don't replace the total of a folder counted in the meantime */
+      entry_path = entry->path;
+      entry->path = NULL;
+      if (entry_path != NULL && g_hash_table_lookup (cache->totals, entry_path) == NULL)
+        thunar_size_cache_entry_set_path (cache, entry, entry_path);
+      else
+        entry->flags &= ~SIZE_CACHE_HAS_TOTAL;
+      g_free (entry_path);
+    }
+
+  cache->loaded = TRUE;
+
+  _size_cache_unlock (cache);
+
+  G_UNLOCK (load);
+}
+
+
+
+static gpointer
+thunar_size_cache_load_thread (gpointer data)
+{
+  ThunarSizeCache *cache = THUNAR_SIZE_CACHE (data);
+
+  thunar_size_cache_load (cache);
+  g_object_unref (G_OBJECT (cache));
+
+  return NULL;
+}
+
+
+
+/**
+ * thunar_size_cache_get:
+ *
+ * Returns a reference to the shared #ThunarSizeCache. The caller is
+ * responsible to free the returned object using g_object_unref() when
+ * no longer needed.
+ *
+ * Return value: a reference to the #ThunarSizeCache.
+ **/
+ThunarSizeCache *
+thunar_size_cache_get (void)
+{
+  static ThunarSizeCache *cache = NULL;
+
+  if (G_UNLIKELY (cache == NULL))
+    {
+      cache = g_object_new (THUNAR_TYPE_SIZE_CACHE, NULL);
+      g_object_add_weak_pointer (G_OBJECT (cache), (gpointer) &cache);
+
+      /* read the cache file in the background */
+      g_object_ref (G_OBJECT (cache));
+#if GLIB_CHECK_VERSION (2, 32, 0)
+      g_thread_unref (g_thread_new ("thunar-size-cache", thunar_size_cache_load_thread, cache));
+#else
+      g_thread_create (thunar_size_cache_load_thread, cache, FALSE, NULL);
+#endif
+    }
+  else
+    {
+      g_object_ref (G_OBJECT (cache));
+    }
+
+  return cache;
+}
+
+
+
+/**
+ * thunar_size_cache_lookup_folder:
+ * @cache  : a #ThunarSizeCache.
+ * @dev    : the device of the folder.
+ * @ino    : the inode of the folder.
+ * @mtime  : the modification time of the folder, in nanoseconds.
+ * @folder : return location for the contents of the folder, which
+ *           must be released with thunar_size_cache_folder_clear().
+ *
+ * Looks up the direct contents of a folder that were stored when the
+ * folder had the modification time @mtime. Must not be called from
+ * the main thread, as it waits until the cache file was read.
+ *
+ * Return value: %TRUE if the folder is cached and unchanged.
+ **/
+gboolean
+thunar_size_cache_lookup_folder (ThunarSizeCache       *cache,
+                                 guint64                dev,
+                                 guint64                ino,
+                                 guint64                mtime,
+                                 ThunarSizeCacheFolder *folder)
+{
+  ThunarSizeCacheEntry *entry;
+  gboolean              found = FALSE;
+  guint64               key[2] = { dev, ino };
+
+  _thunar_return_val_if_fail (THUNAR_IS_SIZE_CACHE (cache), FALSE);
+  _thunar_return_val_if_fail (folder != NULL, FALSE);
+
+  thunar_size_cache_load (cache);
+
+  _size_cache_lock (cache);
+
+  entry = g_hash_table_lookup (cache->entries, key);
+  if (entry != NULL
+      && (entry->flags & SIZE_CACHE_HAS_FOLDER) != 0
+      && entry->mtime == mtime)
+    {
+      thunar_size_cache_folder_copy (&entry->folder, folder);
+      thunar_size_cache_entry_touch (cache, entry);
+      found = TRUE;
+    }
+
+  _size_cache_unlock (cache);
+
+  return found;
+}
+
+
+
+/**
+ * thunar_size_cache_store_folder:
+ * @cache  : a #ThunarSizeCache.
+ * @dev    : the device of the folder.
+ * @ino    : the inode of the folder.
+ * @mtime  : the modification time of the folder, in nanoseconds.
+ * @folder : the direct contents of the folder.
+ *
+ * Remembers the contents of a folder that were read while it had the
+ * modification time @mtime. Must not be called from the main thread.
+ **/
+void
+thunar_size_cache_store_folder (ThunarSizeCache             *cache,
+                                guint64                      dev,
+                                guint64                      ino,
+                                guint64                      mtime,
+                                const ThunarSizeCacheFolder *folder)
+{
+  ThunarSizeCacheEntry *entry;
+
+  _thunar_return_if_fail (THUNAR_IS_SIZE_CACHE (cache));
+  _thunar_return_if_fail (folder != NULL);
+
+  thunar_size_cache_load (cache);
+
+  _size_cache_lock (cache);
+
+  entry = thunar_size_cache_entry_get (cache, dev, ino);
+  thunar_size_cache_folder_clear (&entry->folder);
+  thunar_size_cache_folder_copy (folder, &entry->folder);
+  entry->mtime = mtime;
+  entry->flags |= SIZE_CACHE_HAS_FOLDER;
+  thunar_size_cache_entry_touch (cache, entry);
+
+  thunar_size_cache_changed (cache);
+
+  _size_cache_unlock (cache);
+}
+
+
+
+static gboolean
+thunar_size_cache_get_key (const gchar *path,
+                           guint64     *dev,
+                           guint64     *ino)
+{
+  struct stat statb;
+
+  if (lstat (path, &statb) != 0)
+    return FALSE;
+
+  *dev = statb.st_dev;
+  *ino = statb.st_ino;
+
+  return TRUE;
+}
+
+
+
+/**
+ * thunar_size_cache_lookup_total:
+ * @cache : a #ThunarSizeCache.
+ * @file  : a local folder.
+ * @total : return location for the last result of a deep count.
+ *
+ * Looks up the last deep count of a folder at the path of @file,
+ * which may be outdated. Only looks at the memory, so this is
+ * cheap enough for the main thread, but misses the folders of
+ * the cache file until it was read.
+ *
+ * Return value: %TRUE if @file was counted before.
+ **/
+gboolean
+thunar_size_cache_lookup_total (ThunarSizeCache      *cache,
+                                GFile                *file,
+                                ThunarSizeCacheTotal *total)
+{
+  ThunarSizeCacheEntry *entry;
+  gboolean              found = FALSE;
+  gchar                *path;
+
+  _thunar_return_val_if_fail (THUNAR_IS_SIZE_CACHE (cache), FALSE);
+  _thunar_return_val_if_fail (G_IS_FILE (file), FALSE);
+  _thunar_return_val_if_fail (total != NULL, FALSE);
+
+  path = g_file_get_path (file);
+  if (path == NULL)
+    return FALSE;
+
+  _size_cache_lock (cache);
+
+  entry = g_hash_table_lookup (cache->totals, path);
+  if (entry != NULL)
+    {
+      *total = entry->total;
+      found = TRUE;
+    }
+
+  _size_cache_unlock (cache);
+
+  g_free (path);
+
+  return found;
+}
+
+
+
+/**
+ * thunar_size_cache_store_total:
+ * @cache : a #ThunarSizeCache.
+ * @file  : a local folder.
+ * @total : the result of a deep count of @file.
+ *
+ * Remembers the result of a deep count of @file. Must not be called
+ * from the main thread.
+ **/
+void
+thunar_size_cache_store_total (ThunarSizeCache            *cache,
+                               GFile                      *file,
+                               const ThunarSizeCacheTotal *total)
+{
+  ThunarSizeCacheEntry *entry;
+  guint64               dev;
+  guint64               ino;
+  gchar                *path;
+
+  _thunar_return_if_fail (THUNAR_IS_SIZE_CACHE (cache));
+  _thunar_return_if_fail (G_IS_FILE (file));
+  _thunar_return_if_fail (total != NULL);
+
+  path = g_file_get_path (file);
+  if (path == NULL)
+    return;
+
+  if (thunar_size_cache_get_key (path, &dev, &ino))
+    {
+      thunar_size_cache_load (cache);
+
+      _size_cache_lock (cache);
+
+      entry = thunar_size_cache_entry_get (cache, dev, ino);
+      entry->total = *total;
+      entry->flags |= SIZE_CACHE_HAS_TOTAL;
+      thunar_size_cache_entry_set_path (cache, entry, path);
+      thunar_size_cache_entry_touch (cache, entry);
+
+      thunar_size_cache_changed (cache);
+
+      _size_cache_unlock (cache);
+    }
+
+  g_free (path);
+}
+
+
+
+/**
+ * thunar_size_cache_save:
+ * @cache : a #ThunarSizeCache.
+ *
+ * Writes the @cache to disk if it changed, dropping the folders that
+ * were not used for a month. This is done automatically a while after
+ * the last change and when the @cache is finalized. May be called from
+ * any thread.
+ **/
+void
+thunar_size_cache_save (ThunarSizeCache *cache)
+{
+  ThunarSizeCacheEntry *entry;
+  GByteArray           *array;
+  GList                *lp;
+  GList                *next;
+  gint64                oldest;
+  gchar                *path;
+  gchar                *dirname;
+
+  _thunar_return_if_fail (THUNAR_IS_SIZE_CACHE (cache));
+
+  /* don't replace the file before it was read */
+  thunar_size_cache_load (cache);
+
+  G_LOCK (save);
+
+  _size_cache_lock (cache);
+
+  if (!cache->dirty)
+    {
+      _size_cache_unlock (cache);
+      G_UNLOCK (save);
+      return;
+    }
+
+  cache->dirty = FALSE;
+
+  array = g_byte_array_new ();
+  thunar_size_cache_write (array, SIZE_CACHE_MAGIC, strlen (SIZE_CACHE_MAGIC));
+
+  oldest = g_get_real_time () / G_USEC_PER_SEC - SIZE_CACHE_MAX_AGE;
+
+  for (lp = cache->lru.head; lp != NULL; lp = next)
+    {
+      next = lp->next;
+      entry = lp->data;
+      if (entry->last_used < oldest)
+        thunar_size_cache_entry_remove (cache, entry);
+      else
+        thunar_size_cache_write_entry (array, entry);
+    }
+
+  _size_cache_unlock (cache);
+
+  /* write the new cache file in one go */
+  path = thunar_size_cache_get_path ();
+  dirname = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dirname, 0700) == 0)
+    g_file_set_contents (path, (const gchar *) array->data, array->len, NULL);
+  g_free (dirname);
+  g_free (path);
+
+  g_byte_array_free (array, TRUE);
+
+  G_UNLOCK (save);
+}
+
+
+
+/**
+ * thunar_size_cache_folder_clear:
+ * @folder : a #ThunarSizeCacheFolder.
+ *
+ * Releases the memory held by @folder.
+ **/
+void
+thunar_size_cache_folder_clear (ThunarSizeCacheFolder *folder)
+{
+  if (folder->links != NULL)
+    g_array_free (folder->links, TRUE);
+  g_strfreev (folder->subfolders);
+
+  memset (folder, 0, sizeof (*folder));
+}
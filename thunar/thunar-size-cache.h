@@ -0,0 +1,103 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __THUNAR_SIZE_CACHE_H__
+#define __THUNAR_SIZE_CACHE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ThunarSizeCacheFolder ThunarSizeCacheFolder;
+typedef struct _ThunarSizeCacheLink   ThunarSizeCacheLink;
+typedef struct _ThunarSizeCacheTotal  ThunarSizeCacheTotal;
+typedef struct _ThunarSizeCacheClass  ThunarSizeCacheClass;
+typedef struct _ThunarSizeCache       ThunarSizeCache;
+
+#define THUNAR_TYPE_SIZE_CACHE            (thunar_size_cache_get_type ())
+#define THUNAR_SIZE_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), THUNAR_TYPE_SIZE_CACHE, ThunarSizeCache))
+#define THUNAR_SIZE_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), THUNAR_TYPE_SIZE_CACHE, ThunarSizeCacheClass))
+#define THUNAR_IS_SIZE_CACHE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), THUNAR_TYPE_SIZE_CACHE))
+#define THUNAR_IS_SIZE_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), THUNAR_TYPE_SIZE_CACHE))
+#define THUNAR_SIZE_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), THUNAR_TYPE_SIZE_CACHE, ThunarSizeCacheClass))
+
+/* a file with more than one hard link */
+struct _ThunarSizeCacheLink
+{
+  guint64 dev;
+  guint64 ino;
+  guint64 size;
+  guint64 allocated_size;
+};
+
+/* the direct contents of a folder */
+struct _ThunarSizeCacheFolder
+{
+  /* the files with a single link */
+  guint64  total_size;
+  guint64  allocated_size;
+  guint    file_count;
+
+  /* the files with more than one link, as ThunarSizeCacheLink<!---->s */
+  GArray  *links;
+
+  /* names of the subfolders on the same device */
+  gchar  **subfolders;
+};
+
+/* the result of a deep count */
+struct _ThunarSizeCacheTotal
+{
+  guint64 total_size;
+  guint64 allocated_size;
+  guint   file_count;
+  guint   directory_count;
+  guint   unreadable_directory_count;
+};
+
+GType            thunar_size_cache_get_type      (void) G_GNUC_CONST;
+
+ThunarSizeCache *thunar_size_cache_get           (void) G_GNUC_MALLOC;
+
+gboolean         thunar_size_cache_lookup_folder (ThunarSizeCache             *cache,
+                                                  guint64                      dev,
+                                                  guint64                      ino,
+                                                  guint64                      mtime,
+                                                  ThunarSizeCacheFolder       *folder);
+void             thunar_size_cache_store_folder  (ThunarSizeCache             *cache,
+                                                  guint64                      dev,
+                                                  guint64                      ino,
+                                                  guint64                      mtime,
+                                                  const ThunarSizeCacheFolder *folder);
+
+gboolean         thunar_size_cache_lookup_total  (ThunarSizeCache             *cache,
+                                                  GFile                       *file,
+                                                  ThunarSizeCacheTotal        *total);
+void             thunar_size_cache_store_total   (ThunarSizeCache             *cache,
+                                                  GFile                       *file,
+                                                  const ThunarSizeCacheTotal  *total);
+
+void             thunar_size_cache_save          (ThunarSizeCache             *cache);
+
+void             thunar_size_cache_folder_clear  (ThunarSizeCacheFolder       *folder);
+
+G_END_DECLS
+
+#endif /* !__THUNAR_SIZE_CACHE_H__ */
@@ -34,6 +34,7 @@
 #include <thunar/thunar-gtk-extensions.h>
 #include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
+#include <thunar/thunar-size-cache.h>
 #include <thunar/thunar-size-label.h>
 
 
@@ -61,6 +62,12 @@ static gboolean thunar_size_label_button_press_event    (GtkWidget            *e
                                                          GdkEventButton       *event,
                                                          ThunarSizeLabel      *size_label);
 static void     thunar_size_label_files_changed         (ThunarSizeLabel      *size_label);
+static void     thunar_size_label_set_counts            (ThunarSizeLabel      *size_label,
+                                                         guint64               total_size,
+                                                         guint64               allocated_size,
+                                                         guint                 file_count,
+                                                         guint                 directory_count,
+                                                         guint                 unreadable_directory_count);
 static void     thunar_size_label_error                 (ExoJob               *job,
                                                          const GError         *error,
                                                          ThunarSizeLabel      *size_label);
@@ -68,6 +75,7 @@ static void     thunar_size_label_finished              (ExoJob               *j
                                                          ThunarSizeLabel      *size_label);
 static void     thunar_size_label_status_update         (ThunarDeepCountJob   *job,
                                                          guint64               total_size,
+                                                         guint64               allocated_size,
                                                          guint                 file_count,
                                                          guint                 directory_count,
                                                          guint                 unreadable_directory_count,
@@ -85,16 +93,22 @@ struct _ThunarSizeLabelClass
 
 struct _ThunarSizeLabel
 {
-  GtkHBox             __parent__;
+  GtkHBox              __parent__;
+
+  ThunarDeepCountJob  *job;
+  ThunarPreferences   *preferences;
+  ThunarSizeCache     *size_cache;
 
-  ThunarDeepCountJob *job;
-  ThunarPreferences  *preferences;
+  /* while an earlier result is shown, the job updates are
+   * collected here and only shown when it has finished */
+  gboolean             revalidating;
+  ThunarSizeCacheTotal counts;
 
-  GList              *files;
-  gboolean            file_size_binary;
+  GList               *files;
+  gboolean             file_size_binary;
 
-  GtkWidget          *label;
-  GtkWidget          *spinner;
+  GtkWidget           *label;
+  GtkWidget           *spinner;
 };
 
 
@@ -152,6 +166,9 @@ thunar_size_label_init (ThunarSizeLabel *size_label)
                    G_OBJECT (size_label), "file-size-binary");
   g_signal_connect_swapped (G_OBJECT (size_label->preferences), "notify::misc-file-size-binary",
                             G_CALLBACK (thunar_size_label_files_changed), size_label);
+  /* results of earlier deep counts */
+  size_label->size_cache = thunar_size_cache_get ();
+
   gtk_widget_push_composite_child ();
 
   /* configure the box */
@@ -203,6 +220,8 @@ thunar_size_label_finalize (GObject *object)
   g_signal_handlers_disconnect_by_func (size_label->preferences, thunar_size_label_files_changed, size_label);
   g_object_unref (size_label->preferences);
 
+  g_object_unref (size_label->size_cache);
+
   (*G_OBJECT_CLASS (thunar_size_label_parent_class)->finalize) (object);
 }
 
@@ -299,8 +318,9 @@ thunar_size_label_button_press_event (GtkWidget       *ebox,
 static void
 thunar_size_label_files_changed (ThunarSizeLabel *size_label)
 {
-  gchar             *size_string;
-  guint64            size;
+  ThunarSizeCacheTotal total;
+  gchar               *size_string;
+  guint64              size;
 
   _thunar_return_if_fail (THUNAR_IS_SIZE_LABEL (size_label));
   _thunar_return_if_fail (size_label->files != NULL);
@@ -315,6 +335,8 @@ thunar_size_label_files_changed (ThunarSizeLabel *size_label)
       size_label->job = NULL;
     }
 
+  size_label->revalidating = FALSE;
+
   /* check if there are multiple files or the single file is a directory */
   if (size_label->files->next != NULL
       || thunar_file_is_directory (THUNAR_FILE (size_label->files->data)))
@@ -325,8 +347,23 @@ thunar_size_label_files_changed (ThunarSizeLabel *size_label)
       g_signal_connect (size_label->job, "finished", G_CALLBACK (thunar_size_label_finished), size_label);
       g_signal_connect (size_label->job, "status-update", G_CALLBACK (thunar_size_label_status_update), size_label);
 
-      /* tell the user that we started calculation */
-      gtk_label_set_text (GTK_LABEL (size_label->label), _("Calculating..."));
+      /* show the result of the last calculation while the job
+       * checks which parts of the folder changed, otherwise tell
+       * the user that we started calculation */
+      if (size_label->files->next == NULL
+          && thunar_size_cache_lookup_total (size_label->size_cache,
+                                             thunar_file_get_file (THUNAR_FILE (size_label->files->data)),
+                                             &total))
+        {
+          thunar_size_label_set_counts (size_label, total.total_size, total.allocated_size,
+                                        total.file_count, total.directory_count,
+                                        total.unreadable_directory_count);
+          size_label->revalidating = TRUE;
+        }
+      else
+        {
+          gtk_label_set_text (GTK_LABEL (size_label->label), _("Calculating..."));
+        }
       gtk_spinner_start (GTK_SPINNER (size_label->spinner));
       gtk_widget_show (size_label->spinner);
 
@@ -362,6 +399,7 @@ thunar_size_label_error (ExoJob          *job,
 
   /* setup the error text as label */
   gtk_label_set_text (GTK_LABEL (size_label->label), error->message);
+  size_label->revalidating = FALSE;
 }
 
 
@@ -378,6 +416,18 @@ thunar_size_label_finished (ExoJob          *job,
   gtk_spinner_stop (GTK_SPINNER (size_label->spinner));
   gtk_widget_hide (size_label->spinner);
 
+  /* replace the earlier result with the new one */
+  if (size_label->revalidating)
+    {
+      thunar_size_label_set_counts (size_label,
+                                    size_label->counts.total_size,
+                                    size_label->counts.allocated_size,
+                                    size_label->counts.file_count,
+                                    size_label->counts.directory_count,
+                                    size_label->counts.unreadable_directory_count);
+      size_label->revalidating = FALSE;
+    }
+
   /* disconnect from the job */
   g_signal_handlers_disconnect_matched (size_label->job, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, size_label);
   g_object_unref (size_label->job);
@@ -389,20 +439,48 @@ thunar_size_label_finished (ExoJob          *job,
 static void
 thunar_size_label_status_update (ThunarDeepCountJob *job,
                                  guint64             total_size,
+                                 guint64             allocated_size,
                                  guint               file_count,
                                  guint               directory_count,
                                  guint               unreadable_directory_count,
                                  ThunarSizeLabel    *size_label)
+{
+  _thunar_return_if_fail (THUNAR_IS_DEEP_COUNT_JOB (job));
+  _thunar_return_if_fail (THUNAR_IS_SIZE_LABEL (size_label));
+  _thunar_return_if_fail (size_label->job == job);
+
+  if (size_label->revalidating)
+    {
+      /* keep showing the earlier result, partial counts are
+       * only confusing */
+      size_label->counts.total_size = total_size;
+      size_label->counts.allocated_size = allocated_size;
+      size_label->counts.file_count = file_count;
+      size_label->counts.directory_count = directory_count;
+      size_label->counts.unreadable_directory_count = unreadable_directory_count;
+      return;
+    }
+
+  thunar_size_label_set_counts (size_label, total_size, allocated_size, file_count,
+                                directory_count, unreadable_directory_count);
+}
+
+
+
+static void
+thunar_size_label_set_counts (ThunarSizeLabel *size_label,
+                              guint64          total_size,
+                              guint64          allocated_size,
+                              guint            file_count,
+                              guint            directory_count,
+                              guint            unreadable_directory_count)
 {
   gchar             *size_string;
+  gchar             *allocated_string;
   gchar             *text;
   guint              n;
   gchar             *unreable_text;
 
-  _thunar_return_if_fail (THUNAR_IS_DEEP_COUNT_JOB (job));
-  _thunar_return_if_fail (THUNAR_IS_SIZE_LABEL (size_label));
-  _thunar_return_if_fail (size_label->job == job);
-
   /* determine the total number of items */
   n = file_count + directory_count + unreadable_directory_count;
 
@@ -410,7 +488,10 @@ thunar_size_label_status_update (ThunarDeepCountJob *job,
     {
       /* update the label */
       size_string = g_format_size_full (total_size, size_label->file_size_binary ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT);
-      text = g_strdup_printf (ngettext ("%u item, totalling %s", "%u items, totalling %s", n), n, size_string);
+      allocated_string = g_format_size_full (allocated_size, size_label->file_size_binary ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT);
+      text = g_strdup_printf (ngettext ("%u item, totalling %s (%s on disk)", "%u items, totalling %s (%s on disk)", n),
+                              n, size_string, allocated_string);
+      g_free (allocated_string);
       g_free (size_string);
       
       if (unreadable_directory_count > 0)
@@ -62,6 +62,12 @@
 
 #define THUNAR_STANDARD_VIEW_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), THUNAR_TYPE_STANDARD_VIEW, ThunarStandardViewPrivate))
 
+/* maximum number of pages to prefetch thumbnails for */
+#define THUNAR_STANDARD_VIEW_PREFETCH_PAGES (3)
+
+/* maximum number of files to prefetch thumbnails for */
+#define THUNAR_STANDARD_VIEW_PREFETCH_FILES (256)
+
 
 
 /* Property identifiers */
@@ -296,6 +302,11 @@ static void                 thunar_standard_view_schedule_thumbnail_timeout (Thu
 static void                 thunar_standard_view_schedule_thumbnail_idle    (ThunarStandardView       *standard_view);
 static gboolean             thunar_standard_view_request_thumbnails         (gpointer                  data);
 static gboolean             thunar_standard_view_request_thumbnails_lazy    (gpointer                  data);
+static GList               *thunar_standard_view_get_prefetch_files         (ThunarStandardView       *standard_view,
+                                                                             GtkTreePath              *start_path,
+                                                                             GtkTreePath              *end_path);
+static gboolean             thunar_standard_view_decode_prefetched          (gpointer                  data);
+static void                 thunar_standard_view_prefetch_destroyed         (gpointer                  data);
 static void                 thunar_standard_view_thumbnail_mode_toggled     (ThunarStandardView       *standard_view,
                                                                              GParamSpec               *pspec,
                                                                              ThunarIconFactory        *icon_factory);
@@ -388,6 +399,16 @@ struct _ThunarStandardViewPrivate
   guint                   thumbnail_source_id;
   gboolean                thumbnailing_scheduled;
 
+  /* support for prefetching thumbnails in the scroll direction */
+  GtkAdjustment          *scroll_adjustment;
+  gdouble                 scroll_value;
+  gint64                  scroll_time;
+  gint                    scroll_direction;
+  gdouble                 scroll_velocity;
+  guint                   prefetch_request;
+  GList                  *prefetch_files;
+  guint                   prefetch_source_id;
+
   /* file insert signal */
   gulong                  row_changed_id;
 
@@ -726,6 +747,9 @@ thunar_standard_view_init (ThunarStandardView *standard_view)
   /* be sure to update the statusbar text whenever the file-size-binary property changes */
   g_signal_connect_swapped (G_OBJECT (standard_view->model), "notify::file-size-binary", G_CALLBACK (thunar_standard_view_update_statusbar_text), standard_view);
 
+  /* request the visible folder sizes when they are enabled */
+  g_signal_connect_swapped (G_OBJECT (standard_view->model), "notify::folder-sizes", G_CALLBACK (thunar_standard_view_schedule_thumbnail_idle), standard_view);
+
   /* connect to size allocation signals for generating thumbnail requests */
   g_signal_connect_after (G_OBJECT (standard_view), "size-allocate",
                           G_CALLBACK (thunar_standard_view_size_allocate), NULL);
@@ -1407,6 +1431,10 @@ thunar_standard_view_set_current_directory (ThunarNavigator *navigator,
   /* cancel any pending thumbnail sources and requests */
   thunar_standard_view_cancel_thumbnailing (standard_view);
 
+  /* the new folder is not scrolled yet */
+  standard_view->priv->scroll_direction = 0;
+  standard_view->priv->scroll_velocity = 0;
+
   /* disconnect any previous "loading" binding */
   if (G_LIKELY (standard_view->loading_binding != NULL))
     exo_binding_unbind (standard_view->loading_binding);
@@ -3987,6 +4015,19 @@ thunar_standard_view_finished_thumbnailing (ThunarThumbnailer  *thumbnailer,
 
   if (standard_view->priv->thumbnail_request == request)
     standard_view->priv->thumbnail_request = 0;
+
+  if (standard_view->priv->prefetch_request == request)
+    {
+      standard_view->priv->prefetch_request = 0;
+
+      /* decode the new thumbnails once the thumbnailer marked them ready */
+      if (standard_view->priv->prefetch_source_id == 0)
+        {
+          standard_view->priv->prefetch_source_id =
+            g_idle_add_full (G_PRIORITY_LOW + 10, thunar_standard_view_decode_prefetched,
+                             standard_view, thunar_standard_view_prefetch_destroyed);
+        }
+    }
 }
 
 
@@ -4020,6 +4061,20 @@ thunar_standard_view_cancel_thumbnailing (ThunarStandardView *standard_view)
                                   standard_view->priv->thumbnail_request);
       standard_view->priv->thumbnail_request = 0;
     }
+
+  /* forget about the prefetched files */
+  if (standard_view->priv->prefetch_request > 0)
+    {
+      thunar_thumbnailer_dequeue (standard_view->priv->thumbnailer,
+                                  standard_view->priv->prefetch_request);
+      standard_view->priv->prefetch_request = 0;
+    }
+
+  if (standard_view->priv->prefetch_source_id > 0)
+    g_source_remove (standard_view->priv->prefetch_source_id);
+
+  g_list_free_full (standard_view->priv->prefetch_files, g_object_unref);
+  standard_view->priv->prefetch_files = NULL;
 }
 
 
@@ -4039,8 +4094,10 @@ thunar_standard_view_schedule_thumbnail_timeout (ThunarStandardView *standard_vi
       return;
     }
 
-  /* cancel any pending thumbnail sources and requests */
-  thunar_standard_view_cancel_thumbnailing (standard_view);
+  /* cancel any pending thumbnail sources, the request is replaced once
+   * the new visible range is known */
+  if (standard_view->priv->thumbnail_source_id > 0)
+    g_source_remove (standard_view->priv->thumbnail_source_id);
 
   /* schedule the timeout handler */
   g_assert (standard_view->priv->thumbnail_source_id == 0);
@@ -4066,8 +4123,10 @@ thunar_standard_view_schedule_thumbnail_idle (ThunarStandardView *standard_view)
       return;
     }
 
-  /* cancel any pending thumbnail sources or requests */
-  thunar_standard_view_cancel_thumbnailing (standard_view);
+  /* cancel any pending thumbnail sources, the request is replaced once
+   * the new visible range is known */
+  if (standard_view->priv->thumbnail_source_id > 0)
+    g_source_remove (standard_view->priv->thumbnail_source_id);
 
   /* schedule the timeout or idle handler */
   g_assert (standard_view->priv->thumbnail_source_id == 0);
@@ -4088,14 +4147,19 @@ thunar_standard_view_request_thumbnails_real (ThunarStandardView *standard_view,
   GtkTreeIter  iter;
   ThunarFile  *file;
   gboolean     valid_iter;
+  gboolean     show_thumbnails;
   GList       *visible_files = NULL;
+  GList       *prefetch_files;
+  GList       *files;
+  guint        request;
 
   _thunar_return_val_if_fail (THUNAR_IS_STANDARD_VIEW (standard_view), FALSE);
   _thunar_return_val_if_fail (THUNAR_IS_ICON_FACTORY (standard_view->icon_factory), FALSE);
 
-  /* do nothing if we are not supposed to show thumbnails at all */
-  if (!thunar_icon_factory_get_show_thumbnail (standard_view->icon_factory,
-                                               standard_view->priv->current_directory))
+  /* do nothing if we are not supposed to show thumbnails or folder sizes at all */
+  show_thumbnails = thunar_icon_factory_get_show_thumbnail (standard_view->icon_factory,
+                                                            standard_view->priv->current_directory);
+  if (!show_thumbnails && !thunar_list_model_get_folder_sizes (standard_view->model))
     return FALSE;
 
   /* reschedule the source if we're still loading the folder */
@@ -4136,9 +4200,45 @@ thunar_standard_view_request_thumbnails_real (ThunarStandardView *standard_view,
         }
 
       /* queue a thumbnail request */
-      thunar_thumbnailer_queue_files (standard_view->priv->thumbnailer,
-                                      lazy_request, visible_files,
-                                      &standard_view->priv->thumbnail_request);
+      if (show_thumbnails)
+        {
+          /* replace the previous request, dequeuing it only afterwards so
+           * the thumbnails that are still visible stay in flight */
+          request = standard_view->priv->thumbnail_request;
+          standard_view->priv->thumbnail_request = 0;
+          thunar_thumbnailer_queue_files (standard_view->priv->thumbnailer,
+                                          lazy_request, visible_files,
+                                          &standard_view->priv->thumbnail_request);
+          if (request > 0)
+            thunar_thumbnailer_dequeue (standard_view->priv->thumbnailer, request);
+
+          /* prefetch the thumbnails of the pages the user scrolls to */
+          prefetch_files = thunar_standard_view_get_prefetch_files (standard_view, start_path, end_path);
+          request = standard_view->priv->prefetch_request;
+          standard_view->priv->prefetch_request = 0;
+          if (prefetch_files != NULL)
+            {
+              thunar_thumbnailer_prefetch_files (standard_view->priv->thumbnailer, prefetch_files,
+                                                 &standard_view->priv->prefetch_request);
+            }
+          if (request > 0)
+            thunar_thumbnailer_dequeue (standard_view->priv->thumbnailer, request);
+          g_list_free_full (standard_view->priv->prefetch_files, g_object_unref);
+          standard_view->priv->prefetch_files = prefetch_files;
+
+          /* stop decoding the thumbnails of rows that scrolled away */
+          files = g_list_concat (g_list_copy (prefetch_files), g_list_copy (visible_files));
+          thunar_icon_factory_cancel_thumbnails (standard_view->icon_factory,
+                                                 standard_view->priv->current_directory,
+                                                 files);
+          g_list_free (files);
+
+          /* decode the prefetched thumbnails that are already available */
+          thunar_standard_view_decode_prefetched (standard_view);
+        }
+
+      /* count the visible folders, the list is bottom-up */
+      thunar_list_model_request_folder_sizes (standard_view->model, visible_files);
 
       /* release the file list */
       g_list_free_full (visible_files, g_object_unref);
@@ -4169,6 +4269,106 @@ thunar_standard_view_request_thumbnails_lazy (gpointer data)
 
 
 
+static GList*
+thunar_standard_view_get_prefetch_files (ThunarStandardView *standard_view,
+                                         GtkTreePath        *start_path,
+                                         GtkTreePath        *end_path)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (standard_view->model);
+  GtkTreeIter   iter;
+  GList        *files = NULL;
+  gint          start;
+  gint          end;
+  gint          n_pages;
+  gint          n_files;
+  gint          n;
+
+  _thunar_return_val_if_fail (THUNAR_IS_STANDARD_VIEW (standard_view), NULL);
+
+  if (gtk_tree_path_get_depth (start_path) != 1 || gtk_tree_path_get_depth (end_path) != 1)
+    return NULL;
+
+  start = gtk_tree_path_get_indices (start_path)[0];
+  end = gtk_tree_path_get_indices (end_path)[0];
+
+  /* prefetch more pages the faster the user scrolls */
+  n_pages = CLAMP (1 + (gint) standard_view->priv->scroll_velocity, 1, THUNAR_STANDARD_VIEW_PREFETCH_PAGES);
+  n_files = MIN ((end - start + 1) * n_pages, THUNAR_STANDARD_VIEW_PREFETCH_FILES);
+
+  if (standard_view->priv->scroll_direction < 0)
+    {
+      /* the rows above the visible range, the nearest first */
+      n = MAX (start - n_files, 0);
+      if (n < start && gtk_tree_model_iter_nth_child (model, &iter, NULL, n))
+        {
+          do
+            files = g_list_prepend (files, thunar_list_model_get_file (standard_view->model, &iter));
+          while (++n < start && gtk_tree_model_iter_next (model, &iter));
+        }
+    }
+  else
+    {
+      /* the rows below the visible range, the nearest first */
+      if (gtk_tree_model_iter_nth_child (model, &iter, NULL, end + 1))
+        {
+          n = 0;
+          do
+            files = g_list_prepend (files, thunar_list_model_get_file (standard_view->model, &iter));
+          while (++n < n_files && gtk_tree_model_iter_next (model, &iter));
+        }
+      files = g_list_reverse (files);
+    }
+
+  return files;
+}
+
+
+
+static gboolean
+thunar_standard_view_decode_prefetched (gpointer data)
+{
+  ThunarStandardView   *standard_view = THUNAR_STANDARD_VIEW (data);
+  ThunarIconCacheStats  stats;
+  GdkPixbuf            *icon;
+  GList                *lp;
+  gsize                 n_icons;
+  gint                  size;
+
+  _thunar_return_val_if_fail (THUNAR_IS_STANDARD_VIEW (standard_view), FALSE);
+
+  if (standard_view->priv->prefetch_files == NULL)
+    return FALSE;
+
+  /* leave most of the icon cache to the visible icons */
+  g_object_get (G_OBJECT (standard_view->icon_renderer), "size", &size, NULL);
+  thunar_icon_factory_get_cache_stats (standard_view->icon_factory, &stats);
+  n_icons = stats.max_bytes / 4 / ((gsize) size * size * 4);
+
+  /* load the thumbnails that are available, the icon factory
+   * decodes them in the background */
+  for (lp = standard_view->priv->prefetch_files; lp != NULL && n_icons > 0; lp = lp->next)
+    if (thunar_file_get_thumb_state (lp->data) == THUNAR_FILE_THUMB_STATE_READY)
+      {
+        icon = thunar_icon_factory_peek_file_icon (standard_view->icon_factory, lp->data,
+                                                   THUNAR_FILE_ICON_STATE_DEFAULT, size);
+        if (G_LIKELY (icon != NULL))
+          g_object_unref (G_OBJECT (icon));
+        n_icons--;
+      }
+
+  return FALSE;
+}
+
+
+
+static void
+thunar_standard_view_prefetch_destroyed (gpointer data)
+{
+  THUNAR_STANDARD_VIEW (data)->priv->prefetch_source_id = 0;
+}
+
+
+
 static void
 thunar_standard_view_thumbnail_mode_toggled (ThunarStandardView *standard_view,
                                              GParamSpec         *pspec,
@@ -4203,6 +4403,11 @@ static void
 thunar_standard_view_scrolled (GtkAdjustment      *adjustment,
                                ThunarStandardView *standard_view)
 {
+  gdouble value;
+  gdouble page_size;
+  gdouble velocity;
+  gint64  now;
+
   _thunar_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
   _thunar_return_if_fail (THUNAR_IS_STANDARD_VIEW (standard_view));
 
@@ -4210,6 +4415,23 @@ thunar_standard_view_scrolled (GtkAdjustment      *adjustment,
   if (thunar_view_get_loading (THUNAR_VIEW (standard_view)))
     return;
 
+  /* track the direction and the speed (in pages per second) of
+   * scrolling, for prefetching thumbnails */
+  value = gtk_adjustment_get_value (adjustment);
+  page_size = gtk_adjustment_get_page_size (adjustment);
+  now = g_get_monotonic_time ();
+  if (adjustment == standard_view->priv->scroll_adjustment
+      && page_size > 0 && value != standard_view->priv->scroll_value)
+    {
+      standard_view->priv->scroll_direction = (value > standard_view->priv->scroll_value) ? 1 : -1;
+      velocity = ABS (value - standard_view->priv->scroll_value) / page_size
+                 / (MAX (now - standard_view->priv->scroll_time, 1000) / (gdouble) G_USEC_PER_SEC);
+      standard_view->priv->scroll_velocity = (standard_view->priv->scroll_velocity + velocity) / 2;
+    }
+  standard_view->priv->scroll_adjustment = adjustment;
+  standard_view->priv->scroll_value = value;
+  standard_view->priv->scroll_time = now;
+
   /* reschedule a thumbnail request timeout */
   thunar_standard_view_schedule_thumbnail_timeout (standard_view);
 }
@@ -22,6 +22,10 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #ifdef HAVE_DBUS
 #include <dbus/dbus.h>
 #include <dbus/dbus-glib.h>
@@ -31,23 +35,103 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-thumbnail-cache.h>
 #include <thunar/thunar-file.h>
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
-#define _thumbnail_cache_lock(cache)   g_mutex_lock (&((cache)->lock))
-#define _thumbnail_cache_unlock(cache) g_mutex_unlock (&((cache)->lock))
+#define _thumbnail_cache_lock(cache)      g_mutex_lock (&((cache)->lock))
+#define _thumbnail_cache_unlock(cache)    g_mutex_unlock (&((cache)->lock))
+#define _thumbnail_cache_wait(cache)      g_cond_wait (&((cache)->cond), &((cache)->lock))
+#define _thumbnail_cache_broadcast(cache) g_cond_broadcast (&((cache)->cond))
 #else
-#define _thumbnail_cache_lock(cache)   g_mutex_lock ((cache)->lock)
-#define _thumbnail_cache_unlock(cache) g_mutex_unlock ((cache)->lock)
+#define _thumbnail_cache_lock(cache)      g_mutex_lock ((cache)->lock)
+#define _thumbnail_cache_unlock(cache)    g_mutex_unlock ((cache)->lock)
+#define _thumbnail_cache_wait(cache)      g_cond_wait ((cache)->cond, (cache)->lock)
+#define _thumbnail_cache_broadcast(cache) g_cond_broadcast ((cache)->cond)
+#endif
+
+
+
+/*
+ * Move, copy, delete and cleanup notifications are collected in a queue
+ * per operation and sent to the org.freedesktop.thumbnails.Cache1 service
+ * in chunks, shortly after the last notification or as soon as a chunk is
+ * full. Only a few calls per operation wait for a reply at the same time,
+ * and threads (e.g. of a transfer job) that notify while the queue is full
+ * wait until it drained, so a huge transfer never piles up in memory.
+ *
+ * Without the cache service, thumbnails in the normal and large
+ * directories are renamed, copied or deleted directly, by the thread
+ * of the job that notified or by a worker thread, never in the main
+ * loop or with the cache lock held. A moved or copied
+ * thumbnail is written again with the Thumb::URI of the target, readers
+ * treat a thumbnail with another URI as invalid. The thumbnails of the
+ * files below a moved or copied folder are not updated, finding them
+ * requires reading every thumbnail, so they are left to be regenerated.
+ */
+
+
+
+typedef enum
+{
+  THUNAR_THUMBNAIL_CACHE_MOVE,
+  THUNAR_THUMBNAIL_CACHE_COPY,
+  THUNAR_THUMBNAIL_CACHE_DELETE,
+  THUNAR_THUMBNAIL_CACHE_CLEANUP,
+  THUNAR_THUMBNAIL_CACHE_N_OPERATIONS,
+} ThunarThumbnailCacheOperation;
+
+
+
+#ifdef HAVE_DBUS
+/* maximum number of URIs sent to the cache service with a single call */
+#define THUNAR_THUMBNAIL_CACHE_CHUNK_SIZE (500)
+
+/* number of calls per operation that wait for a reply at the same time */
+#define THUNAR_THUMBNAIL_CACHE_MAX_CALLS  (2)
+
+/* number of queued files above which notifying threads wait */
+#define THUNAR_THUMBNAIL_CACHE_MAX_QUEUED (4 * THUNAR_THUMBNAIL_CACHE_CHUNK_SIZE)
+
+
+
+typedef struct _ThunarThumbnailCacheEntry ThunarThumbnailCacheEntry;
+typedef struct _ThunarThumbnailCacheQueue ThunarThumbnailCacheQueue;
 #endif
 
+typedef struct _ThunarThumbnailCacheCall  ThunarThumbnailCacheCall;
 
 
-static void thunar_thumbnail_cache_finalize (GObject *object);
+
+static void     thunar_thumbnail_cache_finalize              (GObject                       *object);
+#ifdef HAVE_DBUS
+static gboolean thunar_thumbnail_cache_process_queue         (ThunarThumbnailCache          *cache,
+                                                              ThunarThumbnailCacheOperation  operation);
+static gboolean thunar_thumbnail_cache_process_move_queue    (gpointer                       user_data);
+static gboolean thunar_thumbnail_cache_process_copy_queue    (gpointer                       user_data);
+static gboolean thunar_thumbnail_cache_process_delete_queue  (gpointer                       user_data);
+static gboolean thunar_thumbnail_cache_process_cleanup_queue (gpointer                       user_data);
+#endif
+static void     thunar_thumbnail_cache_queue                 (ThunarThumbnailCache          *cache,
+                                                              ThunarThumbnailCacheOperation  operation,
+                                                              GFile                         *source_file,
+                                                              GFile                         *target_file);
+static void     thunar_thumbnail_cache_call_free             (ThunarThumbnailCacheCall      *call);
+static void     thunar_thumbnail_cache_call_changed          (ThunarThumbnailCacheCall      *call);
+static void     thunar_thumbnail_cache_local_thread          (gpointer                       data,
+                                                              gpointer                       user_data);
+static gboolean thunar_thumbnail_cache_local_idle            (gpointer                       user_data);
+static gboolean thunar_thumbnail_cache_relabel               (const gchar                   *source_path,
+                                                              const gchar                   *target_path,
+                                                              const gchar                   *target_uri);
+static void     thunar_thumbnail_cache_update_local          (ThunarThumbnailCacheOperation  operation,
+                                                              const gchar                   *source_uri,
+                                                              const gchar                   *target_uri);
 
 
 
@@ -56,35 +140,72 @@ struct _ThunarThumbnailCacheClass
   GObjectClass __parent__;
 };
 
-struct _ThunarThumbnailCache
+#ifdef HAVE_DBUS
+struct _ThunarThumbnailCacheQueue
 {
-  GObject     __parent__;
+  /* ThunarThumbnailCacheEntry's, the oldest first */
+  GQueue entries;
 
-#ifdef HAVE_DBUS
-  DBusGProxy *cache_proxy;
+  /* timeout or idle source to send the entries */
+  guint  source_id;
+
+  /* number of calls waiting for a reply */
+  guint  n_calls;
+};
+#endif
 
-  GList      *move_source_queue;
-  GList      *move_target_queue;
-  guint       move_queue_idle_id;
+struct _ThunarThumbnailCache
+{
+  GObject                    __parent__;
 
-  GList      *copy_source_queue;
-  GList      *copy_target_queue;
-  guint       copy_queue_idle_id;
+  /* updates the thumbnails without the cache service, a single
+   * thread, so the operations are applied in order */
+  GThreadPool               *local_pool;
+
+#ifdef HAVE_DBUS
+  DBusGProxy                *cache_proxy;
 
-  GList      *delete_queue;
-  guint       delete_queue_idle_id;
+  /* set once the cache service turned out to be missing */
+  gboolean                   service_unknown;
 
-  GList      *cleanup_queue;
-  guint       cleanup_queue_idle_id;
+  ThunarThumbnailCacheQueue  queues[THUNAR_THUMBNAIL_CACHE_N_OPERATIONS];
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
-  GMutex      lock;
+  GMutex                     lock;
+  GCond                      cond;
 #else
-  GMutex     *lock;
+  GMutex                    *lock;
+  GCond                     *cond;
 #endif
 #endif
 };
 
+#ifdef HAVE_DBUS
+struct _ThunarThumbnailCacheEntry
+{
+  GFile *source_file;
+  GFile *target_file;
+};
+#endif
+
+struct _ThunarThumbnailCacheCall
+{
+  ThunarThumbnailCache          *cache;
+  ThunarThumbnailCacheOperation  operation;
+  gchar                        **source_uris;
+  gchar                        **target_uris;
+
+  /* target files of a move or copy, to reload their thumbnails */
+  GList                         *target_files;
+};
+
+
+
+#ifdef HAVE_DBUS
+/* delays to wait for more notifications before sending a queue */
+static const guint queue_delays[] = { 250, 500, 500, 1000 };
+#endif
+
 
 
 G_DEFINE_TYPE (ThunarThumbnailCache, thunar_thumbnail_cache, G_TYPE_OBJECT)
@@ -110,7 +231,12 @@ thunar_thumbnail_cache_init (ThunarThumbnailCache *cache)
 {
 #ifdef HAVE_DBUS
   DBusGConnection *connection;
+  guint            n;
+#endif
 
+  cache->local_pool = g_thread_pool_new (thunar_thumbnail_cache_local_thread, NULL, 1, FALSE, NULL);
+
+#ifdef HAVE_DBUS
   /* try to connect to D-Bus */
   connection = dbus_g_bus_get (DBUS_BUS_SESSION, NULL);
   if (connection != NULL)
@@ -126,11 +252,16 @@ thunar_thumbnail_cache_init (ThunarThumbnailCache *cache)
       dbus_g_connection_unref (connection);
     }
 
+  for (n = 0; n < THUNAR_THUMBNAIL_CACHE_N_OPERATIONS; ++n)
+    g_queue_init (&cache->queues[n].entries);
+
 /* create a new mutex for accessing the cache from different threads */
 #if GLIB_CHECK_VERSION (2, 32, 0)
   g_mutex_init (&cache->lock);
+  g_cond_init (&cache->cond);
 #else
   cache->lock = g_mutex_new ();
+  cache->cond = g_cond_new ();
 #endif
 #endif
 }
@@ -140,33 +271,33 @@ thunar_thumbnail_cache_init (ThunarThumbnailCache *cache)
 static void
 thunar_thumbnail_cache_finalize (GObject *object)
 {
+  ThunarThumbnailCache      *cache = THUNAR_THUMBNAIL_CACHE (object);
 #ifdef HAVE_DBUS
-  ThunarThumbnailCache *cache = THUNAR_THUMBNAIL_CACHE (object);
+  ThunarThumbnailCacheEntry *entry;
+  guint                      n;
+#endif
 
+  /* every queued local update holds a reference, so the pool is idle */
+  g_thread_pool_free (cache->local_pool, FALSE, TRUE);
+
+#ifdef HAVE_DBUS
   /* acquire a cache lock */
   _thumbnail_cache_lock (cache);
 
-  /* drop the move queue idle and all queued files */
-  if (cache->move_queue_idle_id > 0)
-    g_source_remove (cache->move_queue_idle_id);
-  g_list_free_full (cache->move_source_queue, g_object_unref);
-  g_list_free_full (cache->move_target_queue, g_object_unref);
-
-  /* drop the copy queue idle and all queued files */
-  if (cache->copy_queue_idle_id > 0)
-    g_source_remove (cache->copy_queue_idle_id);
-  g_list_free_full (cache->copy_source_queue, g_object_unref);
-  g_list_free_full (cache->copy_target_queue, g_object_unref);
-
-  /* drop the delete queue idle and all queued files */
-  if (cache->delete_queue_idle_id > 0)
-    g_source_remove (cache->delete_queue_idle_id);
-  g_list_free_full (cache->delete_queue, g_object_unref);
+  /* drop the queue sources and all queued files */
+  for (n = 0; n < THUNAR_THUMBNAIL_CACHE_N_OPERATIONS; ++n)
+    {
+      if (cache->queues[n].source_id > 0)
+        g_source_remove (cache->queues[n].source_id);
 
-  /* drop the cleanup queue idle and all queued files */
-  if (cache->cleanup_queue_idle_id > 0)
-    g_source_remove (cache->cleanup_queue_idle_id);
-  g_list_free_full (cache->cleanup_queue, g_object_unref);
+      while ((entry = g_queue_pop_head (&cache->queues[n].entries)) != NULL)
+        {
+          g_object_unref (entry->source_file);
+          if (entry->target_file != NULL)
+            g_object_unref (entry->target_file);
+          g_slice_free (ThunarThumbnailCacheEntry, entry);
+        }
+    }
 
   /* check if we have a valid cache proxy */
   if (cache->cache_proxy != NULL)
@@ -178,8 +309,10 @@ thunar_thumbnail_cache_finalize (GObject *object)
   /* release the mutex itself */
 #if GLIB_CHECK_VERSION (2, 32, 0)
   g_mutex_clear (&cache->lock);
+  g_cond_clear (&cache->cond);
 #else
   g_mutex_free (cache->lock);
+  g_cond_free (cache->cond);
 #endif
 #endif
 
@@ -188,22 +321,27 @@ thunar_thumbnail_cache_finalize (GObject *object)
 
 
 
-#ifdef HAVE_DBUS
 static void
-thunar_thumbnail_cache_move_copy_async_reply (DBusGProxy *proxy,
-                                              GError     *error,
-                                              gpointer    user_data)
+thunar_thumbnail_cache_call_free (ThunarThumbnailCacheCall *call)
 {
-  GList      *li;
-  ThunarFile *file;
+  g_list_free_full (call->target_files, g_object_unref);
+  g_strfreev (call->source_uris);
+  g_strfreev (call->target_uris);
+  g_object_unref (call->cache);
+  g_slice_free (ThunarThumbnailCacheCall, call);
+}
+
 
-  _thunar_return_if_fail (DBUS_IS_G_PROXY (proxy));
 
-  for (li = user_data; li != NULL; li = li->next)
+static void
+thunar_thumbnail_cache_call_changed (ThunarThumbnailCacheCall *call)
+{
+  ThunarFile *file;
+  GList      *li;
+
+  for (li = call->target_files; li != NULL; li = li->next)
     {
       file = thunar_file_cache_lookup (G_FILE (li->data));
-      g_object_unref (G_OBJECT (li->data));
-
       if (G_LIKELY (file != NULL))
         {
           /* if visible, let the view know there might be a thumb */
@@ -211,183 +349,211 @@ thunar_thumbnail_cache_move_copy_async_reply (DBusGProxy *proxy,
           g_object_unref (file);
         }
     }
-
-  g_list_free (user_data);
 }
 
 
 
 static void
-thunar_thumbnail_cache_move_async (ThunarThumbnailCache *cache,
-                                   const gchar         **source_uris,
-                                   const gchar         **target_uris,
-                                   gpointer              user_data)
+thunar_thumbnail_cache_local_thread (gpointer data,
+                                     gpointer user_data)
 {
-  _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
-  _thunar_return_if_fail (source_uris != NULL);
-  _thunar_return_if_fail (target_uris != NULL);
-
-  /* request a thumbnail cache update asynchronously */
-  thunar_thumbnail_cache_proxy_move_async (cache->cache_proxy,
-                                           source_uris, target_uris,
-                                           thunar_thumbnail_cache_move_copy_async_reply,
-                                           user_data);
+  ThunarThumbnailCacheCall *call = data;
+  guint                     n;
+
+  for (n = 0; call->source_uris[n] != NULL; ++n)
+    {
+      thunar_thumbnail_cache_update_local (call->operation, call->source_uris[n],
+                                           call->target_uris != NULL ? call->target_uris[n] : NULL);
+    }
+
+  /* the views and the last reference on the cache belong to the main thread */
+  g_idle_add (thunar_thumbnail_cache_local_idle, call);
 }
 
 
 
-static void
-thunar_thumbnail_cache_copy_async (ThunarThumbnailCache *cache,
-                                   const gchar         **source_uris,
-                                   const gchar         **target_uris,
-                                   gpointer              user_data)
+static gboolean
+thunar_thumbnail_cache_local_idle (gpointer user_data)
 {
-  _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
-  _thunar_return_if_fail (source_uris != NULL);
-  _thunar_return_if_fail (target_uris != NULL);
-
-  /* request a thumbnail cache update asynchronously */
-  thunar_thumbnail_cache_proxy_copy_async (cache->cache_proxy,
-                                           source_uris, target_uris,
-                                           thunar_thumbnail_cache_move_copy_async_reply,
-                                           user_data);
+  ThunarThumbnailCacheCall *call = user_data;
+
+  thunar_thumbnail_cache_call_changed (call);
+  thunar_thumbnail_cache_call_free (call);
+
+  return FALSE;
 }
 
 
 
+#ifdef HAVE_DBUS
+
+
 static void
-thunar_thumbnail_cache_delete_async_reply (DBusGProxy *proxy,
-                                           GError     *error,
-                                           gpointer    user_data)
+thunar_thumbnail_cache_async_reply (DBusGProxy *proxy,
+                                    GError     *error,
+                                    gpointer    user_data)
 {
+  ThunarThumbnailCacheCall  *call = user_data;
+  ThunarThumbnailCache      *cache = call->cache;
+  ThunarThumbnailCacheQueue *queue = &cache->queues[call->operation];
+  gboolean                   local = FALSE;
+
   _thunar_return_if_fail (DBUS_IS_G_PROXY (proxy));
-}
 
+  if (error != NULL
+      && (g_error_matches (error, DBUS_GERROR, DBUS_GERROR_SERVICE_UNKNOWN)
+          || g_error_matches (error, DBUS_GERROR, DBUS_GERROR_NAME_HAS_NO_OWNER)))
+    {
+      /* there is no cache service, so update the thumbnails ourselves */
+      local = TRUE;
+    }
+  else
+    {
+      thunar_thumbnail_cache_call_changed (call);
+    }
 
+  _thumbnail_cache_lock (cache);
 
-static void
-thunar_thumbnail_cache_delete_async (ThunarThumbnailCache *cache,
-                                     const gchar         **uris)
-{
-  _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
-  _thunar_return_if_fail (uris != NULL);
+  if (local)
+    cache->service_unknown = TRUE;
 
-  /* request a thumbnail cache update asynchronously */
-  thunar_thumbnail_cache_proxy_delete_async (cache->cache_proxy, uris,
-                                             thunar_thumbnail_cache_delete_async_reply,
-                                             NULL);
-}
+  /* send the next chunk of the queue */
+  queue->n_calls--;
+  if (queue->entries.length > 0 && queue->source_id == 0)
+    {
+      switch (call->operation)
+        {
+        case THUNAR_THUMBNAIL_CACHE_MOVE:
+          queue->source_id = g_idle_add (thunar_thumbnail_cache_process_move_queue, cache);
+          break;
 
+        case THUNAR_THUMBNAIL_CACHE_COPY:
+          queue->source_id = g_idle_add (thunar_thumbnail_cache_process_copy_queue, cache);
+          break;
 
+        case THUNAR_THUMBNAIL_CACHE_DELETE:
+          queue->source_id = g_idle_add (thunar_thumbnail_cache_process_delete_queue, cache);
+          break;
 
-static void
-thunar_thumbnail_cache_cleanup_async_reply (DBusGProxy *proxy,
-                                            GError     *error,
-                                            gpointer    user_data)
-{
-  _thunar_return_if_fail (DBUS_IS_G_PROXY (proxy));
-}
+        case THUNAR_THUMBNAIL_CACHE_CLEANUP:
+          queue->source_id = g_idle_add (thunar_thumbnail_cache_process_cleanup_queue, cache);
+          break;
 
+        default:
+          _thunar_assert_not_reached ();
+        }
+    }
 
+  /* wake up threads if the service turned out to be missing */
+  _thumbnail_cache_broadcast (cache);
 
-static void
-thunar_thumbnail_cache_cleanup_async (ThunarThumbnailCache *cache,
-                                      const gchar *const    *base_uris)
-{
-  _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
-  _thunar_return_if_fail (base_uris != NULL);
+  _thumbnail_cache_unlock (cache);
 
-  /* request a thumbnail cache update asynchronously */
-  thunar_thumbnail_cache_proxy_cleanup_async (cache->cache_proxy,
-                                              (const gchar **)base_uris, 0,
-                                              thunar_thumbnail_cache_cleanup_async_reply,
-                                              NULL);
+  /* decoding and writing thumbnails is kept away from the main loop */
+  if (local)
+    g_thread_pool_push (cache->local_pool, call, NULL);
+  else
+    thunar_thumbnail_cache_call_free (call);
 }
 
 
 
 static gboolean
-thunar_thumbnail_cache_process_queue (ThunarThumbnailCache *cache,
-                                      gboolean              copy_async)
+thunar_thumbnail_cache_process_queue (ThunarThumbnailCache          *cache,
+                                      ThunarThumbnailCacheOperation  operation)
 {
-  GList  *sp;
-  GList  *tp;
-  gchar **source_uris;
-  gchar **target_uris;
-  guint   n_uris;
-  guint   n;
-  GList  *source_queue;
-  GList  *target_queue;
+  ThunarThumbnailCacheQueue *queue = &cache->queues[operation];
+  ThunarThumbnailCacheEntry *entry;
+  ThunarThumbnailCacheCall  *call;
+  guint                      n_uris;
+  guint                      n;
 
   _thunar_return_val_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache), FALSE);
 
   /* acquire a cache lock */
   _thumbnail_cache_lock (cache);
 
-  /* steal the lists */
-  if (copy_async)
-    {
-      source_queue = cache->copy_source_queue;
-      cache->copy_source_queue = NULL;
-      target_queue = cache->copy_target_queue;
-      cache->copy_target_queue = NULL;
-    }
-  else
+  /* forget about the source, unless it was replaced in the meantime */
+  if (queue->source_id == g_source_get_id (g_main_current_source ()))
+    queue->source_id = 0;
+
+  while (queue->entries.length > 0
+         && (cache->service_unknown || queue->n_calls < THUNAR_THUMBNAIL_CACHE_MAX_CALLS))
     {
-      source_queue = cache->move_source_queue;
-      cache->move_source_queue = NULL;
-      target_queue = cache->move_target_queue;
-      cache->move_target_queue = NULL;
-    }
+      call = g_slice_new0 (ThunarThumbnailCacheCall);
+      call->cache = g_object_ref (cache);
+      call->operation = operation;
 
-  /* compute how many URIs there are */
-  n_uris = g_list_length (source_queue);
+      /* take a chunk of the oldest files */
+      n_uris = MIN (queue->entries.length, THUNAR_THUMBNAIL_CACHE_CHUNK_SIZE);
+      call->source_uris = g_new0 (gchar *, n_uris + 1);
+      if (operation == THUNAR_THUMBNAIL_CACHE_MOVE || operation == THUNAR_THUMBNAIL_CACHE_COPY)
+        call->target_uris = g_new0 (gchar *, n_uris + 1);
 
-  /* allocate a string array for the URIs */
-  source_uris = g_new0 (gchar *, n_uris + 1);
-  target_uris = g_new0 (gchar *, n_uris + 1);
+      for (n = 0; n < n_uris; ++n)
+        {
+          entry = g_queue_pop_head (&queue->entries);
 
-  /* fill URI array with file URIs from the move queue */
-  for (n = 0,
-       sp = g_list_last (source_queue),
-       tp = g_list_last (target_queue);
-       sp != NULL && tp != NULL;
-       sp = sp->prev, tp = tp->prev, ++n)
-    {
-      source_uris[n] = g_file_get_uri (sp->data);
-      target_uris[n] = g_file_get_uri (tp->data);
+          call->source_uris[n] = g_file_get_uri (entry->source_file);
+          g_object_unref (entry->source_file);
 
-      /* release the source object */
-      g_object_unref (sp->data);
-    }
+          if (entry->target_file != NULL)
+            {
+              call->target_uris[n] = g_file_get_uri (entry->target_file);
+              call->target_files = g_list_prepend (call->target_files, entry->target_file);
+            }
 
-  /* NULL-terminate the URI arrays */
-  source_uris[n] = NULL;
-  target_uris[n] = NULL;
+          g_slice_free (ThunarThumbnailCacheEntry, entry);
+        }
 
-  if (copy_async)
-    {
-      /* asynchronously copy the thumbnails */
-      thunar_thumbnail_cache_copy_async (cache,
-                                         (const gchar **)source_uris,
-                                         (const gchar **)target_uris,
-                                         target_queue);
-    }
-  else
-    {
-      /* asynchronously move the thumbnails */
-      thunar_thumbnail_cache_move_async (cache,
-                                         (const gchar **)source_uris,
-                                         (const gchar **)target_uris,
-                                         target_queue);
-    }
+      if (cache->service_unknown)
+        {
+          /* the files queued before the service turned out to be missing */
+          g_thread_pool_push (cache->local_pool, call, NULL);
+          continue;
+        }
 
-  /* free the URI arrays */
-  g_strfreev (source_uris);
-  g_strfreev (target_uris);
+      /* request a thumbnail cache update asynchronously */
+      queue->n_calls++;
+      switch (operation)
+        {
+        case THUNAR_THUMBNAIL_CACHE_MOVE:
+          thunar_thumbnail_cache_proxy_move_async (cache->cache_proxy,
+                                                   (const gchar **) call->source_uris,
+                                                   (const gchar **) call->target_uris,
+                                                   thunar_thumbnail_cache_async_reply,
+                                                   call);
+          break;
+
+        case THUNAR_THUMBNAIL_CACHE_COPY:
+          thunar_thumbnail_cache_proxy_copy_async (cache->cache_proxy,
+                                                   (const gchar **) call->source_uris,
+                                                   (const gchar **) call->target_uris,
+                                                   thunar_thumbnail_cache_async_reply,
+                                                   call);
+          break;
+
+        case THUNAR_THUMBNAIL_CACHE_DELETE:
+          thunar_thumbnail_cache_proxy_delete_async (cache->cache_proxy,
+                                                     (const gchar **) call->source_uris,
+                                                     thunar_thumbnail_cache_async_reply,
+                                                     call);
+          break;
+
+        case THUNAR_THUMBNAIL_CACHE_CLEANUP:
+          thunar_thumbnail_cache_proxy_cleanup_async (cache->cache_proxy,
+                                                      (const gchar **) call->source_uris, 0,
+                                                      thunar_thumbnail_cache_async_reply,
+                                                      call);
+          break;
+
+        default:
+          _thunar_assert_not_reached ();
+        }
+    }
 
-  /* release the move queue lists */
-  g_list_free (source_queue);
+  /* wake up threads waiting for room in the queue */
+  _thumbnail_cache_broadcast (cache);
 
   /* release the cache lock */
   _thumbnail_cache_unlock (cache);
@@ -400,145 +566,275 @@ thunar_thumbnail_cache_process_queue (ThunarThumbnailCache *cache,
 static gboolean
 thunar_thumbnail_cache_process_move_queue (gpointer user_data)
 {
-  return thunar_thumbnail_cache_process_queue (user_data, FALSE);
+  return thunar_thumbnail_cache_process_queue (user_data, THUNAR_THUMBNAIL_CACHE_MOVE);
 }
 
 
 
-static void
-thunar_thumbnail_cache_process_move_queue_destroy (gpointer user_data)
+static gboolean
+thunar_thumbnail_cache_process_copy_queue (gpointer user_data)
 {
-  THUNAR_THUMBNAIL_CACHE (user_data)->move_queue_idle_id = 0;
+  return thunar_thumbnail_cache_process_queue (user_data, THUNAR_THUMBNAIL_CACHE_COPY);
 }
 
 
 
 static gboolean
-thunar_thumbnail_cache_process_copy_queue (gpointer user_data)
+thunar_thumbnail_cache_process_delete_queue (gpointer user_data)
 {
-  return thunar_thumbnail_cache_process_queue (user_data, TRUE);
+  return thunar_thumbnail_cache_process_queue (user_data, THUNAR_THUMBNAIL_CACHE_DELETE);
 }
 
 
 
-static void
-thunar_thumbnail_cache_process_copy_queue_destroy (gpointer user_data)
+static gboolean
+thunar_thumbnail_cache_process_cleanup_queue (gpointer user_data)
 {
-  THUNAR_THUMBNAIL_CACHE (user_data)->copy_queue_idle_id = 0;
+  return thunar_thumbnail_cache_process_queue (user_data, THUNAR_THUMBNAIL_CACHE_CLEANUP);
 }
+#endif /* HAVE_DBUS */
 
 
 
 static gboolean
-thunar_thumbnail_cache_process_delete_queue (ThunarThumbnailCache *cache)
+thunar_thumbnail_cache_relabel (const gchar *source_path,
+                                const gchar *target_path,
+                                const gchar *target_uri)
 {
-  GList  *lp;
-  gchar **uris;
-  guint   n_uris;
-  guint   n;
-
-  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache), FALSE);
-
-  /* acquire a cache lock */
-  _thumbnail_cache_lock (cache);
-
-  /* compute how many URIs there are */
-  n_uris = g_list_length (cache->delete_queue);
-
-  /* allocate a string array for the URIs */
-  uris = g_new0 (gchar *, n_uris + 1);
+  static const gchar *keys[] = { "tEXt::Thumb::MTime", "tEXt::Thumb::Size", "tEXt::Thumb::Mime",
+                                 "tEXt::Thumb::Image::Width", "tEXt::Thumb::Image::Height",
+                                 "tEXt::Software" };
+  const gchar        *value;
+  GdkPixbuf          *pixbuf;
+  gboolean            succeed = FALSE;
+  gchar              *option_keys[G_N_ELEMENTS (keys) + 2];
+  gchar              *option_values[G_N_ELEMENTS (keys) + 2];
+  gchar              *tmp_path;
+  guint               n_options = 0;
+  guint               n;
+  gint                fd;
+
+  pixbuf = gdk_pixbuf_new_from_file (source_path, NULL);
+  if (G_UNLIKELY (pixbuf == NULL))
+    return FALSE;
+
+  /* keep the other keys of the thumbnail, but label it with the new URI */
+  option_keys[n_options] = (gchar *) "tEXt::Thumb::URI";
+  option_values[n_options++] = (gchar *) target_uri;
+  for (n = 0; n < G_N_ELEMENTS (keys); ++n)
+    {
+      value = gdk_pixbuf_get_option (pixbuf, keys[n]);
+      if (value != NULL)
+        {
+          option_keys[n_options] = (gchar *) keys[n];
+          option_values[n_options++] = (gchar *) value;
+        }
+    }
+  option_keys[n_options] = NULL;
+  option_values[n_options] = NULL;
 
-  /* fill URI array with file URIs from the delete queue */
-  for (lp = g_list_last (cache->delete_queue), n = 0; lp != NULL; lp = lp->prev, ++n)
+  /* write to a temporary file, so readers never see a partial thumbnail */
+  tmp_path = g_strconcat (target_path, ".XXXXXX", NULL);
+  fd = g_mkstemp (tmp_path);
+  if (G_LIKELY (fd >= 0))
     {
-      uris[n] = g_file_get_uri (lp->data);
+      close (fd);
 
-      /* release the file object */
-      g_object_unref (lp->data);
+      if (gdk_pixbuf_savev (pixbuf, tmp_path, "png", option_keys, option_values, NULL))
+        succeed = (g_rename (tmp_path, target_path) == 0);
+
+      if (!succeed)
+        g_unlink (tmp_path);
     }
+  g_free (tmp_path);
 
-  /* NULL-terminate the URI array */
-  uris[n] = NULL;
+  g_object_unref (pixbuf);
 
-  /* asynchronously delete the thumbnails */
-  thunar_thumbnail_cache_delete_async (cache, (const gchar **)uris);
+  return succeed;
+}
 
-  /* free the URI array */
-  g_strfreev (uris);
 
-  /* release the delete queue list */
-  g_list_free (cache->delete_queue);
-  cache->delete_queue = NULL;
 
-  /* reset the delete queue idle ID */
-  cache->delete_queue_idle_id = 0;
+static void
+thunar_thumbnail_cache_update_local (ThunarThumbnailCacheOperation  operation,
+                                     const gchar                   *source_uri,
+                                     const gchar                   *target_uri)
+{
+  static const gchar *flavors[] = { "normal", "large" };
+  gchar              *source_path;
+  gchar              *target_path = NULL;
+  gchar              *checksum;
+  gchar              *filename;
+  guint               n;
+
+  for (n = 0; n < G_N_ELEMENTS (flavors); ++n)
+    {
+      /* thumbnails are named after the MD5 sum of the URI */
+      checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, source_uri, -1);
+      filename = g_strconcat (checksum, ".png", NULL);
+      source_path = g_build_filename (g_get_user_cache_dir (), "thumbnails", flavors[n], filename, NULL);
+      g_free (filename);
+      g_free (checksum);
+
+      if (target_uri != NULL)
+        {
+          checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, target_uri, -1);
+          filename = g_strconcat (checksum, ".png", NULL);
+          target_path = g_build_filename (g_get_user_cache_dir (), "thumbnails", flavors[n], filename, NULL);
+          g_free (filename);
+          g_free (checksum);
+        }
 
-  /* release the cache lock */
-  _thumbnail_cache_unlock (cache);
+      switch (operation)
+        {
+        case THUNAR_THUMBNAIL_CACHE_MOVE:
+        case THUNAR_THUMBNAIL_CACHE_COPY:
+          /* without a thumbnail to take over, drop the one of the file that
+           * was replaced rather than keeping a mislabelled one */
+          if (!thunar_thumbnail_cache_relabel (source_path, target_path, target_uri))
+            g_unlink (target_path);
+
+          /* the thumbnail of a moved file is invalid in either case */
+          if (operation == THUNAR_THUMBNAIL_CACHE_MOVE)
+            g_unlink (source_path);
+          break;
+
+        case THUNAR_THUMBNAIL_CACHE_DELETE:
+        case THUNAR_THUMBNAIL_CACHE_CLEANUP:
+          /* the thumbnails of files below a cleaned up folder are left to the
+           * cache service, finding them requires reading every thumbnail */
+          g_unlink (source_path);
+          break;
+
+        default:
+          _thunar_assert_not_reached ();
+        }
 
-  return FALSE;
+      g_free (target_path);
+      g_free (source_path);
+    }
 }
 
 
 
-static gboolean
-thunar_thumbnail_cache_process_cleanup_queue (ThunarThumbnailCache *cache)
+static void
+thunar_thumbnail_cache_queue (ThunarThumbnailCache          *cache,
+                              ThunarThumbnailCacheOperation  operation,
+                              GFile                         *source_file,
+                              GFile                         *target_file)
 {
-  GList  *lp;
-  gchar **uris;
-  guint   n_uris;
-  guint   n;
+#ifdef HAVE_DBUS
+  ThunarThumbnailCacheQueue *queue = &cache->queues[operation];
+  ThunarThumbnailCacheEntry *entry;
+  GSourceFunc                process_func = NULL;
+#endif
+  ThunarThumbnailCacheCall  *call;
+  gchar                     *source_uri;
+  gchar                     *target_uri;
 
-  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache), FALSE);
+  _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
+  _thunar_return_if_fail (G_IS_FILE (source_file));
 
+#ifdef HAVE_DBUS
   /* acquire a cache lock */
   _thumbnail_cache_lock (cache);
 
-  /* compute how many URIs there are */
-  n_uris = g_list_length (cache->cleanup_queue);
-
-  /* allocate a string array for the URIs */
-  uris = g_new0 (gchar *, n_uris + 1);
-
-#ifndef NDEBUG
-  g_debug ("cleanup:");
-#endif
-
-  /* fill URI array with file URIs from the cleanup queue */
-  for (lp = g_list_last (cache->cleanup_queue), n = 0; lp != NULL; lp = lp->prev, ++n)
+  /* check if we have a valid proxy for the cache service */
+  if (cache->cache_proxy != NULL && !cache->service_unknown)
     {
-      uris[n] = g_file_get_uri (lp->data);
+      /* add the files to the queue */
+      entry = g_slice_new (ThunarThumbnailCacheEntry);
+      entry->source_file = g_object_ref (source_file);
+      entry->target_file = (target_file != NULL) ? g_object_ref (target_file) : NULL;
+      g_queue_push_tail (&queue->entries, entry);
 
-#ifndef NDEBUG
-      g_debug ("  %s", uris[n]);
-#endif
+      switch (operation)
+        {
+        case THUNAR_THUMBNAIL_CACHE_MOVE:
+          process_func = thunar_thumbnail_cache_process_move_queue;
+          break;
 
-      /* release the file object */
-      g_object_unref (lp->data);
-    }
+        case THUNAR_THUMBNAIL_CACHE_COPY:
+          process_func = thunar_thumbnail_cache_process_copy_queue;
+          break;
 
-  /* NULL-terminate the URI array */
-  uris[n] = NULL;
+        case THUNAR_THUMBNAIL_CACHE_DELETE:
+          process_func = thunar_thumbnail_cache_process_delete_queue;
+          break;
 
-  /* asynchronously cleanup the thumbnails */
-  thunar_thumbnail_cache_cleanup_async (cache, (const gchar *const *)uris);
+        case THUNAR_THUMBNAIL_CACHE_CLEANUP:
+          process_func = thunar_thumbnail_cache_process_cleanup_queue;
+          break;
 
-  /* free the URI array */
-  g_strfreev (uris);
+        default:
+          _thunar_assert_not_reached ();
+        }
 
-  /* release the cleanup queue list */
-  g_list_free (cache->cleanup_queue);
-  cache->cleanup_queue = NULL;
+      if (queue->entries.length < THUNAR_THUMBNAIL_CACHE_CHUNK_SIZE)
+        {
+          /* wait a moment for more files, to send them together */
+          if (queue->source_id > 0)
+            g_source_remove (queue->source_id);
+          queue->source_id = g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, queue_delays[operation],
+                                                 process_func, cache, NULL);
+        }
+      else if (queue->entries.length == THUNAR_THUMBNAIL_CACHE_CHUNK_SIZE
+               || queue->source_id == 0)
+        {
+          /* send a full chunk right away */
+          if (queue->source_id > 0)
+            g_source_remove (queue->source_id);
+          queue->source_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, process_func, cache, NULL);
+        }
+
+      /* let the threads of jobs wait while the queue is full, but
+       * never block the main loop, which drains the queue */
+      while (queue->entries.length >= THUNAR_THUMBNAIL_CACHE_MAX_QUEUED
+             && !cache->service_unknown
+             && !g_main_context_is_owner (g_main_context_default ()))
+        {
+          _thumbnail_cache_wait (cache);
+        }
 
-  /* reset the cleanup queue idle ID */
-  cache->cleanup_queue_idle_id = 0;
+      /* release the cache lock */
+      _thumbnail_cache_unlock (cache);
+      return;
+    }
 
   /* release the cache lock */
   _thumbnail_cache_unlock (cache);
+#endif
 
-  return FALSE;
+  /* without a cache service, update the thumbnails ourselves */
+  source_uri = g_file_get_uri (source_file);
+  target_uri = (target_file != NULL) ? g_file_get_uri (target_file) : NULL;
+
+  if (g_main_context_is_owner (g_main_context_default ()))
+    {
+      /* never decode thumbnails in the main loop */
+      call = g_slice_new0 (ThunarThumbnailCacheCall);
+      call->cache = g_object_ref (cache);
+      call->operation = operation;
+      call->source_uris = g_new0 (gchar *, 2);
+      call->source_uris[0] = source_uri;
+      if (target_file != NULL)
+        {
+          call->target_uris = g_new0 (gchar *, 2);
+          call->target_uris[0] = target_uri;
+          call->target_files = g_list_prepend (NULL, g_object_ref (target_file));
+        }
+
+      g_thread_pool_push (cache->local_pool, call, NULL);
+    }
+  else
+    {
+      /* the thread of a job does the work, which also keeps a large
+       * transfer from queueing up more than we can handle */
+      thunar_thumbnail_cache_update_local (operation, source_uri, target_uri);
+      g_free (target_uri);
+      g_free (source_uri);
+    }
 }
-#endif /* HAVE_DBUS */
 
 
 
@@ -559,35 +855,7 @@ thunar_thumbnail_cache_move_file (ThunarThumbnailCache *cache,
   _thunar_return_if_fail (G_IS_FILE (source_file));
   _thunar_return_if_fail (G_IS_FILE (target_file));
 
-#ifdef HAVE_DBUS
-  /* acquire a cache lock */
-  _thumbnail_cache_lock (cache);
-
-  /* check if we have a valid proxy for the cache service */
-  if (cache->cache_proxy != NULL)
-    {
-      /* cancel any pending timeout to process the move queue */
-      if (cache->move_queue_idle_id > 0)
-        {
-          g_source_remove (cache->move_queue_idle_id);
-          cache->move_queue_idle_id = 0;
-        }
-
-      /* add the files to the move queue */
-      cache->move_source_queue = g_list_prepend (cache->move_source_queue,
-                                                 g_object_ref (source_file));
-      cache->move_target_queue = g_list_prepend (cache->move_target_queue,
-                                                 g_object_ref (target_file));
-
-      /* process the move queue in a 250ms timeout */
-      cache->move_queue_idle_id =
-        g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, 250, thunar_thumbnail_cache_process_move_queue,
-                            cache, thunar_thumbnail_cache_process_move_queue_destroy);
-    }
-
-  /* release the cache lock */
-  _thumbnail_cache_unlock (cache);
-#endif
+  thunar_thumbnail_cache_queue (cache, THUNAR_THUMBNAIL_CACHE_MOVE, source_file, target_file);
 }
 
 
@@ -601,35 +869,7 @@ thunar_thumbnail_cache_copy_file (ThunarThumbnailCache *cache,
   _thunar_return_if_fail (G_IS_FILE (source_file));
   _thunar_return_if_fail (G_IS_FILE (target_file));
 
-#ifdef HAVE_DBUS
-  /* acquire a cache lock */
-  _thumbnail_cache_lock (cache);
-
-  /* check if we have a valid proxy for the cache service */
-  if (cache->cache_proxy != NULL)
-    {
-      /* cancel any pending timeout to process the copy queue */
-      if (cache->copy_queue_idle_id > 0)
-        {
-          g_source_remove (cache->copy_queue_idle_id);
-          cache->copy_queue_idle_id = 0;
-        }
-
-      /* add the files to the copy queues */
-      cache->copy_source_queue = g_list_prepend (cache->copy_source_queue,
-                                                 g_object_ref (source_file));
-      cache->copy_target_queue = g_list_prepend (cache->copy_target_queue,
-                                                 g_object_ref (target_file));
-
-      /* process the copy queue in a 250ms timeout */
-      cache->copy_queue_idle_id =
-        g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, 500, thunar_thumbnail_cache_process_copy_queue,
-                            cache, thunar_thumbnail_cache_process_copy_queue_destroy);
-    }
-
-  /* release the cache lock */
-  _thumbnail_cache_unlock (cache);
-#endif
+  thunar_thumbnail_cache_queue (cache, THUNAR_THUMBNAIL_CACHE_COPY, source_file, target_file);
 }
 
 
@@ -641,32 +881,7 @@ thunar_thumbnail_cache_delete_file (ThunarThumbnailCache *cache,
   _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
   _thunar_return_if_fail (G_IS_FILE (file));
 
-#ifdef HAVE_DBUS
-  /* acquire a cache lock */
-  _thumbnail_cache_lock (cache);
-
-  /* check if we have a valid proxy for the cache service */
-  if (cache->cache_proxy)
-    {
-      /* cancel any pending timeout to process the delete queue */
-      if (cache->delete_queue_idle_id > 0)
-        {
-          g_source_remove (cache->delete_queue_idle_id);
-          cache->delete_queue_idle_id = 0;
-        }
-
-      /* add the file to the delete queue */
-      cache->delete_queue = g_list_prepend (cache->delete_queue, g_object_ref (file));
-
-      /* process the delete queue in a 250ms timeout */
-      cache->delete_queue_idle_id =
-        g_timeout_add (500, (GSourceFunc) thunar_thumbnail_cache_process_delete_queue,
-                       cache);
-    }
-
-  /* release the cache lock */
-  _thumbnail_cache_unlock (cache);
-#endif
+  thunar_thumbnail_cache_queue (cache, THUNAR_THUMBNAIL_CACHE_DELETE, file, NULL);
 }
 
 
@@ -678,30 +893,22 @@ thunar_thumbnail_cache_cleanup_file (ThunarThumbnailCache *cache,
   _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
   _thunar_return_if_fail (G_IS_FILE (file));
 
-#ifdef HAVE_DBUS
-  /* acquire a cache lock */
-  _thumbnail_cache_lock (cache);
+  thunar_thumbnail_cache_queue (cache, THUNAR_THUMBNAIL_CACHE_CLEANUP, file, NULL);
+}
 
-  /* check if we have a valid proxy for the cache service */
-  if (cache->cache_proxy)
-    {
-      /* cancel any pending timeout to process the cleanup queue */
-      if (cache->cleanup_queue_idle_id > 0)
-        {
-          g_source_remove (cache->cleanup_queue_idle_id);
-          cache->cleanup_queue_idle_id = 0;
-        }
 
-      /* add the file to the cleanup queue */
-      cache->cleanup_queue = g_list_prepend (cache->cleanup_queue, g_object_ref (file));
 
-      /* process the cleanup queue in a 250ms timeout */
-      cache->cleanup_queue_idle_id =
-        g_timeout_add (1000, (GSourceFunc) thunar_thumbnail_cache_process_cleanup_queue,
-                       cache);
-    }
+void
+thunar_thumbnail_cache_cleanup_files (ThunarThumbnailCache *cache,
+                                      GList                *file_list)
+{
+  GList *lp;
 
-  /* release the cache lock */
-  _thumbnail_cache_unlock (cache);
-#endif
+  _thunar_return_if_fail (THUNAR_IS_THUMBNAIL_CACHE (cache));
+
+  for (lp = file_list; lp != NULL; lp = lp->next)
+    {
+      _thunar_assert (G_IS_FILE (lp->data));
+      thunar_thumbnail_cache_queue (cache, THUNAR_THUMBNAIL_CACHE_CLEANUP, lp->data, NULL);
+    }
 }
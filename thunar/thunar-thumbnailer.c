@@ -23,6 +23,23 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
+
 #ifdef HAVE_DBUS
 #include <dbus/dbus.h>
 #include <dbus/dbus-glib.h>
@@ -31,6 +48,7 @@
 #endif
 
 #include <thunar/thunar-marshal.h>
+#include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-thumbnailer.h>
 
@@ -48,14 +66,32 @@
  * Please note that all D-Bus calls are performed asynchronously.
  *
  *
- * When a request call is sent out, an internal request ID is created and
- * associated with the corresponding DBusGProxyCall.
+ * Scheduling
+ * ==========
+ *
+ * Callers queue files and get an internal request ID back. The files are
+ * not sent to the D-Bus thumbnailer right away, but turned into items that
+ * are shared by URI, so views showing the same folder never ask for the
+ * same thumbnail twice. Waiting items are kept in a queue with the most
+ * recently requested files first, so the rows the user is looking at now
+ * are served before the ones of older requests.
  *
- * The D-Bus reply handler then checks if there was an delivery error or
- * not. If the request method was sent successfully, the handle returned by the
- * D-Bus thumbnailer is associated bidirectionally with the internal request ID via
- * the request and handle values in the job structure. In both cases, the
- * association of the internal request ID with the DBusGProxyCall is set to NULL.
+ * Only a few batches of items (jobs) are in flight at the same time. When
+ * a request is dequeued, e.g. because the view scrolled, its waiting items
+ * are dropped unless another request still wants them, and jobs nobody is
+ * interested in anymore are dequeued from the D-Bus thumbnailer.
+ *
+ * Files that are not visible yet, but probably will be soon, can be queued
+ * with a prefetch request. Items only wanted by prefetch requests wait in
+ * a separate queue, which is only served when no other items are waiting
+ * and no job is in flight. Once a visible request wants such an item, it
+ * moves to the regular wait queue.
+ *
+ * When a job is sent out, the DBusGProxyCall is stored in the job. The
+ * D-Bus reply handler then checks if there was an delivery error or
+ * not. If the request method was sent successfully, the handle returned by
+ * the D-Bus thumbnailer is stored in the job. In both cases, the
+ * DBusGProxyCall of the job is set to NULL.
  *
  *
  * Ready / Error
@@ -69,9 +105,24 @@
  * Finished
  * ========
  *
- * The Finished signal handler looks up the internal request ID based on
- * the D-Bus thumbnailer handle. It then drops all corresponding information
- * from handle_request_mapping and request_handle_mapping.
+ * The Finished signal handler looks up the job based on the D-Bus
+ * thumbnailer handle. Its items are done, which finishes the requests that
+ * waited for them, and the next job is sent out.
+ *
+ *
+ * Built-in thumbnailer
+ * ====================
+ *
+ * Local images that GdkPixbuf can load, but no D-Bus thumbnailer handles
+ * (e.g. because tumbler is not running or Thunar is built without D-Bus),
+ * are thumbnailed by a small thread pool instead. The threads write the
+ * thumbnails into the normal and large directories of the freedesktop.org
+ * thumbnail cache, and record files they failed on in the fail directory
+ * so they are not tried again until they change. The files of a request
+ * are finished in idle functions, which set the thumb state and emit
+ * request-finished once the last file is done. A request that is queued
+ * to both thumbnailers shares its ID, and the part that is done last
+ * emits request-finished for both.
  */
 
 
@@ -85,10 +136,30 @@ typedef enum
 
 
 
-typedef struct _ThunarThumbnailerJob  ThunarThumbnailerJob;
-typedef struct _ThunarThumbnailerIdle ThunarThumbnailerIdle;
+/* number of jobs sent to the D-Bus thumbnailer at the same time */
+#define THUNAR_THUMBNAILER_MAX_JOBS (2)
+
+/* number of jobs in flight below which prefetched items are sent */
+#define THUNAR_THUMBNAILER_MAX_PREFETCH_JOBS (1)
+
+/* maximum number of URIs sent with a single job */
+#define THUNAR_THUMBNAILER_JOB_SIZE (16)
+
+
+
+typedef struct _ThunarThumbnailerItem    ThunarThumbnailerItem;
+typedef struct _ThunarThumbnailerJob     ThunarThumbnailerJob;
+typedef struct _ThunarThumbnailerIdle    ThunarThumbnailerIdle;
+typedef struct _ThunarThumbnailerRequest ThunarThumbnailerRequest;
 #endif
 
+/* thumbnail sizes of the normal and large flavors */
+#define THUNAR_THUMBNAILER_NORMAL_SIZE (128)
+#define THUNAR_THUMBNAILER_LARGE_SIZE  (256)
+
+typedef struct _ThunarThumbnailerFallback     ThunarThumbnailerFallback;
+typedef struct _ThunarThumbnailerFallbackTask ThunarThumbnailerFallbackTask;
+
 /* Signal identifiers */
 enum
 {
@@ -99,6 +170,11 @@ enum
 
 
 static void                   thunar_thumbnailer_finalize               (GObject                    *object);
+static gboolean               thunar_thumbnailer_queue_files_real       (ThunarThumbnailer          *thumbnailer,
+                                                                         gboolean                    lazy_checks,
+                                                                         gboolean                    prefetch,
+                                                                         GList                      *files,
+                                                                         guint                      *request);
 #ifdef HAVE_DBUS
 static void                   thunar_thumbnailer_init_thumbnailer_proxy (ThunarThumbnailer          *thumbnailer,
                                                                          DBusGConnection            *connection);
@@ -117,9 +193,19 @@ static void                   thunar_thumbnailer_thumbnailer_ready      (DBusGPr
                                                                          guint32                     handle,
                                                                          const gchar               **uris,
                                                                          ThunarThumbnailer          *thumbnailer);
-static guint                  thunar_thumbnailer_queue_async            (ThunarThumbnailer          *thumbnailer,
-                                                                         gchar                     **uris,
-                                                                         const gchar               **mime_hints);
+static void                   thunar_thumbnailer_item_free              (gpointer                    data);
+static GQueue                *thunar_thumbnailer_item_queue             (ThunarThumbnailer          *thumbnailer,
+                                                                         ThunarThumbnailerItem      *item);
+static void                   thunar_thumbnailer_item_requeue           (ThunarThumbnailer          *thumbnailer,
+                                                                         ThunarThumbnailerItem      *item,
+                                                                         gboolean                    to_front);
+static void                   thunar_thumbnailer_item_finish            (ThunarThumbnailer          *thumbnailer,
+                                                                         ThunarThumbnailerItem      *item,
+                                                                         GSList                    **finished);
+static void                   thunar_thumbnailer_job_free               (ThunarThumbnailerJob       *job);
+static void                   thunar_thumbnailer_schedule               (ThunarThumbnailer          *thumbnailer);
+static void                   thunar_thumbnailer_emit_finished          (ThunarThumbnailer          *thumbnailer,
+                                                                         GSList                     *finished);
 static void                   thunar_thumbnailer_idle                   (ThunarThumbnailer          *thumbnailer,
                                                                          guint                       handle,
                                                                          ThunarThumbnailerIdleType   type,
@@ -127,6 +213,39 @@ static void                   thunar_thumbnailer_idle                   (ThunarT
 static gboolean               thunar_thumbnailer_idle_func              (gpointer                    user_data);
 static void                   thunar_thumbnailer_idle_free              (gpointer                    data);
 #endif
+static gchar                 *thunar_thumbnailer_build_path             (const gchar                *flavor,
+                                                                         const gchar                *filename);
+static gboolean               thunar_thumbnailer_read_mtime             (const gchar                *path,
+                                                                         guint64                    *mtime_return);
+static gboolean               thunar_thumbnailer_is_fresh               (const gchar                *path,
+                                                                         guint64                     mtime);
+static gchar                **thunar_thumbnailer_get_fail_dirs          (ThunarThumbnailer          *thumbnailer);
+static gboolean               thunar_thumbnailer_check_cached           (ThunarThumbnailer          *thumbnailer,
+                                                                         ThunarFile                 *file);
+static gboolean               thunar_thumbnailer_fallback_is_supported  (ThunarThumbnailer          *thumbnailer,
+                                                                         ThunarFile                 *file);
+static void                   thunar_thumbnailer_fallback_queue         (ThunarThumbnailer          *thumbnailer,
+                                                                         GList                      *files,
+                                                                         guint                       request,
+                                                                         gboolean                    prefetch,
+                                                                         gboolean                    shared);
+static void                   thunar_thumbnailer_fallback_dequeue       (ThunarThumbnailer          *thumbnailer,
+                                                                         guint                       request);
+static void                   thunar_thumbnailer_fallback_unref         (ThunarThumbnailerFallback  *fallback);
+static void                   thunar_thumbnailer_fallback_task_free     (gpointer                    data);
+static gint                   thunar_thumbnailer_fallback_task_compare  (gconstpointer               a,
+                                                                         gconstpointer               b,
+                                                                         gpointer                    user_data);
+static gboolean               thunar_thumbnailer_fallback_save          (GdkPixbuf                  *pixbuf,
+                                                                         const gchar                *path,
+                                                                         const gchar                *uri,
+                                                                         const gchar                *mtime);
+static GdkPixbuf             *thunar_thumbnailer_fallback_scale         (GdkPixbuf                  *pixbuf,
+                                                                         gint                        size);
+static gboolean               thunar_thumbnailer_fallback_create        (ThunarThumbnailerFallbackTask *task);
+static void                   thunar_thumbnailer_fallback_thread        (gpointer                    data,
+                                                                         gpointer                    user_data);
+static gboolean               thunar_thumbnailer_fallback_idle          (gpointer                    data);
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
 #define _thumbnailer_lock(thumbnailer)    g_mutex_lock (&((thumbnailer)->lock))
@@ -147,33 +266,72 @@ struct _ThunarThumbnailerClass
 
 struct _ThunarThumbnailer
 {
-  GObject __parent__;
+  GObject      __parent__;
 
 #ifdef HAVE_DBUS
   /* proxies to communicate with D-Bus services */
-  DBusGProxy *thumbnailer_proxy;
+  DBusGProxy  *thumbnailer_proxy;
 
   /* running jobs */
-  GSList     *jobs;
+  GSList      *jobs;
+
+  /* waiting and running items by URI */
+  GHashTable  *items;
+
+  /* waiting items, the most recently requested first */
+  GQueue       waiting;
+
+  /* waiting items only wanted by prefetch requests */
+  GQueue       prefetch;
+
+  /* unfinished requests */
+  GSList      *requests;
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
-  GMutex      lock;
+  GMutex       lock;
 #else
-  GMutex     *lock;
+  GMutex      *lock;
 #endif
 
   /* cached MIME types -> URI schemes for which thumbs can be generated */
-  GHashTable *supported;
-
-  /* last ThunarThumbnailer request ID */
-  guint       last_request;
+  GHashTable  *supported;
 
   /* IDs of idle functions */
-  GSList     *idles;
+  GSList      *idles;
 #endif
+
+  /* last ThunarThumbnailer request ID */
+  guint        last_request;
+
+  /* built-in thumbnailer, MIME types it handles and unfinished requests */
+  GThreadPool *fallback_pool;
+  GHashTable  *fallback_types;
+  GSList      *fallback_requests;
+
+  /* directories with failure markers and the time they were listed for */
+  gchar      **fail_dirs;
+  time_t       fail_dirs_mtime;
 };
 
 #ifdef HAVE_DBUS
+struct _ThunarThumbnailerItem
+{
+  gchar                *uri;
+  gchar                *mime_hint;
+
+  /* requests that wait for this thumbnail */
+  GSList               *requests;
+
+  /* the job the item was sent with, or NULL while it's waiting */
+  ThunarThumbnailerJob *job;
+
+  /* if the item is only wanted by prefetch requests */
+  guint                 prefetch : 1;
+
+  /* link in the wait or prefetch queue */
+  GList                 link;
+};
+
 struct _ThunarThumbnailerJob
 {
   ThunarThumbnailer *thumbnailer;
@@ -181,8 +339,8 @@ struct _ThunarThumbnailerJob
   /* if this job is cancelled */
   guint              cancelled : 1;
 
-  /* request number returned by ThunarThumbnailer */
-  guint              request;
+  /* the items sent with this job */
+  GSList            *items;
 
   /* handle returned by the tumbler dbus service */
   guint              handle;
@@ -191,6 +349,18 @@ struct _ThunarThumbnailerJob
   DBusGProxyCall    *handle_call;
 };
 
+struct _ThunarThumbnailerRequest
+{
+  /* request number returned by ThunarThumbnailer */
+  guint    request;
+
+  /* if the files are not visible yet */
+  gboolean prefetch;
+
+  /* the items that are not done yet */
+  GSList  *items;
+};
+
 struct _ThunarThumbnailerIdle
 {
   ThunarThumbnailerIdleType  type;
@@ -200,6 +370,34 @@ struct _ThunarThumbnailerIdle
 };
 #endif
 
+struct _ThunarThumbnailerFallback
+{
+  ThunarThumbnailer *thumbnailer;
+  gint               ref_count;
+
+  /* request number returned by ThunarThumbnailer */
+  guint              request;
+  gboolean           prefetch;
+
+  /* if the D-Bus thumbnailer has not finished its part of the request */
+  gboolean           shared;
+
+  /* set when the request is dequeued, read by the threads */
+  gint               cancelled;
+
+  /* number of files that are not done yet */
+  guint              n_pending;
+};
+
+struct _ThunarThumbnailerFallbackTask
+{
+  ThunarThumbnailerFallback *fallback;
+  GFile                     *file;
+  gchar                     *uri;
+  guint64                    mtime;
+  gboolean                   success;
+};
+
 
 
 static guint thumbnailer_signals[LAST_SIGNAL];
@@ -240,8 +438,10 @@ thunar_thumbnailer_class_init (ThunarThumbnailerClass *klass)
 static void
 thunar_thumbnailer_init (ThunarThumbnailer *thumbnailer)
 {
+  ThunarPreferences *preferences;
+  guint              n_threads;
 #ifdef HAVE_DBUS
-  DBusGConnection *connection;
+  DBusGConnection   *connection;
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
   g_mutex_init (&thumbnailer->lock);
@@ -249,6 +449,11 @@ thunar_thumbnailer_init (ThunarThumbnailer *thumbnailer)
   thumbnailer->lock = g_mutex_new ();
 #endif
 
+  /* setup the scheduler */
+  thumbnailer->items = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, thunar_thumbnailer_item_free);
+  g_queue_init (&thumbnailer->waiting);
+  g_queue_init (&thumbnailer->prefetch);
+
   /* try to connect to D-Bus */
   connection = dbus_g_bus_get (DBUS_BUS_SESSION, NULL);
 
@@ -259,6 +464,18 @@ thunar_thumbnailer_init (ThunarThumbnailer *thumbnailer)
   if (connection != NULL)
     dbus_g_connection_unref (connection);
 #endif
+
+  /* setup the built-in thumbnailer, unless it is disabled */
+  preferences = thunar_preferences_get ();
+  g_object_get (G_OBJECT (preferences), "misc-thumbnailer-threads", &n_threads, NULL);
+  g_object_unref (G_OBJECT (preferences));
+  if (n_threads > 0)
+    {
+      thumbnailer->fallback_pool = g_thread_pool_new (thunar_thumbnailer_fallback_thread, NULL,
+                                                      n_threads, FALSE, NULL);
+      g_thread_pool_set_sort_function (thumbnailer->fallback_pool,
+                                       thunar_thumbnailer_fallback_task_compare, NULL);
+    }
 }
 
 
@@ -266,11 +483,11 @@ thunar_thumbnailer_init (ThunarThumbnailer *thumbnailer)
 static void
 thunar_thumbnailer_finalize (GObject *object)
 {
-#ifdef HAVE_DBUS
   ThunarThumbnailer     *thumbnailer = THUNAR_THUMBNAILER (object);
+  GSList                *lp;
+#ifdef HAVE_DBUS
   ThunarThumbnailerIdle *idle;
   ThunarThumbnailerJob  *job;
-  GSList                *lp;
 
   /* acquire the thumbnailer lock */
   _thumbnailer_lock (thumbnailer);
@@ -305,10 +522,19 @@ thunar_thumbnailer_finalize (GObject *object)
             thunar_thumbnailer_proxy_dequeue (thumbnailer->thumbnailer_proxy, job->handle, NULL);
         }
 
-      g_slice_free (ThunarThumbnailerJob, job);
+      thunar_thumbnailer_job_free (job);
     }
   g_slist_free (thumbnailer->jobs);
 
+  /* forget about all requests and items */
+  for (lp = thumbnailer->requests; lp != NULL; lp = lp->next)
+    {
+      g_slist_free (((ThunarThumbnailerRequest *) lp->data)->items);
+      g_slice_free (ThunarThumbnailerRequest, lp->data);
+    }
+  g_slist_free (thumbnailer->requests);
+  g_hash_table_destroy (thumbnailer->items);
+
   /* release the thumbnailer proxy */
   if (thumbnailer->thumbnailer_proxy != NULL)
     g_object_unref (thumbnailer->thumbnailer_proxy);
@@ -328,6 +554,24 @@ thunar_thumbnailer_finalize (GObject *object)
 #endif
 #endif
 
+  /* cancel all requests of the built-in thumbnailer, so the threads skip
+   * the remaining files and pending idle functions do nothing */
+  for (lp = thumbnailer->fallback_requests; lp != NULL; lp = lp->next)
+    {
+      g_atomic_int_set (&((ThunarThumbnailerFallback *) lp->data)->cancelled, TRUE);
+      thunar_thumbnailer_fallback_unref (lp->data);
+    }
+  g_slist_free (thumbnailer->fallback_requests);
+
+  /* wait for the threads of the built-in thumbnailer */
+  if (thumbnailer->fallback_pool != NULL)
+    g_thread_pool_free (thumbnailer->fallback_pool, FALSE, TRUE);
+
+  if (thumbnailer->fallback_types != NULL)
+    g_hash_table_destroy (thumbnailer->fallback_types);
+
+  g_strfreev (thumbnailer->fail_dirs);
+
   (*G_OBJECT_CLASS (thunar_thumbnailer_parent_class)->finalize) (object);
 }
 
@@ -571,11 +815,15 @@ thunar_thumbnailer_thumbnailer_finished (DBusGProxy        *proxy,
                                          ThunarThumbnailer *thumbnailer)
 {
   ThunarThumbnailerJob *job;
+  GSList               *finished = NULL;
   GSList               *lp;
+  GSList               *li;
 
   _thunar_return_if_fail (DBUS_IS_G_PROXY (proxy));
   _thunar_return_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer));
 
+  _thumbnailer_lock (thumbnailer);
+
   for (lp = thumbnailer->jobs; lp != NULL; lp = lp->next)
     {
       job = lp->data;
@@ -585,18 +833,25 @@ thunar_thumbnailer_thumbnailer_finished (DBusGProxy        *proxy,
           /* this job is finished, forget about the handle */
           job->handle = 0;
 
-          /* tell everybody we're done here */
-          g_signal_emit (G_OBJECT (thumbnailer), thumbnailer_signals[REQUEST_FINISHED], 0, job->request);
-
           /* remove job from the list */
-          _thumbnailer_lock (thumbnailer);
           thumbnailer->jobs = g_slist_delete_link (thumbnailer->jobs, lp);
-          _thumbnailer_unlock (thumbnailer);
 
-          g_slice_free (ThunarThumbnailerJob, job);
+          /* all items of the job are done */
+          for (li = job->items; li != NULL; li = li->next)
+            thunar_thumbnailer_item_finish (thumbnailer, li->data, &finished);
+
+          thunar_thumbnailer_job_free (job);
+
+          /* send out the next job */
+          thunar_thumbnailer_schedule (thumbnailer);
           break;
         }
     }
+
+  _thumbnailer_unlock (thumbnailer);
+
+  /* tell everybody we're done here */
+  thunar_thumbnailer_emit_finished (thumbnailer, finished);
 }
 
 
@@ -609,6 +864,8 @@ thunar_thumbnailer_queue_async_reply (DBusGProxy *proxy,
 {
   ThunarThumbnailerJob *job = user_data;
   ThunarThumbnailer    *thumbnailer = THUNAR_THUMBNAILER (job->thumbnailer);
+  GSList               *finished = NULL;
+  GSList               *li;
 
   _thunar_return_if_fail (DBUS_IS_G_PROXY (proxy));
   _thunar_return_if_fail (job != NULL);
@@ -622,61 +879,223 @@ thunar_thumbnailer_queue_async_reply (DBusGProxy *proxy,
   if (job->cancelled)
     {
       /* job is cancelled while there was no handle jet, so dequeue it now */
-      thunar_thumbnailer_proxy_dequeue (proxy, handle, NULL);
+      if (error == NULL)
+        thunar_thumbnailer_proxy_dequeue (proxy, handle, NULL);
 
       /* cleanup */
       thumbnailer->jobs = g_slist_remove (thumbnailer->jobs, job);
-      g_slice_free (ThunarThumbnailerJob, job);
+      thunar_thumbnailer_job_free (job);
     }
   else if (error == NULL)
     {
       /* store the handle returned by tumbler */
       job->handle = handle;
     }
+  else
+    {
+      /* the job could not be queued, so its items are done */
+      thumbnailer->jobs = g_slist_remove (thumbnailer->jobs, job);
+      for (li = job->items; li != NULL; li = li->next)
+        thunar_thumbnailer_item_finish (thumbnailer, li->data, &finished);
+      thunar_thumbnailer_job_free (job);
+
+      /* send out the next job */
+      thunar_thumbnailer_schedule (thumbnailer);
+    }
 
   _thumbnailer_unlock (thumbnailer);
+
+  thunar_thumbnailer_emit_finished (thumbnailer, finished);
 }
 
 
 
-static guint
-thunar_thumbnailer_queue_async (ThunarThumbnailer *thumbnailer,
-                                gchar            **uris,
-                                const gchar      **mime_hints)
+static void
+thunar_thumbnailer_item_free (gpointer data)
 {
-  ThunarThumbnailerJob *job;
-  guint                 request_no;
-
-  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer), 0);
-  _thunar_return_val_if_fail (uris != NULL, 0);
-  _thunar_return_val_if_fail (mime_hints != NULL, 0);
-  _thunar_return_val_if_fail (DBUS_IS_G_PROXY (thumbnailer->thumbnailer_proxy), 0);
-  _thunar_return_val_if_fail (!_thumbnailer_trylock (thumbnailer), 0);
-
-  /* compute the next request ID, making sure it's never 0 */
-  request_no = thumbnailer->last_request + 1;
-  request_no = MAX (request_no, 1);
-
-  /* remember the ID for the next request */
-  thumbnailer->last_request = request_no;
-
-  /* allocate a new struct to follow this job until finished */
-  job = g_slice_new0 (ThunarThumbnailerJob);
-  job->thumbnailer = thumbnailer;
-  job->request = request_no;
-
-  /* store the job */
-  thumbnailer->jobs = g_slist_prepend (thumbnailer->jobs, job);
-
-  /* queue thumbnails for the given URIs asynchronously */
-  job->handle_call = thunar_thumbnailer_proxy_queue_async (thumbnailer->thumbnailer_proxy,
-                                                           (const gchar **)uris, mime_hints,
-                                                           "normal", "foreground", 0,
-                                                           thunar_thumbnailer_queue_async_reply,
-                                                           job);
-
-  /* return the request ID used for this request */
-  return request_no;
+  ThunarThumbnailerItem *item = data;
+
+  g_slist_free (item->requests);
+  g_free (item->mime_hint);
+  g_free (item->uri);
+  g_slice_free (ThunarThumbnailerItem, item);
+}
+
+
+
+static GQueue*
+thunar_thumbnailer_item_queue (ThunarThumbnailer     *thumbnailer,
+                               ThunarThumbnailerItem *item)
+{
+  return item->prefetch ? &thumbnailer->prefetch : &thumbnailer->waiting;
+}
+
+
+
+static void
+thunar_thumbnailer_item_requeue (ThunarThumbnailer     *thumbnailer,
+                                 ThunarThumbnailerItem *item,
+                                 gboolean               to_front)
+{
+  gboolean prefetch = TRUE;
+  GSList  *lp;
+
+  _thunar_return_if_fail (item->job == NULL);
+  _thunar_return_if_fail (!_thumbnailer_trylock (thumbnailer));
+
+  /* an item wanted by any visible request is not prefetched */
+  for (lp = item->requests; prefetch && lp != NULL; lp = lp->next)
+    if (!((ThunarThumbnailerRequest *) lp->data)->prefetch)
+      prefetch = FALSE;
+
+  /* leave the item where it is if it stays in the same queue */
+  if (!to_front && item->prefetch == prefetch)
+    return;
+
+  g_queue_unlink (thunar_thumbnailer_item_queue (thumbnailer, item), &item->link);
+  item->prefetch = prefetch;
+  g_queue_push_head_link (thunar_thumbnailer_item_queue (thumbnailer, item), &item->link);
+}
+
+
+
+static void
+thunar_thumbnailer_item_finish (ThunarThumbnailer      *thumbnailer,
+                                ThunarThumbnailerItem  *item,
+                                GSList                **finished)
+{
+  ThunarThumbnailerRequest *request;
+  GSList                   *lp;
+
+  _thunar_return_if_fail (!_thumbnailer_trylock (thumbnailer));
+
+  for (lp = item->requests; lp != NULL; lp = lp->next)
+    {
+      /* the request no longer waits for the item */
+      request = lp->data;
+      request->items = g_slist_remove (request->items, item);
+
+      /* finish the request if this was its last item */
+      if (request->items == NULL)
+        {
+          *finished = g_slist_prepend (*finished, GUINT_TO_POINTER (request->request));
+          thumbnailer->requests = g_slist_remove (thumbnailer->requests, request);
+          g_slice_free (ThunarThumbnailerRequest, request);
+        }
+    }
+
+  /* drop the item, which releases it */
+  if (item->job == NULL)
+    g_queue_unlink (thunar_thumbnailer_item_queue (thumbnailer, item), &item->link);
+  g_hash_table_remove (thumbnailer->items, item->uri);
+}
+
+
+
+static void
+thunar_thumbnailer_job_free (ThunarThumbnailerJob *job)
+{
+  g_slist_free (job->items);
+  g_slice_free (ThunarThumbnailerJob, job);
+}
+
+
+
+static void
+thunar_thumbnailer_schedule (ThunarThumbnailer *thumbnailer)
+{
+  ThunarThumbnailerItem *item;
+  ThunarThumbnailerJob  *job;
+  const gchar          **mime_hints;
+  const gchar          **uris;
+  GQueue                *queue;
+  GSList                *lp;
+  guint                  n_jobs = 0;
+  guint                  n;
+
+  _thunar_return_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer));
+  _thunar_return_if_fail (DBUS_IS_G_PROXY (thumbnailer->thumbnailer_proxy));
+  _thunar_return_if_fail (!_thumbnailer_trylock (thumbnailer));
+
+  /* count the jobs that are still in flight */
+  for (lp = thumbnailer->jobs; lp != NULL; lp = lp->next)
+    if (!((ThunarThumbnailerJob *) lp->data)->cancelled)
+      n_jobs++;
+
+  for (;; ++n_jobs)
+    {
+      /* prefetched items are only sent when nothing else is to be done */
+      if (n_jobs < THUNAR_THUMBNAILER_MAX_JOBS && thumbnailer->waiting.head != NULL)
+        queue = &thumbnailer->waiting;
+      else if (n_jobs < THUNAR_THUMBNAILER_MAX_PREFETCH_JOBS && thumbnailer->prefetch.head != NULL)
+        queue = &thumbnailer->prefetch;
+      else
+        break;
+
+      /* allocate a new struct to follow this job until finished */
+      job = g_slice_new0 (ThunarThumbnailerJob);
+      job->thumbnailer = thumbnailer;
+
+      /* take the most recently requested items */
+      uris = g_new0 (const gchar *, THUNAR_THUMBNAILER_JOB_SIZE + 1);
+      mime_hints = g_new0 (const gchar *, THUNAR_THUMBNAILER_JOB_SIZE + 1);
+      for (n = 0; n < THUNAR_THUMBNAILER_JOB_SIZE && queue->head != NULL; ++n)
+        {
+          item = queue->head->data;
+          g_queue_unlink (queue, &item->link);
+          item->job = job;
+          job->items = g_slist_prepend (job->items, item);
+
+          uris[n] = item->uri;
+          mime_hints[n] = item->mime_hint;
+        }
+
+      /* store the job */
+      thumbnailer->jobs = g_slist_prepend (thumbnailer->jobs, job);
+
+      /* queue thumbnails for the URIs asynchronously */
+      job->handle_call = thunar_thumbnailer_proxy_queue_async (thumbnailer->thumbnailer_proxy,
+                                                               uris, mime_hints,
+                                                               "normal",
+                                                               queue == &thumbnailer->prefetch
+                                                               ? "background" : "foreground", 0,
+                                                               thunar_thumbnailer_queue_async_reply,
+                                                               job);
+
+      g_free (mime_hints);
+      g_free (uris);
+    }
+}
+
+
+
+static void
+thunar_thumbnailer_emit_finished (ThunarThumbnailer *thumbnailer,
+                                  GSList            *finished)
+{
+  ThunarThumbnailerFallback *fallback;
+  GSList                    *lp;
+  GSList                    *li;
+
+  /* emit outside the lock, handlers may queue new requests */
+  for (lp = finished; lp != NULL; lp = lp->next)
+    {
+      /* leave requests the built-in thumbnailer still works on to it */
+      for (li = thumbnailer->fallback_requests; li != NULL; li = li->next)
+        {
+          fallback = li->data;
+          if (fallback->request == GPOINTER_TO_UINT (lp->data))
+            {
+              fallback->shared = FALSE;
+              break;
+            }
+        }
+
+      if (li == NULL)
+        g_signal_emit (G_OBJECT (thumbnailer), thumbnailer_signals[REQUEST_FINISHED], 0, GPOINTER_TO_UINT (lp->data));
+    }
+
+  g_slist_free (finished);
 }
 
 
@@ -806,6 +1225,555 @@ thunar_thumbnailer_idle_free (gpointer data)
 
 
 
+static gboolean
+thunar_thumbnailer_fallback_is_supported (ThunarThumbnailer *thumbnailer,
+                                          ThunarFile        *file)
+{
+  GSList  *formats;
+  GSList  *lp;
+  gchar  **mime_types;
+  guint    n;
+
+  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), FALSE);
+
+  /* the built-in thumbnailer only reads local files */
+  if (thumbnailer->fallback_pool == NULL || !thunar_file_is_local (file))
+    return FALSE;
+
+  if (G_UNLIKELY (thumbnailer->fallback_types == NULL))
+    {
+      /* collect the MIME types of the raster formats GdkPixbuf can load */
+      thumbnailer->fallback_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      formats = gdk_pixbuf_get_formats ();
+      for (lp = formats; lp != NULL; lp = lp->next)
+        {
+          if (gdk_pixbuf_format_is_disabled (lp->data)
+              || gdk_pixbuf_format_is_scalable (lp->data))
+            continue;
+
+          /* the table takes the strings */
+          mime_types = gdk_pixbuf_format_get_mime_types (lp->data);
+          for (n = 0; mime_types != NULL && mime_types[n] != NULL; ++n)
+            g_hash_table_insert (thumbnailer->fallback_types, mime_types[n], mime_types[n]);
+          g_free (mime_types);
+        }
+      g_slist_free (formats);
+    }
+
+  return (thunar_file_get_content_type (file) != NULL
+          && g_hash_table_lookup (thumbnailer->fallback_types,
+                                  thunar_file_get_content_type (file)) != NULL);
+}
+
+
+
+static void
+thunar_thumbnailer_fallback_queue (ThunarThumbnailer *thumbnailer,
+                                   GList             *files,
+                                   guint              request,
+                                   gboolean           prefetch,
+                                   gboolean           shared)
+{
+  ThunarThumbnailerFallbackTask *task;
+  ThunarThumbnailerFallback     *fallback;
+  GList                         *lp;
+
+  _thunar_return_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer));
+  _thunar_return_if_fail (thumbnailer->fallback_pool != NULL);
+  _thunar_return_if_fail (files != NULL);
+
+  fallback = g_slice_new0 (ThunarThumbnailerFallback);
+  fallback->thumbnailer = thumbnailer;
+  fallback->ref_count = 1;
+  fallback->request = request;
+  fallback->prefetch = prefetch;
+  fallback->shared = shared;
+  thumbnailer->fallback_requests = g_slist_prepend (thumbnailer->fallback_requests, fallback);
+
+  for (lp = files; lp != NULL; lp = lp->next)
+    {
+      thunar_file_set_thumb_state (lp->data, THUNAR_FILE_THUMB_STATE_LOADING);
+
+      /* the threads must not touch the ThunarFile */
+      task = g_slice_new0 (ThunarThumbnailerFallbackTask);
+      task->fallback = fallback;
+      task->file = g_object_ref (thunar_file_get_file (lp->data));
+      task->uri = thunar_file_dup_uri (lp->data);
+      task->mtime = thunar_file_get_date (lp->data, THUNAR_FILE_DATE_MODIFIED);
+
+      g_atomic_int_inc (&fallback->ref_count);
+      fallback->n_pending++;
+
+      g_thread_pool_push (thumbnailer->fallback_pool, task, NULL);
+    }
+}
+
+
+
+static void
+thunar_thumbnailer_fallback_dequeue (ThunarThumbnailer *thumbnailer,
+                                     guint              request)
+{
+  ThunarThumbnailerFallback *fallback;
+  GSList                    *lp;
+
+  _thunar_return_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer));
+
+  for (lp = thumbnailer->fallback_requests; lp != NULL; lp = lp->next)
+    {
+      fallback = lp->data;
+      if (fallback->request == request)
+        {
+          /* the threads skip the remaining files of the request */
+          g_atomic_int_set (&fallback->cancelled, TRUE);
+
+          thumbnailer->fallback_requests = g_slist_delete_link (thumbnailer->fallback_requests, lp);
+          thunar_thumbnailer_fallback_unref (fallback);
+          break;
+        }
+    }
+}
+
+
+
+static void
+thunar_thumbnailer_fallback_unref (ThunarThumbnailerFallback *fallback)
+{
+  if (g_atomic_int_dec_and_test (&fallback->ref_count))
+    g_slice_free (ThunarThumbnailerFallback, fallback);
+}
+
+
+
+static void
+thunar_thumbnailer_fallback_task_free (gpointer data)
+{
+  ThunarThumbnailerFallbackTask *task = data;
+
+  thunar_thumbnailer_fallback_unref (task->fallback);
+  g_object_unref (task->file);
+  g_free (task->uri);
+  g_slice_free (ThunarThumbnailerFallbackTask, task);
+}
+
+
+
+static gint
+thunar_thumbnailer_fallback_task_compare (gconstpointer a,
+                                          gconstpointer b,
+                                          gpointer      user_data)
+{
+  const ThunarThumbnailerFallback *a_fallback = ((const ThunarThumbnailerFallbackTask *) a)->fallback;
+  const ThunarThumbnailerFallback *b_fallback = ((const ThunarThumbnailerFallbackTask *) b)->fallback;
+
+  /* visible files before prefetched ones */
+  if (a_fallback->prefetch != b_fallback->prefetch)
+    return a_fallback->prefetch ? 1 : -1;
+
+  /* the most recent request first */
+  if (a_fallback->request != b_fallback->request)
+    return (a_fallback->request > b_fallback->request) ? -1 : 1;
+
+  return 0;
+}
+
+
+
+static gchar*
+thunar_thumbnailer_build_path (const gchar *flavor,
+                               const gchar *filename)
+{
+  if (strcmp (flavor, "fail") == 0)
+    {
+      return g_build_filename (g_get_user_cache_dir (), "thumbnails", "fail",
+                               PACKAGE "-" PACKAGE_VERSION, filename, NULL);
+    }
+
+  return g_build_filename (g_get_user_cache_dir (), "thumbnails", flavor, filename, NULL);
+}
+
+
+
+static gboolean
+thunar_thumbnailer_read_mtime (const gchar *path,
+                               guint64     *mtime_return)
+{
+  static const guchar  signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  guchar               header[8];
+  gchar                text[64];
+  gchar               *end;
+  guint32              length;
+  gboolean             found = FALSE;
+  FILE                *fp;
+  guint                n;
+
+  fp = g_fopen (path, "rb");
+  if (G_UNLIKELY (fp == NULL))
+    return FALSE;
+
+  /* only read the chunks in front of the image data, the
+   * thumbnail spec stores its keys in tEXt chunks there */
+  if (fread (header, 1, sizeof (header), fp) == sizeof (header)
+      && memcmp (header, signature, sizeof (signature)) == 0)
+    {
+      for (n = 0; !found && n < 32 && fread (header, 1, sizeof (header), fp) == sizeof (header); ++n)
+        {
+          memcpy (&length, header, sizeof (length));
+          length = GUINT32_FROM_BE (length);
+
+          if (memcmp (header + 4, "IDAT", 4) == 0
+              || memcmp (header + 4, "IEND", 4) == 0)
+            break;
+
+          if (memcmp (header + 4, "tEXt", 4) == 0 && length < sizeof (text))
+            {
+              if (fread (text, 1, length, fp) != length)
+                break;
+              text[length] = '\0';
+
+              /* the keyword is terminated by a nul byte, followed by the value */
+              if (length > 13 && strcmp (text, "Thumb::MTime") == 0)
+                {
+                  *mtime_return = g_ascii_strtoull (text + 13, &end, 10);
+                  found = (end != text + 13);
+                }
+
+              /* the data is read */
+              length = 0;
+            }
+
+          /* skip the data and the CRC of the chunk */
+          if (fseek (fp, (glong) length + 4, SEEK_CUR) != 0)
+            break;
+        }
+    }
+
+  fclose (fp);
+
+  return found;
+}
+
+
+
+static gboolean
+thunar_thumbnailer_is_fresh (const gchar *path,
+                             guint64      mtime)
+{
+  guint64 thumb_mtime;
+
+  /* a thumbnail is valid for the modification time it was created for */
+  return (thunar_thumbnailer_read_mtime (path, &thumb_mtime) && thumb_mtime == mtime);
+}
+
+
+
+static gchar**
+thunar_thumbnailer_get_fail_dirs (ThunarThumbnailer *thumbnailer)
+{
+  struct stat  statb;
+  GPtrArray   *fail_dirs;
+  const gchar *name;
+  gchar       *path;
+  GDir        *dir;
+
+  /* every application records its failures in its own directory,
+   * so the list only changes with the mtime of the parent */
+  path = g_build_filename (g_get_user_cache_dir (), "thumbnails", "fail", NULL);
+  if (g_stat (path, &statb) != 0)
+    statb.st_mtime = 0;
+
+  if (thumbnailer->fail_dirs == NULL || thumbnailer->fail_dirs_mtime != statb.st_mtime)
+    {
+      fail_dirs = g_ptr_array_new ();
+
+      dir = g_dir_open (path, 0, NULL);
+      if (dir != NULL)
+        {
+          while ((name = g_dir_read_name (dir)) != NULL)
+            g_ptr_array_add (fail_dirs, g_build_filename (path, name, NULL));
+          g_dir_close (dir);
+        }
+
+      g_ptr_array_add (fail_dirs, NULL);
+
+      g_strfreev (thumbnailer->fail_dirs);
+      thumbnailer->fail_dirs = (gchar **) g_ptr_array_free (fail_dirs, FALSE);
+      thumbnailer->fail_dirs_mtime = statb.st_mtime;
+    }
+
+  g_free (path);
+
+  return thumbnailer->fail_dirs;
+}
+
+
+
+static gboolean
+thunar_thumbnailer_check_cached (ThunarThumbnailer *thumbnailer,
+                                 ThunarFile        *file)
+{
+  const gchar  *thumbnail_path;
+  gboolean      known = FALSE;
+  guint64       mtime;
+  gchar       **fail_dirs;
+  gchar        *checksum;
+  gchar        *filename;
+  gchar        *path;
+  gchar        *uri;
+  guint         n;
+
+  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
+  _thunar_return_val_if_fail (THUNAR_IS_FILE (file), FALSE);
+
+  /* the state was already determined for this version of the file */
+  if (thunar_file_is_thumb_state_known (file))
+    return TRUE;
+
+  mtime = thunar_file_get_date (file, THUNAR_FILE_DATE_MODIFIED);
+
+  /* check if the thumbnail is up to date */
+  thumbnail_path = thunar_file_get_thumbnail_path (file);
+  if (thumbnail_path != NULL && thunar_thumbnailer_is_fresh (thumbnail_path, mtime))
+    {
+      thunar_file_set_thumb_state (file, THUNAR_FILE_THUMB_STATE_READY);
+      return TRUE;
+    }
+
+  /* check if a thumbnailer failed on this version of the file */
+  fail_dirs = thunar_thumbnailer_get_fail_dirs (thumbnailer);
+  uri = thunar_file_dup_uri (file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+  filename = g_strconcat (checksum, ".png", NULL);
+  for (n = 0; !known && fail_dirs[n] != NULL; ++n)
+    {
+      path = g_build_filename (fail_dirs[n], filename, NULL);
+      known = thunar_thumbnailer_is_fresh (path, mtime);
+      g_free (path);
+    }
+  g_free (filename);
+  g_free (checksum);
+  g_free (uri);
+
+  if (known)
+    thunar_file_set_thumb_state (file, THUNAR_FILE_THUMB_STATE_NONE);
+
+  return known;
+}
+
+
+
+static gboolean
+thunar_thumbnailer_fallback_save (GdkPixbuf   *pixbuf,
+                                  const gchar *path,
+                                  const gchar *uri,
+                                  const gchar *mtime)
+{
+  gboolean  succeed = FALSE;
+  gchar    *dirname;
+  gchar    *tmp_path;
+  gint      fd;
+
+  /* the thumbnail directories are private */
+  dirname = g_path_get_dirname (path);
+  g_mkdir_with_parents (dirname, 0700);
+  g_free (dirname);
+
+  /* write to a temporary file, so readers never see a partial thumbnail */
+  tmp_path = g_strconcat (path, ".XXXXXX", NULL);
+  fd = g_mkstemp (tmp_path);
+  if (G_LIKELY (fd >= 0))
+    {
+      close (fd);
+
+      if (gdk_pixbuf_save (pixbuf, tmp_path, "png", NULL,
+                           "tEXt::Thumb::URI", uri,
+                           "tEXt::Thumb::MTime", mtime,
+                           "tEXt::Software", PACKAGE_NAME,
+                           NULL))
+        {
+          succeed = (g_rename (tmp_path, path) == 0);
+        }
+
+      if (!succeed)
+        g_unlink (tmp_path);
+    }
+  g_free (tmp_path);
+
+  return succeed;
+}
+
+
+
+static GdkPixbuf*
+thunar_thumbnailer_fallback_scale (GdkPixbuf *pixbuf,
+                                   gint       size)
+{
+  gint width = gdk_pixbuf_get_width (pixbuf);
+  gint height = gdk_pixbuf_get_height (pixbuf);
+
+  /* thumbnails are never scaled up */
+  if (width <= size && height <= size)
+    return g_object_ref (pixbuf);
+
+  if (width > height)
+    return gdk_pixbuf_scale_simple (pixbuf, size, MAX (height * size / width, 1), GDK_INTERP_BILINEAR);
+  else
+    return gdk_pixbuf_scale_simple (pixbuf, MAX (width * size / height, 1), size, GDK_INTERP_BILINEAR);
+}
+
+
+
+static gboolean
+thunar_thumbnailer_fallback_create (ThunarThumbnailerFallbackTask *task)
+{
+  GdkPixbuf *pixbuf = NULL;
+  GdkPixbuf *oriented;
+  GdkPixbuf *thumbnail;
+  gboolean   succeed = FALSE;
+  gchar     *checksum;
+  gchar     *filename;
+  gchar     *mtime;
+  gchar     *normal_path;
+  gchar     *large_path;
+  gchar     *fail_path;
+  gchar     *path;
+  gint       width;
+  gint       height;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, task->uri, -1);
+  filename = g_strconcat (checksum, ".png", NULL);
+  mtime = g_strdup_printf ("%" G_GUINT64_FORMAT, task->mtime);
+
+  normal_path = thunar_thumbnailer_build_path ("normal", filename);
+  large_path = thunar_thumbnailer_build_path ("large", filename);
+  fail_path = thunar_thumbnailer_build_path ("fail", filename);
+
+  if (thunar_thumbnailer_is_fresh (normal_path, task->mtime))
+    {
+      /* the thumbnail is still up to date */
+      succeed = TRUE;
+    }
+  else if (!thunar_thumbnailer_is_fresh (fail_path, task->mtime))
+    {
+      /* load the image at the size of the large flavor */
+      path = g_file_get_path (task->file);
+      if (path != NULL && gdk_pixbuf_get_file_info (path, &width, &height) != NULL)
+        {
+          if (width > THUNAR_THUMBNAILER_LARGE_SIZE || height > THUNAR_THUMBNAILER_LARGE_SIZE)
+            {
+              pixbuf = gdk_pixbuf_new_from_file_at_scale (path, THUNAR_THUMBNAILER_LARGE_SIZE,
+                                                          THUNAR_THUMBNAILER_LARGE_SIZE, TRUE, NULL);
+            }
+          else
+            {
+              pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+            }
+        }
+      g_free (path);
+
+      if (G_LIKELY (pixbuf != NULL))
+        {
+          /* rotate photos like the camera was held */
+          oriented = gdk_pixbuf_apply_embedded_orientation (pixbuf);
+          g_object_unref (pixbuf);
+          pixbuf = oriented;
+
+          thunar_thumbnailer_fallback_save (pixbuf, large_path, task->uri, mtime);
+
+          thumbnail = thunar_thumbnailer_fallback_scale (pixbuf, THUNAR_THUMBNAILER_NORMAL_SIZE);
+          succeed = thunar_thumbnailer_fallback_save (thumbnail, normal_path, task->uri, mtime);
+          g_object_unref (thumbnail);
+          g_object_unref (pixbuf);
+        }
+
+      if (!succeed)
+        {
+          /* remember the failure until the file changes */
+          pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 1, 1);
+          gdk_pixbuf_fill (pixbuf, 0x00000000);
+          thunar_thumbnailer_fallback_save (pixbuf, fail_path, task->uri, mtime);
+          g_object_unref (pixbuf);
+        }
+    }
+
+  g_free (fail_path);
+  g_free (large_path);
+  g_free (normal_path);
+  g_free (mtime);
+  g_free (filename);
+  g_free (checksum);
+
+  return succeed;
+}
+
+
+
+static void
+thunar_thumbnailer_fallback_thread (gpointer data,
+                                    gpointer user_data)
+{
+  ThunarThumbnailerFallbackTask *task = data;
+
+  /* skip files of dequeued requests */
+  if (g_atomic_int_get (&task->fallback->cancelled))
+    {
+      thunar_thumbnailer_fallback_task_free (task);
+      return;
+    }
+
+  task->success = thunar_thumbnailer_fallback_create (task);
+
+  /* update the file in the main thread */
+  g_idle_add_full (G_PRIORITY_LOW, thunar_thumbnailer_fallback_idle,
+                   task, thunar_thumbnailer_fallback_task_free);
+}
+
+
+
+static gboolean
+thunar_thumbnailer_fallback_idle (gpointer data)
+{
+  ThunarThumbnailerFallbackTask *task = data;
+  ThunarThumbnailerFallback     *fallback = task->fallback;
+  ThunarThumbnailer             *thumbnailer;
+  ThunarFile                    *file;
+  gboolean                       shared;
+  guint                          request;
+
+  /* the request, or the thumbnailer, is gone */
+  if (g_atomic_int_get (&fallback->cancelled))
+    return FALSE;
+
+  file = thunar_file_cache_lookup (task->file);
+  if (file != NULL)
+    {
+      if (task->success)
+        thunar_file_set_thumb_state (file, THUNAR_FILE_THUMB_STATE_READY);
+      else if (thunar_file_get_thumb_state (file) != THUNAR_FILE_THUMB_STATE_READY)
+        thunar_file_set_thumb_state (file, THUNAR_FILE_THUMB_STATE_NONE);
+      g_object_unref (file);
+    }
+
+  if (--fallback->n_pending == 0)
+    {
+      /* the request is finished */
+      thumbnailer = fallback->thumbnailer;
+      request = fallback->request;
+      shared = fallback->shared;
+      thumbnailer->fallback_requests = g_slist_remove (thumbnailer->fallback_requests, fallback);
+      thunar_thumbnailer_fallback_unref (fallback);
+
+      /* otherwise the D-Bus thumbnailer emits once its part is done */
+      if (!shared)
+        g_signal_emit (G_OBJECT (thumbnailer), thumbnailer_signals[REQUEST_FINISHED], 0, request);
+    }
+
+  return FALSE;
+}
+
+
+
 /**
  * thunar_thumbnailer_get:
  *
@@ -858,22 +1826,26 @@ thunar_thumbnailer_queue_file (ThunarThumbnailer *thumbnailer,
 
 
 
-gboolean
-thunar_thumbnailer_queue_files (ThunarThumbnailer *thumbnailer,
-                                gboolean           lazy_checks,
-                                GList             *files,
-                                guint             *request)
+static gboolean
+thunar_thumbnailer_queue_files_real (ThunarThumbnailer *thumbnailer,
+                                     gboolean           lazy_checks,
+                                     gboolean           prefetch,
+                                     GList             *files,
+                                     guint             *request)
 {
-  gboolean               success = FALSE;
+  gboolean                  success = FALSE;
+  gboolean                  shared;
+  GList                    *lp;
+  GList                    *fallback_files = NULL;
+  guint                     request_id = 0;
+  ThunarFileThumbState      thumb_state;
+  const gchar              *thumbnail_path;
 #ifdef HAVE_DBUS
-  const gchar          **mime_hints;
-  gchar                **uris;
-  GList                 *lp;
-  GList                 *supported_files = NULL;
-  guint                  n;
-  guint                  n_items = 0;
-  ThunarFileThumbState   thumb_state;
-  const gchar           *thumbnail_path;
+  ThunarThumbnailerRequest *req;
+  ThunarThumbnailerItem    *item;
+  gchar                    *uri;
+  GList                    *supported_files = NULL;
+  guint                     n_items = 0;
 #endif
 
   _thunar_return_val_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
@@ -883,15 +1855,10 @@ thunar_thumbnailer_queue_files (ThunarThumbnailer *thumbnailer,
   /* acquire the thumbnailer lock */
   _thumbnailer_lock (thumbnailer);
 
-  if (thumbnailer->thumbnailer_proxy == NULL)
-    {
-      /* release the lock and abort */
-      _thumbnailer_unlock (thumbnailer);
-      return FALSE;
-    }
-
   /* make sure there is a hash table with supported files */
-  thunar_thumbnailer_get_supported_types (thumbnailer);
+  if (thumbnailer->thumbnailer_proxy != NULL)
+    thunar_thumbnailer_get_supported_types (thumbnailer);
+#endif
 
   /* collect all supported files from the list that are neither in the
    * about to be queued (wait queue), nor already queued, nor already
@@ -917,12 +1884,27 @@ thunar_thumbnailer_queue_files (ThunarThumbnailer *thumbnailer,
             continue;
         }
 
+      /* skip files with an up to date thumbnail or failure marker,
+       * so unchanged files are not sent to a thumbnailer again */
+      if (thunar_thumbnailer_check_cached (thumbnailer, lp->data))
+        continue;
+
+#ifdef HAVE_DBUS
       /* check if the file is supported, assume it is when the state was ready previously */
-      if (thumb_state == THUNAR_FILE_THUMB_STATE_READY
-          || thunar_thumbnailer_file_is_supported (thumbnailer, lp->data))
+      if (thumbnailer->thumbnailer_proxy != NULL
+          && (thumb_state == THUNAR_FILE_THUMB_STATE_READY
+              || thunar_thumbnailer_file_is_supported (thumbnailer, lp->data)))
         {
           supported_files = g_list_prepend (supported_files, lp->data);
           n_items++;
+          continue;
+        }
+#endif
+
+      if (thunar_thumbnailer_fallback_is_supported (thumbnailer, lp->data))
+        {
+          /* no thumbnailer service handles the file, but we can */
+          fallback_files = g_list_prepend (fallback_files, lp->data);
         }
       else
         {
@@ -931,51 +1913,74 @@ thunar_thumbnailer_queue_files (ThunarThumbnailer *thumbnailer,
           thumbnail_path = thunar_file_get_thumbnail_path (lp->data);
 
           /* test if a thumbnail can be found */
-          if (g_file_test (thumbnail_path, G_FILE_TEST_EXISTS))
+          if (thumbnail_path != NULL && g_file_test (thumbnail_path, G_FILE_TEST_EXISTS))
             thunar_file_set_thumb_state (lp->data, THUNAR_FILE_THUMB_STATE_READY);
           else
             thunar_file_set_thumb_state (lp->data, THUNAR_FILE_THUMB_STATE_NONE);
         }
     }
 
+#ifdef HAVE_DBUS
   /* release the thumbnailer lock */
   _thumbnailer_unlock (thumbnailer);
 
   /* check if we have any supported files */
   if (n_items > 0)
     {
-      /* allocate arrays for URIs and mime hints */
-      uris = g_new0 (gchar *, n_items + 1);
-      mime_hints = g_new0 (const gchar *, n_items + 1);
+      /* set the thumbnail state to loading, outside the lock
+       * because this emits signals on the files */
+      for (lp = supported_files; lp != NULL; lp = lp->next)
+        thunar_file_set_thumb_state (lp->data, THUNAR_FILE_THUMB_STATE_LOADING);
+
+      _thumbnailer_lock (thumbnailer);
 
-      /* fill URI and MIME hint arrays with items from the wait queue */
-      for (lp = supported_files, n = 0; lp != NULL; lp = lp->next, ++n)
+      /* allocate a new request, making sure its ID is never 0 */
+      req = g_slice_new0 (ThunarThumbnailerRequest);
+      req->request = request_id = MAX (thumbnailer->last_request + 1, 1);
+      req->prefetch = prefetch;
+      thumbnailer->last_request = req->request;
+      thumbnailer->requests = g_slist_prepend (thumbnailer->requests, req);
+
+      /* the list of supported files is reversed, so pushing them to the
+       * head of the wait queue keeps the order of the caller */
+      for (lp = supported_files; lp != NULL; lp = lp->next)
         {
-          /* set the thumbnail state to loading */
-          thunar_file_set_thumb_state (lp->data, THUNAR_FILE_THUMB_STATE_LOADING);
+          uri = thunar_file_dup_uri (lp->data);
 
-          /* save URI and MIME hint in the arrays */
-          uris[n] = thunar_file_dup_uri (lp->data);
-          mime_hints[n] = thunar_file_get_content_type (lp->data);
-        }
+          /* check if the thumbnail was already requested */
+          item = g_hash_table_lookup (thumbnailer->items, uri);
+          if (G_LIKELY (item == NULL))
+            {
+              item = g_slice_new0 (ThunarThumbnailerItem);
+              item->uri = uri;
+              item->mime_hint = g_strdup (thunar_file_get_content_type (lp->data));
+              item->prefetch = prefetch;
+              item->link.data = item;
+              g_hash_table_insert (thumbnailer->items, item->uri, item);
+              g_queue_push_head_link (thunar_thumbnailer_item_queue (thumbnailer, item), &item->link);
+            }
+          else
+            {
+              g_free (uri);
 
-      /* NULL-terminate both arrays */
-      uris[n] = NULL;
-      mime_hints[n] = NULL;
+              /* skip files that are in the list twice */
+              if (g_slist_find (item->requests, req) != NULL)
+                continue;
+            }
 
-      _thumbnailer_lock (thumbnailer);
+          /* the request waits for the item */
+          item->requests = g_slist_prepend (item->requests, req);
+          req->items = g_slist_prepend (req->items, item);
 
-      /* queue a thumbnail request for the URIs from the wait queue */
-      if (request != NULL)
-        *request = thunar_thumbnailer_queue_async (thumbnailer, uris, mime_hints);
-      else
-        thunar_thumbnailer_queue_async (thumbnailer, uris, mime_hints);
+          /* a waiting item is wanted again, so move it to the front */
+          if (item->job == NULL)
+            thunar_thumbnailer_item_requeue (thumbnailer, item, TRUE);
+        }
 
-      _thumbnailer_unlock (thumbnailer);
+      /* send out the most recently requested thumbnails */
+      thunar_thumbnailer_schedule (thumbnailer);
 
-      /* free mime hints array */
-      g_free (mime_hints);
-      g_strfreev (uris);
+      _thumbnailer_unlock (thumbnailer);
 
       /* free the list of supported files */
       g_list_free (supported_files);
@@ -985,18 +1990,82 @@ thunar_thumbnailer_queue_files (ThunarThumbnailer *thumbnailer,
     }
 #endif /* HAVE_DBUS */
 
+  if (fallback_files != NULL)
+    {
+      /* share the ID of the request to the D-Bus thumbnailer, which
+       * then finishes the request if it is done after us */
+      shared = (request_id != 0);
+      if (!shared)
+        request_id = thumbnailer->last_request = MAX (thumbnailer->last_request + 1, 1);
+
+      /* keep the order of the caller */
+      fallback_files = g_list_reverse (fallback_files);
+      thunar_thumbnailer_fallback_queue (thumbnailer, fallback_files, request_id, prefetch, shared);
+      g_list_free (fallback_files);
+
+      success = TRUE;
+    }
+
+  if (success && request != NULL)
+    *request = request_id;
+
   return success;
 }
 
 
 
+gboolean
+thunar_thumbnailer_queue_files (ThunarThumbnailer *thumbnailer,
+                                gboolean           lazy_checks,
+                                GList             *files,
+                                guint             *request)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
+  _thunar_return_val_if_fail (files != NULL, FALSE);
+
+  return thunar_thumbnailer_queue_files_real (thumbnailer, lazy_checks, FALSE, files, request);
+}
+
+
+
+/**
+ * thunar_thumbnailer_prefetch_files:
+ * @thumbnailer : a #ThunarThumbnailer.
+ * @files       : the files that will probably be visible soon.
+ * @request     : return location for the request ID, or %NULL.
+ *
+ * Like thunar_thumbnailer_queue_files() with lazy checks, but the
+ * thumbnails are only generated when no thumbnails of visible
+ * files are pending.
+ *
+ * Return value: %TRUE if thumbnails were requested for any of the
+ *               @files.
+ **/
+gboolean
+thunar_thumbnailer_prefetch_files (ThunarThumbnailer *thumbnailer,
+                                   GList             *files,
+                                   guint             *request)
+{
+  _thunar_return_val_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
+  _thunar_return_val_if_fail (files != NULL, FALSE);
+
+  return thunar_thumbnailer_queue_files_real (thumbnailer, TRUE, TRUE, files, request);
+}
+
+
+
 void
 thunar_thumbnailer_dequeue (ThunarThumbnailer *thumbnailer,
                             guint              request)
 {
 #ifdef HAVE_DBUS
-  ThunarThumbnailerJob *job;
-  GSList               *lp;
+  ThunarThumbnailerRequest *req;
+  ThunarThumbnailerItem    *item;
+  ThunarThumbnailerJob     *job;
+  GSList                   *lp;
+  GSList                   *li;
+  GSList                   *next;
+  gboolean                  wanted;
 #endif
 
   _thunar_return_if_fail (THUNAR_IS_THUMBNAILER (thumbnailer));
@@ -1005,16 +2074,63 @@ thunar_thumbnailer_dequeue (ThunarThumbnailer *thumbnailer,
   /* acquire the thumbnailer lock */
   _thumbnailer_lock (thumbnailer);
 
-  for (lp = thumbnailer->jobs; lp != NULL; lp = lp->next)
+  /* find the request in the list */
+  for (lp = thumbnailer->requests; lp != NULL; lp = lp->next)
+    if (((ThunarThumbnailerRequest *) lp->data)->request == request)
+      break;
+
+  if (lp != NULL)
     {
-      job = lp->data;
+      req = lp->data;
+      thumbnailer->requests = g_slist_delete_link (thumbnailer->requests, lp);
+
+      for (li = req->items; li != NULL; li = li->next)
+        {
+          item = li->data;
+          item->requests = g_slist_remove (item->requests, req);
+
+          if (item->job != NULL)
+            continue;
+
+          /* drop waiting items nobody else is interested in */
+          if (item->requests == NULL)
+            {
+              g_queue_unlink (thunar_thumbnailer_item_queue (thumbnailer, item), &item->link);
+              g_hash_table_remove (thumbnailer->items, item->uri);
+            }
+          else if (!req->prefetch)
+            {
+              /* move the item to the prefetch queue if no
+               * visible request wants it anymore */
+              thunar_thumbnailer_item_requeue (thumbnailer, item, FALSE);
+            }
+        }
 
-      /* find the request in the list */
-      if (job->request == request)
+      g_slist_free (req->items);
+      g_slice_free (ThunarThumbnailerRequest, req);
+
+      /* dequeue the jobs whose items are no longer wanted */
+      for (lp = thumbnailer->jobs; lp != NULL; lp = next)
         {
+          next = lp->next;
+          job = lp->data;
+          if (job->cancelled)
+            continue;
+
+          for (li = job->items, wanted = FALSE; !wanted && li != NULL; li = li->next)
+            wanted = (((ThunarThumbnailerItem *) li->data)->requests != NULL);
+          if (wanted)
+            continue;
+
           /* this job is cancelled */
           job->cancelled = TRUE;
 
+          /* forget about its items */
+          for (li = job->items; li != NULL; li = li->next)
+            g_hash_table_remove (thumbnailer->items, ((ThunarThumbnailerItem *) li->data)->uri);
+          g_slist_free (job->items);
+          job->items = NULL;
+
           if (job->handle != 0)
             {
               /* dequeue the tumbler request */
@@ -1023,14 +2139,19 @@ thunar_thumbnailer_dequeue (ThunarThumbnailer *thumbnailer,
 
               /* remove job */
               thumbnailer->jobs = g_slist_delete_link (thumbnailer->jobs, lp);
-              g_slice_free (ThunarThumbnailerJob, job);
+              thunar_thumbnailer_job_free (job);
             }
-
-          break;
         }
+
+      /* use the free slots for the remaining requests */
+      if (thumbnailer->thumbnailer_proxy != NULL)
+        thunar_thumbnailer_schedule (thumbnailer);
     }
 
   /* release the thumbnailer lock */
   _thumbnailer_unlock (thumbnailer);
 #endif
+
+  /* cancel the files the built-in thumbnailer has not done yet */
+  thunar_thumbnailer_fallback_dequeue (thumbnailer, request);
 }
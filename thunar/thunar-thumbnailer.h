@@ -46,6 +46,9 @@ gboolean           thunar_thumbnailer_queue_files     (ThunarThumbnailer
                                                        gboolean                  lazy_checks,
                                                        GList                    *files,
                                                        guint                    *request);
+gboolean           thunar_thumbnailer_prefetch_files  (ThunarThumbnailer        *thumbnailer,
+                                                       GList                    *files,
+                                                       guint                    *request);
 void               thunar_thumbnailer_dequeue         (ThunarThumbnailer        *thumbnailer,
                                                        guint                     request);
 
@@ -23,23 +23,36 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_MEMORY_H
+#include <memory.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
 #include <gio/gio.h>
 
 #include <thunar/thunar-application.h>
 #include <thunar/thunar-gio-extensions.h>
 #include <thunar/thunar-io-scan-directory.h>
 #include <thunar/thunar-io-jobs-util.h>
+#include <thunar/thunar-io-large-file.h>
 #include <thunar/thunar-job.h>
 #include <thunar/thunar-preferences.h>
 #include <thunar/thunar-private.h>
 #include <thunar/thunar-thumbnail-cache.h>
 #include <thunar/thunar-transfer-job.h>
+#include <thunar/thunar-transfer-journal.h>
+#include <thunar/thunar-transfer-queue.h>
 
 
 
 /* seconds before we show the transfer rate + remaining time */
 #define MINIMUM_TRANSFER_TIME (10 * G_USEC_PER_SEC) /* 10 seconds */
 
+/* chunk size used to compare file contents in sync mode */
+#define COMPARE_BUFFER_SIZE (64 * 1024)
+
 
 
 /* Property identifiers */
@@ -49,6 +62,13 @@ enum
   PROP_FILE_SIZE_BINARY,
 };
 
+/* Signal identifiers */
+enum
+{
+  QUEUED,
+  LAST_SIGNAL,
+};
+
 
 
 typedef struct _ThunarTransferNode ThunarTransferNode;
@@ -93,6 +113,27 @@ struct _ThunarTransferJob
   guint64               total_progress;
   guint64               file_progress;
   guint64               transfer_rate;
+  guint64               skipped_size;
+
+  ThunarTransferSyncMode sync_mode;
+
+  guint64               large_file_threshold;
+  gsize                 large_file_buffer_size;
+
+  /* journal to resume the transfer and the file being copied */
+  ThunarTransferJournal *journal;
+  gboolean              journal_enabled;
+  GFile                *journal_source_file;
+  GFile                *journal_target_file;
+  guint64               journal_size;
+  guint64               journal_mtime;
+  gboolean              journal_partial;
+
+  /* names in the folders we create duplicates in */
+  GHashTable           *name_index;
+
+  /* serializes transfers touching the same device */
+  ThunarTransferQueue  *queue;
 
   ThunarPreferences    *preferences;
   gboolean              file_size_binary;
@@ -107,6 +148,10 @@ struct _ThunarTransferNode
 
 
 
+static guint transfer_job_signals[LAST_SIGNAL];
+
+
+
 G_DEFINE_TYPE (ThunarTransferJob, thunar_transfer_job, THUNAR_TYPE_JOB)
 
 
@@ -114,16 +159,16 @@ G_DEFINE_TYPE (ThunarTransferJob, thunar_transfer_job, THUNAR_TYPE_JOB)
 static void
 thunar_transfer_job_class_init (ThunarTransferJobClass *klass)
 {
-  GObjectClass *gobject_class;
-  ExoJobClass  *exojob_class;
+  GObjectClass   *gobject_class;
+  ThunarJobClass *thunarjob_class;
 
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->finalize = thunar_transfer_job_finalize;
   gobject_class->get_property = thunar_transfer_job_get_property;
   gobject_class->set_property = thunar_transfer_job_set_property;
 
-  exojob_class = EXO_JOB_CLASS (klass);
-  exojob_class->execute = thunar_transfer_job_execute;
+  thunarjob_class = THUNAR_JOB_CLASS (klass);
+  thunarjob_class->execute = thunar_transfer_job_execute;
 
   /**
    * ThunarPropertiesDialog:file_size_binary:
@@ -137,6 +182,21 @@ thunar_transfer_job_class_init (ThunarTransferJobClass *klass)
                                                          NULL,
                                                          FALSE,
                                                          EXO_PARAM_READWRITE));
+
+  /**
+   * ThunarTransferJob::queued:
+   * @job    : a #ThunarTransferJob.
+   * @queued : whether the @job waits for other transfers.
+   *
+   * Emitted when the @job has to wait for other transfers on the
+   * same devices to finish, and again once it starts.
+   **/
+  transfer_job_signals[QUEUED] =
+    g_signal_new (I_("queued"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_NO_HOOKS, 0, NULL, NULL,
+                  g_cclosure_marshal_VOID__BOOLEAN,
+                  G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
 }
 
 
@@ -144,10 +204,16 @@ thunar_transfer_job_class_init (ThunarTransferJobClass *klass)
 static void
 thunar_transfer_job_init (ThunarTransferJob *job)
 {
+  guint threshold;
+  guint buffer_size;
+
   job->preferences = thunar_preferences_get ();
   exo_binding_new (G_OBJECT (job->preferences), "misc-file-size-binary",
                    G_OBJECT (job), "file-size-binary");
 
+  /* transfers are limited per device by the transfer queue */
+  thunar_job_set_priority (THUNAR_JOB (job), THUNAR_JOB_PRIORITY_TRANSFER);
+
   job->type = 0;
   job->source_node_list = NULL;
   job->target_file_list = NULL;
@@ -158,6 +224,28 @@ thunar_transfer_job_init (ThunarTransferJob *job)
   job->last_total_progress = 0;
   job->transfer_rate = 0;
   job->start_time = 0;
+  job->skipped_size = 0;
+
+  /* whether to skip files that are already up to date at the destination */
+  g_object_get (G_OBJECT (job->preferences), "misc-transfer-sync-mode", &job->sync_mode, NULL);
+
+  /* settings for the large file copy engine, stored in MiB and KiB */
+  g_object_get (G_OBJECT (job->preferences),
+                "misc-transfer-large-file-threshold", &threshold,
+                "misc-transfer-large-file-buffer-size", &buffer_size,
+                NULL);
+  job->large_file_threshold = (guint64) threshold * 1024 * 1024;
+  job->large_file_buffer_size = (gsize) buffer_size * 1024;
+
+  /* whether to keep a journal to resume interrupted transfers */
+  g_object_get (G_OBJECT (job->preferences), "misc-transfer-journal", &job->journal_enabled, NULL);
+  job->journal = NULL;
+  job->journal_source_file = NULL;
+  job->journal_target_file = NULL;
+
+  job->queue = thunar_transfer_queue_get ();
+
+  job->name_index = thunar_io_jobs_util_name_index_new ();
 }
 
 
@@ -171,6 +259,13 @@ thunar_transfer_job_finalize (GObject *object)
 
   thunar_g_file_list_free (job->target_file_list);
 
+  /* an interrupted transfer keeps its journal file */
+  if (job->journal != NULL)
+    thunar_transfer_journal_free (job->journal);
+
+  g_hash_table_destroy (job->name_index);
+
+  g_object_unref (job->queue);
   g_object_unref (job->preferences);
 
   (*G_OBJECT_CLASS (thunar_transfer_job_parent_class)->finalize) (object);
@@ -274,6 +369,47 @@ thunar_transfer_job_progress (goffset  current_num_bytes,
 
 
 
+static void
+ttj_journal_progress (goffset  current_num_bytes,
+                      goffset  total_num_bytes,
+                      gpointer user_data)
+{
+  ThunarTransferJob *job = user_data;
+
+  /* the first progress means the target was created by us, so it
+   * can be replaced without asking if the transfer is resumed */
+  if (job->journal_source_file != NULL && !job->journal_partial)
+    {
+      thunar_transfer_journal_set_partial (job->journal, job->journal_source_file,
+                                           job->journal_target_file, 0,
+                                           job->journal_size, job->journal_mtime);
+      job->journal_partial = TRUE;
+    }
+
+  thunar_transfer_job_progress (current_num_bytes, total_num_bytes, user_data);
+}
+
+
+
+static void
+ttj_journal_checkpoint (goffset  current_num_bytes,
+                        goffset  total_num_bytes,
+                        gpointer user_data)
+{
+  ThunarTransferJob *job = user_data;
+
+  _thunar_return_if_fail (job->journal_source_file != NULL);
+
+  /* the data up to this offset is on disk */
+  thunar_transfer_journal_set_partial (job->journal, job->journal_source_file,
+                                       job->journal_target_file, current_num_bytes,
+                                       job->journal_size, job->journal_mtime);
+  thunar_transfer_journal_sync (job->journal);
+  job->journal_partial = TRUE;
+}
+
+
+
 static gboolean
 thunar_transfer_job_collect_node (ThunarTransferJob  *job,
                                   ThunarTransferNode *node,
@@ -292,6 +428,10 @@ thunar_transfer_job_collect_node (ThunarTransferJob  *job,
   if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
     return FALSE;
 
+  /* nodes completed before the transfer was interrupted are not copied again */
+  if (job->journal != NULL && thunar_transfer_journal_is_completed (job->journal, node->source_file))
+    return TRUE;
+
   info = g_file_query_info (node->source_file,
                             G_FILE_ATTRIBUTE_STANDARD_SIZE ","
                             G_FILE_ATTRIBUTE_STANDARD_TYPE,
@@ -351,12 +491,18 @@ ttj_copy_file (ThunarTransferJob *job,
                GFile             *target_file,
                GFileCopyFlags     copy_flags,
                gboolean           merge_directories,
+               goffset            resume_offset,
                GError           **error)
 {
-  GFileType source_type;
-  GFileType target_type;
-  gboolean  target_exists;
-  GError   *err = NULL;
+  GFileProgressCallback progress_callback = thunar_transfer_job_progress;
+  GFileInfo            *source_info;
+  GFileType             source_type = G_FILE_TYPE_UNKNOWN;
+  GFileType             target_type;
+  guint64               source_size = 0;
+  guint64               source_mtime = 0;
+  gboolean              target_exists;
+  gboolean              copied = FALSE;
+  GError               *err = NULL;
 
   _thunar_return_val_if_fail (THUNAR_IS_TRANSFER_JOB (job), FALSE);
   _thunar_return_val_if_fail (G_IS_FILE (source_file), FALSE);
@@ -369,8 +515,32 @@ ttj_copy_file (ThunarTransferJob *job,
   if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
     return FALSE;
 
-  source_type = g_file_query_file_type (source_file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                        exo_job_get_cancellable (EXO_JOB (job)));
+  source_info = g_file_query_info (source_file,
+                                   G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                   G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                   exo_job_get_cancellable (EXO_JOB (job)),
+                                   NULL);
+  if (G_LIKELY (source_info != NULL))
+    {
+      source_type = g_file_info_get_file_type (source_info);
+      source_size = g_file_info_get_size (source_info);
+      source_mtime = g_file_info_get_attribute_uint64 (source_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+      g_object_unref (source_info);
+    }
+
+  /* remember the file, so partial copies can be recorded in the journal */
+  job->journal_source_file = NULL;
+  if (job->journal != NULL && source_type == G_FILE_TYPE_REGULAR)
+    {
+      job->journal_source_file = source_file;
+      job->journal_target_file = target_file;
+      job->journal_size = source_size;
+      job->journal_mtime = source_mtime;
+      job->journal_partial = (resume_offset > 0);
+      progress_callback = ttj_journal_progress;
+    }
 
   if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
     return FALSE;
@@ -392,10 +562,37 @@ ttj_copy_file (ThunarTransferJob *job,
         }
     }
 
+  /* copy big local files with preallocation and without trashing the page cache */
+  if (job->large_file_threshold > 0
+      && source_size >= job->large_file_threshold
+      && source_type == G_FILE_TYPE_REGULAR
+      && (target_type == G_FILE_TYPE_UNKNOWN || target_type == G_FILE_TYPE_REGULAR)
+      && g_file_is_native (source_file)
+      && g_file_is_native (target_file))
+    {
+      copied = thunar_io_large_file_copy (source_file, target_file, copy_flags,
+                                          job->large_file_buffer_size, resume_offset,
+                                          exo_job_get_cancellable (EXO_JOB (job)),
+                                          thunar_transfer_job_progress,
+                                          job->journal_source_file != NULL ? ttj_journal_checkpoint : NULL,
+                                          job, &err);
+
+      /* fall back to GIO if the file cannot be handled */
+      if (!copied && g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        g_clear_error (&err);
+      else
+        copied = TRUE;
+    }
+
   /* try to copy the file */
-  g_file_copy (source_file, target_file, copy_flags,
-               exo_job_get_cancellable (EXO_JOB (job)),
-               thunar_transfer_job_progress, job, &err);
+  if (!copied)
+    {
+      g_file_copy (source_file, target_file, copy_flags,
+                   exo_job_get_cancellable (EXO_JOB (job)),
+                   progress_callback, job, &err);
+    }
+
+  job->journal_source_file = NULL;
 
   /* check if there were errors */
   if (G_UNLIKELY (err != NULL && err->domain == G_IO_ERROR))
@@ -466,6 +663,171 @@ ttj_copy_file (ThunarTransferJob *job,
 
 
 
+static gboolean
+ttj_contents_equal (ThunarTransferJob *job,
+                    GFile             *source_file,
+                    GFile             *target_file)
+{
+  GFileInputStream *source_stream;
+  GFileInputStream *target_stream;
+  gboolean          equal = FALSE;
+  guchar           *source_buffer;
+  guchar           *target_buffer;
+  gsize             source_len;
+  gsize             target_len;
+
+  source_stream = g_file_read (source_file, exo_job_get_cancellable (EXO_JOB (job)), NULL);
+  if (G_UNLIKELY (source_stream == NULL))
+    return FALSE;
+
+  target_stream = g_file_read (target_file, exo_job_get_cancellable (EXO_JOB (job)), NULL);
+  if (G_UNLIKELY (target_stream == NULL))
+    {
+      g_object_unref (source_stream);
+      return FALSE;
+    }
+
+  source_buffer = g_malloc (COMPARE_BUFFER_SIZE);
+  target_buffer = g_malloc (COMPARE_BUFFER_SIZE);
+
+  /* compare both files chunk by chunk, bailing out on the first difference */
+  while (!exo_job_is_cancelled (EXO_JOB (job)))
+    {
+      if (!g_input_stream_read_all (G_INPUT_STREAM (source_stream), source_buffer,
+                                    COMPARE_BUFFER_SIZE, &source_len,
+                                    exo_job_get_cancellable (EXO_JOB (job)), NULL)
+          || !g_input_stream_read_all (G_INPUT_STREAM (target_stream), target_buffer,
+                                       COMPARE_BUFFER_SIZE, &target_len,
+                                       exo_job_get_cancellable (EXO_JOB (job)), NULL))
+        break;
+
+      if (source_len != target_len
+          || memcmp (source_buffer, target_buffer, source_len) != 0)
+        break;
+
+      /* both files ended at the same position */
+      if (source_len == 0)
+        {
+          equal = TRUE;
+          break;
+        }
+    }
+
+  g_free (source_buffer);
+  g_free (target_buffer);
+
+  g_object_unref (source_stream);
+  g_object_unref (target_stream);
+
+  return equal;
+}
+
+
+
+/* checks whether @target_file already holds an up to date copy of
+ * @source_file according to the sync mode of the @job. If it doesn't,
+ * @outdated_return is set to %TRUE when the target is an older regular
+ * file that can be replaced without asking the user */
+static gboolean
+ttj_is_unchanged (ThunarTransferJob *job,
+                  GFile             *source_file,
+                  GFile             *target_file,
+                  guint64           *size_return,
+                  gboolean          *outdated_return)
+{
+  GFileInfo *source_info;
+  GFileInfo *target_info;
+  gboolean   unchanged = FALSE;
+  guint64    source_mtime;
+  guint64    target_mtime;
+
+  _thunar_return_val_if_fail (job->sync_mode != THUNAR_TRANSFER_SYNC_MODE_NEVER, FALSE);
+
+  *outdated_return = FALSE;
+
+  source_info = g_file_query_info (source_file,
+                                   G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                   G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                   exo_job_get_cancellable (EXO_JOB (job)),
+                                   NULL);
+  if (G_UNLIKELY (source_info == NULL))
+    return FALSE;
+
+  /* this fails if the target does not exist yet */
+  target_info = g_file_query_info (target_file,
+                                   G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                   G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                   exo_job_get_cancellable (EXO_JOB (job)),
+                                   NULL);
+  if (target_info == NULL)
+    {
+      g_object_unref (source_info);
+      return FALSE;
+    }
+
+  /* directories are merged anyway and their children compared one by one */
+  if (g_file_info_get_file_type (source_info) == G_FILE_TYPE_REGULAR
+      && g_file_info_get_file_type (target_info) == G_FILE_TYPE_REGULAR)
+    {
+      source_mtime = g_file_info_get_attribute_uint64 (source_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+      target_mtime = g_file_info_get_attribute_uint64 (target_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+      *size_return = g_file_info_get_size (source_info);
+
+      if (g_file_info_get_size (source_info) == g_file_info_get_size (target_info))
+        {
+          if (job->sync_mode == THUNAR_TRANSFER_SYNC_MODE_CONTENTS)
+            unchanged = ttj_contents_equal (job, source_file, target_file);
+          else
+            unchanged = (source_mtime == target_mtime);
+        }
+
+      /* never silently replace a target that was modified after the source */
+      *outdated_return = !unchanged && target_mtime <= source_mtime;
+    }
+
+  g_object_unref (source_info);
+  g_object_unref (target_info);
+
+  return unchanged;
+}
+
+
+
+/* checks whether @source_file still has the @size and @mtime recorded
+ * in the journal when its partial copy was written */
+static gboolean
+ttj_source_matches (ThunarTransferJob *job,
+                    GFile             *source_file,
+                    guint64            size,
+                    guint64            mtime)
+{
+  GFileInfo *info;
+  gboolean   matches;
+
+  info = g_file_query_info (source_file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                            exo_job_get_cancellable (EXO_JOB (job)),
+                            NULL);
+  if (G_UNLIKELY (info == NULL))
+    return FALSE;
+
+  matches = ((guint64) g_file_info_get_size (info) == size
+             && g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) == mtime);
+
+  g_object_unref (info);
+
+  return matches;
+}
+
+
+
 /**
  * thunar_transfer_job_copy_file:
  * @job                : a #ThunarTransferJob.
@@ -497,7 +859,10 @@ thunar_transfer_job_copy_file (ThunarTransferJob *job,
   ThunarJobResponse response;
   GFileCopyFlags    copy_flags = G_FILE_COPY_NOFOLLOW_SYMLINKS;
   GError           *err = NULL;
-  gint              n;
+  gboolean          outdated;
+  guint64           size = 0;
+  guint64           mtime;
+  goffset           resume_offset = 0;
 
   _thunar_return_val_if_fail (THUNAR_IS_TRANSFER_JOB (job), NULL);
   _thunar_return_val_if_fail (G_IS_FILE (source_file), NULL);
@@ -508,43 +873,84 @@ thunar_transfer_job_copy_file (ThunarTransferJob *job,
   if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
     return NULL;
 
+  /* check if the target is a partial copy from an interrupted transfer */
+  if (job->journal != NULL
+      && thunar_transfer_journal_get_partial (job->journal, source_file, target_file,
+                                              &resume_offset, &size, &mtime))
+    {
+      /* only continue if the source did not change in the meantime */
+      if (resume_offset > 0 && !ttj_source_matches (job, source_file, size, mtime))
+        resume_offset = 0;
+
+      /* the target is ours, replace it without asking */
+      copy_flags |= G_FILE_COPY_OVERWRITE;
+    }
+
   /* various attempts to copy the file */
   while (err == NULL)
     {
       if (G_LIKELY (!g_file_equal (source_file, target_file)))
         {
+          /* check whether the target is already up to date in sync mode */
+          if (job->sync_mode != THUNAR_TRANSFER_SYNC_MODE_NEVER
+              && job->type == THUNAR_TRANSFER_JOB_COPY
+              && (copy_flags & G_FILE_COPY_OVERWRITE) == 0)
+            {
+              if (ttj_is_unchanged (job, source_file, target_file, &size, &outdated))
+                {
+                  /* account the skipped file in the progress */
+                  job->skipped_size += size;
+                  job->file_progress = 0;
+                  thunar_transfer_job_progress (size, size, job);
+
+                  /* tell the caller we skipped the file */
+                  return g_object_ref (source_file);
+                }
+
+              /* replace older copies without asking */
+              if (outdated)
+                copy_flags |= G_FILE_COPY_OVERWRITE;
+            }
+
           /* try to copy the file from source_file to the target_file */
-          if (ttj_copy_file (job, source_file, target_file, copy_flags, TRUE, &err))
+          if (ttj_copy_file (job, source_file, target_file, copy_flags, TRUE, resume_offset, &err))
             {
+              /* keep the duplicate names in sync */
+              thunar_io_jobs_util_name_index_add (job->name_index, target_file);
+
               /* return the real target file */
               return g_object_ref (target_file);
             }
         }
       else
         {
-          for (n = 1; err == NULL; ++n)
+          while (err == NULL)
             {
               GFile *duplicate_file = thunar_io_jobs_util_next_duplicate_file (THUNAR_JOB (job),
+                                                                               job->name_index,
                                                                                source_file,
-                                                                               TRUE, n,
-                                                                               &err);
+                                                                               TRUE, &err);
 
               if (err == NULL)
                 {
                   /* try to copy the file from source file to the duplicate file */
-                  if (ttj_copy_file (job, source_file, duplicate_file, copy_flags, TRUE, &err))
+                  if (ttj_copy_file (job, source_file, duplicate_file, copy_flags, TRUE, 0, &err))
                     {
+                      thunar_io_jobs_util_name_index_add (job->name_index, duplicate_file);
+
                       /* return the real target file */
                       return duplicate_file;
                     }
 
-                  g_object_unref (duplicate_file);
-                }
+                  if (err->domain == G_IO_ERROR && err->code == G_IO_ERROR_EXISTS)
+                    {
+                      /* this duplicate was created behind our back => clear
+                       * the error to try the next alternative */
+                      thunar_io_jobs_util_name_index_add (job->name_index, duplicate_file);
+                      g_clear_error (&err);
+                    }
 
-              if (err != NULL && err->domain == G_IO_ERROR && err->code == G_IO_ERROR_EXISTS)
-                {
-                  /* this duplicate already exists => clear the error to try the next alternative */
-                  g_clear_error (&err);
+                  g_object_unref (duplicate_file);
                 }
             }
         }
@@ -622,6 +1028,10 @@ thunar_transfer_job_copy_node (ThunarTransferJob  *job,
 
   for (; err == NULL && node != NULL; node = node->next)
     {
+      /* skip nodes completed before the transfer was interrupted */
+      if (job->journal != NULL && thunar_transfer_journal_is_completed (job->journal, node->source_file))
+        continue;
+
       /* guess the target file for this node (unless already provided) */
       if (G_LIKELY (target_file == NULL))
         {
@@ -719,6 +1129,10 @@ retry_remove:
                 }
             }
 
+          /* the node is done, even if the user decided to skip it */
+          if (job->journal != NULL)
+            thunar_transfer_journal_set_completed (job->journal, node->source_file);
+
           g_object_unref (real_target_file);
         }
       else if (err != NULL)
@@ -735,6 +1149,14 @@ retry_remove:
               /* check whether to retry */
               if (G_UNLIKELY (response == THUNAR_JOB_RESPONSE_RETRY))
                 goto retry_copy;
+
+              /* don't ask again when the transfer is resumed, and don't
+               * leave an incomplete target behind once the journal is gone */
+              if (response == THUNAR_JOB_RESPONSE_YES && job->journal != NULL)
+                {
+                  thunar_transfer_journal_drop_partial (job->journal, node->source_file);
+                  thunar_transfer_journal_set_completed (job->journal, node->source_file);
+                }
             }
         }
 
@@ -864,6 +1286,8 @@ thunar_transfer_job_execute (ExoJob  *job,
   GList                *tnext;
   GList                *tp;
   GFile                *target_parent;
+  GList                *source_file_list = NULL;
+  GList                *device_file_list;
   gchar                *base_name;
   gchar                *parent_display_name;
 
@@ -873,6 +1297,31 @@ thunar_transfer_job_execute (ExoJob  *job,
   if (exo_job_set_error_if_cancelled (job, error))
     return FALSE;
 
+  /* keep a journal of the progress, so the transfer can be resumed */
+  if (transfer_job->journal_enabled
+      && transfer_job->journal == NULL
+      && transfer_job->source_node_list != NULL
+      && (transfer_job->type == THUNAR_TRANSFER_JOB_COPY
+          || transfer_job->type == THUNAR_TRANSFER_JOB_MOVE))
+    {
+      for (sp = g_list_last (transfer_job->source_node_list); sp != NULL; sp = sp->prev)
+        {
+          node = sp->data;
+          source_file_list = g_list_prepend (source_file_list, node->source_file);
+        }
+
+      transfer_job->journal = thunar_transfer_journal_new (transfer_job->type, source_file_list,
+                                                           transfer_job->target_file_list, &err);
+      g_list_free (source_file_list);
+
+      /* the transfer works without the journal, it just can't be resumed */
+      if (G_UNLIKELY (transfer_job->journal == NULL))
+        {
+          g_warning ("Failed to create transfer journal: %s", err->message);
+          g_clear_error (&err);
+        }
+    }
+
   exo_job_info_message (job, _("Collecting files..."));
 
   /* take a reference on the thumbnail cache */
@@ -995,6 +1444,9 @@ thunar_transfer_job_execute (ExoJob  *job,
               /* add the target file to the new files list */
               new_files_list = thunar_g_file_list_prepend (new_files_list, tp->data);
 
+              if (transfer_job->journal != NULL)
+                thunar_transfer_journal_set_completed (transfer_job->journal, node->source_file);
+
               /* release source and target files */
               thunar_transfer_node_free (node);
               g_object_unref (tp->data);
@@ -1045,11 +1497,34 @@ thunar_transfer_job_execute (ExoJob  *job,
             }
           else
             {
-              /* pretend nothing happened */
+              /* pretend nothing happened, there is nothing to resume */
+              if (transfer_job->journal != NULL)
+                {
+                  thunar_transfer_journal_remove (transfer_job->journal);
+                  transfer_job->journal = NULL;
+                }
+
               return TRUE;
             }
         }
 
+      /* wait for the other transfers on the same devices */
+      device_file_list = g_list_copy (transfer_job->target_file_list);
+      for (sp = transfer_job->source_node_list; sp != NULL; sp = sp->next)
+        device_file_list = g_list_prepend (device_file_list, ((ThunarTransferNode *) sp->data)->source_file);
+
+      if (!thunar_transfer_queue_add (transfer_job->queue, THUNAR_JOB (job), device_file_list))
+        {
+          exo_job_emit (job, transfer_job_signals[QUEUED], 0, TRUE);
+          exo_job_info_message (job, _("Waiting for other transfers on the same device..."));
+
+          thunar_transfer_queue_wait (transfer_job->queue, THUNAR_JOB (job), &err);
+
+          exo_job_emit (job, transfer_job_signals[QUEUED], 0, FALSE);
+        }
+
+      g_list_free (device_file_list);
+
       /* transfer starts now */
       transfer_job->start_time = g_get_real_time ();
 
@@ -1061,6 +1536,9 @@ thunar_transfer_job_execute (ExoJob  *job,
           thunar_transfer_job_copy_node (transfer_job, sp->data, tp->data, NULL,
                                          &new_files_list, &err);
         }
+
+      /* let the next transfer on these devices start */
+      thunar_transfer_queue_remove (transfer_job->queue, THUNAR_JOB (job));
     }
 
   /* check if we failed */
@@ -1071,6 +1549,13 @@ thunar_transfer_job_execute (ExoJob  *job,
     }
   else
     {
+      /* the transfer is complete, drop its journal */
+      if (transfer_job->journal != NULL)
+        {
+          thunar_transfer_journal_remove (transfer_job->journal);
+          transfer_job->journal = NULL;
+        }
+
       thunar_job_new_files (THUNAR_JOB (job), new_files_list);
       thunar_g_file_list_free (new_files_list);
       return TRUE;
@@ -1154,11 +1639,67 @@ thunar_transfer_job_new (GList                *source_node_list,
 
 
 
+/**
+ * thunar_transfer_job_new_from_journal:
+ * @journal_path : path of the journal of an interrupted transfer.
+ * @error        : return location for errors or %NULL.
+ *
+ * Allocates a job that resumes the transfer recorded in the journal at
+ * @journal_path. Nodes that were completed are skipped and partially
+ * written files are continued where possible. The journal is deleted
+ * once the transfer finishes.
+ *
+ * Return value: the new #ThunarJob, or %NULL with @error set if the
+ *               journal cannot be loaded or is in use.
+ **/
+ThunarJob *
+thunar_transfer_job_new_from_journal (const gchar *journal_path,
+                                      GError     **error)
+{
+  ThunarTransferJournal *journal;
+  ThunarTransferNode    *node;
+  ThunarTransferJob     *job;
+  GList                 *sp;
+  GList                 *tp;
+
+  _thunar_return_val_if_fail (journal_path != NULL, NULL);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  journal = thunar_transfer_journal_load (journal_path, error);
+  if (G_UNLIKELY (journal == NULL))
+    return NULL;
+
+  job = g_object_new (THUNAR_TYPE_TRANSFER_JOB, NULL);
+  job->type = thunar_transfer_journal_get_job_type (journal);
+  job->journal = journal;
+
+  /* add a transfer node for each toplevel file that is not done yet */
+  for (sp = thunar_transfer_journal_get_source_files (journal),
+       tp = thunar_transfer_journal_get_target_files (journal);
+       sp != NULL && tp != NULL;
+       sp = sp->next, tp = tp->next)
+    {
+      if (thunar_transfer_journal_is_completed (journal, sp->data))
+        continue;
+
+      node = g_slice_new0 (ThunarTransferNode);
+      node->source_file = g_object_ref (sp->data);
+      job->source_node_list = g_list_append (job->source_node_list, node);
+
+      job->target_file_list = thunar_g_file_list_append (job->target_file_list, tp->data);
+    }
+
+  return THUNAR_JOB (job);
+}
+
+
+
 gchar *
 thunar_transfer_job_get_status (ThunarTransferJob *job)
 {
   gchar             *total_size_str;
   gchar             *total_progress_str;
+  gchar             *skipped_size_str;
   gchar             *transfer_rate_str;
   GString           *status;
   gulong             remaining_time;
@@ -1174,6 +1715,15 @@ thunar_transfer_job_get_status (ThunarTransferJob *job)
   g_free (total_size_str);
   g_free (total_progress_str);
 
+  /* amount of data that was already up to date in sync mode */
+  if (job->skipped_size > 0)
+    {
+      skipped_size_str = g_format_size_full (job->skipped_size, job->file_size_binary ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT);
+      g_string_append_c (status, ' ');
+      g_string_append_printf (status, _("(%s unchanged)"), skipped_size_str);
+      g_free (skipped_size_str);
+    }
+
   /* show time and transfer rate after 10 seconds */
   if (job->transfer_rate > 0
       && (job->last_update_time - job->start_time) > MINIMUM_TRANSFER_TIME)
@@ -51,11 +51,13 @@ typedef struct _ThunarTransferJob        ThunarTransferJob;
 
 GType      thunar_transfer_job_get_type (void) G_GNUC_CONST;
 
-ThunarJob *thunar_transfer_job_new        (GList                *source_file_list,
-                                           GList                *target_file_list,
-                                           ThunarTransferJobType type) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
+ThunarJob *thunar_transfer_job_new              (GList                *source_file_list,
+                                                 GList                *target_file_list,
+                                                 ThunarTransferJobType type) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
+ThunarJob *thunar_transfer_job_new_from_journal (const gchar          *journal_path,
+                                                 GError              **error) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 
-gchar     *thunar_transfer_job_get_status (ThunarTransferJob    *job);
+gchar     *thunar_transfer_job_get_status       (ThunarTransferJob    *job);
 
 G_END_DECLS
 
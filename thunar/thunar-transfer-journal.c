@@ -0,0 +1,962 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The journal is a plain text file in $XDG_CACHE_HOME/Thunar/transfers/,
+ * which is only ever appended to, one record per line:
+ *
+ *   THUNAR-TRANSFER-JOURNAL 1
+ *   T <job type>
+ *   S <source uri> <target uri>                        (toplevel files)
+ *   C <source uri>                                     (completed node)
+ *   P <offset> <size> <mtime> <source uri> <target uri> (partial file)
+ *
+ * URIs are escaped and never contain spaces or newlines. A record that
+ * was cut short by a crash is simply ignored when the journal is loaded.
+ * The journal is locked while a job uses it, so the same transfer is
+ * never resumed twice.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_MEMORY_H
+#include <memory.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <exo/exo.h>
+
+#include <thunar/thunar-gio-extensions.h>
+#include <thunar/thunar-private.h>
+#include <thunar/thunar-transfer-journal.h>
+
+
+
+#define JOURNAL_HEADER "THUNAR-TRANSFER-JOURNAL 1"
+#define JOURNAL_SUFFIX ".journal"
+
+
+
+typedef struct _ThunarTransferJournalPartial ThunarTransferJournalPartial;
+
+
+
+struct _ThunarTransferJournal
+{
+  ThunarTransferJobType type;
+
+  gchar                *path;
+  gint                  fd;
+
+  GList                *source_file_list;
+  GList                *target_file_list;
+
+  /* source uris of the completed nodes */
+  GHashTable           *completed;
+
+  /* source uri -> ThunarTransferJournalPartial */
+  GHashTable           *partials;
+};
+
+struct _ThunarTransferJournalPartial
+{
+  gchar   *target_uri;
+  goffset  offset;
+  guint64  size;
+  guint64  mtime;
+};
+
+
+
+static const struct
+{
+  ThunarTransferJobType type;
+  const gchar          *name;
+}
+journal_types[] =
+{
+  { THUNAR_TRANSFER_JOB_COPY, "copy", },
+  { THUNAR_TRANSFER_JOB_MOVE, "move", },
+};
+
+
+
+/* paths of the journals opened by this process */
+static GHashTable *active_journals = NULL;
+G_LOCK_DEFINE_STATIC (active_journals);
+
+
+
+static void
+thunar_transfer_journal_partial_free (gpointer data)
+{
+  ThunarTransferJournalPartial *partial = data;
+
+  g_free (partial->target_uri);
+  g_slice_free (ThunarTransferJournalPartial, partial);
+}
+
+
+
+static gchar *
+thunar_transfer_journal_get_directory (GError **error)
+{
+  gchar *directory;
+
+  directory = g_build_filename (g_get_user_cache_dir (), "Thunar", "transfers", NULL);
+  if (g_mkdir_with_parents (directory, 0700) < 0)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   _("Failed to create directory \"%s\": %s"),
+                   directory, g_strerror (errno));
+      g_free (directory);
+      return NULL;
+    }
+
+  return directory;
+}
+
+
+
+static gboolean
+thunar_transfer_journal_lock (gint fd)
+{
+#ifdef F_SETLK
+  struct flock lock;
+
+  memset (&lock, 0, sizeof (lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+
+  /* fails if another process works on this journal */
+  return fcntl (fd, F_SETLK, &lock) == 0;
+#else
+  return TRUE;
+#endif
+}
+
+
+
+/* opens and locks the journal at @path, and registers it as active.
+ * returns -1 if the journal is in use by this or another process */
+static gint
+thunar_transfer_journal_open (const gchar *path,
+                              gint         flags,
+                              GError     **error)
+{
+  gint fd = -1;
+
+  G_LOCK (active_journals);
+
+  if (active_journals == NULL)
+    active_journals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (!g_hash_table_lookup_extended (active_journals, path, NULL, NULL))
+    {
+      fd = g_open (path, flags, 0);
+      if (G_UNLIKELY (fd < 0))
+        {
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                       _("Failed to open \"%s\": %s"), path, g_strerror (errno));
+        }
+      else if (!thunar_transfer_journal_lock (fd))
+        {
+          close (fd);
+          fd = -1;
+        }
+      else
+        {
+          g_hash_table_insert (active_journals, g_strdup (path), NULL);
+        }
+    }
+
+  if (fd < 0 && error != NULL && *error == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                           _("The transfer is already running"));
+    }
+
+  G_UNLOCK (active_journals);
+
+  return fd;
+}
+
+
+
+/* reads the journal through @fd. opening and closing the file again
+ * would release the lock of this process */
+static gchar *
+thunar_transfer_journal_read (gint         fd,
+                              const gchar *path,
+                              GError     **error)
+{
+  GString *contents;
+  gchar    buffer[4096];
+  gssize   n_read;
+
+  contents = g_string_new (NULL);
+
+  /* writes use O_APPEND, so the offset only matters for reading */
+  lseek (fd, 0, SEEK_SET);
+
+  for (;;)
+    {
+      n_read = read (fd, buffer, sizeof (buffer));
+      if (n_read > 0)
+        {
+          g_string_append_len (contents, buffer, n_read);
+        }
+      else if (n_read == 0)
+        {
+          break;
+        }
+      else if (errno != EINTR)
+        {
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                       _("Failed to read \"%s\": %s"), path, g_strerror (errno));
+          g_string_free (contents, TRUE);
+          return NULL;
+        }
+    }
+
+  return g_string_free (contents, FALSE);
+}
+
+
+
+static void
+thunar_transfer_journal_append (ThunarTransferJournal *journal,
+                                const gchar           *format,
+                                ...)
+{
+  va_list  var_args;
+  gchar   *record;
+  gssize   n_written;
+  gsize    length;
+  gsize    n;
+
+  /* writing was disabled after an error */
+  if (G_UNLIKELY (journal->fd < 0))
+    return;
+
+  va_start (var_args, format);
+  record = g_strdup_vprintf (format, var_args);
+  va_end (var_args);
+
+  /* the fd is opened with O_APPEND, so each record is written at the end */
+  length = strlen (record);
+  for (n = 0; n < length; n += n_written)
+    {
+      n_written = write (journal->fd, record + n, length - n);
+      if (G_UNLIKELY (n_written < 0))
+        {
+          n_written = 0;
+          if (errno == EINTR)
+            continue;
+
+          /* the transfer itself is not affected, it just can't be resumed */
+          g_warning ("Failed to write transfer journal \"%s\": %s",
+                     journal->path, g_strerror (errno));
+          close (journal->fd);
+          journal->fd = -1;
+          break;
+        }
+    }
+
+  g_free (record);
+}
+
+
+
+static ThunarTransferJournal *
+thunar_transfer_journal_alloc (const gchar *path,
+                               gint         fd)
+{
+  ThunarTransferJournal *journal;
+
+  journal = g_slice_new0 (ThunarTransferJournal);
+  journal->path = g_strdup (path);
+  journal->fd = fd;
+  journal->completed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  journal->partials = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             thunar_transfer_journal_partial_free);
+
+  return journal;
+}
+
+
+
+/**
+ * thunar_transfer_journal_new:
+ * @type             : the #ThunarTransferJobType of the transfer.
+ * @source_file_list : the toplevel source #GFile<!---->s.
+ * @target_file_list : the matching target #GFile<!---->s.
+ * @error            : return location for errors or %NULL.
+ *
+ * Creates a new journal for a transfer of @source_file_list to
+ * @target_file_list in the cache directory of the user.
+ *
+ * Return value: the new #ThunarTransferJournal, or %NULL with @error
+ *               set if the journal could not be created.
+ **/
+ThunarTransferJournal *
+thunar_transfer_journal_new (ThunarTransferJobType  type,
+                             GList                 *source_file_list,
+                             GList                 *target_file_list,
+                             GError               **error)
+{
+  ThunarTransferJournal *journal;
+  const gchar           *type_name = NULL;
+  GString               *header;
+  GList                 *sp, *tp;
+  gchar                 *directory;
+  gchar                 *path;
+  gchar                 *source_uri;
+  gchar                 *target_uri;
+  guint                  n;
+  gint                   fd;
+
+  _thunar_return_val_if_fail (g_list_length (source_file_list) == g_list_length (target_file_list), NULL);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  for (n = 0; n < G_N_ELEMENTS (journal_types); ++n)
+    if (journal_types[n].type == type)
+      type_name = journal_types[n].name;
+
+  if (G_UNLIKELY (type_name == NULL))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Transfer type cannot be journaled");
+      return NULL;
+    }
+
+  directory = thunar_transfer_journal_get_directory (error);
+  if (G_UNLIKELY (directory == NULL))
+    return NULL;
+
+  /* create a journal with a unique name */
+  path = g_build_filename (directory, "transfer-XXXXXX" JOURNAL_SUFFIX, NULL);
+  g_free (directory);
+
+  /* record locks belong to the process, so a scan for pending journals
+   * must not probe the journal between creating and registering it */
+  G_LOCK (active_journals);
+
+  fd = g_mkstemp_full (path, O_WRONLY | O_APPEND, 0600);
+  if (G_UNLIKELY (fd < 0))
+    {
+      G_UNLOCK (active_journals);
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   _("Failed to create \"%s\": %s"), path, g_strerror (errno));
+      g_free (path);
+      return NULL;
+    }
+
+  /* lock it before anybody can mistake it for an interrupted transfer */
+  if (!thunar_transfer_journal_lock (fd))
+    {
+      G_UNLOCK (active_journals);
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                           _("The transfer is already running"));
+      close (fd);
+      g_unlink (path);
+      g_free (path);
+      return NULL;
+    }
+
+  if (active_journals == NULL)
+    active_journals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_hash_table_insert (active_journals, g_strdup (path), NULL);
+
+  G_UNLOCK (active_journals);
+
+  journal = thunar_transfer_journal_alloc (path, fd);
+  journal->type = type;
+  journal->source_file_list = thunar_g_file_list_copy (source_file_list);
+  journal->target_file_list = thunar_g_file_list_copy (target_file_list);
+  g_free (path);
+
+  /* write the header in one go */
+  header = g_string_new (JOURNAL_HEADER "\n");
+  g_string_append_printf (header, "T %s\n", type_name);
+  for (sp = source_file_list, tp = target_file_list; sp != NULL; sp = sp->next, tp = tp->next)
+    {
+      source_uri = g_file_get_uri (sp->data);
+      target_uri = g_file_get_uri (tp->data);
+      g_string_append_printf (header, "S %s %s\n", source_uri, target_uri);
+      g_free (source_uri);
+      g_free (target_uri);
+    }
+
+  thunar_transfer_journal_append (journal, "%s", header->str);
+  g_string_free (header, TRUE);
+
+  thunar_transfer_journal_sync (journal);
+
+  return journal;
+}
+
+
+
+/**
+ * thunar_transfer_journal_load:
+ * @path  : the path of a journal file.
+ * @error : return location for errors or %NULL.
+ *
+ * Loads the journal of an interrupted transfer from @path, so the
+ * transfer can be resumed. Fails with %G_IO_ERROR_BUSY if the
+ * journal is in use by a running transfer.
+ *
+ * Return value: the #ThunarTransferJournal or %NULL with @error set.
+ **/
+ThunarTransferJournal *
+thunar_transfer_journal_load (const gchar *path,
+                              GError     **error)
+{
+  ThunarTransferJournalPartial *partial;
+  ThunarTransferJournal        *journal;
+  gboolean                      has_type = FALSE;
+  gchar                        *contents;
+  gchar                       **lines;
+  gchar                       **fields;
+  guint                         n_lines;
+  guint                         n;
+  guint                         i;
+  GFile                        *file;
+  gint                          fd;
+
+  _thunar_return_val_if_fail (path != NULL, NULL);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  fd = thunar_transfer_journal_open (path, O_RDWR | O_APPEND, error);
+  if (G_UNLIKELY (fd < 0))
+    return NULL;
+
+  journal = thunar_transfer_journal_alloc (path, fd);
+
+  contents = thunar_transfer_journal_read (fd, path, error);
+  if (G_UNLIKELY (contents == NULL))
+    {
+      thunar_transfer_journal_free (journal);
+      return NULL;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+  n_lines = g_strv_length (lines);
+  g_free (contents);
+
+  /* the last element is whatever follows the last newline, i.e. empty
+   * or a record that was not completely written */
+  for (n = 1; n + 1 < n_lines && g_strcmp0 (lines[0], JOURNAL_HEADER) == 0; ++n)
+    {
+      fields = g_strsplit (lines[n], " ", 7);
+
+      switch (g_strv_length (fields))
+        {
+        case 2:
+          if (strcmp (fields[0], "T") == 0)
+            {
+              for (i = 0; i < G_N_ELEMENTS (journal_types); ++i)
+                if (strcmp (fields[1], journal_types[i].name) == 0)
+                  {
+                    journal->type = journal_types[i].type;
+                    has_type = TRUE;
+                  }
+            }
+          else if (strcmp (fields[0], "C") == 0)
+            {
+              g_hash_table_remove (journal->partials, fields[1]);
+              g_hash_table_insert (journal->completed, g_strdup (fields[1]), NULL);
+            }
+          break;
+
+        case 3:
+          if (strcmp (fields[0], "S") == 0)
+            {
+              file = g_file_new_for_uri (fields[1]);
+              journal->source_file_list = g_list_append (journal->source_file_list, file);
+              file = g_file_new_for_uri (fields[2]);
+              journal->target_file_list = g_list_append (journal->target_file_list, file);
+            }
+          break;
+
+        case 6:
+          if (strcmp (fields[0], "P") == 0)
+            {
+              partial = g_slice_new0 (ThunarTransferJournalPartial);
+              partial->offset = g_ascii_strtoll (fields[1], NULL, 10);
+              partial->size = g_ascii_strtoull (fields[2], NULL, 10);
+              partial->mtime = g_ascii_strtoull (fields[3], NULL, 10);
+              partial->target_uri = g_strdup (fields[5]);
+              g_hash_table_replace (journal->partials, g_strdup (fields[4]), partial);
+            }
+          break;
+        }
+
+      g_strfreev (fields);
+    }
+
+  g_strfreev (lines);
+
+  if (G_UNLIKELY (!has_type || journal->source_file_list == NULL))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   _("The transfer journal \"%s\" is corrupted"), path);
+      thunar_transfer_journal_free (journal);
+      return NULL;
+    }
+
+  return journal;
+}
+
+
+
+/**
+ * thunar_transfer_journal_free:
+ * @journal : a #ThunarTransferJournal.
+ *
+ * Closes the @journal and releases its resources. The journal file
+ * is kept, so the transfer can be resumed later.
+ **/
+void
+thunar_transfer_journal_free (ThunarTransferJournal *journal)
+{
+  _thunar_return_if_fail (journal != NULL);
+
+  /* closing the fd drops the lock */
+  if (journal->fd >= 0)
+    close (journal->fd);
+
+  G_LOCK (active_journals);
+  g_hash_table_remove (active_journals, journal->path);
+  G_UNLOCK (active_journals);
+
+  thunar_g_file_list_free (journal->source_file_list);
+  thunar_g_file_list_free (journal->target_file_list);
+
+  g_hash_table_destroy (journal->completed);
+  g_hash_table_destroy (journal->partials);
+
+  g_free (journal->path);
+
+  g_slice_free (ThunarTransferJournal, journal);
+}
+
+
+
+/**
+ * thunar_transfer_journal_remove:
+ * @journal : a #ThunarTransferJournal.
+ *
+ * Deletes the journal file of a finished transfer and frees @journal.
+ **/
+void
+thunar_transfer_journal_remove (ThunarTransferJournal *journal)
+{
+  _thunar_return_if_fail (journal != NULL);
+
+  /* unlink while still holding the lock */
+  g_unlink (journal->path);
+
+  thunar_transfer_journal_free (journal);
+}
+
+
+
+ThunarTransferJobType
+thunar_transfer_journal_get_job_type (ThunarTransferJournal *journal)
+{
+  _thunar_return_val_if_fail (journal != NULL, THUNAR_TRANSFER_JOB_COPY);
+  return journal->type;
+}
+
+
+
+/**
+ * thunar_transfer_journal_get_source_files:
+ * @journal : a #ThunarTransferJournal.
+ *
+ * Return value: the toplevel source #GFile<!---->s of the transfer,
+ *               owned by @journal.
+ **/
+GList *
+thunar_transfer_journal_get_source_files (ThunarTransferJournal *journal)
+{
+  _thunar_return_val_if_fail (journal != NULL, NULL);
+  return journal->source_file_list;
+}
+
+
+
+/**
+ * thunar_transfer_journal_get_target_files:
+ * @journal : a #ThunarTransferJournal.
+ *
+ * Return value: the toplevel target #GFile<!---->s of the transfer,
+ *               owned by @journal.
+ **/
+GList *
+thunar_transfer_journal_get_target_files (ThunarTransferJournal *journal)
+{
+  _thunar_return_val_if_fail (journal != NULL, NULL);
+  return journal->target_file_list;
+}
+
+
+
+gboolean
+thunar_transfer_journal_is_completed (ThunarTransferJournal *journal,
+                                      GFile                 *source_file)
+{
+  gboolean completed;
+  gchar   *uri;
+
+  _thunar_return_val_if_fail (journal != NULL, FALSE);
+  _thunar_return_val_if_fail (G_IS_FILE (source_file), FALSE);
+
+  if (g_hash_table_size (journal->completed) == 0)
+    return FALSE;
+
+  uri = g_file_get_uri (source_file);
+  completed = g_hash_table_lookup_extended (journal->completed, uri, NULL, NULL);
+  g_free (uri);
+
+  return completed;
+}
+
+
+
+/**
+ * thunar_transfer_journal_set_completed:
+ * @journal     : a #ThunarTransferJournal.
+ * @source_file : the source #GFile of the node.
+ *
+ * Records that the node for @source_file, including all its children,
+ * was transferred or skipped by the user and must not be touched again
+ * when the transfer is resumed.
+ **/
+void
+thunar_transfer_journal_set_completed (ThunarTransferJournal *journal,
+                                       GFile                 *source_file)
+{
+  gchar *uri;
+
+  _thunar_return_if_fail (journal != NULL);
+  _thunar_return_if_fail (G_IS_FILE (source_file));
+
+  uri = g_file_get_uri (source_file);
+
+  g_hash_table_remove (journal->partials, uri);
+
+  if (!g_hash_table_lookup_extended (journal->completed, uri, NULL, NULL))
+    {
+      thunar_transfer_journal_append (journal, "C %s\n", uri);
+      g_hash_table_insert (journal->completed, uri, NULL);
+    }
+  else
+    {
+      g_free (uri);
+    }
+}
+
+
+
+/**
+ * thunar_transfer_journal_get_partial:
+ * @journal       : a #ThunarTransferJournal.
+ * @source_file   : the source #GFile.
+ * @target_file   : the target #GFile.
+ * @offset_return : return location for the verified offset.
+ * @size_return   : return location for the source size at that time.
+ * @mtime_return  : return location for the source mtime at that time.
+ *
+ * Looks up whether @target_file is an incomplete copy of @source_file
+ * that was created by this transfer.
+ *
+ * Return value: %TRUE if @target_file is a partial copy.
+ **/
+gboolean
+thunar_transfer_journal_get_partial (ThunarTransferJournal *journal,
+                                     GFile                 *source_file,
+                                     GFile                 *target_file,
+                                     goffset               *offset_return,
+                                     guint64               *size_return,
+                                     guint64               *mtime_return)
+{
+  ThunarTransferJournalPartial *partial;
+  gboolean                      found = FALSE;
+  gchar                        *uri;
+
+  _thunar_return_val_if_fail (journal != NULL, FALSE);
+  _thunar_return_val_if_fail (G_IS_FILE (source_file), FALSE);
+  _thunar_return_val_if_fail (G_IS_FILE (target_file), FALSE);
+
+  if (g_hash_table_size (journal->partials) == 0)
+    return FALSE;
+
+  uri = g_file_get_uri (source_file);
+  partial = g_hash_table_lookup (journal->partials, uri);
+  g_free (uri);
+
+  if (partial != NULL)
+    {
+      uri = g_file_get_uri (target_file);
+      found = (strcmp (uri, partial->target_uri) == 0);
+      g_free (uri);
+
+      if (found)
+        {
+          *offset_return = partial->offset;
+          *size_return = partial->size;
+          *mtime_return = partial->mtime;
+        }
+    }
+
+  return found;
+}
+
+
+
+/**
+ * thunar_transfer_journal_set_partial:
+ * @journal     : a #ThunarTransferJournal.
+ * @source_file : the source #GFile.
+ * @target_file : the target #GFile being written.
+ * @offset      : the offset up to which @target_file is on disk.
+ * @size        : the size of @source_file.
+ * @mtime       : the modification time of @source_file.
+ *
+ * Records that @target_file was created by this transfer and that its
+ * data up to @offset is complete, as long as @source_file still has
+ * the given @size and @mtime.
+ **/
+void
+thunar_transfer_journal_set_partial (ThunarTransferJournal *journal,
+                                     GFile                 *source_file,
+                                     GFile                 *target_file,
+                                     goffset                offset,
+                                     guint64                size,
+                                     guint64                mtime)
+{
+  ThunarTransferJournalPartial *partial;
+  gchar                        *source_uri;
+
+  _thunar_return_if_fail (journal != NULL);
+  _thunar_return_if_fail (G_IS_FILE (source_file));
+  _thunar_return_if_fail (G_IS_FILE (target_file));
+
+  partial = g_slice_new0 (ThunarTransferJournalPartial);
+  partial->target_uri = g_file_get_uri (target_file);
+  partial->offset = offset;
+  partial->size = size;
+  partial->mtime = mtime;
+
+  source_uri = g_file_get_uri (source_file);
+
+  thunar_transfer_journal_append (journal,
+                                  "P %" G_GINT64_FORMAT " %" G_GUINT64_FORMAT
+                                  " %" G_GUINT64_FORMAT " %s %s\n",
+                                  (gint64) offset, size, mtime,
+                                  source_uri, partial->target_uri);
+
+  g_hash_table_replace (journal->partials, source_uri, partial);
+}
+
+
+
+/**
+ * thunar_transfer_journal_drop_partial:
+ * @journal     : a #ThunarTransferJournal.
+ * @source_file : the source #GFile of the node.
+ *
+ * Deletes the incomplete target recorded for @source_file, if any.
+ * Used when the user skips a node whose copy failed, as the target
+ * might already have the full size with its tail missing.
+ **/
+void
+thunar_transfer_journal_drop_partial (ThunarTransferJournal *journal,
+                                      GFile                 *source_file)
+{
+  ThunarTransferJournalPartial *partial;
+  GFile                        *target_file;
+  gchar                        *uri;
+
+  _thunar_return_if_fail (journal != NULL);
+  _thunar_return_if_fail (G_IS_FILE (source_file));
+
+  if (g_hash_table_size (journal->partials) == 0)
+    return;
+
+  uri = g_file_get_uri (source_file);
+  partial = g_hash_table_lookup (journal->partials, uri);
+  if (partial != NULL)
+    {
+      target_file = g_file_new_for_uri (partial->target_uri);
+      g_file_delete (target_file, NULL, NULL);
+      g_object_unref (target_file);
+
+      g_hash_table_remove (journal->partials, uri);
+    }
+  g_free (uri);
+}
+
+
+
+/**
+ * thunar_transfer_journal_sync:
+ * @journal : a #ThunarTransferJournal.
+ *
+ * Makes sure the records written so far survive a system crash.
+ **/
+void
+thunar_transfer_journal_sync (ThunarTransferJournal *journal)
+{
+  _thunar_return_if_fail (journal != NULL);
+
+  if (G_LIKELY (journal->fd >= 0))
+    fsync (journal->fd);
+}
+
+
+
+/**
+ * thunar_transfer_journal_discard:
+ * @path  : the path of a journal file.
+ * @error : return location for errors or %NULL.
+ *
+ * Deletes the journal of an interrupted transfer at @path together
+ * with the incomplete targets it recorded. The files that were
+ * transferred completely are kept.
+ *
+ * Return value: %TRUE if the journal was deleted, %FALSE with @error
+ *               set if it could not be loaded.
+ **/
+gboolean
+thunar_transfer_journal_discard (const gchar *path,
+                                 GError     **error)
+{
+  ThunarTransferJournalPartial *partial;
+  ThunarTransferJournal        *journal;
+  GHashTableIter                iter;
+  GFile                        *target_file;
+
+  _thunar_return_val_if_fail (path != NULL, FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  journal = thunar_transfer_journal_load (path, error);
+  if (G_UNLIKELY (journal == NULL))
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, journal->partials);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) &partial))
+    {
+      target_file = g_file_new_for_uri (partial->target_uri);
+      g_file_delete (target_file, NULL, NULL);
+      g_object_unref (target_file);
+    }
+
+  thunar_transfer_journal_remove (journal);
+
+  return TRUE;
+}
+
+
+
+/**
+ * thunar_transfer_journal_list_pending:
+ *
+ * Looks for journals of transfers that were interrupted and are not
+ * being resumed already.
+ *
+ * Return value: the list of journal paths, to be freed with
+ *               g_list_free_full() and g_free().
+ **/
+GList *
+thunar_transfer_journal_list_pending (void)
+{
+  const gchar *name;
+  GList       *paths = NULL;
+  gchar       *directory;
+  gchar       *path;
+  GDir        *dir;
+  gint         fd;
+
+  directory = g_build_filename (g_get_user_cache_dir (), "Thunar", "transfers", NULL);
+  dir = g_dir_open (directory, 0, NULL);
+
+  if (G_LIKELY (dir != NULL))
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          if (!g_str_has_suffix (name, JOURNAL_SUFFIX))
+            continue;
+
+          path = g_build_filename (directory, name, NULL);
+
+          /* skip journals of running transfers. closing the fd would
+           * release the locks of journals opened by this process, so
+           * only probe the journals of other processes, and keep this
+           * process from opening the journal until the probe is done */
+          G_LOCK (active_journals);
+          if (active_journals == NULL || !g_hash_table_lookup_extended (active_journals, path, NULL, NULL))
+            {
+              fd = g_open (path, O_WRONLY, 0);
+              if (fd >= 0)
+                {
+                  if (thunar_transfer_journal_lock (fd))
+                    {
+                      paths = g_list_prepend (paths, path);
+                      path = NULL;
+                    }
+                  close (fd);
+                }
+            }
+          G_UNLOCK (active_journals);
+
+          g_free (path);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_free (directory);
+
+  return g_list_reverse (paths);
+}
@@ -0,0 +1,74 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __THUNAR_TRANSFER_JOURNAL_H__
+#define __THUNAR_TRANSFER_JOURNAL_H__
+
+#include <gio/gio.h>
+
+#include <thunar/thunar-transfer-job.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ThunarTransferJournal ThunarTransferJournal;
+
+ThunarTransferJournal *thunar_transfer_journal_new              (ThunarTransferJobType  type,
+                                                                 GList                 *source_file_list,
+                                                                 GList                 *target_file_list,
+                                                                 GError               **error) G_GNUC_MALLOC;
+ThunarTransferJournal *thunar_transfer_journal_load             (const gchar           *path,
+                                                                 GError               **error) G_GNUC_MALLOC;
+void                   thunar_transfer_journal_free             (ThunarTransferJournal *journal);
+void                   thunar_transfer_journal_remove           (ThunarTransferJournal *journal);
+
+ThunarTransferJobType  thunar_transfer_journal_get_job_type     (ThunarTransferJournal *journal);
+GList                 *thunar_transfer_journal_get_source_files (ThunarTransferJournal *journal);
+GList                 *thunar_transfer_journal_get_target_files (ThunarTransferJournal *journal);
+
+gboolean               thunar_transfer_journal_is_completed     (ThunarTransferJournal *journal,
+                                                                 GFile                 *source_file);
+void                   thunar_transfer_journal_set_completed    (ThunarTransferJournal *journal,
+                                                                 GFile                 *source_file);
+
+gboolean               thunar_transfer_journal_get_partial      (ThunarTransferJournal *journal,
+                                                                 GFile                 *source_file,
+                                                                 GFile                 *target_file,
+                                                                 goffset               *offset_return,
+                                                                 guint64               *size_return,
+                                                                 guint64               *mtime_return);
+void                   thunar_transfer_journal_set_partial      (ThunarTransferJournal *journal,
+                                                                 GFile                 *source_file,
+                                                                 GFile                 *target_file,
+                                                                 goffset                offset,
+                                                                 guint64                size,
+                                                                 guint64                mtime);
+
+void                   thunar_transfer_journal_drop_partial     (ThunarTransferJournal *journal,
+                                                                 GFile                 *source_file);
+
+void                   thunar_transfer_journal_sync             (ThunarTransferJournal *journal);
+
+gboolean               thunar_transfer_journal_discard          (const gchar           *path,
+                                                                 GError               **error);
+GList                 *thunar_transfer_journal_list_pending     (void) G_GNUC_MALLOC;
+
+G_END_DECLS
+
+#endif /* !__THUNAR_TRANSFER_JOURNAL_H__ */
@@ -0,0 +1,700 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <gio/gio.h>
+
+#include <thunar/thunar-preferences.h>
+#include <thunar/thunar-private.h>
+#include <thunar/thunar-transfer-queue.h>
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define _transfer_queue_lock(queue)   g_mutex_lock (&((queue)->lock))
+#define _transfer_queue_unlock(queue) g_mutex_unlock (&((queue)->lock))
+#define _transfer_queue_wait(queue)   g_cond_wait (&((queue)->cond), &((queue)->lock))
+#define _transfer_queue_signal(queue) g_cond_broadcast (&((queue)->cond))
+#else
+#define _transfer_queue_lock(queue)   g_mutex_lock ((queue)->lock)
+#define _transfer_queue_unlock(queue) g_mutex_unlock ((queue)->lock)
+#define _transfer_queue_wait(queue)   g_cond_wait ((queue)->cond, (queue)->lock)
+#define _transfer_queue_signal(queue) g_cond_broadcast ((queue)->cond)
+#endif
+
+
+
+/* classes of devices, each with its own concurrency limit */
+typedef enum
+{
+  DEVICE_ROTATIONAL,
+  DEVICE_SOLID_STATE,
+  DEVICE_REMOTE,
+  N_DEVICE_CLASSES,
+} DeviceClass;
+
+typedef struct _ThunarTransferQueueEntry ThunarTransferQueueEntry;
+
+
+
+static void        thunar_transfer_queue_finalize          (GObject                  *object);
+static void        thunar_transfer_queue_limits_changed    (ThunarTransferQueue      *queue);
+static void        thunar_transfer_queue_entry_free        (ThunarTransferQueueEntry *entry);
+
+
+
+struct _ThunarTransferQueueClass
+{
+  GObjectClass __parent__;
+};
+
+struct _ThunarTransferQueue
+{
+  GObject            __parent__;
+
+  ThunarPreferences *preferences;
+
+  /* maximum number of transfers per device, 0 for no limit */
+  guint              concurrency[N_DEVICE_CLASSES];
+
+  /* filesystem id -> DeviceClass + 1 */
+  GHashTable        *device_classes;
+
+  /* all transfers in the order they are served, running or not */
+  GList             *entries;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  GMutex             lock;
+  GCond              cond;
+#else
+  GMutex            *lock;
+  GCond             *cond;
+#endif
+};
+
+struct _ThunarTransferQueueEntry
+{
+  ThunarJob *job;
+
+  /* filesystem ids of the devices touched by the job */
+  gchar    **devices;
+  guint     *classes;
+
+  guint      running : 1;
+  guint      forced : 1;
+};
+
+
+
+static const gchar *concurrency_properties[] =
+{
+  "misc-transfer-concurrency-rotational",
+  "misc-transfer-concurrency-solid-state",
+  "misc-transfer-concurrency-remote",
+};
+
+
+
+G_DEFINE_TYPE (ThunarTransferQueue, thunar_transfer_queue, G_TYPE_OBJECT)
+
+
+
+static void
+thunar_transfer_queue_class_init (ThunarTransferQueueClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = thunar_transfer_queue_finalize;
+}
+
+
+
+static void
+thunar_transfer_queue_init (ThunarTransferQueue *queue)
+{
+  guint n;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+#else
+  queue->lock = g_mutex_new ();
+  queue->cond = g_cond_new ();
+#endif
+
+  queue->device_classes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* watch the concurrency settings */
+  queue->preferences = thunar_preferences_get ();
+  for (n = 0; n < G_N_ELEMENTS (concurrency_properties); ++n)
+    {
+      gchar *signal_name = g_strconcat ("notify::", concurrency_properties[n], NULL);
+      g_signal_connect_swapped (G_OBJECT (queue->preferences), signal_name,
+                                G_CALLBACK (thunar_transfer_queue_limits_changed), queue);
+      g_free (signal_name);
+    }
+
+  thunar_transfer_queue_limits_changed (queue);
+}
+
+
+
+static void
+thunar_transfer_queue_finalize (GObject *object)
+{
+  ThunarTransferQueue *queue = THUNAR_TRANSFER_QUEUE (object);
+
+  /* every job holds a reference while it is queued */
+  _thunar_assert (queue->entries == NULL);
+
+  g_signal_handlers_disconnect_matched (queue->preferences, G_SIGNAL_MATCH_DATA,
+                                        0, 0, NULL, NULL, queue);
+  g_object_unref (queue->preferences);
+
+  g_hash_table_destroy (queue->device_classes);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_mutex_clear (&queue->lock);
+  g_cond_clear (&queue->cond);
+#else
+  g_mutex_free (queue->lock);
+  g_cond_free (queue->cond);
+#endif
+
+  (*G_OBJECT_CLASS (thunar_transfer_queue_parent_class)->finalize) (object);
+}
+
+
+
+static void
+thunar_transfer_queue_limits_changed (ThunarTransferQueue *queue)
+{
+  guint concurrency[N_DEVICE_CLASSES];
+  guint n;
+
+  _thunar_return_if_fail (THUNAR_IS_TRANSFER_QUEUE (queue));
+
+  for (n = 0; n < N_DEVICE_CLASSES; ++n)
+    g_object_get (G_OBJECT (queue->preferences), concurrency_properties[n], &concurrency[n], NULL);
+
+  _transfer_queue_lock (queue);
+  for (n = 0; n < N_DEVICE_CLASSES; ++n)
+    queue->concurrency[n] = concurrency[n];
+
+  /* higher limits may allow queued jobs to start */
+  _transfer_queue_signal (queue);
+  _transfer_queue_unlock (queue);
+}
+
+
+
+static void
+thunar_transfer_queue_entry_free (ThunarTransferQueueEntry *entry)
+{
+  g_strfreev (entry->devices);
+  g_free (entry->classes);
+  g_slice_free (ThunarTransferQueueEntry, entry);
+}
+
+
+
+static ThunarTransferQueueEntry *
+thunar_transfer_queue_lookup (ThunarTransferQueue *queue,
+                              ThunarJob           *job)
+{
+  GList *lp;
+
+  for (lp = queue->entries; lp != NULL; lp = lp->next)
+    if (((ThunarTransferQueueEntry *) lp->data)->job == job)
+      return lp->data;
+
+  return NULL;
+}
+
+
+
+static DeviceClass
+thunar_transfer_queue_classify (GFile     *file,
+                                GFileInfo *info)
+{
+  DeviceClass  device_class = DEVICE_ROTATIONAL;
+  GFileInfo   *fs_info;
+  gchar       *path;
+  gchar       *contents;
+#if defined (major) && defined (minor)
+  guint32      device;
+#endif
+
+  /* network shares are limited by the link rather than by seeks */
+  if (!g_file_is_native (file))
+    return DEVICE_REMOTE;
+
+  fs_info = g_file_query_filesystem_info (file, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE, NULL, NULL);
+  if (fs_info != NULL)
+    {
+      if (g_file_info_get_attribute_boolean (fs_info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE))
+        device_class = DEVICE_REMOTE;
+      g_object_unref (fs_info);
+
+      if (device_class == DEVICE_REMOTE)
+        return DEVICE_REMOTE;
+    }
+
+#if defined (major) && defined (minor)
+  /* ask the kernel whether the block device has to seek, first for the
+   * device itself and then for the disk holding the partition */
+  device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+
+  path = g_strdup_printf ("/sys/dev/block/%u:%u/queue/rotational", major (device), minor (device));
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      path = g_strdup_printf ("/sys/dev/block/%u:%u/../queue/rotational", major (device), minor (device));
+      if (!g_file_get_contents (path, &contents, NULL, NULL))
+        contents = NULL;
+    }
+  g_free (path);
+
+  if (contents != NULL)
+    {
+      if (contents[0] == '0')
+        device_class = DEVICE_SOLID_STATE;
+      g_free (contents);
+    }
+#endif
+
+  return device_class;
+}
+
+
+
+/* determines the filesystem id of the device holding @file, or its
+ * closest existing parent for files that are yet to be created */
+static gchar *
+thunar_transfer_queue_get_device (ThunarTransferQueue *queue,
+                                  GFile               *file,
+                                  DeviceClass         *class_return)
+{
+  GFileInfo *info = NULL;
+  GFile     *parent;
+  gchar     *device = NULL;
+  gpointer   value;
+
+  g_object_ref (file);
+
+  while (file != NULL)
+    {
+      info = g_file_query_info (file,
+                                G_FILE_ATTRIBUTE_ID_FILESYSTEM ","
+                                G_FILE_ATTRIBUTE_UNIX_DEVICE,
+                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                NULL, NULL);
+      if (info != NULL)
+        break;
+
+      parent = g_file_get_parent (file);
+      g_object_unref (file);
+      file = parent;
+    }
+
+  if (G_LIKELY (info != NULL))
+    {
+      device = g_strdup (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM));
+      if (device != NULL)
+        {
+          /* classify each device only once */
+          _transfer_queue_lock (queue);
+          value = g_hash_table_lookup (queue->device_classes, device);
+          _transfer_queue_unlock (queue);
+
+          if (value != NULL)
+            {
+              *class_return = GPOINTER_TO_UINT (value) - 1;
+            }
+          else
+            {
+              *class_return = thunar_transfer_queue_classify (file, info);
+
+              _transfer_queue_lock (queue);
+              g_hash_table_insert (queue->device_classes, g_strdup (device),
+                                   GUINT_TO_POINTER (*class_return + 1));
+              _transfer_queue_unlock (queue);
+            }
+        }
+
+      g_object_unref (info);
+    }
+
+  if (file != NULL)
+    g_object_unref (file);
+
+  return device;
+}
+
+
+
+/* whether @entry may start now. must be called with the lock held */
+static gboolean
+thunar_transfer_queue_can_start (ThunarTransferQueue      *queue,
+                                 ThunarTransferQueueEntry *entry)
+{
+  ThunarTransferQueueEntry *other;
+  gboolean                  before;
+  GList                    *lp;
+  guint                     n_running;
+  guint                     limit;
+  guint                     n, m;
+
+  if (entry->running || entry->forced)
+    return TRUE;
+
+  for (n = 0; entry->devices[n] != NULL; ++n)
+    {
+      limit = queue->concurrency[entry->classes[n]];
+      if (limit == 0)
+        continue;
+
+      n_running = 0;
+      before = TRUE;
+
+      for (lp = queue->entries; lp != NULL; lp = lp->next)
+        {
+          other = lp->data;
+          if (other == entry)
+            {
+              before = FALSE;
+              continue;
+            }
+
+          for (m = 0; other->devices[m] != NULL; ++m)
+            if (strcmp (other->devices[m], entry->devices[n]) == 0)
+              break;
+
+          if (other->devices[m] == NULL)
+            continue;
+
+          if (other->running)
+            n_running++;
+          else if (before)
+            return FALSE; /* an earlier job waits for this device */
+        }
+
+      if (n_running >= limit)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+thunar_transfer_queue_cancelled (GCancellable        *cancellable,
+                                 ThunarTransferQueue *queue)
+{
+  /* wake up the waiting job, so it notices the cancellation */
+  _transfer_queue_lock (queue);
+  _transfer_queue_signal (queue);
+  _transfer_queue_unlock (queue);
+}
+
+
+
+/**
+ * thunar_transfer_queue_get:
+ *
+ * Returns a reference to the shared #ThunarTransferQueue. The caller is
+ * responsible to free the returned object using g_object_unref() when
+ * no longer needed.
+ *
+ * Return value: a reference to the #ThunarTransferQueue.
+ **/
+ThunarTransferQueue *
+thunar_transfer_queue_get (void)
+{
+  static ThunarTransferQueue *queue = NULL;
+
+  if (G_UNLIKELY (queue == NULL))
+    {
+      queue = g_object_new (THUNAR_TYPE_TRANSFER_QUEUE, NULL);
+      g_object_add_weak_pointer (G_OBJECT (queue), (gpointer) &queue);
+    }
+  else
+    {
+      g_object_ref (G_OBJECT (queue));
+    }
+
+  return queue;
+}
+
+
+
+/**
+ * thunar_transfer_queue_add:
+ * @queue     : a #ThunarTransferQueue.
+ * @job       : the #ThunarJob that wants to transfer files.
+ * @file_list : the source and target #GFile<!---->s of the @job.
+ *
+ * Appends @job to the @queue. The devices touched by the @job are
+ * determined from the @file_list, which should contain the toplevel
+ * sources and targets.
+ *
+ * This function is meant to be called from the job thread, and must
+ * be followed by thunar_transfer_queue_remove() once the transfer is
+ * done.
+ *
+ * Return value: %TRUE if the @job may start right away, %FALSE if it
+ *               has to thunar_transfer_queue_wait() for its turn.
+ **/
+gboolean
+thunar_transfer_queue_add (ThunarTransferQueue *queue,
+                           ThunarJob           *job,
+                           GList               *file_list)
+{
+  ThunarTransferQueueEntry *entry;
+  DeviceClass               device_class = DEVICE_ROTATIONAL;
+  GPtrArray                *devices;
+  GArray                   *classes;
+  GList                    *lp;
+  gchar                    *device;
+  guint                     n;
+
+  _thunar_return_val_if_fail (THUNAR_IS_TRANSFER_QUEUE (queue), TRUE);
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), TRUE);
+
+  devices = g_ptr_array_new ();
+  classes = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* collect the distinct devices of all files */
+  for (lp = file_list; lp != NULL; lp = lp->next)
+    {
+      device = thunar_transfer_queue_get_device (queue, lp->data, &device_class);
+      if (device == NULL)
+        continue;
+
+      for (n = 0; n < devices->len; ++n)
+        if (strcmp (g_ptr_array_index (devices, n), device) == 0)
+          break;
+
+      if (n < devices->len)
+        {
+          g_free (device);
+          continue;
+        }
+
+      g_ptr_array_add (devices, device);
+      g_array_append_val (classes, device_class);
+    }
+
+  g_ptr_array_add (devices, NULL);
+
+  entry = g_slice_new0 (ThunarTransferQueueEntry);
+  entry->job = job;
+  entry->devices = (gchar **) g_ptr_array_free (devices, FALSE);
+  entry->classes = (guint *) g_array_free (classes, FALSE);
+
+  _transfer_queue_lock (queue);
+  queue->entries = g_list_append (queue->entries, entry);
+  entry->running = thunar_transfer_queue_can_start (queue, entry);
+  _transfer_queue_unlock (queue);
+
+  return entry->running;
+}
+
+
+
+/**
+ * thunar_transfer_queue_wait:
+ * @queue : a #ThunarTransferQueue.
+ * @job   : a #ThunarJob added to the @queue.
+ * @error : return location for errors or %NULL.
+ *
+ * Blocks until it's the turn of @job, either because the transfers
+ * before it finished or because the user wants to run it now.
+ *
+ * Return value: %TRUE if the @job may start, %FALSE if it was
+ *               cancelled while waiting.
+ **/
+gboolean
+thunar_transfer_queue_wait (ThunarTransferQueue *queue,
+                            ThunarJob           *job,
+                            GError             **error)
+{
+  ThunarTransferQueueEntry *entry;
+  GCancellable             *cancellable;
+  gulong                    handler_id;
+
+  _thunar_return_val_if_fail (THUNAR_IS_TRANSFER_QUEUE (queue), FALSE);
+  _thunar_return_val_if_fail (THUNAR_IS_JOB (job), FALSE);
+  _thunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  cancellable = exo_job_get_cancellable (EXO_JOB (job));
+
+  /* this runs the handler right away if the job is already cancelled,
+   * so it must be connected without holding the lock */
+  handler_id = g_cancellable_connect (cancellable, G_CALLBACK (thunar_transfer_queue_cancelled),
+                                      queue, NULL);
+
+  _transfer_queue_lock (queue);
+
+  entry = thunar_transfer_queue_lookup (queue, job);
+  _thunar_assert (entry != NULL);
+
+  while (!g_cancellable_is_cancelled (cancellable))
+    {
+      if (thunar_transfer_queue_can_start (queue, entry))
+        {
+          entry->running = TRUE;
+          break;
+        }
+
+      _transfer_queue_wait (queue);
+    }
+
+  _transfer_queue_unlock (queue);
+
+  g_cancellable_disconnect (cancellable, handler_id);
+
+  return !exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+}
+
+
+
+/**
+ * thunar_transfer_queue_remove:
+ * @queue : a #ThunarTransferQueue.
+ * @job   : a #ThunarJob added to the @queue.
+ *
+ * Removes the @job from the @queue, which gives the next jobs waiting
+ * for the same devices a chance to start.
+ **/
+void
+thunar_transfer_queue_remove (ThunarTransferQueue *queue,
+                              ThunarJob           *job)
+{
+  ThunarTransferQueueEntry *entry;
+
+  _thunar_return_if_fail (THUNAR_IS_TRANSFER_QUEUE (queue));
+  _thunar_return_if_fail (THUNAR_IS_JOB (job));
+
+  _transfer_queue_lock (queue);
+
+  entry = thunar_transfer_queue_lookup (queue, job);
+  if (G_LIKELY (entry != NULL))
+    {
+      queue->entries = g_list_remove (queue->entries, entry);
+      thunar_transfer_queue_entry_free (entry);
+      _transfer_queue_signal (queue);
+    }
+
+  _transfer_queue_unlock (queue);
+}
+
+
+
+/**
+ * thunar_transfer_queue_run_now:
+ * @queue : a #ThunarTransferQueue.
+ * @job   : a #ThunarJob waiting in the @queue.
+ *
+ * Lets @job start right away, regardless of the other transfers
+ * running on the same devices.
+ **/
+void
+thunar_transfer_queue_run_now (ThunarTransferQueue *queue,
+                               ThunarJob           *job)
+{
+  ThunarTransferQueueEntry *entry;
+
+  _thunar_return_if_fail (THUNAR_IS_TRANSFER_QUEUE (queue));
+  _thunar_return_if_fail (THUNAR_IS_JOB (job));
+
+  _transfer_queue_lock (queue);
+
+  entry = thunar_transfer_queue_lookup (queue, job);
+  if (G_LIKELY (entry != NULL))
+    {
+      entry->forced = TRUE;
+      _transfer_queue_signal (queue);
+    }
+
+  _transfer_queue_unlock (queue);
+}
+
+
+
+/**
+ * thunar_transfer_queue_move:
+ * @queue     : a #ThunarTransferQueue.
+ * @job       : a #ThunarJob waiting in the @queue.
+ * @direction : negative to move @job ahead of the waiting job before
+ *              it, positive to move it behind the next one.
+ *
+ * Changes the order in which the waiting jobs are started.
+ **/
+void
+thunar_transfer_queue_move (ThunarTransferQueue *queue,
+                            ThunarJob           *job,
+                            gint                 direction)
+{
+  ThunarTransferQueueEntry *entry;
+  GList                    *lp;
+  GList                    *sibling;
+
+  _thunar_return_if_fail (THUNAR_IS_TRANSFER_QUEUE (queue));
+  _thunar_return_if_fail (THUNAR_IS_JOB (job));
+
+  _transfer_queue_lock (queue);
+
+  entry = thunar_transfer_queue_lookup (queue, job);
+  if (G_LIKELY (entry != NULL && !entry->running && direction != 0))
+    {
+      lp = g_list_find (queue->entries, entry);
+
+      /* find the neighbour among the waiting jobs */
+      for (sibling = (direction < 0) ? lp->prev : lp->next;
+           sibling != NULL && ((ThunarTransferQueueEntry *) sibling->data)->running;
+           sibling = (direction < 0) ? sibling->prev : sibling->next)
+        ;
+
+      if (sibling != NULL)
+        {
+          /* swap both jobs */
+          lp->data = sibling->data;
+          sibling->data = entry;
+          _transfer_queue_signal (queue);
+        }
+    }
+
+  _transfer_queue_unlock (queue);
+}
@@ -0,0 +1,59 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __THUNAR_TRANSFER_QUEUE_H__
+#define __THUNAR_TRANSFER_QUEUE_H__
+
+#include <thunar/thunar-job.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ThunarTransferQueueClass ThunarTransferQueueClass;
+typedef struct _ThunarTransferQueue      ThunarTransferQueue;
+
+#define THUNAR_TYPE_TRANSFER_QUEUE            (thunar_transfer_queue_get_type ())
+#define THUNAR_TRANSFER_QUEUE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), THUNAR_TYPE_TRANSFER_QUEUE, ThunarTransferQueue))
+#define THUNAR_TRANSFER_QUEUE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), THUNAR_TYPE_TRANSFER_QUEUE, ThunarTransferQueueClass))
+#define THUNAR_IS_TRANSFER_QUEUE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), THUNAR_TYPE_TRANSFER_QUEUE))
+#define THUNAR_IS_TRANSFER_QUEUE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), THUNAR_TYPE_TRANSFER_QUEUE))
+#define THUNAR_TRANSFER_QUEUE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), THUNAR_TYPE_TRANSFER_QUEUE, ThunarTransferQueueClass))
+
+GType                thunar_transfer_queue_get_type (void) G_GNUC_CONST;
+
+ThunarTransferQueue *thunar_transfer_queue_get      (void) G_GNUC_MALLOC;
+
+gboolean             thunar_transfer_queue_add      (ThunarTransferQueue *queue,
+                                                     ThunarJob           *job,
+                                                     GList               *file_list);
+gboolean             thunar_transfer_queue_wait     (ThunarTransferQueue *queue,
+                                                     ThunarJob           *job,
+                                                     GError             **error);
+void                 thunar_transfer_queue_remove   (ThunarTransferQueue *queue,
+                                                     ThunarJob           *job);
+
+void                 thunar_transfer_queue_run_now  (ThunarTransferQueue *queue,
+                                                     ThunarJob           *job);
+void                 thunar_transfer_queue_move     (ThunarTransferQueue *queue,
+                                                     ThunarJob           *job,
+                                                     gint                 direction);
+
+G_END_DECLS
+
+#endif /* !__THUNAR_TRANSFER_QUEUE_H__ */
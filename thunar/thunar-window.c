@@ -158,6 +158,10 @@ static void     thunar_window_action_open_new_window      (GtkAction
                                                            ThunarWindow           *window);
 static void     thunar_window_action_empty_trash          (GtkAction              *action,
                                                            ThunarWindow           *window);
+static void     thunar_window_action_resume_transfers     (GtkAction              *action,
+                                                           ThunarWindow           *window);
+static void     thunar_window_action_discard_transfers    (GtkAction              *action,
+                                                           ThunarWindow           *window);
 static void     thunar_window_action_detach_tab           (GtkAction              *action,
                                                            ThunarWindow           *window);
 static void     thunar_window_action_close_all_windows    (GtkAction              *action,
@@ -232,6 +236,9 @@ static void     thunar_window_menu_item_deselected        (GtkWidget
 static void     thunar_window_update_custom_actions       (ThunarView             *view,
                                                            GParamSpec             *pspec,
                                                            ThunarWindow           *window);
+static void     thunar_window_pending_transfers_changed   (ThunarApplication      *application,
+                                                           GParamSpec             *pspec,
+                                                           ThunarWindow           *window);
 static void     thunar_window_notify_loading              (ThunarView             *view,
                                                            GParamSpec             *pspec,
                                                            ThunarWindow           *window);
@@ -354,6 +361,8 @@ static GtkActionEntry action_entries[] =
   { "new-window", "window-new", N_ ("New _Window"), "<control>N", N_ ("Open a new Thunar window for the displayed location"), G_CALLBACK (thunar_window_action_open_new_window), },
   { "sendto-menu", NULL, N_ ("_Send To"), NULL, },
   { "empty-trash", NULL, N_ ("_Empty Trash"), NULL, N_ ("Delete all files and folders in the Trash"), G_CALLBACK (thunar_window_action_empty_trash), },
+  { "resume-transfers", NULL, N_ ("_Resume Interrupted Transfers"), NULL, N_ ("Continue copying and moving files where it was interrupted"), G_CALLBACK (thunar_window_action_resume_transfers), },
+  { "discard-transfers", NULL, N_ ("_Discard Interrupted Transfers"), NULL, N_ ("Forget the interrupted copy and move operations, so they cannot be resumed"), G_CALLBACK (thunar_window_action_discard_transfers), },
   { "detach-tab", NULL, N_ ("Detac_h Tab"), NULL, N_ ("Open current folder in a new window"), G_CALLBACK (thunar_window_action_detach_tab), },
   { "close-all-windows", NULL, N_ ("Close _All Windows"), "<control><shift>W", N_ ("Close all Thunar windows"), G_CALLBACK (thunar_window_action_close_all_windows), },
   { "close-tab", "window-close", N_ ("C_lose Tab"), "<control>W", N_ ("Close this folder"), G_CALLBACK (thunar_window_action_close_tab), },
@@ -696,24 +705,25 @@ view_index2type (gint idx)
 static void
 thunar_window_init (ThunarWindow *window)
 {
-  GtkRadioAction *radio_action;
-  GtkAccelGroup  *accel_group;
-  GtkWidget      *label;
-  GtkWidget      *infobar;
-  GtkWidget      *item;
-  GtkAction      *action;
-  gboolean        last_show_hidden;
-  gboolean        last_menubar_visible;
-  GSList         *group;
-  gchar          *last_location_bar;
-  gchar          *last_side_pane;
-  GType           type;
-  gint            last_separator_position;
-  gint            last_window_width;
-  gint            last_window_height;
-  gboolean        last_window_maximized;
-  gboolean        last_statusbar_visible;
-  GtkRcStyle     *style;
+  ThunarApplication *application;
+  GtkRadioAction    *radio_action;
+  GtkAccelGroup     *accel_group;
+  GtkWidget         *label;
+  GtkWidget         *infobar;
+  GtkWidget         *item;
+  GtkAction         *action;
+  gboolean           last_show_hidden;
+  gboolean           last_menubar_visible;
+  GSList            *group;
+  gchar             *last_location_bar;
+  gchar             *last_side_pane;
+  GType              type;
+  gint               last_separator_position;
+  gint               last_window_width;
+  gint               last_window_height;
+  gboolean           last_window_maximized;
+  gboolean           last_statusbar_visible;
+  GtkRcStyle        *style;
 
   /* unset the view type */
   window->view_type = G_TYPE_NONE;
@@ -764,6 +774,13 @@ thunar_window_init (ThunarWindow *window)
   action = gtk_action_group_get_action (window->action_group, "show-hidden");
   gtk_toggle_action_set_active (GTK_TOGGLE_ACTION (action), last_show_hidden);
 
+  /* offer the interrupted transfers the application found */
+  application = thunar_application_get ();
+  g_signal_connect_object (G_OBJECT (application), "notify::pending-transfers",
+                           G_CALLBACK (thunar_window_pending_transfers_changed), window, 0);
+  thunar_window_pending_transfers_changed (application, NULL, window);
+  g_object_unref (G_OBJECT (application));
+
   /*
    * add view options
    */
@@ -2419,6 +2436,34 @@ thunar_window_action_empty_trash (GtkAction    *action,
 
 
 
+static void
+thunar_window_action_resume_transfers (GtkAction    *action,
+                                       ThunarWindow *window)
+{
+  ThunarApplication *application;
+
+  /* launch the operation */
+  application = thunar_application_get ();
+  thunar_application_resume_transfers (application, GTK_WIDGET (window));
+  g_object_unref (G_OBJECT (application));
+}
+
+
+
+static void
+thunar_window_action_discard_transfers (GtkAction    *action,
+                                        ThunarWindow *window)
+{
+  ThunarApplication *application;
+
+  /* drop the journals */
+  application = thunar_application_get ();
+  thunar_application_discard_transfers (application);
+  g_object_unref (G_OBJECT (application));
+}
+
+
+
 static void
 thunar_window_action_detach_tab (GtkAction    *action,
                                  ThunarWindow *window)
@@ -3584,6 +3629,27 @@ thunar_window_update_custom_actions (ThunarView   *view,
 
 
 
+static void
+thunar_window_pending_transfers_changed (ThunarApplication *application,
+                                         GParamSpec        *pspec,
+                                         ThunarWindow      *window)
+{
+  GtkAction *action;
+  gboolean   pending_transfers;
+
+  _thunar_return_if_fail (THUNAR_IS_APPLICATION (application));
+  _thunar_return_if_fail (THUNAR_IS_WINDOW (window));
+
+  /* update the "Resume" and "Discard Interrupted Transfers" actions */
+  pending_transfers = thunar_application_get_pending_transfers (application);
+  action = gtk_action_group_get_action (window->action_group, "resume-transfers");
+  gtk_action_set_visible (action, pending_transfers);
+  action = gtk_action_group_get_action (window->action_group, "discard-transfers");
+  gtk_action_set_visible (action, pending_transfers);
+}
+
+
+
 static void
 thunar_window_notify_loading (ThunarView   *view,
                               GParamSpec   *pspec,